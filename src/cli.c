@@ -1,4 +1,5 @@
 #include <getopt.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,6 +7,7 @@
 #include <unistd.h>
 
 #include "cli.h"
+#include "utils.h"
 
 // Global variable to track pager process
 static pid_t pager_pid = -1;
@@ -42,6 +44,49 @@ static alignment_t parse_alignment(const char *align_str)
     return ALIGN_LEFT;  // default
 }
 
+static int parse_format(const char *format_str, output_format_t *format)
+{
+    if (strcasecmp(format_str, "table") == 0)
+        *format = FORMAT_TABLE;
+    else if (strcasecmp(format_str, "text") == 0)
+        *format = FORMAT_TEXT;
+    else if (strcasecmp(format_str, "ndjson") == 0)
+        *format = FORMAT_NDJSON;
+    else if (strcasecmp(format_str, "arrow") == 0)
+        *format = FORMAT_ARROW;
+    else
+        return -1;
+    return 0;
+}
+
+// --rows FROM-TO, FROM-, -TO or a single record N, 1-based and inclusive
+static int parse_rows(const char *str, long *from, long *to)
+{
+    char *end;
+    *from = 1;
+    *to   = LONG_MAX;
+
+    if (*str != '-') {
+        *from = strtol(str, &end, 10);
+        if (end == str || *from < 1)
+            return -1;
+        str = end;
+        if (*str == '\0') {
+            *to = *from;
+            return 0;
+        }
+        if (*str != '-')
+            return -1;
+    }
+    str++;
+    if (*str != '\0') {
+        *to = strtol(str, &end, 10);
+        if (end == str || *end != '\0' || *to < *from)
+            return -1;
+    }
+    return 0;
+}
+
 void print_help(const char *program_name)
 {
     printf("Usage: %s [OPTIONS] [FILE]\n\n", program_name);
@@ -52,7 +97,8 @@ void print_help(const char *program_name)
     printf("  -H, --no-headers          Specify that the input has no header row\n");
     printf("  -n, --number              Prepend a column of line numbers to the table\n");
     printf("  -t, --tsv                 Use '\\t' as delimiter for tsv\n");
-    printf("  -d, --delimiter <CHAR>    Specify the field delimiter [default: ,]\n");
+    printf("  -d, --delimiter <CHAR>    Specify the field delimiter [default: , unless\n");
+    printf("                            tab, ; or | splits a file's first lines evenly]\n");
     printf("  -s, --style <STYLE>       Specify the border style [default: sharp]\n");
     printf("                            [possible values: none, ascii, ascii2, sharp, rounded,\n");
     printf("                             reinforced, markdown, grid]\n");
@@ -66,6 +112,49 @@ void print_help(const char *program_name)
     printf("                            [possible values: left, center, right]\n");
     printf("      --body-align <ALIGN>  Specify the alignment of the table body [default: left]\n");
     printf("                            [possible values: left, center, right]\n");
+    printf("      --format <FORMAT>     Specify the output format [default: table]\n");
+    printf("                            [possible values: table, text, ndjson, arrow]\n");
+    printf("      --max-memory <SIZE>   Spill parsed rows to a temp file beyond SIZE bytes\n");
+    printf("                            (suffixes K, M, G, T) [default: unlimited]\n");
+    printf("      --summary             Print per-column statistics instead of the table\n");
+    printf("      --sketch              Print approximate distinct counts, quantiles and\n");
+    printf("                            frequent values per column in constant memory\n");
+    printf("      --sample <NUM>        Show NUM random records in file order\n");
+    printf("      --seed <NUM>          Seed for --sample [default: random]\n");
+    printf("      --group-by <COLS>     Print one row per distinct value of the columns\n");
+    printf("      --agg <AGGS>          Aggregates for --group-by, comma separated\n");
+    printf("                            [default: count] [possible values: count, sum:COL,\n");
+    printf("                             avg:COL, min:COL, max:COL]\n");
+    printf("      --sort-count          Order --group-by results by descending count\n");
+    printf("      --grep <PATTERN>      Only show records containing PATTERN\n");
+    printf("      --grep-col <COL>      Only match --grep against this column\n");
+    printf("      --regex               Treat the --grep pattern as an extended regex\n");
+    printf("      --highlight           Highlight --grep matches in the output\n");
+    printf("      --diff <OLD>          Show records added, removed or changed since OLD\n");
+    printf("      --key <COLS>          Key columns that identify a record for --diff\n");
+    printf("      --join <FILE>         Join the input with FILE on the --on columns\n");
+    printf("      --on <COLS>           Join columns, COL or LEFT=RIGHT, comma separated\n");
+    printf("      --left                Keep input records without a match in --join\n");
+    printf("  -x, --vertical            Print each record as a block of header: value lines\n");
+    printf("      --count               Print the record and column counts and nothing else\n");
+    printf("      --top <NUM>           Show only the first NUM records in --by order\n");
+    printf("      --by <COL[:num][:desc]>\n");
+    printf("                            Order for --top, numeric with :num, largest first\n");
+    printf("                            with :desc\n");
+    printf("      --index-key <COL>     Build a sidecar index of the file by COL\n");
+    printf("      --lookup <COL=VALUES> Show records whose COL is one of the comma-separated\n");
+    printf("                            values, read through the COL index\n");
+    printf("      --fit                 Draw only the columns that fit the terminal width\n");
+    printf("      --columns <COLS>      Draw these columns in this order, the first ones\n");
+    printf("                            take precedence under --fit\n");
+    printf("      --rows <FROM-TO>      Draw only records FROM to TO (1-based, either end may\n");
+    printf("                            be left out), widths still cover the whole table\n");
+    printf("      --serve <SOCKET>      Answer --client requests on SOCKET, keeping parsed\n");
+    printf("                            tables in memory (bounded by --max-memory)\n");
+    printf("      --client <SOCKET>     Have the --serve daemon on SOCKET render the request\n");
+    printf("      --progress            Show parse progress, SIGUSR1 prints it to stderr\n");
+    printf("  -j, --threads <NUM>       Worker threads for measuring and rendering rows\n");
+    printf("                            [default: 0, one per CPU]\n");
     printf("  -P, --disable-pager       Disable pager\n");
     printf("  -h, --help                Print help information\n");
     printf("  -V, --version             Print version information\n");
@@ -79,12 +168,49 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
     args->number        = false;
     args->tsv           = false;
     args->delimiter     = ',';
+    args->delimiter_set = false;
     args->style         = STYLE_SHARP;
     args->padding       = 1;
     args->indent        = 0;
     args->sniff         = 1000;
     args->header_align  = ALIGN_CENTER;
     args->body_align    = ALIGN_LEFT;
+    args->format        = FORMAT_TABLE;
+    args->summary       = false;
+    args->max_memory    = 0;
+    args->threads       = 0;
+    args->sample        = 0;
+    args->seed          = 0;
+    args->seeded        = false;
+    args->group_by      = NULL;
+    args->agg           = NULL;
+    args->sort_count    = false;
+    args->grep          = NULL;
+    args->grep_col      = NULL;
+    args->regex         = false;
+    args->highlight     = false;
+    args->diff          = NULL;
+    args->diff_key      = NULL;
+    args->join          = NULL;
+    args->join_on       = NULL;
+    args->join_left     = false;
+    args->vertical      = false;
+    args->progress      = false;
+    args->count         = false;
+    args->index_key     = NULL;
+    args->lookup        = NULL;
+    args->top           = 0;
+    args->by            = NULL;
+    args->fit           = false;
+    args->columns       = NULL;
+    args->sketch        = false;
+    args->rows_from     = 0;
+    args->rows_to       = LONG_MAX;
+    args->serve         = NULL;
+    args->client        = NULL;
+    args->width         = 0;
+    args->output        = stdout;
+    args->errors        = stderr;
     args->disable_pager = false;
     args->help          = false;
     args->version       = false;
@@ -100,6 +226,37 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
         {"sniff",         required_argument, 0, 1001},
         {"header-align",  required_argument, 0, 1002},
         {"body-align",    required_argument, 0, 1003},
+        {"format",        required_argument, 0, 1004},
+        {"summary",       no_argument,       0, 1005},
+        {"max-memory",    required_argument, 0, 1006},
+        {"sample",        required_argument, 0, 1007},
+        {"seed",          required_argument, 0, 1008},
+        {"group-by",      required_argument, 0, 1009},
+        {"agg",           required_argument, 0, 1010},
+        {"sort-count",    no_argument,       0, 1011},
+        {"grep",          required_argument, 0, 1012},
+        {"grep-col",      required_argument, 0, 1013},
+        {"regex",         no_argument,       0, 1014},
+        {"highlight",     no_argument,       0, 1015},
+        {"diff",          required_argument, 0, 1016},
+        {"key",           required_argument, 0, 1017},
+        {"join",          required_argument, 0, 1018},
+        {"on",            required_argument, 0, 1019},
+        {"left",          no_argument,       0, 1020},
+        {"vertical",      no_argument,       0, 'x' },
+        {"progress",      no_argument,       0, 1021},
+        {"count",         no_argument,       0, 1022},
+        {"index-key",     required_argument, 0, 1023},
+        {"lookup",        required_argument, 0, 1024},
+        {"top",           required_argument, 0, 1025},
+        {"by",            required_argument, 0, 1026},
+        {"fit",           no_argument,       0, 1027},
+        {"columns",       required_argument, 0, 1028},
+        {"sketch",        no_argument,       0, 1029},
+        {"rows",          required_argument, 0, 1030},
+        {"serve",         required_argument, 0, 1031},
+        {"client",        required_argument, 0, 1032},
+        {"threads",       required_argument, 0, 'j' },
         {"disable-pager", no_argument,       0, 'P' },
         {"help",          no_argument,       0, 'h' },
         {"version",       no_argument,       0, 'V' },
@@ -109,7 +266,7 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
     int c;
     int option_index = 0;
 
-    while ((c = getopt_long(argc, argv, "Hntd:s:p:i:PhV", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "Hntd:s:p:i:xj:PhV", long_options, &option_index)) != -1) {
         switch (c) {
             case 'H':
                 args->no_headers = true;
@@ -118,14 +275,16 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
                 args->number = true;
                 break;
             case 't':
-                args->tsv = true;
+                args->tsv           = true;
+                args->delimiter_set = true;
                 break;
             case 'd':
                 if (strlen(optarg) != 1) {
                     fprintf(stderr, "Delimiter must be a single character\n");
                     return -1;
                 }
-                args->delimiter = optarg[0];
+                args->delimiter     = optarg[0];
+                args->delimiter_set = true;
                 break;
             case 's':
                 args->style = parse_style(optarg);
@@ -157,6 +316,160 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
             case 1003:  // --body-align
                 args->body_align = parse_alignment(optarg);
                 break;
+            case 1004:  // --format
+                if (parse_format(optarg, &args->format) != 0) {
+                    fprintf(stderr, "Unknown output format: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 1005:  // --summary
+                args->summary = true;
+                break;
+            case 1006:  // --max-memory
+                if (parse_size(optarg, &args->max_memory) != 0) {
+                    fprintf(stderr, "Invalid memory size: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 1007: {  // --sample
+                char *end;
+                args->sample = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || args->sample <= 0) {
+                    fprintf(stderr, "Sample size must be a positive number\n");
+                    return -1;
+                }
+                break;
+            }
+            case 1008: {  // --seed
+                char *end;
+                args->seed   = strtoul(optarg, &end, 10);
+                args->seeded = true;
+                if (*optarg == '\0' || *end != '\0') {
+                    fprintf(stderr, "Invalid seed: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            }
+            case 1009:  // --group-by
+                free(args->group_by);
+                args->group_by = strdup(optarg);
+                break;
+            case 1010: {  // --agg, repeatable
+                size_t len = (args->agg ? strlen(args->agg) + 1 : 0) + strlen(optarg) + 1;
+                char  *agg = malloc(len);
+                if (!agg) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    return -1;
+                }
+                if (args->agg)
+                    snprintf(agg, len, "%s,%s", args->agg, optarg);
+                else
+                    snprintf(agg, len, "%s", optarg);
+                free(args->agg);
+                args->agg = agg;
+                break;
+            }
+            case 1011:  // --sort-count
+                args->sort_count = true;
+                break;
+            case 1012:  // --grep
+                free(args->grep);
+                args->grep = strdup(optarg);
+                break;
+            case 1013:  // --grep-col
+                free(args->grep_col);
+                args->grep_col = strdup(optarg);
+                break;
+            case 1014:  // --regex
+                args->regex = true;
+                break;
+            case 1015:  // --highlight
+                args->highlight = true;
+                break;
+            case 1016:  // --diff
+                free(args->diff);
+                args->diff = strdup(optarg);
+                break;
+            case 1017:  // --key
+                free(args->diff_key);
+                args->diff_key = strdup(optarg);
+                break;
+            case 1018:  // --join
+                free(args->join);
+                args->join = strdup(optarg);
+                break;
+            case 1019:  // --on
+                free(args->join_on);
+                args->join_on = strdup(optarg);
+                break;
+            case 1020:  // --left
+                args->join_left = true;
+                break;
+            case 'x':
+                args->vertical = true;
+                break;
+            case 1021:  // --progress
+                args->progress = true;
+                break;
+            case 1022:  // --count
+                args->count = true;
+                break;
+            case 1023:  // --index-key
+                free(args->index_key);
+                args->index_key = strdup(optarg);
+                break;
+            case 1024:  // --lookup
+                free(args->lookup);
+                args->lookup = strdup(optarg);
+                break;
+            case 1025: {  // --top
+                char *end;
+                args->top = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || args->top <= 0) {
+                    fprintf(stderr, "--top must be a positive number\n");
+                    return -1;
+                }
+                break;
+            }
+            case 1026:  // --by
+                free(args->by);
+                args->by = strdup(optarg);
+                break;
+            case 1027:  // --fit
+                args->fit = true;
+                break;
+            case 1028:  // --columns
+                free(args->columns);
+                args->columns = strdup(optarg);
+                break;
+            case 1029:  // --sketch
+                args->sketch = true;
+                break;
+            case 1030: {  // --rows
+                long from, to;
+                if (parse_rows(optarg, &from, &to) != 0) {
+                    fprintf(stderr, "Invalid row range: %s\n", optarg);
+                    return -1;
+                }
+                args->rows_from = from - 1;
+                args->rows_to   = to;
+                break;
+            }
+            case 1031:  // --serve
+                free(args->serve);
+                args->serve = strdup(optarg);
+                break;
+            case 1032:  // --client
+                free(args->client);
+                args->client = strdup(optarg);
+                break;
+            case 'j':
+                args->threads = atoi(optarg);
+                if (args->threads < 0) {
+                    fprintf(stderr, "Thread count must be non-negative\n");
+                    return -1;
+                }
+                break;
             case 'P':
                 args->disable_pager = true;
                 break;
@@ -188,6 +501,110 @@ int parse_cli_args(int argc, char *argv[], struct cli_args *args)
         fprintf(stderr, "Cannot specify both --tsv and --delimiter\n");
         return -1;
     }
+    if (args->summary && args->format != FORMAT_TABLE) {
+        fprintf(stderr, "--summary only applies to table output\n");
+        return -1;
+    }
+    if (args->sample > 0 && (args->summary || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--sample only applies to table output\n");
+        return -1;
+    }
+    if (args->group_by && (args->summary || args->sample > 0 || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--group-by only applies to table output\n");
+        return -1;
+    }
+    if (args->grep &&
+        (args->summary || args->sample > 0 || args->group_by || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--grep only applies to table output\n");
+        return -1;
+    }
+    if ((args->grep_col || args->regex || args->highlight) && !args->grep) {
+        fprintf(stderr, "--grep-col, --regex and --highlight require --grep\n");
+        return -1;
+    }
+    if (args->diff && (args->summary || args->sample > 0 || args->group_by || args->grep ||
+                       args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--diff only applies to table output\n");
+        return -1;
+    }
+    if ((args->diff != NULL) != (args->diff_key != NULL)) {
+        fprintf(stderr, "--diff and --key must be used together\n");
+        return -1;
+    }
+    if (args->join && (args->summary || args->sample > 0 || args->group_by || args->grep ||
+                       args->diff || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--join only applies to table output\n");
+        return -1;
+    }
+    if ((args->join != NULL) != (args->join_on != NULL)) {
+        fprintf(stderr, "--join and --on must be used together\n");
+        return -1;
+    }
+    if (args->join_left && !args->join) {
+        fprintf(stderr, "--left requires --join\n");
+        return -1;
+    }
+    if (args->vertical && (args->summary || args->sample > 0 || args->group_by || args->grep ||
+                           args->diff || args->join || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--vertical only applies to plain table output\n");
+        return -1;
+    }
+    if (args->count && (args->summary || args->sample > 0 || args->group_by || args->grep ||
+                        args->diff || args->join || args->vertical ||
+                        args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--count cannot be combined with other output modes\n");
+        return -1;
+    }
+    if ((args->index_key || args->lookup) &&
+        (args->summary || args->sample > 0 || args->group_by || args->grep || args->diff ||
+         args->join || args->vertical || args->count || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--index-key and --lookup only apply to table output\n");
+        return -1;
+    }
+    if ((args->index_key || args->lookup) && !args->file) {
+        fprintf(stderr, "--index-key and --lookup need an input file\n");
+        return -1;
+    }
+    if (args->top > 0 &&
+        (args->summary || args->sample > 0 || args->group_by || args->grep || args->diff ||
+         args->join || args->vertical || args->count || args->index_key || args->lookup ||
+         args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--top only applies to plain table output\n");
+        return -1;
+    }
+    if ((args->top > 0) != (args->by != NULL)) {
+        fprintf(stderr, "--top and --by must be used together\n");
+        return -1;
+    }
+    if (args->sketch &&
+        (args->summary || args->sample > 0 || args->group_by || args->grep || args->diff ||
+         args->join || args->vertical || args->count || args->index_key || args->lookup ||
+         args->top > 0 || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--sketch cannot be combined with other output modes\n");
+        return -1;
+    }
+    if ((args->fit || args->columns) &&
+        (args->summary || args->vertical || args->count || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--fit and --columns only apply to table output\n");
+        return -1;
+    }
+    if ((args->rows_from > 0 || args->rows_to < LONG_MAX) &&
+        (args->vertical || args->count || args->format != FORMAT_TABLE)) {
+        fprintf(stderr, "--rows only applies to table output\n");
+        return -1;
+    }
+    if (args->serve && (args->client || args->file)) {
+        fprintf(stderr, "--serve takes no input file and no --client\n");
+        return -1;
+    }
+    if (args->client && !args->file) {
+        fprintf(stderr, "--client needs an input file\n");
+        return -1;
+    }
+    if ((args->agg || args->sort_count) && !args->group_by) {
+        fprintf(stderr, "--agg and --sort-count require --group-by\n");
+        return -1;
+    }
 
     return 0;
 }
@@ -198,9 +615,39 @@ void free_cli_args(struct cli_args *args)
         free(args->file);
         args->file = NULL;
     }
+    if (args) {
+        free(args->group_by);
+        free(args->agg);
+        free(args->grep);
+        free(args->grep_col);
+        free(args->diff);
+        free(args->diff_key);
+        free(args->join);
+        free(args->join_on);
+        free(args->index_key);
+        free(args->lookup);
+        free(args->by);
+        free(args->columns);
+        free(args->serve);
+        free(args->client);
+        args->group_by  = NULL;
+        args->agg       = NULL;
+        args->grep      = NULL;
+        args->grep_col  = NULL;
+        args->diff      = NULL;
+        args->diff_key  = NULL;
+        args->join      = NULL;
+        args->join_on   = NULL;
+        args->index_key = NULL;
+        args->lookup    = NULL;
+        args->by        = NULL;
+        args->columns   = NULL;
+        args->serve     = NULL;
+        args->client    = NULL;
+    }
 }
 
-void setup_pager(bool disable_pager)
+void setup_pager(bool disable_pager, bool colors)
 {
     // Only setup pager if output is going to a terminal and pager is not disabled
     if (disable_pager || !isatty(STDOUT_FILENO)) {
@@ -234,9 +681,10 @@ void setup_pager(bool disable_pager)
         dup2(pipefd[0], STDIN_FILENO);  // Redirect stdin to read end of pipe
         close(pipefd[0]);
 
-        // Set environment for less if using default pager
+        // Set environment for less if using default pager, passing the
+        // --highlight escapes through raw
         if (strcmp(pager_cmd, "less") == 0) {
-            setenv("LESS", "-SF", 0);  // Don't override existing LESS settings
+            setenv("LESS", colors ? "-SRF" : "-SF", 0);  // Don't override existing LESS settings
         }
 
         // Execute pager
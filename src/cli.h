@@ -2,6 +2,8 @@
 #define CLI_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
 
 typedef enum {
     STYLE_NONE,
@@ -20,27 +22,71 @@ typedef enum {
     ALIGN_RIGHT
 } alignment_t;
 
+typedef enum {
+    FORMAT_TABLE,
+    FORMAT_TEXT,
+    FORMAT_NDJSON,
+    FORMAT_ARROW
+} output_format_t;
+
 struct cli_args {
-    char         *file;
-    bool          no_headers;
-    bool          number;
-    bool          tsv;
-    char          delimiter;
-    table_style_t style;
-    int           padding;
-    int           indent;
-    int           sniff;
-    alignment_t   header_align;
-    alignment_t   body_align;
-    bool          disable_pager;
-    bool          help;
-    bool          version;
+    char           *file;
+    bool            no_headers;
+    bool            number;
+    bool            tsv;
+    char            delimiter;
+    bool            delimiter_set;  // -d or -t was given, nothing is sniffed
+    table_style_t   style;
+    int             padding;
+    int             indent;
+    int             sniff;
+    alignment_t     header_align;
+    alignment_t     body_align;
+    output_format_t format;
+    bool            summary;
+    size_t          max_memory;
+    int             threads;  // 0 means one per online CPU
+    long            sample;   // Random records to show, 0 shows all
+    unsigned long   seed;
+    bool            seeded;
+    char           *group_by;  // Comma-separated key columns
+    char           *agg;       // Comma-separated aggregates, count by default
+    bool            sort_count;
+    char           *grep;      // Only show records containing this pattern
+    char           *grep_col;  // Restrict --grep to one column
+    bool            regex;     // --grep is a POSIX extended regex
+    bool            highlight;
+    char           *diff;      // Old file to compare the input against
+    char           *diff_key;  // Comma-separated key columns for --diff
+    char           *join;      // File to join the input with
+    char           *join_on;   // Comma-separated LEFT[=RIGHT] join columns
+    bool            join_left;  // Keep input records without a match
+    bool            vertical;   // One block of header: value lines per record
+    bool            progress;   // Report parse progress on the terminal and on SIGUSR1
+    bool            count;      // Only print the record and column counts
+    char           *index_key;  // Column to build a sidecar index for
+    char           *lookup;     // COL=VALUE[,VALUE...] point lookup through the index
+    long            top;        // Keep only this many records in --by order
+    char           *by;         // COL[:num][:desc] ordering for --top
+    bool            fit;        // Draw only the columns that fit the terminal
+    char           *columns;    // Comma-separated columns to draw, in order
+    bool            sketch;     // Approximate per-column statistics in constant memory
+    long            rows_from;  // First record to draw, 0-based
+    long            rows_to;    // Records before this one are drawn, LONG_MAX for all
+    char           *serve;      // Socket path to answer --client requests on
+    char           *client;     // Socket path of a --serve daemon to ask instead
+    int             width;      // Terminal width for --fit, 0 asks the terminal
+    FILE           *output;     // Where reports go, stdout unless answering a client
+    FILE           *errors;     // Where diagnostics go, stderr unless answering a client
+    bool            disable_pager;
+    bool            help;
+    bool            version;
 };
 
 int  parse_cli_args(int argc, char *argv[], struct cli_args *args);
 void print_help(const char *program_name);
 void free_cli_args(struct cli_args *args);
-void setup_pager(bool disable_pager);
+void setup_pager(bool disable_pager, bool colors);
 void wait_for_pager(void);
 
 #endif  // CLI_H
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "column_view.h"
+#include "utils.h"
+
+#define DEFAULT_TERMINAL_WIDTH 80
+#define MIN_CLIPPED_WIDTH      4  // Narrower leftovers drop the column instead
+
+// $COLUMNS wins as it does for ls; stdout is usually the pager's pipe by
+// now, so the other standard streams and the controlling terminal are asked
+// as well.
+int terminal_width(void)
+{
+    const char *env = getenv("COLUMNS");
+    if (env && atoi(env) > 0)
+        return atoi(env);
+
+    struct winsize ws;
+    const int      fds[] = {STDOUT_FILENO, STDERR_FILENO, STDIN_FILENO};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (ioctl(fds[i], TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+            return ws.ws_col;
+    }
+
+    int fd = open("/dev/tty", O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        bool ok = ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0;
+        close(fd);
+        if (ok)
+            return ws.ws_col;
+    }
+    return DEFAULT_TERMINAL_WIDTH;
+}
+
+// Field indices in priority order: the --columns list, or every field
+static int column_order(const struct csv_data *csv,
+                        const struct cli_args *args,
+                        int                  **order,
+                        int                   *count)
+{
+    int fields = csv->max_columns - (args->number ? 1 : 0);
+    if (!args->columns) {
+        // Records not measured yet may hold more fields than the header
+        for (int r = 0; r < csv->unmeasured; r++) {
+            if (csv->records[r].field_count > fields)
+                fields = csv->records[r].field_count;
+        }
+        *order = malloc((size_t)(fields > 0 ? fields : 1) * sizeof(int));
+        if (!*order)
+            return -1;
+        for (int i = 0; i < fields; i++) {
+            (*order)[i] = i;
+        }
+        *count = fields;
+        return 0;
+    }
+
+    const char *const *names = csv->header ? (const char *const *)csv->header->fields : NULL;
+    int                named = csv->header ? csv->header->field_count : 0;
+    char              *list  = strdup(args->columns);
+    *order                   = malloc((strlen(args->columns) / 2 + 1) * sizeof(int));
+    *count                   = 0;
+    if (!list || !*order) {
+        free(list);
+        free(*order);
+        return -1;
+    }
+
+    char *save;
+    for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        int column = resolve_column(tok, names, named);
+        if (column < 0) {
+            fprintf(args->errors, "Unknown column: %s\n", tok);
+            free(list);
+            free(*order);
+            return -1;
+        }
+        (*order)[(*count)++] = column;
+    }
+    free(list);
+    return 0;
+}
+
+static int separator_width(const char *sep)
+{
+    return sep ? unicode_display_width(sep) : 0;
+}
+
+int column_view_init(struct column_view    *view,
+                     const struct csv_data *csv,
+                     const struct cli_args *args,
+                     const table_format_t  *style)
+{
+    int *order;
+    int  candidates;
+    if (column_order(csv, args, &order, &candidates) != 0)
+        return -1;
+
+    int slots     = candidates + (args->number ? 1 : 0);
+    view->fields  = malloc((size_t)(slots ? slots : 1) * sizeof(int));
+    view->widths  = malloc((size_t)(slots ? slots : 1) * sizeof(int));
+    view->count   = 0;
+    view->clipped = -1;
+    if (!view->fields || !view->widths) {
+        free(order);
+        column_view_free(view);
+        return -1;
+    }
+
+    // A served request carries the width of the client's terminal
+    int limit = 0;
+    if (args->fit)
+        limit = args->width > 0 ? args->width : terminal_width();
+
+    // Columns are taken in priority order until the next one overflows the
+    // terminal, so nothing past that one is ever measured
+    int used = style->indent + separator_width(style->col_seps.lhs) +
+               separator_width(style->col_seps.rhs);
+    int mid  = separator_width(style->col_seps.mid);
+    int ret  = 0;
+
+    for (int k = args->number ? -1 : 0; k < candidates; k++) {
+        int field = k < 0 ? -1 : order[k];
+        int width = 0;
+        if (field < 0) {
+            width = csv->column_widths[0];
+        } else {
+            int slot = field + (args->number ? 1 : 0);
+            int rest = csv_data_measure_column(csv, field, args->threads);
+            if (rest < 0) {
+                ret = -1;
+                break;
+            }
+            width = slot < csv->max_columns ? csv->column_widths[slot] : 0;
+            if (rest > width)
+                width = rest;
+        }
+
+        int cost = (view->count > 0 ? mid : 0) + style->padding * 2;
+        if (args->fit && used + cost + width > limit) {
+            int room = limit - used - cost;
+            if (room < MIN_CLIPPED_WIDTH && view->count > 0)
+                break;
+            width         = room > 1 ? room : 1;
+            view->clipped = view->count;
+        }
+
+        view->fields[view->count] = field;
+        view->widths[view->count] = width;
+        view->count++;
+        used += cost + width;
+        if (view->clipped >= 0)
+            break;
+    }
+
+    free(order);
+    if (ret != 0)
+        column_view_free(view);
+    return ret;
+}
+
+void column_view_free(struct column_view *view)
+{
+    free(view->fields);
+    free(view->widths);
+    view->fields = NULL;
+    view->widths = NULL;
+    view->count  = 0;
+}
\ No newline at end of file
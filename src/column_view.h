@@ -0,0 +1,27 @@
+#ifndef COLUMN_VIEW_H
+#define COLUMN_VIEW_H
+
+#include "cli.h"
+#include "csv_parser.h"
+#include "table_printer.h"
+
+// The columns print_table draws, in order. --columns picks and orders the
+// fields, --fit keeps only as many as the terminal can show; fields left
+// out are neither measured nor formatted.
+struct column_view {
+    int *fields;   // Field index of each drawn column, -1 for the sequence number
+    int *widths;   // Drawn width of each column
+    int  count;
+    int  clipped;  // Column narrowed to fit the terminal, or -1
+};
+
+int  column_view_init(struct column_view    *view,
+                      const struct csv_data *csv,
+                      const struct cli_args *args,
+                      const table_format_t  *style);
+void column_view_free(struct column_view *view);
+
+// Width of the terminal the table ends up on
+int terminal_width(void);
+
+#endif  // COLUMN_VIEW_H
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "count.h"
+#include "csv_scan.h"
+#include "parallel.h"
+
+#define BLOCK           64
+#define MIN_CHUNK_BYTES (1 << 22)  // Smallest slice of the file worth a thread
+#define CONFIRM_RECORDS 4
+#define RESYNC_LINES    64
+#define STREAM_BUFFER   (1 << 20)
+
+// Bit i of each mask is set when byte i of a block matches
+struct block_masks {
+    uint64_t newline;
+    uint64_t cr;
+    uint64_t quote;
+    uint64_t blank;  // Space or tab that is not the delimiter
+};
+
+struct count_chunk {
+    const char *begin;
+    const char *end;
+    const char *stop;  // End of the last record started before end
+    long        records;
+};
+
+struct count_job {
+    struct count_chunk *chunks;
+    const char         *file_end;
+    char                delim;
+};
+
+static void scan_block(const char *p, char delim, struct block_masks *m)
+{
+    *m = (struct block_masks){0};
+#if defined(__SSE2__)
+    // A blank delimiter is matched as a quote instead, which already forces the slow path
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr      = _mm_set1_epi8('\r');
+    const __m128i quote   = _mm_set1_epi8('"');
+    const __m128i space   = _mm_set1_epi8(delim == ' ' ? '"' : ' ');
+    const __m128i tab     = _mm_set1_epi8(delim == '\t' ? '"' : '\t');
+
+    for (int i = 0; i < BLOCK; i += 16) {
+        __m128i  v     = _mm_loadu_si128((const __m128i *)(const void *)(p + i));
+        __m128i  blank = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        uint64_t nl    = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+        uint64_t r     = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+        uint64_t q     = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote));
+        uint64_t b     = (uint32_t)_mm_movemask_epi8(blank);
+        m->newline |= nl << i;
+        m->cr |= r << i;
+        m->quote |= q << i;
+        m->blank |= b << i;
+    }
+#else
+    for (int i = 0; i < BLOCK; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        char     c   = p[i];
+        if (c == '\n')
+            m->newline |= bit;
+        else if (c == '\r')
+            m->cr |= bit;
+        else if (c == '"')
+            m->quote |= bit;
+        else if ((c == ' ' || c == '\t') && c != delim)
+            m->blank |= bit;
+    }
+#endif
+}
+
+// Count the records starting in [p, limit), scanning them up to end, and
+// return the position after the last one. Whole blocks of unquoted lines
+// are counted by their line feeds; a block with a quote, a lone carriage
+// return or a line opening with a blank is rescanned by csv_scan_record from
+// the start of its first line, which libcsv's rules apply to exactly. Unless
+// eof is set, a record running into end is left uncounted for the next call.
+static const char *count_span(const char *p,
+                              const char *limit,
+                              const char *end,
+                              char        delim,
+                              bool        eof,
+                              long       *records)
+{
+    long count = 0;
+
+    while (p < limit) {
+        const char *line  = p;
+        uint64_t    carry = 1;  // Bit 0 of the next block starts a line
+
+        while (limit - p >= BLOCK) {
+            struct block_masks m;
+            scan_block(p, delim, &m);
+
+            uint64_t starts = m.newline << 1 | carry;
+            uint64_t lone   = m.cr & ~(m.newline >> 1);
+            if (m.quote || lone || (starts & (m.blank | m.cr)))
+                break;
+
+            // A line feed ends a record unless it is the whole line
+            count += __builtin_popcountll(m.newline & ~starts);
+            if (m.newline)
+                line = p + BLOCK - __builtin_clzll(m.newline);
+            carry = m.newline >> (BLOCK - 1);
+            p += BLOCK;
+        }
+
+        const char *until = limit - p > BLOCK ? p + BLOCK : limit;
+        for (p = line; p < until;) {
+            int         fields;
+            bool        clean;
+            const char *next = csv_scan_record(p, end, delim, &fields, &clean);
+            if (next == end && !eof) {
+                *records += count;
+                return p;
+            }
+            if (fields > 0)
+                count++;
+            p = next;
+        }
+    }
+
+    *records += count;
+    return p;
+}
+
+static void count_chunks(void *ctx, long begin, long end, int worker __attribute__((unused)))
+{
+    struct count_job *job = ctx;
+
+    for (long c = begin; c < end; c++) {
+        struct count_chunk *chunk = &job->chunks[c];
+        chunk->stop =
+            count_span(chunk->begin, chunk->end, job->file_end, job->delim, true, &chunk->records);
+    }
+}
+
+// Count file slices on worker threads. Slice starts are guessed at confirmed
+// line breaks; unless every slice stops exactly where the next one begins a
+// guess split a record and the file is counted serially instead.
+static int count_mapped(const char            *data,
+                        size_t                 size,
+                        int                    columns,
+                        const struct cli_args *args,
+                        long                  *records)
+{
+    const char *end     = data + size;
+    char        delim   = args->tsv ? '\t' : args->delimiter;
+    int         threads = parallel_threads(args->threads, (long)size, MIN_CHUNK_BYTES);
+
+    if (threads <= 1) {
+        count_span(data, end, end, delim, true, records);
+        return 0;
+    }
+
+    struct count_chunk *chunks = calloc((size_t)threads, sizeof(*chunks));
+    if (!chunks)
+        return -1;
+
+    chunks[0].begin = data;
+    for (int i = 1; i < threads; i++) {
+        const char *guess = data + size / (size_t)threads * (size_t)i - 1;
+        const char *start = csv_resync(guess, end, delim, columns, CONFIRM_RECORDS, RESYNC_LINES);
+        if (!start || start < chunks[i - 1].begin)
+            start = start ? chunks[i - 1].begin : end;
+        chunks[i].begin   = start;
+        chunks[i - 1].end = start;
+    }
+    chunks[threads - 1].end = end;
+
+    struct count_job job = {.chunks = chunks, .file_end = end, .delim = delim};
+    parallel_for(threads, threads, count_chunks, &job);
+
+    bool aligned = true;
+    long total   = 0;
+    for (int i = 0; i < threads; i++) {
+        if (i < threads - 1 && chunks[i].stop != chunks[i + 1].begin)
+            aligned = false;
+        total += chunks[i].records;
+    }
+    free(chunks);
+
+    if (aligned)
+        *records = total;
+    else
+        count_span(data, end, end, delim, true, records);
+    return 0;
+}
+
+// Count a pipe through a buffer, carrying the unfinished record over to the
+// next read and doubling the buffer when a single record does not fit
+static int count_stream(FILE *input, const struct cli_args *args, long *records, int *columns)
+{
+    char   delim = args->tsv ? '\t' : args->delimiter;
+    size_t cap   = STREAM_BUFFER;
+    size_t len   = 0;
+    bool   eof   = false;
+    bool   first = true;
+    char  *buf   = malloc(cap);
+    if (!buf) {
+        fprintf(args->errors, "Memory allocation failed\n");
+        return -1;
+    }
+
+    while (!eof) {
+        if (len == cap) {
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                fprintf(args->errors, "Memory allocation failed\n");
+                free(buf);
+                return -1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+
+        size_t n = fread(buf + len, 1, cap - len, input);
+        eof      = n < cap - len;
+        len += n;
+        if (eof && ferror(input)) {
+            fprintf(args->errors, "%s: %s\n", "read", strerror(errno));
+            free(buf);
+            return -1;
+        }
+
+        const char *end = buf + len;
+        if (first) {
+            bool clean;
+            if (csv_scan_record(buf, end, delim, columns, &clean) == end && !eof)
+                continue;
+            first = false;
+        }
+
+        const char *stop = count_span(buf, end, end, delim, eof, records);
+        len              = (size_t)(end - stop);
+        memmove(buf, stop, len);
+    }
+
+    free(buf);
+    return 0;
+}
+
+int print_count(FILE *input, const struct cli_args *args)
+{
+    struct stat sb;
+    void       *map     = MAP_FAILED;
+    size_t      size    = 0;
+    long        records = 0;
+    int         columns = 0;
+    if (fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    int ret;
+    if (map != MAP_FAILED) {
+        const char *data  = map;
+        char        delim = args->tsv ? '\t' : args->delimiter;
+        bool        clean;
+        madvise(map, size, MADV_SEQUENTIAL);
+        csv_scan_record(data, data + size, delim, &columns, &clean);
+        ret = count_mapped(data, size, columns, args, &records);
+        munmap(map, size);
+    } else {
+        ret = count_stream(input, args, &records, &columns);
+    }
+    if (ret != 0)
+        return ret;
+
+    // The header is not a record unless -H says so
+    if (!args->no_headers && records > 0)
+        records--;
+    fprintf(args->output, "%ld %d\n", records, columns);
+    return 0;
+}
\ No newline at end of file
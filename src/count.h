@@ -0,0 +1,12 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Print the record count and the column count of the first record without
+// parsing any field. Regular files are scanned on worker threads.
+int print_count(FILE *input, const struct cli_args *args);
+
+#endif  // COUNT_H
\ No newline at end of file
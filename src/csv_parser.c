@@ -1,13 +1,54 @@
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include <csv.h>
 
 #include "csv_parser.h"
+#include "input_profile.h"
+#include "intern.h"
+#include "parallel.h"
+#include "progress.h"
+#include "spill.h"
 #include "utils.h"
 
 #define BUFFER_SIZE             8192
 #define INITIAL_RECORD_CAPACITY 1000
+#define MIN_ROWS_PER_THREAD     4096
+#define MEMORY_SLICE            (1 << 16)
+
+struct row_buf {
+    char        *data;
+    size_t       len;
+    size_t       cap;
+    size_t      *offsets;
+    size_t      *lengths;
+    const char **fields;
+    int          count;
+    int          field_cap;
+};
+
+struct stream_state {
+    struct row_buf row;
+    csv_row_fn     fn;
+    void          *ctx;
+    bool           is_header;
+    long           index;
+    int            status;  // Last non-zero return of fn, stops parsing
+    bool           oom;
+    bool           unterminated;  // Last record was ended by the end of input
+};
+
+// Quote-free input bypasses libcsv: records are split on line breaks and
+// fields on the delimiter with memchr, trimmed and blank lines skipped as
+// libcsv does. The bytes of a record cut by a chunk end wait in carry.
+struct fast_split {
+    char  *carry;
+    size_t len;
+    size_t cap;
+    char   delim;
+    bool   lf_only;  // The profile saw LF line breaks
+};
 
 struct parse_state {
     struct csv_data   *csv;
@@ -16,26 +57,194 @@ struct parse_state {
     bool               no_headers;
     bool               number;
     int                sniff_limit;
-    int                record_count;
+    int                sniff_count;  // Leading in-memory records whose widths are still due
+    long               record_count;
+    int               *widths;  // Scratch per-field widths for spilled records
+    int                widths_cap;
+    int                status;  // Non-zero stops parsing
 };
 
+static void merge_column_width(struct csv_data *csv, int column, int width)
+{
+    if (column >= csv->max_columns) {
+        csv->max_columns = column + 1;
+        csv->column_widths = realloc(csv->column_widths, (size_t)csv->max_columns * sizeof(int));
+        for (int j = column; j < csv->max_columns; j++) {
+            csv->column_widths[j] = 0;
+        }
+    }
+
+    if (width > csv->column_widths[column]) {
+        csv->column_widths[column] = width;
+    }
+}
+
 static void update_column_widths(struct csv_data *csv, struct csv_record *record)
 {
     for (int i = 0; i < record->field_count; i++) {
-        if (i >= csv->max_columns) {
-            csv->max_columns = i + 1;
-            csv->column_widths =
-                realloc(csv->column_widths, (size_t)csv->max_columns * sizeof(int));
-            for (int j = i; j < csv->max_columns; j++) {
-                csv->column_widths[j] = 0;
-            }
+        merge_column_width(csv, i, unicode_display_width(record->fields[i]));
+    }
+}
+
+// ASCII input is measured a byte per column, cells with other bytes fall back
+static inline int cell_width(const struct csv_data *csv, const char *value)
+{
+    return csv->ascii ? ascii_display_width(value) : unicode_display_width(value);
+}
+
+struct width_task {
+    const struct csv_data *csv;
+    int                   *maxima;  // One row of column maxima per worker
+    size_t                 stride;
+};
+
+static void measure_chunk(void *ctx, long begin, long end, int worker)
+{
+    struct width_task *task   = ctx;
+    int               *maxima = task->maxima + (size_t)worker * task->stride;
+
+    for (long r = begin; r < end; r++) {
+        const struct csv_record *record = &task->csv->records[r];
+        for (int i = 0; i < record->field_count; i++) {
+            if (intern_active(task->csv->dict, i))
+                continue;
+            int width = cell_width(task->csv, record->fields[i]);
+            if (width > maxima[i])
+                maxima[i] = width;
+        }
+    }
+}
+
+struct column_task {
+    const struct csv_data *csv;
+    int                    column;
+    int                   *maxima;  // One cache line per worker
+};
+
+static void measure_column_chunk(void *ctx, long begin, long end, int worker)
+{
+    struct column_task *task  = ctx;
+    int                 width = task->maxima[worker * 16];
+
+    for (long r = begin; r < end; r++) {
+        const struct csv_record *record = &task->csv->records[r];
+        if (task->column < record->field_count) {
+            int w = cell_width(task->csv, record->fields[task->column]);
+            if (w > width)
+                width = w;
         }
+    }
+    task->maxima[worker * 16] = width;
+}
 
-        int width = unicode_display_width(record->fields[i]);
-        if (width > csv->column_widths[i]) {
-            csv->column_widths[i] = width;
+// Measure the first `count` in-memory records on worker threads and fold the
+// per-worker column maxima into the table's column widths. Interned columns
+// take their widths from the dictionary instead of from every cell.
+static int measure_records(struct csv_data *csv, int count, int threads)
+{
+    int columns = 0;
+    for (int r = 0; r < count; r++) {
+        if (csv->records[r].field_count > columns)
+            columns = csv->records[r].field_count;
+    }
+    if (columns == 0)
+        return 0;
+
+    // Keep each worker's maxima on separate cache lines
+    struct width_task task = {.csv = csv, .stride = ((size_t)columns + 15) & ~(size_t)15};
+    threads                = parallel_threads(threads, count, MIN_ROWS_PER_THREAD);
+    task.maxima            = calloc((size_t)threads * task.stride, sizeof(int));
+    if (!task.maxima)
+        return -1;
+
+    parallel_for(threads, count, measure_chunk, &task);
+
+    for (int w = 0; w < threads; w++) {
+        for (int i = 0; i < columns; i++) {
+            merge_column_width(csv, i, task.maxima[(size_t)w * task.stride + (size_t)i]);
         }
     }
+    for (int i = 0; i < columns; i++) {
+        if (intern_active(csv->dict, i))
+            merge_column_width(csv, i, intern_sniff_width(csv->dict, i, count));
+    }
+    free(task.maxima);
+    return 0;
+}
+
+// Approximate heap usage of a parsed record, including allocator overhead.
+// Cells of interned columns only cost their pointer.
+static size_t record_footprint(const struct csv_record *record, const struct csv_dict *dict)
+{
+    size_t bytes = sizeof(struct csv_record) + (size_t)record->field_count * sizeof(char *);
+    for (int i = 0; i < record->field_count; i++) {
+        if (intern_active(dict, i))
+            continue;
+        bytes += (strlen(record->fields[i]) + 1 + 8 + 15) & ~(size_t)15;
+    }
+    return bytes;
+}
+
+// Append fields to the spill file, measuring them into widths. Records
+// within the sniff window also count towards the column widths.
+static int spill_fields(struct csv_data   *csv,
+                        const char *const *fields,
+                        int                field_count,
+                        int               *widths,
+                        bool               sniff)
+{
+    if (!csv->spill) {
+        csv->spill = malloc(sizeof(struct spill_file));
+        if (!csv->spill || spill_open(csv->spill) != 0) {
+            free(csv->spill);
+            csv->spill = NULL;
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < field_count; i++) {
+        widths[i] = unicode_display_width(fields[i]);
+        if (sniff)
+            merge_column_width(csv, i, widths[i]);
+    }
+
+    if (spill_write(csv->spill, fields, widths, field_count) != 0) {
+        perror("csview: writing spill file");
+        return -1;
+    }
+    return 0;
+}
+
+// Move a record out of memory into the spill file, keeping widths exact
+static int spill_record(struct parse_state *state, bool sniff)
+{
+    struct csv_record *record = state->current_record;
+
+    if (record->field_count > state->widths_cap) {
+        int *widths = realloc(state->widths, (size_t)record->field_count * sizeof(int));
+        if (!widths)
+            return -1;
+        state->widths     = widths;
+        state->widths_cap = record->field_count;
+    }
+
+    const char *const *fields = (const char *const *)record->fields;
+    return spill_fields(state->csv, fields, record->field_count, state->widths, sniff);
+}
+
+static int reserve_record(struct csv_data *csv)
+{
+    if (csv->record_count < csv->record_capacity)
+        return 0;
+
+    int capacity = csv->record_capacity ? csv->record_capacity * 2 : INITIAL_RECORD_CAPACITY;
+    struct csv_record *records =
+        realloc(csv->records, (size_t)capacity * sizeof(struct csv_record));
+    if (!records)
+        return -1;
+    csv->records         = records;
+    csv->record_capacity = capacity;
+    return 0;
 }
 
 static void field_callback(void *s, size_t len, void *data)
@@ -45,6 +254,7 @@ static void field_callback(void *s, size_t len, void *data)
     if (!state->current_record) {
         state->current_record              = malloc(sizeof(struct csv_record));
         state->current_record->fields      = NULL;
+        state->current_record->widths      = NULL;
         state->current_record->field_count = 0;
     }
 
@@ -81,18 +291,40 @@ static void record_callback(int c __attribute__((unused)), void *data)
 
     state->is_header = false;
 
+    bool             sniff = state->sniff_limit == 0 || state->record_count < state->sniff_limit;
+    struct csv_data *csv   = state->csv;
+
+    // Over the memory budget every further record goes to disk, keeping file order
+    if (csv->memory_limit > 0) {
+        size_t bytes = record_footprint(state->current_record, csv->dict);
+        if (csv->spill || csv->memory_used + bytes > csv->memory_limit) {
+            if (spill_record(state, sniff) != 0)
+                state->status = -1;
+            state->record_count++;
+            free_csv_record(state->current_record);
+            free(state->current_record);
+            state->current_record = NULL;
+            return;
+        }
+        csv->memory_used += bytes;
+    }
+
     // Expand records array if needed
-    if (state->csv->record_count >= INITIAL_RECORD_CAPACITY) {
-        state->csv->records =
-            realloc(state->csv->records,
-                    (size_t)(state->csv->record_count + 1) * sizeof(struct csv_record));
+    if (reserve_record(state->csv) != 0) {
+        free_csv_record(state->current_record);
+        free(state->current_record);
+        state->current_record = NULL;
+        state->status         = -1;
+        return;
     }
 
     state->csv->records[state->csv->record_count] = *state->current_record;
+    if (csv->dict && intern_record(csv, csv->record_count) != 0)
+        state->status = -1;
 
-    // Only update column widths if we haven't reached the sniff limit
-    if (state->sniff_limit == 0 || state->record_count < state->sniff_limit) {
-        update_column_widths(state->csv, &state->csv->records[state->csv->record_count]);
+    // Widths of in-memory records within the sniff limit are measured after parsing
+    if (sniff) {
+        state->sniff_count = state->csv->record_count + 1;
     }
 
     state->csv->record_count++;
@@ -102,67 +334,464 @@ static void record_callback(int c __attribute__((unused)), void *data)
     state->current_record = NULL;
 }
 
-int parse_csv(FILE *input, struct csv_data *csv, struct cli_args args)
+static void stream_field_callback(void *s, size_t len, void *data)
 {
-    csv->header        = NULL;
-    csv->records       = malloc(INITIAL_RECORD_CAPACITY * sizeof(struct csv_record));
-    csv->record_count  = 0;
-    csv->max_columns   = 0;
-    csv->column_widths = NULL;
+    struct stream_state *state = (struct stream_state *)data;
+    struct row_buf      *row   = &state->row;
 
-    if (!csv->records) {
-        return -1;
+    if (state->status != 0)
+        return;
+
+    if (row->count >= row->field_cap) {
+        int     cap     = row->field_cap ? row->field_cap * 2 : 16;
+        size_t *offsets = realloc(row->offsets, (size_t)cap * sizeof(size_t));
+        if (offsets)
+            row->offsets = offsets;
+        size_t *lengths = realloc(row->lengths, (size_t)cap * sizeof(size_t));
+        if (lengths)
+            row->lengths = lengths;
+        const char **fields = realloc(row->fields, (size_t)cap * sizeof(char *));
+        if (fields)
+            row->fields = fields;
+        if (!offsets || !lengths || !fields) {
+            state->oom    = true;
+            state->status = -1;
+            return;
+        }
+        row->field_cap = cap;
+    }
+
+    if (row->len + len + 1 > row->cap) {
+        size_t cap = row->cap ? row->cap : 4096;
+        while (cap < row->len + len + 1)
+            cap *= 2;
+        char *buf = realloc(row->data, cap);
+        if (!buf) {
+            state->oom    = true;
+            state->status = -1;
+            return;
+        }
+        row->data = buf;
+        row->cap  = cap;
+    }
+
+    // Fields are packed back to back; pointers are resolved once the record is complete
+    if (len > 0)
+        memcpy(row->data + row->len, s, len);
+    row->data[row->len + len] = '\0';
+    row->offsets[row->count]  = row->len;
+    row->lengths[row->count]  = len;
+    row->len += len + 1;
+    row->count++;
+}
+
+static void stream_record_callback(int c, void *data)
+{
+    struct stream_state *state = (struct stream_state *)data;
+    struct row_buf      *row   = &state->row;
+
+    state->unterminated = c < 0;
+
+    if (state->status != 0 || row->count == 0)
+        return;
+
+    for (int i = 0; i < row->count; i++) {
+        row->fields[i] = row->data + row->offsets[i];
+    }
+
+    struct csv_row_view view = {.fields      = row->fields,
+                                .lengths     = row->lengths,
+                                .field_count = row->count,
+                                .index       = state->is_header ? -1 : state->index};
+
+    if (state->is_header)
+        state->is_header = false;
+    else
+        state->index++;
+
+    state->status = state->fn(&view, state->ctx);
+    row->len      = 0;
+    row->count    = 0;
+}
+
+static inline bool is_blank(char c, char delim)
+{
+    return (c == ' ' || c == '\t') && c != delim;
+}
+
+static void split_record(const char *p,
+                         const char *end,
+                         int         term,
+                         char        delim,
+                         void        (*field_cb)(void *, size_t, void *),
+                         void        (*record_cb)(int, void *),
+                         void       *state)
+{
+    const char *s = p;
+    while (s < end && is_blank(*s, delim))
+        s++;
+    if (s == end)
+        return;  // libcsv drops lines holding nothing but blanks
+
+    for (;;) {
+        const char *stop = memchr(p, delim, (size_t)(end - p));
+        const char *last = stop ? stop : end;
+        while (p < last && is_blank(*p, delim))
+            p++;
+        while (last > p && is_blank(last[-1], delim))
+            last--;
+        field_cb((void *)(uintptr_t)p, (size_t)(last - p), state);
+        if (!stop)
+            break;
+        p = stop + 1;
+    }
+    record_cb(term, state);
+}
+
+static const char *find_line_break(const char *p, const char *end, bool lf_only)
+{
+    if (lf_only)
+        return memchr(p, '\n', (size_t)(end - p));
+    while (p < end && *p != '\n' && *p != '\r')
+        p++;
+    return p < end ? p : NULL;
+}
+
+static int carry_bytes(struct fast_split *fs, const char *p, size_t len)
+{
+    if (fs->len + len > fs->cap) {
+        size_t cap = fs->cap ? fs->cap : 4096;
+        while (cap < fs->len + len)
+            cap *= 2;
+        char *carry = realloc(fs->carry, cap);
+        if (!carry)
+            return -1;
+        fs->carry = carry;
+        fs->cap   = cap;
+    }
+    if (len > 0)
+        memcpy(fs->carry + fs->len, p, len);
+    fs->len += len;
+    return 0;
+}
+
+// Split a chunk known to hold no quote, starting with the record the last one cut
+static int split_chunk(struct fast_split *fs,
+                       const char        *p,
+                       size_t             len,
+                       void               (*field_cb)(void *, size_t, void *),
+                       void               (*record_cb)(int, void *),
+                       void              *state)
+{
+    const char *end     = p + len;
+    bool        lf_only = fs->lf_only && !memchr(p, '\r', len);
+
+    if (fs->len > 0) {
+        const char *brk = find_line_break(p, end, lf_only);
+        if (carry_bytes(fs, p, (size_t)((brk ? brk : end) - p)) != 0)
+            return -1;
+        if (!brk)
+            return 0;
+        split_record(fs->carry,
+                     fs->carry + fs->len,
+                     (unsigned char)*brk,
+                     fs->delim,
+                     field_cb,
+                     record_cb,
+                     state);
+        fs->len = 0;
+        p       = brk + 1;
+    }
+
+    const char *brk;
+    while ((brk = find_line_break(p, end, lf_only)) != NULL) {
+        split_record(p, brk, (unsigned char)*brk, fs->delim, field_cb, record_cb, state);
+        p = brk + 1;
     }
+    return carry_bytes(fs, p, (size_t)(end - p));
+}
 
+// Feed the whole input through the parser, stopping early once *stop becomes
+// non-zero. The input is either a stream or, when input is NULL, the len
+// bytes at data. Progress is published per chunk from the callbacks' own
+// *records count. The profile of the input head, stored in *profile when
+// given, starts quote-free input on the fast split; the first chunk with a
+// quote hands the rest to libcsv from the last record boundary.
+static int run_parser(FILE                 *input,
+                      FILE                 *errors,
+                      const char           *data,
+                      size_t                len,
+                      char                  delimiter,
+                      void                  (*field_cb)(void *, size_t, void *),
+                      void                  (*record_cb)(int, void *),
+                      void                 *state,
+                      const int            *stop,
+                      const long           *records,
+                      struct input_profile *profile)
+{
     struct csv_parser parser;
     if (csv_init(&parser, 0) != 0) {
-        free(csv->records);
         return -1;
     }
 
-    // Set delimiter
-    char delimiter = args.tsv ? '\t' : args.delimiter;
     csv_set_delim(&parser, (unsigned char)delimiter);
 
-    // Set up parsing state
-    struct parse_state state = {.csv            = csv,
-                                .current_record = NULL,
-                                .is_header      = !args.no_headers,
-                                .no_headers     = args.no_headers,
-                                .number         = args.number,
-                                .sniff_limit    = args.sniff,
-                                .record_count   = 0};
+    // Memory and regular files are profiled over their head, pipes over the first chunk
+    struct input_profile head     = {.quotes = true};
+    bool                 profiled = true;
+    if (!input)
+        profile_block(data, len < PROFILE_BLOCK ? len : PROFILE_BLOCK, &head);
+    else
+        profiled = profile_input(input, &head) == 0;
+
+    struct fast_split fs   = {.delim = delimiter, .lf_only = head.line_ending == EOL_LF};
+    bool              fast = !head.quotes;
 
     // Read and parse input
     char   buffer[BUFFER_SIZE];
     size_t bytes_read;
+    size_t pos       = 0;
+    long   published = 0;
+    int    ret       = 0;
+
+    for (;;) {
+        const char *chunk = buffer;
+        if (input) {
+            bytes_read = fread(buffer, 1, BUFFER_SIZE, input);
+        } else {
+            chunk      = data + pos;
+            bytes_read = len - pos < MEMORY_SLICE ? len - pos : MEMORY_SLICE;
+            pos += bytes_read;
+        }
+        if (bytes_read == 0)
+            break;
+        if (!profiled) {
+            profile_block(chunk, bytes_read, &head);
+            profiled   = true;
+            fast       = !head.quotes;
+            fs.lf_only = head.line_ending == EOL_LF;
+        }
 
-    while ((bytes_read = fread(buffer, 1, BUFFER_SIZE, input)) > 0) {
-        if (csv_parse(&parser, buffer, bytes_read, field_callback, record_callback, &state) !=
-            bytes_read) {
-            fprintf(stderr, "Error parsing CSV: %s\n", csv_strerror(csv_error(&parser)));
-            csv_free(&parser);
-            free_csv_data(csv);
-            return -1;
+        if (fast && !memchr(chunk, '"', bytes_read)) {
+            if (split_chunk(&fs, chunk, bytes_read, field_cb, record_cb, state) != 0) {
+                fprintf(errors, "Memory allocation failed\n");
+                ret = -1;
+                break;
+            }
+        } else {
+            // libcsv takes over at the record boundary the fast split stopped at
+            size_t carried = fast ? fs.len : 0;
+            fast           = false;
+            if (csv_parse(&parser, fs.carry, carried, field_cb, record_cb, state) != carried ||
+                csv_parse(&parser, chunk, bytes_read, field_cb, record_cb, state) != bytes_read) {
+                fprintf(errors, "Error parsing CSV: %s\n", csv_strerror(csv_error(&parser)));
+                ret = -1;
+                break;
+            }
         }
+        progress_advance(bytes_read, (uint64_t)(*records - published));
+        published = *records;
 
-        // Continue parsing all records even after sniff limit
-        // The sniff limit only affects column width calculation
+        if (stop && *stop != 0)
+            break;
     }
 
     // Finalize parsing
-    if (csv_fini(&parser, field_callback, record_callback, &state) != 0) {
-        fprintf(stderr, "Error finalizing CSV parse: %s\n", csv_strerror(csv_error(&parser)));
-        csv_free(&parser);
-        free_csv_data(csv);
-        return -1;
+    if (ret == 0 && !(stop && *stop != 0)) {
+        if (fast && fs.len > 0) {
+            split_record(fs.carry, fs.carry + fs.len, -1, delimiter, field_cb, record_cb, state);
+        } else if (!fast && csv_fini(&parser, field_cb, record_cb, state) != 0) {
+            fprintf(errors, "Error finalizing CSV parse: %s\n", csv_strerror(csv_error(&parser)));
+            ret = -1;
+        }
+        progress_advance(0, (uint64_t)(*records - published));
     }
 
+    if (profile)
+        *profile = head;
+    free(fs.carry);
     csv_free(&parser);
+    return ret;
+}
+
+static int stream_rows(FILE                  *input,
+                       const char            *data,
+                       size_t                 len,
+                       const struct cli_args *args,
+                       csv_row_fn             fn,
+                       void                  *ctx,
+                       bool                  *unterminated)
+{
+    struct stream_state state = {.fn        = fn,
+                                 .ctx       = ctx,
+                                 .is_header = !args->no_headers,
+                                 .index     = 0,
+                                 .status    = 0,
+                                 .oom       = false};
+
+    char delimiter = args->tsv ? '\t' : args->delimiter;
+    int  ret       = run_parser(input,
+                         args->errors,
+                         data,
+                         len,
+                         delimiter,
+                         stream_field_callback,
+                         stream_record_callback,
+                         &state,
+                         &state.status,
+                         &state.index,
+                         NULL);
+
+    free(state.row.data);
+    free(state.row.offsets);
+    free(state.row.lengths);
+    free(state.row.fields);
+    if (unterminated)
+        *unterminated = state.unterminated;
+
+    if (state.oom) {
+        fprintf(args->errors, "Memory allocation failed\n");
+        return -1;
+    }
+    if (ret != 0)
+        return ret;
+    return state.status < 0 ? state.status : 0;
+}
+
+int parse_csv_stream(FILE *input, const struct cli_args *args, csv_row_fn fn, void *ctx)
+{
+    return stream_rows(input, NULL, 0, args, fn, ctx, NULL);
+}
+
+int parse_csv_buffer(const char            *data,
+                     size_t                 len,
+                     const struct cli_args *args,
+                     csv_row_fn             fn,
+                     void                  *ctx,
+                     bool                  *unterminated)
+{
+    return stream_rows(NULL, data, len, args, fn, ctx, unterminated);
+}
 
+int csv_data_init(struct csv_data *csv)
+{
+    csv->header          = NULL;
+    csv->records         = NULL;
+    csv->record_count    = 0;
+    csv->record_capacity = 0;
+    csv->numbers         = NULL;
+    csv->max_columns     = 0;
+    csv->column_widths   = NULL;
+    csv->spill           = NULL;
+    csv->memory_used     = 0;
+    csv->memory_limit    = 0;
+    csv->mapping         = NULL;
+    csv->mapping_len     = 0;
+    csv->field_pool      = NULL;
+    csv->dict            = NULL;
+    csv->unmeasured      = 0;
+    csv->ascii           = false;
+
+    return reserve_record(csv);
+}
+
+int csv_data_add(struct csv_data *csv, const char *const *fields, int field_count, bool is_header)
+{
+    // Over the memory budget every further record goes to disk, keeping order
+    if (!is_header && csv->memory_limit > 0) {
+        size_t bytes = sizeof(struct csv_record) + (size_t)field_count * sizeof(char *);
+        for (int i = 0; i < field_count; i++) {
+            bytes += (strlen(fields[i] ? fields[i] : "") + 1 + 8 + 15) & ~(size_t)15;
+        }
+        if (csv->spill || csv->memory_used + bytes > csv->memory_limit) {
+            int *widths = malloc((size_t)(field_count ? field_count : 1) * sizeof(int));
+            int  ret    = widths ? spill_fields(csv, fields, field_count, widths, true) : -1;
+            free(widths);
+            return ret;
+        }
+        csv->memory_used += bytes;
+    }
+
+    struct csv_record record;
+    record.fields      = malloc((size_t)(field_count ? field_count : 1) * sizeof(char *));
+    record.widths      = NULL;
+    record.field_count = 0;
+    if (!record.fields)
+        return -1;
+
+    for (int i = 0; i < field_count; i++) {
+        record.fields[i] = strdup(fields[i] ? fields[i] : "");
+        if (!record.fields[i]) {
+            free_csv_record(&record);
+            return -1;
+        }
+        record.field_count++;
+    }
+
+    if (is_header) {
+        if (csv->header) {
+            free_csv_record(csv->header);
+            free(csv->header);
+        }
+        csv->header = malloc(sizeof(struct csv_record));
+        if (!csv->header) {
+            free_csv_record(&record);
+            return -1;
+        }
+        *csv->header = record;
+        update_column_widths(csv, csv->header);
+        return 0;
+    }
+
+    if (reserve_record(csv) != 0) {
+        free_csv_record(&record);
+        return -1;
+    }
+    csv->records[csv->record_count] = record;
+    update_column_widths(csv, &csv->records[csv->record_count]);
+    csv->record_count++;
+    return 0;
+}
+
+long csv_data_total_records(const struct csv_data *csv)
+{
+    return csv->record_count + (csv->spill ? csv->spill->count : 0);
+}
+
+int csv_data_measure_column(const struct csv_data *csv, int column, int threads)
+{
+    int count = csv->unmeasured;
+    if (count == 0 || column < 0)
+        return 0;
+    if (intern_active(csv->dict, column))
+        return intern_sniff_width(csv->dict, column, count);
+
+    struct column_task task = {.csv = csv, .column = column};
+    threads                 = parallel_threads(threads, count, MIN_ROWS_PER_THREAD);
+    task.maxima             = calloc((size_t)threads * 16, sizeof(int));
+    if (!task.maxima)
+        return -1;
+
+    parallel_for(threads, count, measure_column_chunk, &task);
+
+    int width = 0;
+    for (int w = 0; w < threads; w++) {
+        if (task.maxima[w * 16] > width)
+            width = task.maxima[w * 16];
+    }
+    free(task.maxima);
+    return width;
+}
+
+void csv_data_finish(struct csv_data *csv, bool number)
+{
     // Add sequence number column width if needed
-    if (args.number) {
-        int seq_width = snprintf(NULL, 0, "%d", csv->record_count);
+    if (number) {
+        // Given numbers ascend in file order, so the last one is the widest
+        long last = csv_data_total_records(csv);
+        if (csv->numbers && csv->record_count > 0)
+            last = csv->numbers[csv->record_count - 1];
+        int seq_width = snprintf(NULL, 0, "%ld", last);
         if (seq_width < 1)
             seq_width = 1;
 
@@ -174,7 +803,68 @@ int parse_csv(FILE *input, struct csv_data *csv, struct cli_args args)
                 (size_t)(csv->max_columns - 1) * sizeof(int));
         csv->column_widths[0] = seq_width;
     }
+}
+
+int parse_csv(FILE *input, struct csv_data *csv, struct cli_args args)
+{
+    if (csv_data_init(csv) != 0) {
+        return -1;
+    }
+    csv->memory_limit = args.max_memory;
+    csv->dict         = malloc(sizeof(struct csv_dict));
+    if (!csv->dict || intern_init(csv->dict, args.sniff) != 0) {
+        free_csv_data(csv);
+        return -1;
+    }
 
+    // Set up parsing state
+    struct parse_state state = {.csv            = csv,
+                                .current_record = NULL,
+                                .is_header      = !args.no_headers,
+                                .no_headers     = args.no_headers,
+                                .number         = args.number,
+                                .sniff_limit    = args.sniff,
+                                .sniff_count    = 0,
+                                .record_count   = 0,
+                                .widths         = NULL,
+                                .widths_cap     = 0,
+                                .status         = 0};
+
+    // The profile of the input head picks the parser and width fast paths
+    struct input_profile profile;
+
+    // The sniff limit only affects column width calculation, every record is parsed
+    char delimiter = args.tsv ? '\t' : args.delimiter;
+    int  ret       = run_parser(input,
+                         args.errors,
+                         NULL,
+                         0,
+                         delimiter,
+                         field_callback,
+                         record_callback,
+                         &state,
+                         &state.status,
+                         &state.record_count,
+                         &profile);
+    free(state.widths);
+    csv->ascii = profile.ascii;
+
+    // A column projection measures only the columns it ends up drawing
+    if (args.fit || args.columns)
+        csv->unmeasured = state.sniff_count;
+    else if (ret == 0 && state.status == 0 &&
+             measure_records(csv, state.sniff_count, args.threads) != 0)
+        ret = -1;
+    if (ret != 0 || state.status != 0) {
+        if (state.current_record) {
+            free_csv_record(state.current_record);
+            free(state.current_record);
+        }
+        free_csv_data(csv);
+        return -1;
+    }
+
+    csv_data_finish(csv, args.number);
     return 0;
 }
 
@@ -190,8 +880,38 @@ void free_csv_record(struct csv_record *record)
     }
 }
 
+// Free a table record, leaving the shared values of interned columns alone
+static void free_record_fields(struct csv_data *csv, struct csv_record *record)
+{
+    if (!csv->dict) {
+        free_csv_record(record);
+        return;
+    }
+
+    for (int i = 0; i < record->field_count; i++) {
+        if (!intern_active(csv->dict, i))
+            free(record->fields[i]);
+    }
+    free(record->fields);
+    record->fields      = NULL;
+    record->field_count = 0;
+}
+
 void free_csv_data(struct csv_data *csv)
 {
+    // Tables loaded from a cache image borrow their fields from the mapping
+    if (csv && csv->mapping) {
+        free(csv->header);
+        free(csv->records);
+        free(csv->field_pool);
+        munmap(csv->mapping, csv->mapping_len);
+        csv->header      = NULL;
+        csv->records     = NULL;
+        csv->field_pool  = NULL;
+        csv->mapping     = NULL;
+        csv->mapping_len = 0;
+    }
+
     if (csv) {
         if (csv->header) {
             free_csv_record(csv->header);
@@ -201,15 +921,30 @@ void free_csv_data(struct csv_data *csv)
 
         if (csv->records) {
             for (int i = 0; i < csv->record_count; i++) {
-                free_csv_record(&csv->records[i]);
+                free_record_fields(csv, &csv->records[i]);
             }
             free(csv->records);
             csv->records = NULL;
         }
 
+        if (csv->dict) {
+            intern_free(csv->dict);
+            free(csv->dict);
+            csv->dict = NULL;
+        }
+
+        if (csv->spill) {
+            spill_close(csv->spill);
+            free(csv->spill);
+            csv->spill = NULL;
+        }
+
+        free(csv->numbers);
         free(csv->column_widths);
-        csv->column_widths = NULL;
-        csv->record_count  = 0;
-        csv->max_columns   = 0;
+        csv->numbers         = NULL;
+        csv->column_widths   = NULL;
+        csv->record_count    = 0;
+        csv->record_capacity = 0;
+        csv->max_columns     = 0;
     }
 }
\ No newline at end of file
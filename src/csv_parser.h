@@ -1,24 +1,67 @@
 #ifndef CSV_PARSER_H
 #define CSV_PARSER_H
 
+#include <stddef.h>
 #include <stdio.h>
 
 #include "cli.h"
 
 struct csv_record {
-    char **fields;
-    int    field_count;
+    char     **fields;
+    const int *widths;  // Precomputed display width per field, or NULL
+    int        field_count;
 };
 
+struct spill_file;
+struct csv_dict;
+
 struct csv_data {
     struct csv_record *header;
     struct csv_record *records;
-    int                record_count;
+    int                record_count;  // Records held in memory
+    int                record_capacity;
+    long              *numbers;       // -n number of each in-memory record, NULL for 1, 2, ...
     int                max_columns;
     int               *column_widths;
+    struct spill_file *spill;         // Records past the memory budget, in file order
+    size_t             memory_used;   // Estimated bytes held by in-memory records
+    size_t             memory_limit;  // 0 means unlimited
+    void              *mapping;       // Cache image the fields point into, if any
+    size_t             mapping_len;
+    char             **field_pool;    // Field pointer arrays of a mapped table
+    struct csv_dict   *dict;          // Shared values of interned columns, or NULL
+    int                unmeasured;    // Leading records not yet in column_widths
+    bool               ascii;         // The profiled head of the input was pure ASCII
+};
+
+// A parsed row handed to streaming consumers. Field slices are NUL-terminated
+// and only valid for the duration of the callback.
+struct csv_row_view {
+    const char *const *fields;
+    const size_t      *lengths;
+    int                field_count;
+    long               index;  // 0-based data record index, -1 for the header row
 };
 
+// Streaming row callback: return 0 to continue, >0 to stop early, <0 on error
+typedef int (*csv_row_fn)(const struct csv_row_view *row, void *ctx);
+
 int  parse_csv(FILE *input, struct csv_data *csv, struct cli_args args);
+int  csv_data_init(struct csv_data *csv);
+int  csv_data_add(struct csv_data *csv, const char *const *fields, int field_count, bool is_header);
+void csv_data_finish(struct csv_data *csv, bool number);
+long csv_data_total_records(const struct csv_data *csv);
+// Widest cell of one column among the records parse_csv left unmeasured
+int  csv_data_measure_column(const struct csv_data *csv, int column, int threads);
+int  parse_csv_stream(FILE *input, const struct cli_args *args, csv_row_fn fn, void *ctx);
+// Parse len bytes of memory. When unterminated is given it reports whether
+// the data ended inside a record, e.g. a chunk split within a quoted field.
+int  parse_csv_buffer(const char            *data,
+                      size_t                 len,
+                      const struct cli_args *args,
+                      csv_row_fn             fn,
+                      void                  *ctx,
+                      bool                  *unterminated);
 void free_csv_data(struct csv_data *csv);
 void free_csv_record(struct csv_record *record);
 
@@ -0,0 +1,136 @@
+#include "csv_scan.h"
+
+enum scan_state {
+    SCAN_ROW,          // Before the first field of a record
+    SCAN_FIELD_START,  // After a delimiter
+    SCAN_FIELD,        // Inside a field
+    SCAN_QUOTE_END     // After a quote that may close a quoted field
+};
+
+static inline bool is_term(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+static inline bool is_blank(char c, char delim)
+{
+    return (c == ' ' || c == '\t') && c != delim;
+}
+
+const char *csv_scan_record(const char *p, const char *end, char delim, int *fields, bool *clean)
+{
+    enum scan_state state  = SCAN_ROW;
+    bool            quoted = false;
+    bool            spaces = false;  // Blanks seen after a closing quote
+    int             count  = 0;
+
+    *clean = true;
+    while (p < end) {
+        char c = *p++;
+        switch (state) {
+            case SCAN_ROW:
+            case SCAN_FIELD_START:
+                if (is_blank(c, delim))
+                    break;
+                if (c == delim) {
+                    count++;
+                    state = SCAN_FIELD_START;
+                } else if (is_term(c)) {
+                    // libcsv skips blank lines, a pending empty field ends the record
+                    if (state == SCAN_FIELD_START) {
+                        *fields = count + 1;
+                        return p;
+                    }
+                } else {
+                    quoted = c == '"';
+                    state  = SCAN_FIELD;
+                }
+                break;
+
+            case SCAN_FIELD:
+                if (c == '"') {
+                    if (quoted) {
+                        state  = SCAN_QUOTE_END;
+                        spaces = false;
+                    } else {
+                        *clean = false;
+                    }
+                } else if (!quoted && c == delim) {
+                    count++;
+                    state = SCAN_FIELD_START;
+                } else if (!quoted && is_term(c)) {
+                    *fields = count + 1;
+                    return p;
+                }
+                break;
+
+            case SCAN_QUOTE_END:
+                if (c == delim) {
+                    count++;
+                    state = SCAN_FIELD_START;
+                } else if (is_term(c)) {
+                    *fields = count + 1;
+                    return p;
+                } else if (is_blank(c, delim)) {
+                    spaces = true;
+                } else if (c == '"' && !spaces) {
+                    state = SCAN_FIELD;  // Escaped quote
+                } else {
+                    // libcsv keeps the text and stays inside the quoted field; a
+                    // quote after blanks restarts the count of blanks
+                    *clean = false;
+                    spaces = false;
+                    if (c != '"')
+                        state = SCAN_FIELD;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (state == SCAN_FIELD && quoted)
+        *clean = false;
+    *fields = state == SCAN_ROW ? 0 : count + 1;
+    return end;
+}
+
+static bool confirm_records(const char *p, const char *end, char delim, int columns, int confirm)
+{
+    int scanned = 0;
+    while (scanned < confirm && p < end) {
+        int  fields;
+        bool clean;
+        p = csv_scan_record(p, end, delim, &fields, &clean);
+        if (fields == 0)
+            break;  // Only blank lines were left
+        if (columns > 0 ? fields != columns : !clean)
+            return false;
+        scanned++;
+    }
+    return scanned > 0;
+}
+
+const char *csv_resync(const char *p,
+                       const char *end,
+                       char        delim,
+                       int         columns,
+                       int         confirm,
+                       int         max_lines)
+{
+    for (int line = 0; line < max_lines && p < end; line++) {
+        while (p < end && !is_term(*p))
+            p++;
+        while (p < end && is_term(*p))
+            p++;
+        if (p == end)
+            break;
+
+        // A quoted field spanning lines makes the candidate misparse quickly,
+        // so a few clean records in a row confirm a real boundary
+        if (confirm_records(p, end, delim, columns, confirm))
+            return p;
+    }
+    return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef CSV_SCAN_H
+#define CSV_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Record boundary scanning over raw CSV bytes, mirroring libcsv's quoting and
+// whitespace rules without materializing any field.
+
+// Scan the record starting at p (blank lines before it are skipped). Returns
+// the first byte after its terminator, or end. *fields receives the field
+// count and *clean is cleared on anything a strict parser would reject: a
+// stray quote in an unquoted field, text after a closing quote or an
+// unterminated quoted field.
+const char *csv_scan_record(const char *p, const char *end, char delim, int *fields, bool *clean);
+
+// Find the first record start after the line terminator at or following p
+// whose next `confirm` records all have `columns` fields, or scan cleanly
+// when columns is 0. Gives up after max_lines candidates and returns NULL.
+const char *csv_resync(const char *p,
+                       const char *end,
+                       char        delim,
+                       int         columns,
+                       int         confirm,
+                       int         max_lines);
+
+#endif  // CSV_SCAN_H
\ No newline at end of file
@@ -0,0 +1,479 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_parser.h"
+#include "csv_scan.h"
+#include "diff.h"
+#include "progress.h"
+#include "strtab.h"
+#include "table_printer.h"
+#include "utils.h"
+
+#define CHANGE_ARROW " → "
+
+// Where an old record lives; only keys and these are kept for the old file
+struct diff_record {
+    uint64_t offset;  // Record start in the old file
+    uint64_t hash;    // Hash of all fields, unchanged records skip the reparse
+    uint32_t length;
+    bool     seen;  // Matched by a record of the new file
+};
+
+struct diff_state {
+    const struct cli_args     *args;
+    char                      *key_buf;  // Copy of --key, split in place
+    const char               **key_names;
+    int                       *key_columns;  // Resolved against the file being read
+    int                        key_count;
+    struct strtab              index;  // Old key -> struct diff_record
+    char                      *key;    // Scratch buffer for the composite key
+    size_t                     key_cap;
+    void                      *map;  // Old file mapping
+    size_t                     map_len;
+    const char                *base;
+    const char                *end;
+    const char                *cursor;  // Start of the next old record
+    char                       delim;
+    long                       duplicates;
+    char                     **old_header;  // Copy of the old file's header
+    int                        old_header_count;
+    int                       *column_map;  // Result column -> old column, NULL when headers agree
+    int                        new_header_count;
+    int                        mapped_count;  // New columns followed by the ones only OLD has
+    const struct csv_row_view *current;       // New record being compared
+    struct csv_data           *out;
+    const char               **cells;
+    int                        cells_cap;
+    char                      *text;  // Scratch for changed cells
+    size_t                     text_cap;
+};
+
+static int parse_keys(struct diff_state *st, const char *list)
+{
+    st->key_buf = strdup(list);
+    if (!st->key_buf)
+        return -1;
+
+    int count = 1;
+    for (const char *p = list; *p; p++) {
+        if (*p == ',')
+            count++;
+    }
+    st->key_names   = calloc((size_t)count, sizeof(char *));
+    st->key_columns = calloc((size_t)count, sizeof(int));
+    if (!st->key_names || !st->key_columns)
+        return -1;
+
+    char *save = NULL;
+    for (char *tok = strtok_r(st->key_buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        st->key_names[st->key_count++] = tok;
+    }
+    if (st->key_count == 0) {
+        fprintf(st->args->errors, "--key needs at least one column\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int resolve_keys(struct diff_state *st, const char *const *header, int count)
+{
+    for (int k = 0; k < st->key_count; k++) {
+        st->key_columns[k] = resolve_column(st->key_names[k], header, count);
+        if (st->key_columns[k] < 0) {
+            fprintf(st->args->errors, "Unknown key column: %s\n", st->key_names[k]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Fields are length-prefixed in the key, so no value can collide with another split
+static int build_key(struct diff_state *st, const struct csv_row_view *row, size_t *len)
+{
+    size_t need = 0;
+    for (int k = 0; k < st->key_count; k++) {
+        int column = st->key_columns[k];
+        need += sizeof(uint32_t) + (column < row->field_count ? row->lengths[column] : 0);
+    }
+
+    if (need > st->key_cap) {
+        size_t cap = st->key_cap ? st->key_cap : 256;
+        while (cap < need)
+            cap *= 2;
+        char *key = realloc(st->key, cap);
+        if (!key)
+            return -1;
+        st->key     = key;
+        st->key_cap = cap;
+    }
+
+    char *p = st->key;
+    for (int k = 0; k < st->key_count; k++) {
+        int      column = st->key_columns[k];
+        uint32_t n      = column < row->field_count ? (uint32_t)row->lengths[column] : 0;
+        memcpy(p, &n, sizeof(n));
+        p += sizeof(n);
+        if (n > 0)
+            memcpy(p, row->fields[column], n);
+        p += n;
+    }
+    *len = need;
+    return 0;
+}
+
+static uint64_t row_hash(const struct csv_row_view *row)
+{
+    uint64_t h = (uint64_t)row->field_count;
+    for (int i = 0; i < row->field_count; i++) {
+        h = (h ^ strtab_hash(row->fields[i], row->lengths[i])) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return h;
+}
+
+static const char *cell_at(const struct csv_row_view *row, int column, size_t *len)
+{
+    if (!row || column < 0 || column >= row->field_count) {
+        *len = 0;
+        return "";
+    }
+    *len = row->lengths[column];
+    return row->fields[column];
+}
+
+// Result columns are the new file's, then those only the old file has; cells
+// past either header keep their position after them
+static int new_column(const struct diff_state *st, int column)
+{
+    if (!st->column_map || column < st->new_header_count)
+        return column;
+    if (column < st->mapped_count)
+        return -1;
+    return st->new_header_count + column - st->mapped_count;
+}
+
+static int old_column(const struct diff_state *st, int column)
+{
+    if (!st->column_map)
+        return column;
+    if (column < st->mapped_count)
+        return st->column_map[column];
+    return st->old_header_count + column - st->mapped_count;
+}
+
+static int result_width(const struct diff_state  *st,
+                        const struct csv_row_view *old,
+                        const struct csv_row_view *row)
+{
+    int old_count = old ? old->field_count : 0;
+    int new_count = row ? row->field_count : 0;
+    if (st->column_map) {
+        old_count = old_count > st->old_header_count ? old_count - st->old_header_count : 0;
+        new_count = new_count > st->new_header_count ? new_count - st->new_header_count : 0;
+    }
+    int count = old_count > new_count ? old_count : new_count;
+    return st->column_map ? st->mapped_count + count : count;
+}
+
+// Append a result row: the change mark followed by the record's fields. A
+// NULL mark adds the header row.
+static int add_row(struct diff_state *st, const char *mark, const char *const *fields, int count)
+{
+    if (count + 1 > st->cells_cap) {
+        const char **cells = realloc(st->cells, (size_t)(count + 1) * sizeof(char *));
+        if (!cells)
+            return -1;
+        st->cells     = cells;
+        st->cells_cap = count + 1;
+    }
+
+    st->cells[0] = mark;
+    for (int i = 0; i < count; i++) {
+        st->cells[i + 1] = fields[i];
+    }
+    return csv_data_add(st->out, st->cells, count + 1, mark == NULL);
+}
+
+// Lay a record out in result columns. With both versions given, every cell
+// that differs reads old → new and the row is only added when one does.
+static int add_record(struct diff_state         *st,
+                      const char                *mark,
+                      const struct csv_row_view *old,
+                      const struct csv_row_view *row)
+{
+    if (!old && !st->column_map)
+        return add_row(st, mark, row->fields, row->field_count);
+
+    int    count = result_width(st, old, row);
+    size_t need  = 0;
+    for (int i = 0; i < count; i++) {
+        size_t old_len, new_len;
+        cell_at(old, old_column(st, i), &old_len);
+        cell_at(row, new_column(st, i), &new_len);
+        need += old_len + strlen(CHANGE_ARROW) + new_len + 1;
+    }
+    if (need > st->text_cap) {
+        char *text = realloc(st->text, need);
+        if (!text)
+            return -1;
+        st->text     = text;
+        st->text_cap = need;
+    }
+
+    // The old record only lives for this callback, so the cells are built here
+    const char **fields = malloc((size_t)(count > 0 ? count : 1) * sizeof(char *));
+    if (!fields)
+        return -1;
+    char *p       = st->text;
+    bool  changed = false;
+    for (int i = 0; i < count; i++) {
+        size_t      old_len, new_len;
+        const char *before = cell_at(old, old_column(st, i), &old_len);
+        const char *after  = cell_at(row, new_column(st, i), &new_len);
+        if (!old || !row) {
+            fields[i] = old ? before : after;
+        } else if (old_len == new_len && memcmp(before, after, new_len) == 0) {
+            fields[i] = after;
+        } else {
+            fields[i] = p;
+            p += sprintf(p, "%s%s%s", before, CHANGE_ARROW, after) + 1;
+            changed = true;
+        }
+    }
+
+    int ret = old && row && !changed ? 0 : add_row(st, mark, fields, count);
+    free(fields);
+    return ret;
+}
+
+// Remember where each old record starts, keeping the scanner in step with the parser
+static int index_row(const struct csv_row_view *row, void *ctx)
+{
+    struct diff_state *st    = ctx;
+    const char        *start = st->cursor;
+    int                fields;
+    bool               clean;
+
+    st->cursor = csv_scan_record(start, st->end, st->delim, &fields, &clean);
+    if (row->index < 0) {
+        st->old_header = calloc((size_t)(row->field_count ? row->field_count : 1), sizeof(char *));
+        if (!st->old_header)
+            return -1;
+        for (int i = 0; i < row->field_count; i++) {
+            st->old_header[i] = strdup(row->fields[i]);
+            if (!st->old_header[i])
+                return -1;
+            st->old_header_count++;
+        }
+        return resolve_keys(st, row->fields, row->field_count);
+    }
+
+    size_t len;
+    bool   created;
+    if (build_key(st, row, &len) != 0)
+        return -1;
+    struct diff_record *record = strtab_get(&st->index, st->key, len, &created);
+    if (!record)
+        return -1;
+    if (!created) {
+        st->duplicates++;
+        return 0;
+    }
+
+    record->offset = (uint64_t)(start - st->base);
+    record->length = (uint32_t)(st->cursor - start);
+    record->hash   = row_hash(row);
+    return 0;
+}
+
+static int removed_row(const struct csv_row_view *row, void *ctx)
+{
+    return add_record(ctx, "-", row, NULL);
+}
+
+// Called with the old version of st->current, marks every cell that differs
+static int changed_row(const struct csv_row_view *old, void *ctx)
+{
+    struct diff_state *st = ctx;
+    return add_record(st, "~", old, st->current);
+}
+
+// Match the old columns to the new header by name, each old column used once.
+// Identical headers keep the positional comparison.
+static int map_columns(struct diff_state *st, const char *const *header, int count)
+{
+    bool same = count == st->old_header_count;
+    for (int i = 0; same && i < count; i++) {
+        same = strcmp(header[i], st->old_header[i]) == 0;
+    }
+    if (same || !st->old_header)
+        return add_row(st, NULL, header, count);
+
+    int          total = count + st->old_header_count;
+    bool        *used  = calloc((size_t)(total ? total : 1), sizeof(bool));
+    const char **names = malloc((size_t)(total ? total : 1) * sizeof(char *));
+    st->column_map     = malloc((size_t)(total ? total : 1) * sizeof(int));
+    if (!used || !names || !st->column_map) {
+        free(used);
+        free(names);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        names[i]          = header[i];
+        st->column_map[i] = -1;
+        for (int j = 0; j < st->old_header_count; j++) {
+            if (!used[j] && strcmp(header[i], st->old_header[j]) == 0) {
+                st->column_map[i] = j;
+                used[j]           = true;
+                break;
+            }
+        }
+    }
+    st->new_header_count = count;
+    st->mapped_count     = count;
+    for (int j = 0; j < st->old_header_count; j++) {
+        if (!used[j]) {
+            names[st->mapped_count]          = st->old_header[j];
+            st->column_map[st->mapped_count] = j;
+            st->mapped_count++;
+        }
+    }
+
+    int ret = add_row(st, NULL, names, st->mapped_count);
+    free(used);
+    free(names);
+    return ret;
+}
+
+static int reparse_old(struct diff_state *st, const struct diff_record *record, csv_row_fn fn)
+{
+    struct cli_args body = *st->args;
+    body.no_headers      = true;
+    return parse_csv_buffer(st->base + record->offset, record->length, &body, fn, st, NULL);
+}
+
+static int compare_row(const struct csv_row_view *row, void *ctx)
+{
+    struct diff_state *st = ctx;
+
+    if (row->index < 0) {
+        if (resolve_keys(st, row->fields, row->field_count) != 0)
+            return -1;
+        return map_columns(st, row->fields, row->field_count);
+    }
+
+    size_t len;
+    if (build_key(st, row, &len) != 0)
+        return -1;
+    struct diff_record *record = strtab_find(&st->index, st->key, len);
+    if (!record || record->seen)
+        return add_record(st, "+", NULL, row);
+
+    record->seen = true;
+    if (record->hash == row_hash(row))
+        return 0;
+    st->current = row;
+    return reparse_old(st, record, changed_row);
+}
+
+static int index_old(struct diff_state *st, const struct cli_args *args)
+{
+    FILE *fp = fopen(args->diff, "r");
+    if (!fp) {
+        fprintf(args->errors, "%s: %s\n", args->diff, strerror(errno));
+        return -1;
+    }
+
+    struct stat sb;
+    if (fstat(fileno(fp), &sb) != 0 || !S_ISREG(sb.st_mode)) {
+        fprintf(args->errors, "%s: --diff needs a regular file\n", args->diff);
+        fclose(fp);
+        return -1;
+    }
+    if (sb.st_size == 0) {
+        fclose(fp);
+        return 0;
+    }
+    progress_expect(fp);
+
+    // Only the mapping is kept, records are reparsed from it when they differ
+    size_t size = (size_t)sb.st_size;
+    void  *map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    fclose(fp);
+    if (map == MAP_FAILED) {
+        fprintf(args->errors, "%s: %s\n", args->diff, strerror(errno));
+        return -1;
+    }
+    st->map     = map;
+    st->map_len = size;
+    st->base    = map;
+    st->end     = st->base + size;
+    st->cursor  = st->base;
+
+    madvise(map, size, MADV_SEQUENTIAL);
+    if (args->no_headers && resolve_keys(st, NULL, 0) != 0)
+        return -1;
+    if (parse_csv_buffer(st->base, size, args, index_row, st, NULL) != 0)
+        return -1;
+    madvise(map, size, MADV_RANDOM);
+
+    if (st->duplicates > 0)
+        fprintf(args->errors,
+                "csview: %ld duplicate keys in %s, only the first record of each is compared\n",
+                st->duplicates,
+                args->diff);
+    return 0;
+}
+
+int print_diff(FILE *input, struct cli_args *args)
+{
+    struct csv_data   out;
+    struct diff_state st = {.args = args, .delim = args->tsv ? '\t' : args->delimiter, .out = &out};
+
+    int ret = csv_data_init(&out);
+    if (ret == 0 && (parse_keys(&st, args->diff_key) != 0 ||
+                     strtab_init(&st.index, sizeof(struct diff_record)) != 0))
+        ret = -1;
+    if (ret == 0)
+        ret = index_old(&st, args);
+
+    // One pass over the new file: added and changed records in its order
+    if (ret == 0 && args->no_headers)
+        ret = resolve_keys(&st, NULL, 0);
+    if (ret == 0)
+        ret = parse_csv_stream(input, args, compare_row, &st);
+
+    // Then the old records nobody matched, in the old file's order
+    for (size_t i = 0; i < st.index.count && ret == 0; i++) {
+        const struct diff_record *record = strtab_value(&st.index, i);
+        if (!record->seen)
+            ret = reparse_old(&st, record, removed_row);
+    }
+
+    if (ret == 0) {
+        csv_data_finish(&out, args->number);
+        ret = print_table(&out, args);
+    }
+
+    if (st.map)
+        munmap(st.map, st.map_len);
+    strtab_free(&st.index);
+    free_csv_data(&out);
+    free(st.key_buf);
+    free(st.key_names);
+    free(st.key_columns);
+    for (int i = 0; i < st.old_header_count; i++) {
+        free(st.old_header[i]);
+    }
+    free(st.old_header);
+    free(st.column_map);
+    free(st.key);
+    free(st.cells);
+    free(st.text);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Compare the input against the --diff file by the --key columns and print
+// the added, removed and changed records as one table
+int print_diff(FILE *input, struct cli_args *args);
+
+#endif  // DIFF_H
\ No newline at end of file
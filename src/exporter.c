@@ -0,0 +1,796 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exporter.h"
+#include "spill.h"
+#include "table_cache.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Arrow IPC output assumes a little-endian host"
+#endif
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+#define ARROW_BATCH_ROWS  65536
+#define ARROW_BATCH_BYTES (64 << 20)
+#define FB_MAX_SLOTS      8
+
+/* ---- JSON ---- */
+
+// Non-zero when any byte of the word is a control character, '"' or '\\'
+static inline uint64_t json_special_mask(uint64_t w)
+{
+    uint64_t quote  = w ^ (ONES * '"');
+    uint64_t bslash = w ^ (ONES * '\\');
+    uint64_t ctrl   = (w - ONES * 0x20) & ~w;
+
+    quote  = (quote - ONES) & ~quote;
+    bslash = (bslash - ONES) & ~bslash;
+    return (ctrl | quote | bslash) & HIGHS;
+}
+
+static int write_json_escape(struct out_buf *out, unsigned char c)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    switch (c) {
+        case '"':
+            return out_buf_write(out, "\\\"", 2);
+        case '\\':
+            return out_buf_write(out, "\\\\", 2);
+        case '\b':
+            return out_buf_write(out, "\\b", 2);
+        case '\f':
+            return out_buf_write(out, "\\f", 2);
+        case '\n':
+            return out_buf_write(out, "\\n", 2);
+        case '\r':
+            return out_buf_write(out, "\\r", 2);
+        case '\t':
+            return out_buf_write(out, "\\t", 2);
+        default: {
+            char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+            return out_buf_write(out, esc, sizeof(esc));
+        }
+    }
+}
+
+// Write a quoted JSON string, copying clean runs in bulk and scanning 8 bytes at a time
+static int write_json_string(struct out_buf *out, const char *str, size_t len)
+{
+    size_t start = 0;
+    size_t i     = 0;
+
+    out_buf_putc(out, '"');
+    while (i < len) {
+        while (i + 8 <= len) {
+            uint64_t w;
+            memcpy(&w, str + i, 8);
+            if (json_special_mask(w))
+                break;
+            i += 8;
+        }
+        if (i >= len)
+            break;
+
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            i++;
+            continue;
+        }
+
+        out_buf_write(out, str + start, i - start);
+        write_json_escape(out, c);
+        start = ++i;
+    }
+    out_buf_write(out, str + start, len - start);
+    return out_buf_putc(out, '"');
+}
+
+/* ---- NDJSON backend ---- */
+
+struct ndjson_state {
+    char  **keys;  // Pre-escaped `"name":` prefixes
+    size_t *key_lens;
+    int     key_count;
+};
+
+static int ndjson_add_key(struct ndjson_state *st, const char *name, size_t len)
+{
+    struct out_buf tmp;
+    if (out_buf_init(&tmp, NULL, len * 6 + 4) != 0)
+        return -1;
+    write_json_string(&tmp, name, len);
+    out_buf_putc(&tmp, ':');
+
+    char  **keys     = realloc(st->keys, (size_t)(st->key_count + 1) * sizeof(char *));
+    size_t *key_lens = realloc(st->key_lens, (size_t)(st->key_count + 1) * sizeof(size_t));
+    if (keys)
+        st->keys = keys;
+    if (key_lens)
+        st->key_lens = key_lens;
+    if (!keys || !key_lens) {
+        out_buf_free(&tmp);
+        return -1;
+    }
+
+    st->keys[st->key_count]     = tmp.data;
+    st->key_lens[st->key_count] = tmp.len;
+    st->key_count++;
+    return 0;
+}
+
+static int ndjson_begin(struct exporter *ex, const struct csv_row_view *first)
+{
+    struct ndjson_state *st = calloc(1, sizeof(*st));
+    if (!st)
+        return -1;
+    ex->state = st;
+
+    if (first->index >= 0)
+        return 0;
+
+    for (int i = 0; i < first->field_count; i++) {
+        if (ndjson_add_key(st, first->fields[i], first->lengths[i]) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int ndjson_row(struct exporter *ex, const struct csv_row_view *row)
+{
+    struct ndjson_state *st  = ex->state;
+    struct out_buf      *out = &ex->out;
+
+    if (row->index < 0)
+        return 0;
+
+    // Without headers every record becomes a JSON array
+    if (ex->args->no_headers) {
+        out_buf_putc(out, '[');
+        for (int i = 0; i < row->field_count; i++) {
+            if (i > 0)
+                out_buf_putc(out, ',');
+            write_json_string(out, row->fields[i], row->lengths[i]);
+        }
+        out_buf_write(out, "]\n", 2);
+        return out->error ? -1 : 0;
+    }
+
+    // Records wider than the header get positional key names
+    while (st->key_count < row->field_count) {
+        char name[32];
+        int  len = snprintf(name, sizeof(name), "column_%d", st->key_count + 1);
+        if (ndjson_add_key(st, name, (size_t)len) != 0)
+            return -1;
+    }
+
+    out_buf_putc(out, '{');
+    for (int i = 0; i < st->key_count; i++) {
+        if (i > 0)
+            out_buf_putc(out, ',');
+        out_buf_write(out, st->keys[i], st->key_lens[i]);
+        if (i < row->field_count)
+            write_json_string(out, row->fields[i], row->lengths[i]);
+        else
+            out_buf_write(out, "\"\"", 2);
+    }
+    out_buf_write(out, "}\n", 2);
+    return out->error ? -1 : 0;
+}
+
+static void ndjson_release(struct exporter *ex)
+{
+    struct ndjson_state *st = ex->state;
+    if (!st)
+        return;
+    for (int i = 0; i < st->key_count; i++) {
+        free(st->keys[i]);
+    }
+    free(st->keys);
+    free(st->key_lens);
+    free(st);
+    ex->state = NULL;
+}
+
+/* ---- Flatbuffers (Arrow IPC metadata) ---- */
+
+// Minimal front-to-back flatbuffer writer: a table is emitted right after its
+// vtable, children are appended later and linked with forward uoffsets.
+struct fb {
+    uint8_t *buf;
+    size_t   len;
+    size_t   cap;
+    bool     failed;
+};
+
+static size_t fb_zero(struct fb *b, size_t n)
+{
+    if (b->failed)
+        return 0;
+    if (b->len + n > b->cap) {
+        size_t cap = b->cap ? b->cap : 1024;
+        while (cap < b->len + n)
+            cap *= 2;
+        uint8_t *buf = realloc(b->buf, cap);
+        if (!buf) {
+            b->failed = true;
+            return 0;
+        }
+        b->buf = buf;
+        b->cap = cap;
+    }
+
+    size_t pos = b->len;
+    memset(b->buf + pos, 0, n);
+    b->len += n;
+    return pos;
+}
+
+static void fb_align(struct fb *b, size_t align)
+{
+    if (b->len % align)
+        fb_zero(b, align - b->len % align);
+}
+
+static void fb_put(struct fb *b, size_t pos, const void *data, size_t n)
+{
+    if (!b->failed)
+        memcpy(b->buf + pos, data, n);
+}
+
+static void fb_put8(struct fb *b, size_t pos, uint8_t v)
+{
+    fb_put(b, pos, &v, 1);
+}
+
+static void fb_put16(struct fb *b, size_t pos, uint16_t v)
+{
+    fb_put(b, pos, &v, 2);
+}
+
+static void fb_put32(struct fb *b, size_t pos, uint32_t v)
+{
+    fb_put(b, pos, &v, 4);
+}
+
+static void fb_put64(struct fb *b, size_t pos, int64_t v)
+{
+    fb_put(b, pos, &v, 8);
+}
+
+// Point the uoffset stored at `at` to `target`, which must lie after it
+static void fb_link(struct fb *b, size_t at, size_t target)
+{
+    fb_put32(b, at, (uint32_t)(target - at));
+}
+
+// Emit a table whose slot i holds sizes[i] bytes (0 = absent); the position of
+// every present slot is returned in pos[] for the caller to fill in
+static size_t fb_table(struct fb *b, int nslots, const uint8_t *sizes, size_t *pos)
+{
+    uint16_t vtable[2 + FB_MAX_SLOTS];
+    size_t   size = 4;  // soffset to the vtable
+
+    for (int i = 0; i < nslots; i++) {
+        if (sizes[i] == 0) {
+            vtable[2 + i] = 0;
+            continue;
+        }
+        size          = (size + sizes[i] - 1) & ~(size_t)(sizes[i] - 1);
+        vtable[2 + i] = (uint16_t)size;
+        size += sizes[i];
+    }
+    vtable[0] = (uint16_t)(4 + 2 * nslots);
+    vtable[1] = (uint16_t)size;
+
+    fb_align(b, 2);
+    size_t vt = fb_zero(b, vtable[0]);
+    fb_put(b, vt, vtable, vtable[0]);
+
+    fb_align(b, 8);
+    size_t table = fb_zero(b, size);
+    fb_put32(b, table, (uint32_t)(table - vt));
+
+    for (int i = 0; i < nslots; i++) {
+        pos[i] = vtable[2 + i] ? table + vtable[2 + i] : 0;
+    }
+    return table;
+}
+
+static size_t fb_string(struct fb *b, const char *str, size_t len)
+{
+    fb_align(b, 4);
+    size_t pos = fb_zero(b, 4 + len + 1);
+    fb_put32(b, pos, (uint32_t)len);
+    fb_put(b, pos + 4, str, len);
+    return pos;
+}
+
+// Vector header; elements start 4 bytes after the returned position
+static size_t fb_vector(struct fb *b, size_t count, size_t elem_size)
+{
+    fb_align(b, 4);
+    if (elem_size >= 8 && (b->len + 4) % 8)
+        fb_zero(b, 4);
+    size_t pos = fb_zero(b, 4 + count * elem_size);
+    fb_put32(b, pos, (uint32_t)count);
+    return pos;
+}
+
+/* ---- Arrow IPC stream backend ---- */
+
+enum {
+    ARROW_METADATA_V5     = 4,
+    ARROW_HEADER_SCHEMA   = 1,
+    ARROW_HEADER_BATCH    = 3,
+    ARROW_TYPE_UTF8       = 5,
+    ARROW_CONTINUATION    = -1,
+    ARROW_BUFFERS_PER_COL = 3,  // validity, offsets, data
+};
+
+struct arrow_column {
+    int32_t *offsets;
+    char    *data;
+    size_t   data_len;
+    size_t   data_cap;
+};
+
+struct arrow_state {
+    int                  ncols;
+    char               **names;
+    struct arrow_column *cols;
+    int32_t              rows;
+    size_t               offsets_cap;  // In rows, shared by every column
+    bool                 schema_sent;  // Until then wider records add columns
+    long                 truncated;    // Records with fields past the sent schema
+    struct fb            fb;
+};
+
+static size_t pad8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static size_t arrow_message_start(struct fb *b, uint8_t header_type, int64_t body_len)
+{
+    static const uint8_t sizes[4] = {2, 1, 4, 8};  // version, header_type, header, bodyLength
+    size_t               msg[4];
+
+    b->len    = 0;
+    b->failed = false;
+
+    size_t root  = fb_zero(b, 4);
+    size_t table = fb_table(b, 4, sizes, msg);
+    fb_link(b, root, table);
+    fb_put16(b, msg[0], ARROW_METADATA_V5);
+    fb_put8(b, msg[1], header_type);
+    fb_put64(b, msg[3], body_len);
+    return msg[2];
+}
+
+static int arrow_message_finish(struct exporter *ex, struct fb *b)
+{
+    // The 8-byte prefix plus padded metadata keeps the body 8-byte aligned
+    fb_align(b, 8);
+    if (b->failed)
+        return -1;
+
+    int32_t prefix[2] = {ARROW_CONTINUATION, (int32_t)b->len};
+    out_buf_write(&ex->out, prefix, sizeof(prefix));
+    return out_buf_write(&ex->out, b->buf, b->len);
+}
+
+static int arrow_write_schema(struct exporter *ex, struct arrow_state *st)
+{
+    static const uint8_t schema_sizes[2] = {0, 4};  // endianness (little), fields
+    // name, nullable, type_type, type, dictionary, children
+    static const uint8_t field_sizes[6] = {4, 1, 1, 4, 0, 4};
+
+    struct fb *b      = &st->fb;
+    size_t     header = arrow_message_start(b, ARROW_HEADER_SCHEMA, 0);
+
+    size_t schema[2];
+    size_t schema_table = fb_table(b, 2, schema_sizes, schema);
+    fb_link(b, header, schema_table);
+
+    size_t fields = fb_vector(b, (size_t)st->ncols, 4);
+    fb_link(b, schema[1], fields);
+
+    for (int c = 0; c < st->ncols; c++) {
+        size_t field[6];
+        size_t field_table = fb_table(b, 6, field_sizes, field);
+        fb_link(b, fields + 4 + 4 * (size_t)c, field_table);
+        fb_put8(b, field[1], 1);
+        fb_put8(b, field[2], ARROW_TYPE_UTF8);
+
+        size_t name = fb_string(b, st->names[c], strlen(st->names[c]));
+        fb_link(b, field[0], name);
+
+        size_t utf8 = fb_table(b, 0, NULL, NULL);
+        fb_link(b, field[3], utf8);
+
+        size_t children = fb_vector(b, 0, 4);
+        fb_link(b, field[5], children);
+    }
+
+    return arrow_message_finish(ex, b);
+}
+
+static int arrow_flush_batch(struct exporter *ex, struct arrow_state *st)
+{
+    static const uint8_t batch_sizes[3] = {8, 4, 4};  // length, nodes, buffers
+
+    // The schema waits for the first batch so records in it can still widen it
+    if (!st->schema_sent) {
+        if (arrow_write_schema(ex, st) != 0)
+            return -1;
+        st->schema_sent = true;
+    }
+    if (st->rows == 0)
+        return 0;
+
+    size_t offsets_len = ((size_t)st->rows + 1) * sizeof(int32_t);
+    size_t body_len    = 0;
+    for (int c = 0; c < st->ncols; c++) {
+        body_len += pad8(offsets_len) + pad8(st->cols[c].data_len);
+    }
+
+    struct fb *b      = &st->fb;
+    size_t     header = arrow_message_start(b, ARROW_HEADER_BATCH, (int64_t)body_len);
+
+    size_t batch[3];
+    size_t batch_table = fb_table(b, 3, batch_sizes, batch);
+    fb_link(b, header, batch_table);
+    fb_put64(b, batch[0], st->rows);
+
+    // FieldNode { length, null_count }
+    size_t nodes = fb_vector(b, (size_t)st->ncols, 16);
+    fb_link(b, batch[1], nodes);
+    for (int c = 0; c < st->ncols; c++) {
+        fb_put64(b, nodes + 4 + 16 * (size_t)c, st->rows);
+    }
+
+    // Buffer { offset, length } for each column's validity, offsets and data
+    size_t buffers = fb_vector(b, (size_t)st->ncols * ARROW_BUFFERS_PER_COL, 16);
+    fb_link(b, batch[2], buffers);
+    size_t body_off = 0;
+    size_t at       = buffers + 4;
+    for (int c = 0; c < st->ncols; c++) {
+        fb_put64(b, at, (int64_t)body_off);
+        fb_put64(b, at + 16, (int64_t)body_off);
+        fb_put64(b, at + 24, (int64_t)offsets_len);
+        body_off += pad8(offsets_len);
+        fb_put64(b, at + 32, (int64_t)body_off);
+        fb_put64(b, at + 40, (int64_t)st->cols[c].data_len);
+        body_off += pad8(st->cols[c].data_len);
+        at += 16 * ARROW_BUFFERS_PER_COL;
+    }
+
+    if (arrow_message_finish(ex, b) != 0)
+        return -1;
+
+    static const char zeros[8] = {0};
+    for (int c = 0; c < st->ncols; c++) {
+        struct arrow_column *col = &st->cols[c];
+        out_buf_write(&ex->out, col->offsets, offsets_len);
+        out_buf_write(&ex->out, zeros, pad8(offsets_len) - offsets_len);
+        out_buf_write(&ex->out, col->data, col->data_len);
+        out_buf_write(&ex->out, zeros, pad8(col->data_len) - col->data_len);
+        col->data_len = 0;
+    }
+    st->rows = 0;
+    return ex->out.error ? -1 : 0;
+}
+
+// Add columns up to ncols, empty in the rows already buffered; records wider
+// than the header get positional names like the NDJSON keys
+static int arrow_widen(struct arrow_state *st, const struct csv_row_view *names, int ncols)
+{
+    char **grown_names = realloc(st->names, (size_t)ncols * sizeof(char *));
+    if (grown_names)
+        st->names = grown_names;
+    struct arrow_column *grown_cols = realloc(st->cols, (size_t)ncols * sizeof(*grown_cols));
+    if (grown_cols)
+        st->cols = grown_cols;
+    if (!grown_names || !grown_cols)
+        return -1;
+
+    while (st->ncols < ncols) {
+        int                  c   = st->ncols;
+        struct arrow_column *col = &st->cols[c];
+        memset(col, 0, sizeof(*col));
+        if (names) {
+            st->names[c] = strdup(names->fields[c]);
+        } else {
+            char name[32];
+            snprintf(name, sizeof(name), "column_%d", c + 1);
+            st->names[c] = strdup(name);
+        }
+        if (st->offsets_cap > 0)
+            col->offsets = calloc(st->offsets_cap, sizeof(int32_t));
+        st->ncols++;
+        if (!st->names[c] || (st->offsets_cap > 0 && !col->offsets))
+            return -1;
+    }
+    return 0;
+}
+
+static int arrow_begin(struct exporter *ex, const struct csv_row_view *first)
+{
+    struct arrow_state *st = calloc(1, sizeof(*st));
+    if (!st)
+        return -1;
+    ex->state = st;
+
+    if (first->field_count == 0)
+        return 0;
+    return arrow_widen(st, first->index < 0 ? first : NULL, first->field_count);
+}
+
+static int arrow_row(struct exporter *ex, const struct csv_row_view *row)
+{
+    struct arrow_state *st = ex->state;
+
+    if (row->index < 0)
+        return 0;
+
+    bool full = st->rows >= ARROW_BATCH_ROWS;
+    for (int c = 0; c < st->ncols && !full; c++) {
+        full = st->cols[c].data_len > ARROW_BATCH_BYTES;
+    }
+    if (full && arrow_flush_batch(ex, st) != 0)
+        return -1;
+
+    if (row->field_count > st->ncols) {
+        if (!st->schema_sent && arrow_widen(st, NULL, row->field_count) != 0)
+            return -1;
+        if (st->schema_sent)
+            st->truncated++;
+    }
+
+    if ((size_t)st->rows + 2 > st->offsets_cap) {
+        size_t cap = st->offsets_cap ? st->offsets_cap * 2 : 1024;
+        for (int c = 0; c < st->ncols; c++) {
+            int32_t *offsets = realloc(st->cols[c].offsets, cap * sizeof(int32_t));
+            if (!offsets)
+                return -1;
+            offsets[0]          = 0;
+            st->cols[c].offsets = offsets;
+        }
+        st->offsets_cap = cap;
+    }
+
+    // Missing trailing fields become empty strings
+    for (int c = 0; c < st->ncols; c++) {
+        struct arrow_column *col = &st->cols[c];
+        size_t               len = c < row->field_count ? row->lengths[c] : 0;
+
+        if (col->data_len + len > col->data_cap) {
+            size_t cap = col->data_cap ? col->data_cap : 4096;
+            while (cap < col->data_len + len)
+                cap *= 2;
+            char *data = realloc(col->data, cap);
+            if (!data)
+                return -1;
+            col->data     = data;
+            col->data_cap = cap;
+        }
+        if (len > 0)
+            memcpy(col->data + col->data_len, row->fields[c], len);
+        col->data_len += len;
+        col->offsets[st->rows + 1] = (int32_t)col->data_len;
+    }
+    st->rows++;
+    return 0;
+}
+
+static int arrow_end(struct exporter *ex)
+{
+    struct arrow_state *st = ex->state;
+    if (arrow_flush_batch(ex, st) != 0)
+        return -1;
+    if (st->truncated > 0)
+        fprintf(ex->args->errors,
+                "csview: %ld records were wider than the Arrow schema sent with the first "
+                "batch, their extra fields were dropped\n",
+                st->truncated);
+
+    int32_t eos[2] = {ARROW_CONTINUATION, 0};
+    return out_buf_write(&ex->out, eos, sizeof(eos));
+}
+
+static void arrow_release(struct exporter *ex)
+{
+    struct arrow_state *st = ex->state;
+    if (!st)
+        return;
+    for (int c = 0; c < st->ncols; c++) {
+        if (st->names)
+            free(st->names[c]);
+        if (st->cols) {
+            free(st->cols[c].offsets);
+            free(st->cols[c].data);
+        }
+    }
+    free(st->names);
+    free(st->cols);
+    free(st->fb.buf);
+    free(st);
+    ex->state = NULL;
+}
+
+/* ---- Aligned plain text backend ---- */
+
+static int text_row(struct exporter *ex, const struct csv_row_view *row)
+{
+    const struct csv_data *csv    = ex->csv;
+    struct out_buf        *out    = &ex->out;
+    bool                   number = ex->args->number;
+    alignment_t            align  = row->index < 0 ? ex->args->header_align : ex->args->body_align;
+
+    for (int i = 0; i < csv->max_columns; i++) {
+        const char *content = "";
+        char        seq[24];
+
+        if (number && i == 0) {
+            if (row->index < 0) {
+                content = "#";
+            } else {
+                snprintf(seq, sizeof(seq), "%ld", row->index + 1);
+                content = seq;
+            }
+        } else {
+            int field_index = number ? i - 1 : i;
+            if (field_index < row->field_count)
+                content = row->fields[field_index];
+        }
+
+        int pad = csv->column_widths[i] - unicode_display_width(content);
+        if (pad < 0)
+            pad = 0;
+
+        int left = 0;
+        if (align == ALIGN_RIGHT)
+            left = pad;
+        else if (align == ALIGN_CENTER)
+            left = pad / 2;
+
+        if (i > 0)
+            out_buf_write(out, "  ", 2);
+        out_buf_fill(out, ' ', (size_t)left);
+        out_buf_puts(out, content);
+
+        // No trailing blanks after the last column
+        if (i < csv->max_columns - 1)
+            out_buf_fill(out, ' ', (size_t)(pad - left));
+    }
+    return out_buf_putc(out, '\n');
+}
+
+static const output_backend_t backends[] = {
+    {FORMAT_TEXT,   true,  NULL,         text_row,   NULL,      NULL          },
+    {FORMAT_NDJSON, false, ndjson_begin, ndjson_row, NULL,      ndjson_release},
+    {FORMAT_ARROW,  false, arrow_begin,  arrow_row,  arrow_end, arrow_release },
+};
+
+const output_backend_t *get_output_backend(output_format_t format)
+{
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (backends[i].format == format)
+            return &backends[i];
+    }
+    return NULL;
+}
+
+static int export_row(const struct csv_row_view *row, void *ctx)
+{
+    struct exporter *ex = ctx;
+
+    if (!ex->started) {
+        ex->started = true;
+        if (ex->backend->begin && ex->backend->begin(ex, row) != 0)
+            return -1;
+    }
+
+    if (ex->backend->row(ex, row) != 0 || ex->out.error)
+        return -1;
+    return 0;
+}
+
+// Replay a fully parsed table, including spilled records, through the backend
+// so it can use column widths
+static int export_buffered(struct exporter *ex, FILE *input)
+{
+    struct csv_data csv;
+    if (load_table(input, &csv, ex->args) != 0)
+        return -1;
+    ex->csv = &csv;
+
+    int     ret      = 0;
+    size_t *lengths  = NULL;
+    int     capacity = 0;
+    long    total    = csv_data_total_records(&csv);
+
+    if (csv.spill && spill_rewind(csv.spill) != 0)
+        ret = -1;
+
+    for (long i = -1; i < total && ret == 0; i++) {
+        char     **fields;
+        int        field_count;
+        const int *cell_widths;
+
+        if (i < 0) {
+            if (!csv.header)
+                continue;
+            fields      = csv.header->fields;
+            field_count = csv.header->field_count;
+        } else if (i < csv.record_count) {
+            fields      = csv.records[i].fields;
+            field_count = csv.records[i].field_count;
+        } else if (spill_read(csv.spill, &fields, &cell_widths, &field_count) != 0) {
+            fprintf(ex->args->errors, "Error reading spilled records\n");
+            ret = -1;
+            break;
+        }
+
+        if (field_count > capacity) {
+            size_t *grown = realloc(lengths, (size_t)field_count * sizeof(size_t));
+            if (!grown) {
+                ret = -1;
+                break;
+            }
+            lengths  = grown;
+            capacity = field_count;
+        }
+        for (int j = 0; j < field_count; j++) {
+            lengths[j] = strlen(fields[j]);
+        }
+
+        struct csv_row_view view = {.fields      = (const char *const *)fields,
+                                    .lengths     = lengths,
+                                    .field_count = field_count,
+                                    .index       = i};
+        ret = export_row(&view, ex);
+    }
+
+    free(lengths);
+    free_csv_data(&csv);
+    ex->csv = NULL;
+    return ret;
+}
+
+int export_csv(FILE *input, FILE *output, const struct cli_args *args)
+{
+    struct exporter ex = {.backend = get_output_backend(args->format), .args = args};
+    if (!ex.backend)
+        return -1;
+
+    if (out_buf_init(&ex.out, output, OUT_BUF_SIZE) != 0) {
+        fprintf(args->errors, "Memory allocation failed\n");
+        return -1;
+    }
+
+    int ret;
+    if (ex.backend->buffered)
+        ret = export_buffered(&ex, input);
+    else
+        ret = parse_csv_stream(input, args, export_row, &ex);
+
+    // Framed formats still owe a complete stream, a schema without columns, for empty input
+    if (ret == 0 && !ex.started && ex.backend->end) {
+        struct csv_row_view empty = {.index = -1};
+        ret                       = export_row(&empty, &ex);
+    }
+    if (ret == 0 && ex.backend->end)
+        ret = ex.backend->end(&ex);
+    if (out_buf_flush(&ex.out) != 0 && ret == 0)
+        ret = -1;
+
+    if (ex.backend->release)
+        ex.backend->release(&ex);
+    out_buf_free(&ex.out);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cli.h"
+#include "csv_parser.h"
+#include "utils.h"
+
+struct exporter;
+
+// Output backend used instead of the box table renderer. Streaming backends
+// receive rows straight from the parser; buffered ones get the parsed table
+// (and its column widths) replayed through the same row hook.
+typedef struct {
+    output_format_t format;
+    bool            buffered;
+    int (*begin)(struct exporter *ex, const struct csv_row_view *header);
+    int (*row)(struct exporter *ex, const struct csv_row_view *row);
+    int (*end)(struct exporter *ex);
+    void (*release)(struct exporter *ex);
+} output_backend_t;
+
+struct exporter {
+    const output_backend_t *backend;
+    const struct cli_args  *args;
+    struct out_buf          out;
+    struct csv_data        *csv;      // Parsed table for buffered backends
+    bool                    started;  // begin() has been called
+    void                   *state;    // Backend private state
+};
+
+const output_backend_t *get_output_backend(output_format_t format);
+int                     export_csv(FILE *input, FILE *output, const struct cli_args *args);
+
+#endif  // EXPORTER_H
\ No newline at end of file
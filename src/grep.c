@@ -0,0 +1,236 @@
+#define _GNU_SOURCE  // memmem, memrchr
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_scan.h"
+#include "grep.h"
+#include "utils.h"
+
+struct grep_state {
+    struct csv_data           *csv;
+    const struct grep_matcher *matcher;
+    const char                *column_name;  // --grep-col, resolved once the header is seen
+    FILE                      *errors;
+    int                        column;       // -1 matches any column
+    bool                       resolved;
+};
+
+int grep_matcher_init(struct grep_matcher *m, const struct cli_args *args)
+{
+    m->pattern     = args->grep;
+    m->pattern_len = strlen(args->grep);
+    m->regex       = args->regex;
+    if (!m->regex)
+        return 0;
+
+    int err = regcomp(&m->re, args->grep, REG_EXTENDED);
+    if (err != 0) {
+        char msg[256];
+        regerror(err, &m->re, msg, sizeof(msg));
+        fprintf(args->errors, "Invalid regex '%s': %s\n", args->grep, msg);
+        return -1;
+    }
+    return 0;
+}
+
+void grep_matcher_free(struct grep_matcher *m)
+{
+    if (m->regex)
+        regfree(&m->re);
+}
+
+bool grep_find(const struct grep_matcher *m,
+               const char                *str,
+               size_t                     len,
+               size_t                     from,
+               size_t                    *start,
+               size_t                    *end)
+{
+    if (from > len)
+        return false;
+
+    if (!m->regex) {
+        const char *hit = memmem(str + from, len - from, m->pattern, m->pattern_len);
+        if (!hit)
+            return false;
+        *start = (size_t)(hit - str);
+        *end   = *start + m->pattern_len;
+        return true;
+    }
+
+    regmatch_t match;
+    if (regexec(&m->re, str + from, 1, &match, from > 0 ? REG_NOTBOL : 0) != 0)
+        return false;
+    *start = from + (size_t)match.rm_so;
+    *end   = from + (size_t)match.rm_eo;
+    return true;
+}
+
+static int resolve_grep_column(struct grep_state *st, const char *const *header, int count)
+{
+    st->resolved = true;
+    if (!st->column_name)
+        return 0;
+
+    st->column = resolve_column(st->column_name, header, count);
+    if (st->column < 0) {
+        fprintf(st->errors, "Unknown column: %s\n", st->column_name);
+        return -1;
+    }
+    return 0;
+}
+
+static bool row_matches(const struct grep_state *st, const struct csv_row_view *row)
+{
+    size_t start, end;
+    if (st->column >= 0) {
+        return st->column < row->field_count &&
+               grep_find(st->matcher,
+                         row->fields[st->column],
+                         row->lengths[st->column],
+                         0,
+                         &start,
+                         &end);
+    }
+
+    for (int i = 0; i < row->field_count; i++) {
+        if (grep_find(st->matcher, row->fields[i], row->lengths[i], 0, &start, &end))
+            return true;
+    }
+    return false;
+}
+
+// Confirm a candidate on its parsed fields, a raw hit may span a delimiter
+static int grep_row(const struct csv_row_view *row, void *ctx)
+{
+    struct grep_state *st = ctx;
+
+    if (row->index < 0) {
+        if (resolve_grep_column(st, row->fields, row->field_count) != 0)
+            return -1;
+        return csv_data_add(st->csv, row->fields, row->field_count, true) == 0 ? 0 : -1;
+    }
+
+    if (!row_matches(st, row))
+        return 0;
+    return csv_data_add(st->csv, row->fields, row->field_count, false) == 0 ? 0 : -1;
+}
+
+static inline bool is_term(char c)
+{
+    return c == '\n' || c == '\r';
+}
+
+// Start of the record containing hit, given a known record start at or before it
+static const char *record_start(const char *cursor, const char *hit, const char *end, char delim)
+{
+    // Quotes are the only way a line break can sit inside a record, so step
+    // over whole records until the last quote before the hit is behind us
+    const char *quote = memrchr(cursor, '"', (size_t)(hit - cursor));
+    while (quote && cursor <= quote) {
+        int         fields;
+        bool        clean;
+        const char *next = csv_scan_record(cursor, end, delim, &fields, &clean);
+        if (next > hit)
+            return cursor;
+        cursor = next;
+    }
+
+    // Without quotes in between, the last line break before the hit ends the previous record
+    const char *p = hit;
+    while (p > cursor && !is_term(p[-1]))
+        p--;
+    return p;
+}
+
+static int grep_mapped(struct grep_state     *st,
+                       const char            *base,
+                       size_t                 size,
+                       const struct cli_args *args)
+{
+    const char     *end     = base + size;
+    const char     *data    = base;
+    const char     *pattern = st->matcher->pattern;
+    size_t          len     = st->matcher->pattern_len;
+    char            delim   = args->tsv ? '\t' : args->delimiter;
+    int             fields;
+    bool            clean;
+    struct cli_args body = *args;
+    body.no_headers      = true;
+
+    if (!args->no_headers) {
+        data = csv_scan_record(base, end, delim, &fields, &clean);
+        if (parse_csv_buffer(base, (size_t)(data - base), args, grep_row, st, NULL) != 0)
+            return -1;
+    }
+    if (!st->resolved && resolve_grep_column(st, NULL, 0) != 0)
+        return -1;
+
+    // Regex hits cannot be found in raw bytes reliably, anchors mean field
+    // boundaries, so every record is parsed. The same goes for a literal with
+    // a quote, which is stored doubled inside quoted fields but not elsewhere
+    if (st->matcher->regex || memchr(pattern, '"', len))
+        return parse_csv_buffer(data, (size_t)(end - data), &body, grep_row, st, NULL);
+
+    const char *cursor = data;  // Always a record start
+    while (cursor < end) {
+        const char *hit = memmem(cursor, (size_t)(end - cursor), pattern, len);
+        if (!hit)
+            break;
+
+        const char *start = record_start(cursor, hit, end, delim);
+        const char *next  = csv_scan_record(start, end, delim, &fields, &clean);
+        if (fields > 0 &&
+            parse_csv_buffer(start, (size_t)(next - start), &body, grep_row, st, NULL) != 0)
+            return -1;
+        cursor = next;
+    }
+    return 0;
+}
+
+int grep_table(FILE *input, struct csv_data *csv, const struct cli_args *args)
+{
+    struct grep_matcher matcher;
+    if (grep_matcher_init(&matcher, args) != 0)
+        return -1;
+    if (csv_data_init(csv) != 0) {
+        grep_matcher_free(&matcher);
+        return -1;
+    }
+
+    struct grep_state st = {.csv         = csv,
+                            .matcher     = &matcher,
+                            .column_name = args->grep_col,
+                            .errors      = args->errors,
+                            .column      = -1};
+
+    struct stat sb;
+    void       *map  = MAP_FAILED;
+    size_t      size = 0;
+    if (fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    int ret;
+    if (map != MAP_FAILED) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        ret = grep_mapped(&st, map, size, args);
+        munmap(map, size);
+    } else {
+        ret = args->no_headers ? resolve_grep_column(&st, NULL, 0) : 0;
+        if (ret == 0)
+            ret = parse_csv_stream(input, args, grep_row, &st);
+    }
+
+    grep_matcher_free(&matcher);
+    if (ret != 0) {
+        free_csv_data(csv);
+        return -1;
+    }
+    csv_data_finish(csv, args->number);
+    return 0;
+}
\ No newline at end of file
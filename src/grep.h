@@ -0,0 +1,35 @@
+#ifndef GREP_H
+#define GREP_H
+
+#include <regex.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cli.h"
+#include "csv_parser.h"
+
+struct grep_matcher {
+    const char *pattern;
+    size_t      pattern_len;
+    bool        regex;
+    regex_t     re;
+};
+
+int  grep_matcher_init(struct grep_matcher *m, const struct cli_args *args);
+void grep_matcher_free(struct grep_matcher *m);
+
+// Find the first match in the NUL-terminated str at or after from. On success
+// [*start, *end) is the matched byte range.
+bool grep_find(const struct grep_matcher *m,
+               const char                *str,
+               size_t                     len,
+               size_t                     from,
+               size_t                    *start,
+               size_t                    *end);
+
+// Fill csv with the header and the records matching --grep, in file order.
+// Literal patterns on regular files are searched in the raw bytes first and
+// only records around a hit are parsed.
+int grep_table(FILE *input, struct csv_data *csv, const struct cli_args *args);
+
+#endif  // GREP_H
\ No newline at end of file
@@ -0,0 +1,622 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_parser.h"
+#include "csv_scan.h"
+#include "group_by.h"
+#include "numparse.h"
+#include "parallel.h"
+#include "strtab.h"
+#include "table_printer.h"
+#include "utils.h"
+
+#define MIN_CHUNK_BYTES (1 << 22)  // Smallest slice of the file worth a thread
+#define CONFIRM_RECORDS 4
+#define RESYNC_LINES    64
+
+typedef enum {
+    AGG_COUNT,
+    AGG_SUM,
+    AGG_AVG,
+    AGG_MIN,
+    AGG_MAX
+} agg_kind_t;
+
+struct agg_spec {
+    agg_kind_t  kind;
+    const char *column_name;  // Points into group_spec.agg_buf
+    int         column;
+};
+
+struct group_spec {
+    char            *group_buf;  // Copies of the arguments, split in place
+    char            *agg_buf;
+    const char     **group_names;
+    int             *group_columns;
+    int              group_count;
+    struct agg_spec *aggs;
+    int              agg_count;
+    char           **labels;  // Output header, group columns then aggregates
+    bool             resolved;
+    FILE            *errors;
+};
+
+struct agg_acc {
+    double sum;
+    double compensation;  // Neumaier running error, keeps sums independent of chunking
+    double min;
+    double max;
+    long   numbers;  // Numeric cells seen
+};
+
+struct group_value {
+    long           count;
+    struct agg_acc acc[];  // One per aggregate, unused by count
+};
+
+struct group_state {
+    struct group_spec *spec;
+    struct strtab      table;
+    char              *key;  // Scratch buffer for the composite key
+    size_t             key_cap;
+};
+
+struct group_chunk {
+    const char        *begin;
+    const char        *end;
+    struct group_state state;
+    bool               unterminated;
+    int                status;
+};
+
+struct chunk_job {
+    struct group_chunk    *chunks;
+    const struct cli_args *args;
+};
+
+static int count_items(const char *list)
+{
+    int count = 1;
+    for (const char *p = list; *p; p++) {
+        if (*p == ',')
+            count++;
+    }
+    return count;
+}
+
+static int parse_agg(struct agg_spec *agg, char *text)
+{
+    static const struct {
+        const char *name;
+        agg_kind_t  kind;
+    } kinds[] = {
+        {"sum", AGG_SUM},
+        {"avg", AGG_AVG},
+        {"min", AGG_MIN},
+        {"max", AGG_MAX},
+    };
+
+    agg->column_name = NULL;
+    agg->column      = -1;
+    if (strcmp(text, "count") == 0) {
+        agg->kind = AGG_COUNT;
+        return 0;
+    }
+
+    char *colon = strchr(text, ':');
+    if (!colon || colon[1] == '\0')
+        return -1;
+    *colon = '\0';
+    for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++) {
+        if (strcmp(text, kinds[i].name) == 0) {
+            agg->kind        = kinds[i].kind;
+            agg->column_name = colon + 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void free_spec(struct group_spec *spec)
+{
+    if (spec->labels) {
+        for (int i = 0; i < spec->group_count + spec->agg_count; i++) {
+            free(spec->labels[i]);
+        }
+    }
+    free(spec->labels);
+    free(spec->group_buf);
+    free(spec->agg_buf);
+    free(spec->group_names);
+    free(spec->group_columns);
+    free(spec->aggs);
+}
+
+static int parse_spec(struct group_spec *spec, const struct cli_args *args)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->errors    = args->errors;
+    spec->group_buf = strdup(args->group_by);
+    spec->agg_buf   = strdup(args->agg ? args->agg : "count");
+    if (!spec->group_buf || !spec->agg_buf)
+        return -1;
+
+    spec->group_count   = count_items(spec->group_buf);
+    spec->agg_count     = count_items(spec->agg_buf);
+    spec->group_names   = calloc((size_t)spec->group_count, sizeof(char *));
+    spec->group_columns = calloc((size_t)spec->group_count, sizeof(int));
+    spec->aggs          = calloc((size_t)spec->agg_count, sizeof(struct agg_spec));
+    spec->labels = calloc((size_t)(spec->group_count + spec->agg_count), sizeof(char *));
+    if (!spec->group_names || !spec->group_columns || !spec->aggs || !spec->labels)
+        return -1;
+
+    char *save = NULL;
+    int   n    = 0;
+    for (char *tok = strtok_r(spec->group_buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        spec->group_names[n++] = tok;
+    }
+    spec->group_count = n;
+
+    n = 0;
+    for (char *tok = strtok_r(spec->agg_buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (parse_agg(&spec->aggs[n], tok) != 0) {
+            fprintf(args->errors, "Invalid aggregate: %s\n", tok);
+            return -1;
+        }
+        n++;
+    }
+    spec->agg_count = n;
+
+    if (spec->group_count == 0) {
+        fprintf(args->errors, "--group-by needs at least one column\n");
+        return -1;
+    }
+    return 0;
+}
+
+// Map column names to indexes once the header is known (NULL without one)
+static int resolve_spec(struct group_spec *spec, const char *const *header, int count)
+{
+    for (int g = 0; g < spec->group_count; g++) {
+        int column = resolve_column(spec->group_names[g], header, count);
+        if (column < 0) {
+            fprintf(spec->errors, "Unknown column: %s\n", spec->group_names[g]);
+            return -1;
+        }
+        spec->group_columns[g] = column;
+        spec->labels[g]        = strdup(header ? header[column] : spec->group_names[g]);
+        if (!spec->labels[g])
+            return -1;
+    }
+
+    for (int a = 0; a < spec->agg_count; a++) {
+        struct agg_spec *agg   = &spec->aggs[a];
+        char           **label = &spec->labels[spec->group_count + a];
+        if (agg->kind == AGG_COUNT) {
+            *label = strdup("count");
+        } else {
+            static const char *const names[] = {"count", "sum", "avg", "min", "max"};
+
+            agg->column = resolve_column(agg->column_name, header, count);
+            if (agg->column < 0) {
+                fprintf(spec->errors, "Unknown column: %s\n", agg->column_name);
+                return -1;
+            }
+            const char *name = header ? header[agg->column] : agg->column_name;
+            size_t      size = strlen(names[agg->kind]) + strlen(name) + 3;
+            *label           = malloc(size);
+            if (*label)
+                snprintf(*label, size, "%s(%s)", names[agg->kind], name);
+        }
+        if (!*label)
+            return -1;
+    }
+
+    spec->resolved = true;
+    return 0;
+}
+
+static int group_state_init(struct group_state *st, struct group_spec *spec)
+{
+    st->spec    = spec;
+    st->key     = NULL;
+    st->key_cap = 0;
+    size_t size = sizeof(struct group_value) + (size_t)spec->agg_count * sizeof(struct agg_acc);
+    return strtab_init(&st->table, size);
+}
+
+static void group_state_free(struct group_state *st)
+{
+    strtab_free(&st->table);
+    free(st->key);
+    st->key = NULL;
+}
+
+static void add_sum(struct agg_acc *acc, double value)
+{
+    double sum = acc->sum + value;
+    if (fabs(acc->sum) >= fabs(value))
+        acc->compensation += (acc->sum - sum) + value;
+    else
+        acc->compensation += (value - sum) + acc->sum;
+    acc->sum = sum;
+}
+
+static void add_value(struct agg_acc *acc, double value)
+{
+    if (acc->numbers == 0 || value < acc->min)
+        acc->min = value;
+    if (acc->numbers == 0 || value > acc->max)
+        acc->max = value;
+    add_sum(acc, value);
+    acc->numbers++;
+}
+
+// Fields are length-prefixed in the key, so no value can collide with another split
+static int build_key(struct group_state *st, const struct csv_row_view *row, size_t *len)
+{
+    const struct group_spec *spec = st->spec;
+    size_t                   need = 0;
+    for (int g = 0; g < spec->group_count; g++) {
+        int column = spec->group_columns[g];
+        need += sizeof(uint32_t) + (column < row->field_count ? row->lengths[column] : 0);
+    }
+
+    if (need > st->key_cap) {
+        size_t cap = st->key_cap ? st->key_cap : 256;
+        while (cap < need)
+            cap *= 2;
+        char *key = realloc(st->key, cap);
+        if (!key)
+            return -1;
+        st->key     = key;
+        st->key_cap = cap;
+    }
+
+    char *p = st->key;
+    for (int g = 0; g < spec->group_count; g++) {
+        int      column = spec->group_columns[g];
+        uint32_t n      = column < row->field_count ? (uint32_t)row->lengths[column] : 0;
+        memcpy(p, &n, sizeof(n));
+        p += sizeof(n);
+        if (n > 0)
+            memcpy(p, row->fields[column], n);
+        p += n;
+    }
+    *len = need;
+    return 0;
+}
+
+static int group_row(const struct csv_row_view *row, void *ctx)
+{
+    struct group_state      *st   = ctx;
+    const struct group_spec *spec = st->spec;
+
+    if (row->index < 0)
+        return resolve_spec(st->spec, row->fields, row->field_count);
+
+    size_t len;
+    bool   created;
+    if (build_key(st, row, &len) != 0)
+        return -1;
+    struct group_value *value = strtab_get(&st->table, st->key, len, &created);
+    if (!value)
+        return -1;
+
+    value->count++;
+    for (int a = 0; a < spec->agg_count; a++) {
+        int    column = spec->aggs[a].column;
+        double number;
+        if (column < 0 || column >= row->field_count)
+            continue;
+        if (parse_number(row->fields[column], row->lengths[column], &number) != NUM_NONE)
+            add_value(&value->acc[a], number);
+    }
+    return 0;
+}
+
+// Fold a partial table into dst, keys new to dst keep src's order
+static int merge_state(struct group_state *dst, const struct group_state *src)
+{
+    for (size_t i = 0; i < src->table.count; i++) {
+        const struct strtab_entry *entry = strtab_entry(&src->table, i);
+        const struct group_value  *from  = strtab_value(&src->table, i);
+        bool                       created;
+        struct group_value        *to = strtab_get(&dst->table, entry->key, entry->len, &created);
+        if (!to)
+            return -1;
+
+        to->count += from->count;
+        for (int a = 0; a < dst->spec->agg_count; a++) {
+            const struct agg_acc *x = &from->acc[a];
+            struct agg_acc       *y = &to->acc[a];
+            if (x->numbers == 0)
+                continue;
+            if (y->numbers == 0 || x->min < y->min)
+                y->min = x->min;
+            if (y->numbers == 0 || x->max > y->max)
+                y->max = x->max;
+            add_sum(y, x->sum);
+            y->compensation += x->compensation;
+            y->numbers += x->numbers;
+        }
+    }
+    return 0;
+}
+
+static void run_chunks(void *ctx, long begin, long end, int worker __attribute__((unused)))
+{
+    struct chunk_job *job = ctx;
+    struct cli_args   body = *job->args;
+    body.no_headers        = true;
+
+    for (long c = begin; c < end; c++) {
+        struct group_chunk *chunk = &job->chunks[c];
+        chunk->status             = parse_csv_buffer(chunk->begin,
+                                         (size_t)(chunk->end - chunk->begin),
+                                         &body,
+                                         group_row,
+                                         &chunk->state,
+                                         &chunk->unterminated);
+    }
+}
+
+// Aggregate file slices on worker threads into partial tables merged in file
+// order. Slice starts are guessed at confirmed line breaks; a slice that ends
+// inside a record shows the guess was wrong and the pass reruns serially.
+static int aggregate_parallel(struct group_state    *st,
+                              const char            *data,
+                              const char            *end,
+                              int                    columns,
+                              int                    threads,
+                              const struct cli_args *args)
+{
+    struct group_chunk *chunks = calloc((size_t)threads, sizeof(*chunks));
+    if (!chunks)
+        return -1;
+
+    char   delim = args->tsv ? '\t' : args->delimiter;
+    size_t span  = (size_t)(end - data);
+    int    ret   = 0;
+
+    chunks[0].begin = data;
+    for (int i = 1; i < threads; i++) {
+        const char *guess = data + span / (size_t)threads * (size_t)i - 1;
+        const char *start = csv_resync(guess, end, delim, columns, CONFIRM_RECORDS, RESYNC_LINES);
+        if (!start || start < chunks[i - 1].begin)
+            start = start ? chunks[i - 1].begin : end;
+        chunks[i].begin   = start;
+        chunks[i - 1].end = start;
+    }
+    chunks[threads - 1].end = end;
+
+    for (int i = 0; i < threads; i++) {
+        if (group_state_init(&chunks[i].state, st->spec) != 0)
+            ret = -1;
+    }
+
+    bool aligned = true;
+    if (ret == 0) {
+        struct chunk_job job = {.chunks = chunks, .args = args};
+        parallel_for(threads, threads, run_chunks, &job);
+
+        for (int i = 0; i < threads; i++) {
+            if (chunks[i].status != 0)
+                ret = -1;
+            if (i < threads - 1 && chunks[i].unterminated)
+                aligned = false;
+        }
+    }
+
+    for (int i = 0; i < threads && ret == 0 && aligned; i++) {
+        ret = merge_state(st, &chunks[i].state);
+    }
+    for (int i = 0; i < threads; i++) {
+        group_state_free(&chunks[i].state);
+    }
+    free(chunks);
+
+    if (ret == 0 && !aligned) {
+        struct cli_args body = *args;
+        body.no_headers      = true;
+        ret = parse_csv_buffer(data, span, &body, group_row, st, NULL);
+    }
+    return ret;
+}
+
+static int aggregate_mapped(struct group_state    *st,
+                            const char            *base,
+                            size_t                 size,
+                            const struct cli_args *args)
+{
+    const char     *end     = base + size;
+    const char     *data    = base;
+    char            delim   = args->tsv ? '\t' : args->delimiter;
+    int             columns = 0;
+    bool            clean;
+    struct cli_args body = *args;
+    body.no_headers      = true;
+
+    if (!args->no_headers) {
+        data = csv_scan_record(base, end, delim, &columns, &clean);
+        if (parse_csv_buffer(base, (size_t)(data - base), args, group_row, st, NULL) != 0)
+            return -1;
+    } else {
+        csv_scan_record(base, end, delim, &columns, &clean);
+    }
+    if (!st->spec->resolved && resolve_spec(st->spec, NULL, 0) != 0)
+        return -1;
+
+    int threads = parallel_threads(args->threads, (long)(end - data), MIN_CHUNK_BYTES);
+    if (threads > 1)
+        return aggregate_parallel(st, data, end, columns, threads, args);
+    return parse_csv_buffer(data, (size_t)(end - data), &body, group_row, st, NULL);
+}
+
+struct group_order {
+    long   count;
+    size_t index;
+};
+
+static int compare_groups(const void *a, const void *b)
+{
+    const struct group_order *x = a;
+    const struct group_order *y = b;
+
+    // Largest groups first, ties in order of first appearance
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static void format_agg(char                     *buf,
+                       size_t                    size,
+                       const struct agg_spec    *agg,
+                       const struct group_value *value,
+                       int                       a)
+{
+    const struct agg_acc *acc = &value->acc[a];
+    if (agg->kind == AGG_COUNT) {
+        snprintf(buf, size, "%ld", value->count);
+        return;
+    }
+    if (acc->numbers == 0) {
+        snprintf(buf, size, "-");
+        return;
+    }
+
+    double sum = acc->sum + acc->compensation;
+    switch (agg->kind) {
+        case AGG_SUM:
+            snprintf(buf, size, "%.15g", sum);
+            break;
+        case AGG_AVG:
+            snprintf(buf, size, "%.6g", sum / (double)acc->numbers);
+            break;
+        case AGG_MIN:
+            snprintf(buf, size, "%.15g", acc->min);
+            break;
+        case AGG_MAX:
+            snprintf(buf, size, "%.15g", acc->max);
+            break;
+        case AGG_COUNT:
+        default:
+            break;
+    }
+}
+
+static int add_group_row(struct csv_data           *csv,
+                         const struct group_spec   *spec,
+                         const struct strtab_entry *entry,
+                         const struct group_value  *value,
+                         const char               **fields,
+                         char                      *buf)
+{
+    // Unpack the length-prefixed key into NUL-terminated fields
+    const char *p = entry->key;
+    char       *q = buf;
+    for (int g = 0; g < spec->group_count; g++) {
+        uint32_t n;
+        memcpy(&n, p, sizeof(n));
+        p += sizeof(n);
+        memcpy(q, p, n);
+        q[n]      = '\0';
+        fields[g] = q;
+        p += n;
+        q += n + 1;
+    }
+
+    for (int a = 0; a < spec->agg_count; a++) {
+        format_agg(q, 32, &spec->aggs[a], value, a);
+        fields[spec->group_count + a] = q;
+        q += 32;
+    }
+    return csv_data_add(csv, fields, spec->group_count + spec->agg_count, false);
+}
+
+static int render_groups(struct group_state *st, struct cli_args *args)
+{
+    struct group_spec *spec  = st->spec;
+    struct strtab     *table = &st->table;
+    int                width = spec->group_count + spec->agg_count;
+    struct csv_data    csv;
+
+    struct group_order *order   = malloc((table->count ? table->count : 1) * sizeof(*order));
+    const char        **fields  = malloc((size_t)width * sizeof(char *));
+    size_t              longest = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        if (strtab_entry(table, i)->len > longest)
+            longest = strtab_entry(table, i)->len;
+    }
+    char *buf = malloc(longest + (size_t)spec->group_count + (size_t)spec->agg_count * 32);
+    int   ret = (order && fields && buf && csv_data_init(&csv) == 0) ? 0 : -1;
+
+    if (ret == 0) {
+        for (size_t i = 0; i < table->count; i++) {
+            const struct group_value *value = strtab_value(table, i);
+            order[i]                        = (struct group_order){value->count, i};
+        }
+        if (args->sort_count)
+            qsort(order, table->count, sizeof(*order), compare_groups);
+
+        ret = csv_data_add(&csv, (const char *const *)spec->labels, width, true);
+        for (size_t i = 0; i < table->count && ret == 0; i++) {
+            size_t index = order[i].index;
+            ret          = add_group_row(
+                &csv, spec, strtab_entry(table, index), strtab_value(table, index), fields, buf);
+        }
+        csv_data_finish(&csv, args->number);
+
+        // The result is a regular table, so every style and alignment applies
+        if (ret == 0)
+            ret = print_table(&csv, args);
+        free_csv_data(&csv);
+    }
+
+    free(order);
+    free(fields);
+    free(buf);
+    return ret;
+}
+
+int print_group_by(FILE *input, struct cli_args *args)
+{
+    struct group_spec  spec;
+    struct group_state st;
+    if (parse_spec(&spec, args) != 0 || group_state_init(&st, &spec) != 0) {
+        free_spec(&spec);
+        return -1;
+    }
+
+    struct stat sb;
+    void       *map  = MAP_FAILED;
+    size_t      size = 0;
+    if (fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    int ret;
+    if (map != MAP_FAILED) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        ret = aggregate_mapped(&st, map, size, args);
+        munmap(map, size);
+    } else {
+        ret = args->no_headers ? resolve_spec(&spec, NULL, 0) : 0;
+        if (ret == 0)
+            ret = parse_csv_stream(input, args, group_row, &st);
+        if (ret == 0 && !spec.resolved)
+            ret = resolve_spec(&spec, NULL, 0);
+    }
+
+    if (ret == 0)
+        ret = render_groups(&st, args);
+
+    group_state_free(&st);
+    free_spec(&spec);
+    return ret;
+}
\ No newline at end of file
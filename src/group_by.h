@@ -0,0 +1,12 @@
+#ifndef GROUP_BY_H
+#define GROUP_BY_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Aggregate records by the --group-by columns in one pass and print one row
+// per distinct key with the --agg results
+int print_group_by(FILE *input, struct cli_args *args);
+
+#endif  // GROUP_BY_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "input_profile.h"
+
+#define DELIMITER_LINES 64  // Lines that must agree on a delimiter candidate
+
+static const char candidates[] = {',', '\t', ';', '|'};
+
+// Count each candidate on the line [p, end)
+static void count_candidates(const char *p, const char *end, int *counts)
+{
+    memset(counts, 0, sizeof(candidates) * sizeof(int));
+    for (; p < end; p++) {
+        for (size_t k = 0; k < sizeof(candidates); k++) {
+            if (*p == candidates[k])
+                counts[k]++;
+        }
+    }
+}
+
+// The comma is kept whenever it splits the first lines consistently, so only
+// files without one switch delimiter; otherwise the candidate that appears
+// the same non-zero number of times on every line, the most often, wins
+static char dominant_delimiter(const char *data, size_t len)
+{
+    int         first[sizeof(candidates)];
+    int         counts[sizeof(candidates)];
+    bool        steady[sizeof(candidates)];
+    const char *p     = data;
+    const char *end   = data + len;
+    int         lines = 0;
+
+    while (p < end && lines < DELIMITER_LINES) {
+        const char *eol = p;
+        while (eol < end && *eol != '\n' && *eol != '\r')
+            eol++;
+        if (eol == end && lines > 0)
+            break;  // The last line may be cut short by the block end
+        if (eol > p) {
+            count_candidates(p, eol, lines == 0 ? first : counts);
+            for (size_t k = 0; k < sizeof(candidates); k++) {
+                if (lines == 0)
+                    steady[k] = first[k] > 0;
+                else if (counts[k] != first[k])
+                    steady[k] = false;
+            }
+            lines++;
+        }
+        p = eol + 1;
+    }
+
+    int best = -1;
+    for (size_t k = 0; k < sizeof(candidates) && lines > 0; k++) {
+        if (steady[k] && (best < 0 || (best > 0 && first[k] > first[best])))
+            best = (int)k;
+    }
+    return best < 0 ? 0 : candidates[best];
+}
+
+void profile_block(const char *data, size_t len, struct input_profile *profile)
+{
+    bool   quotes = false;
+    int    high   = 0;
+    size_t i      = 0;
+
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    __m128i       q     = _mm_setzero_si128();
+    __m128i       h     = _mm_setzero_si128();
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+        q         = _mm_or_si128(q, _mm_cmpeq_epi8(v, quote));
+        h         = _mm_or_si128(h, v);
+    }
+    quotes = _mm_movemask_epi8(q) != 0;
+    high   = _mm_movemask_epi8(h);
+#endif
+    for (; i < len; i++) {
+        quotes |= data[i] == '"';
+        high |= (unsigned char)data[i] & 0x80;
+    }
+
+    const char *nl     = memchr(data, '\n', len);
+    const char *ret    = memchr(data, '\r', nl ? (size_t)(nl - data) : len);
+    profile->quotes    = quotes;
+    profile->ascii     = high == 0;
+    profile->delimiter = dominant_delimiter(data, len);
+    if (ret)
+        profile->line_ending = ret + 1 == nl ? EOL_CRLF : EOL_CR;
+    else
+        profile->line_ending = nl ? EOL_LF : EOL_NONE;
+}
+
+int profile_input(FILE *input, struct input_profile *profile)
+{
+    struct stat st;
+    int         fd = fileno(input);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+
+    off_t offset = ftello(input);
+    char *buf    = malloc(PROFILE_BLOCK);
+    if (offset < 0 || !buf) {
+        free(buf);
+        return -1;
+    }
+
+    ssize_t len = pread(fd, buf, PROFILE_BLOCK, offset);
+    if (len >= 0)
+        profile_block(buf, (size_t)len, profile);
+    free(buf);
+    return len >= 0 ? 0 : -1;
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef INPUT_PROFILE_H
+#define INPUT_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define PROFILE_BLOCK (1 << 20)  // Bytes of the input head that are profiled
+
+enum line_ending { EOL_NONE, EOL_LF, EOL_CRLF, EOL_CR };
+
+// Properties of the head of an input that select the parser's fast paths.
+// They only hold for the profiled bytes, consumers recheck the rest.
+struct input_profile {
+    bool             quotes;       // A quote character appears
+    bool             ascii;        // No byte above 0x7f
+    enum line_ending line_ending;  // Style of the first line break
+    char             delimiter;    // Candidate splitting every line alike, 0 if none
+};
+
+void profile_block(const char *data, size_t len, struct input_profile *profile);
+
+// Profile the head of a regular file without consuming it; -1 for streams
+int profile_input(FILE *input, struct input_profile *profile);
+
+#endif  // INPUT_PROFILE_H
\ No newline at end of file
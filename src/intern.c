@@ -0,0 +1,180 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "csv_parser.h"
+#include "intern.h"
+
+#define INTERN_MIN_PROBE   256        // Fewest records seen before columns are judged
+#define INTERN_MAX_PROBE   4096       // Most, also when --sniff measures every record
+#define INTERN_MIN_REPEAT  8          // Average repeats per value to stay interned
+#define INTERN_MAX_VALUES  (1 << 16)  // Distinct values after which a column gives up
+#define INTERN_ARENA_BLOCK (1 << 16)
+#define INTERN_VALUE_COST  64  // Approximate dictionary overhead per distinct value
+
+struct intern_block {
+    struct intern_block *next;
+    char                 data[];
+};
+
+struct intern_value {
+    char *text;   // Shared NUL-terminated copy, display width stored in front
+    int   first;  // Index of the first record holding the value
+};
+
+int intern_init(struct csv_dict *dict, int sniff)
+{
+    dict->columns      = NULL;
+    dict->column_count = 0;
+    dict->probe_rows   = sniff > 0 && sniff < INTERN_MAX_PROBE ? sniff : INTERN_MAX_PROBE;
+    dict->probing      = true;
+    if (dict->probe_rows < INTERN_MIN_PROBE)
+        dict->probe_rows = INTERN_MIN_PROBE;
+    return 0;
+}
+
+static void free_column(struct intern_column *column)
+{
+    strtab_free(&column->values);
+    while (column->blocks) {
+        struct intern_block *next = column->blocks->next;
+        free(column->blocks);
+        column->blocks = next;
+    }
+    column->arena      = NULL;
+    column->arena_left = 0;
+    column->active     = false;
+}
+
+void intern_free(struct csv_dict *dict)
+{
+    for (int i = 0; i < dict->column_count; i++) {
+        free_column(&dict->columns[i]);
+    }
+    free(dict->columns);
+    dict->columns      = NULL;
+    dict->column_count = 0;
+}
+
+static int grow_columns(struct csv_dict *dict, int count)
+{
+    struct intern_column *columns = realloc(dict->columns, (size_t)count * sizeof(*columns));
+    if (!columns)
+        return -1;
+    dict->columns = columns;
+
+    for (; dict->column_count < count; dict->column_count++) {
+        struct intern_column *column = &columns[dict->column_count];
+        memset(column, 0, sizeof(*column));
+        if (strtab_init(&column->values, sizeof(struct intern_value)) != 0)
+            return -1;
+        column->active = true;
+    }
+    return 0;
+}
+
+// Copy a value into the column's arena behind its display width
+static char *copy_value(struct intern_column *column, const char *value, size_t len)
+{
+    size_t need = sizeof(int) + len + 1;
+    if (need > column->arena_left) {
+        size_t               size  = need > INTERN_ARENA_BLOCK ? need : INTERN_ARENA_BLOCK;
+        struct intern_block *block = malloc(sizeof(*block) + size);
+        if (!block)
+            return NULL;
+        block->next        = column->blocks;
+        column->blocks     = block;
+        column->arena      = block->data;
+        column->arena_left = size;
+    }
+
+    int   width = unicode_display_width(value);
+    char *text  = column->arena + sizeof(int);
+    memcpy(column->arena, &width, sizeof(int));
+    memcpy(text, value, len + 1);
+    column->arena += need;
+    column->arena_left -= need;
+    return text;
+}
+
+// Give the leading count records private copies of a column and drop its dictionary
+static int release_column(struct csv_data *csv, int column, int count)
+{
+    for (int r = 0; r < count; r++) {
+        struct csv_record *record = &csv->records[r];
+        if (column >= record->field_count)
+            continue;
+
+        size_t len  = strlen(record->fields[column]);
+        char  *copy = malloc(len + 1);
+        if (!copy)
+            return -1;
+        memcpy(copy, record->fields[column], len + 1);
+        record->fields[column] = copy;
+        csv->memory_used += (len + 1 + 8 + 15) & ~(size_t)15;
+    }
+
+    free_column(&csv->dict->columns[column]);
+    return 0;
+}
+
+int intern_record(struct csv_data *csv, int index)
+{
+    struct csv_dict   *dict   = csv->dict;
+    struct csv_record *record = &csv->records[index];
+
+    // Columns first seen after the probe window are never interned
+    if (dict->probing && record->field_count > dict->column_count &&
+        grow_columns(dict, record->field_count) != 0)
+        return -1;
+
+    for (int i = 0; i < record->field_count && i < dict->column_count; i++) {
+        struct intern_column *column = &dict->columns[i];
+        if (!column->active)
+            continue;
+
+        // The table's key is the shared copy itself, so a value is stored once
+        size_t               len   = strlen(record->fields[i]);
+        struct intern_value *value = strtab_find(&column->values, record->fields[i], len);
+        if (!value) {
+            bool  created;
+            char *text = copy_value(column, record->fields[i], len);
+            if (!text || !(value = strtab_get_borrowed(&column->values, text, len, &created)))
+                return -1;
+            value->text  = text;
+            value->first = index;
+            csv->memory_used += sizeof(int) + len + 1 + INTERN_VALUE_COST;
+        }
+
+        free(record->fields[i]);
+        record->fields[i] = value->text;
+
+        if (!dict->probing && column->values.count > INTERN_MAX_VALUES &&
+            release_column(csv, i, index + 1) != 0)
+            return -1;
+    }
+
+    if (dict->probing && index + 1 >= dict->probe_rows) {
+        dict->probing = false;
+        for (int i = 0; i < dict->column_count; i++) {
+            size_t distinct = dict->columns[i].values.count;
+            if (dict->columns[i].active &&
+                distinct * INTERN_MIN_REPEAT > (size_t)dict->probe_rows &&
+                release_column(csv, i, index + 1) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int intern_sniff_width(const struct csv_dict *dict, int column, int count)
+{
+    const struct strtab *values = &dict->columns[column].values;
+
+    int width = 0;
+    for (size_t i = 0; i < values->count; i++) {
+        const struct intern_value *value = strtab_value(values, i);
+        if (value->first < count && intern_width(value->text) > width)
+            width = intern_width(value->text);
+    }
+    return width;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "strtab.h"
+#include "utils.h"
+
+struct csv_data;
+struct intern_block;
+
+struct intern_column {
+    struct strtab        values;  // Shared copies, borrowed as keys -> struct intern_value
+    struct intern_block *blocks;  // Arena holding the shared, width-prefixed copies
+    char                *arena;
+    size_t               arena_left;
+    bool                 active;
+};
+
+// Value dictionaries for the low-cardinality columns of a buffered table.
+// Every column starts out interned; columns whose distinct values are not a
+// small fraction of the probe window, the records --sniff measures, fall back
+// to private copies. Interned cells of all in-memory records point at one
+// shared copy per value, which carries its display width in front of the text.
+struct csv_dict {
+    struct intern_column *columns;
+    int                   column_count;
+    int                   probe_rows;
+    bool                  probing;  // Still inside the probe window
+};
+
+int  intern_init(struct csv_dict *dict, int sniff);
+void intern_free(struct csv_dict *dict);
+
+// Replace the fields of the in-memory record at index with shared copies
+// for every interned column, freeing the private ones
+int intern_record(struct csv_data *csv, int index);
+
+// Widest value of column first seen within the leading count records
+int intern_sniff_width(const struct csv_dict *dict, int column, int count);
+
+static inline bool intern_active(const struct csv_dict *dict, int column)
+{
+    return dict && column < dict->column_count && dict->columns[column].active;
+}
+
+static inline int intern_width(const char *value)
+{
+    int width;
+    memcpy(&width, value - sizeof(int), sizeof(int));
+    return width;
+}
+
+// Display width of a cell, looked up for interned columns
+static inline int intern_cell_width(const struct csv_dict *dict, int column, const char *value)
+{
+    return intern_active(dict, column) ? intern_width(value) : unicode_display_width(value);
+}
+
+#endif  // INTERN_H
\ No newline at end of file
@@ -0,0 +1,593 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "csv_parser.h"
+#include "join.h"
+#include "progress.h"
+#include "spill.h"
+#include "strtab.h"
+#include "table_printer.h"
+#include "utils.h"
+
+#define JOIN_PARTITIONS 16
+#define JOIN_ROW_COST   64  // Approximate table overhead per build record
+
+enum { SIDE_LEFT, SIDE_RIGHT };
+
+struct join_side {
+    const char **key_names;  // Point into join_state.on_buf
+    int         *key_columns;
+    char       **header;  // Copy of the header row, NULL without one
+    int          header_count;
+    int          columns;  // Header width, or that of the first record without one
+    bool         seen;
+};
+
+struct join_row {
+    size_t offset;  // First field in join_state.data
+    long   next;    // Next build record with the same key, -1 ends the chain
+    int    field_count;
+    bool   matched;
+};
+
+struct join_bucket {
+    long head;
+    long tail;
+};
+
+struct join_state {
+    const struct cli_args *args;
+    char                  *on_buf;  // Copy of --on, split in place
+    int                    key_count;
+    struct join_side       sides[2];
+    int                    build;  // Side held in the hash table, the other one streams
+    struct strtab          keys;   // Build key -> struct join_bucket
+    struct join_row       *rows;
+    long                   row_count;
+    long                   row_cap;
+    char                  *data;  // Build fields, NUL-terminated back to back
+    size_t                 data_len;
+    size_t                 data_cap;
+    size_t                 bytes;  // Estimated size of the table
+    struct spill_file     *parts;  // Build partitions, then probe partitions
+    bool                   partitioned;
+    char                  *key;  // Scratch buffer for the composite key
+    size_t                 key_cap;
+    const char           **cells;  // Scratch for output rows
+    int                    cells_cap;
+    const char           **fields;   // Scratch for decoded build records
+    size_t                *lengths;  // Scratch for records read back from partitions
+    int                   *zeros;    // Widths written to partitions
+    int                    scratch_cap;
+    struct csv_data       *out;
+};
+
+typedef int (*replay_fn)(struct join_state *st, const struct csv_row_view *row);
+
+static int reserve_cells(struct join_state *st, int count)
+{
+    if (count <= st->cells_cap)
+        return 0;
+
+    const char **cells = realloc(st->cells, (size_t)count * sizeof(char *));
+    if (!cells)
+        return -1;
+    st->cells     = cells;
+    st->cells_cap = count;
+    return 0;
+}
+
+// Grow the per-field scratch arrays to hold records of count fields
+static int reserve_scratch(struct join_state *st, int count)
+{
+    if (count <= st->scratch_cap)
+        return 0;
+
+    int cap = st->scratch_cap ? st->scratch_cap * 2 : 16;
+    while (cap < count)
+        cap *= 2;
+
+    const char **fields = realloc(st->fields, (size_t)cap * sizeof(char *));
+    if (fields)
+        st->fields = fields;
+    size_t *lengths = realloc(st->lengths, (size_t)cap * sizeof(size_t));
+    if (lengths)
+        st->lengths = lengths;
+    int *zeros = realloc(st->zeros, (size_t)cap * sizeof(int));
+    if (zeros)
+        st->zeros = zeros;
+    if (!fields || !lengths || !zeros)
+        return -1;
+
+    memset(st->zeros, 0, (size_t)cap * sizeof(int));
+    st->scratch_cap = cap;
+    return 0;
+}
+
+// Split "a=b,c" into left and right key names, a bare name is used for both
+static int parse_on(struct join_state *st, const char *list)
+{
+    st->on_buf = strdup(list);
+    if (!st->on_buf)
+        return -1;
+
+    int count = 1;
+    for (const char *p = list; *p; p++) {
+        if (*p == ',')
+            count++;
+    }
+    for (int s = 0; s < 2; s++) {
+        st->sides[s].key_names   = calloc((size_t)count, sizeof(char *));
+        st->sides[s].key_columns = calloc((size_t)count, sizeof(int));
+        if (!st->sides[s].key_names || !st->sides[s].key_columns)
+            return -1;
+    }
+
+    char *save = NULL;
+    for (char *tok = strtok_r(st->on_buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        if (eq)
+            *eq++ = '\0';
+        st->sides[SIDE_LEFT].key_names[st->key_count]  = tok;
+        st->sides[SIDE_RIGHT].key_names[st->key_count] = eq ? eq : tok;
+        st->key_count++;
+    }
+    if (st->key_count == 0) {
+        fprintf(st->args->errors, "--on needs at least one column\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int resolve_side(struct join_state *st, int side, const char *const *header, int count)
+{
+    struct join_side *js = &st->sides[side];
+    for (int k = 0; k < st->key_count; k++) {
+        js->key_columns[k] = resolve_column(js->key_names[k], header, count);
+        if (js->key_columns[k] < 0) {
+            fprintf(st->args->errors, "Unknown join column: %s\n", js->key_names[k]);
+            return -1;
+        }
+    }
+    if (!header)
+        return 0;
+
+    js->header = calloc((size_t)(count ? count : 1), sizeof(char *));
+    if (!js->header)
+        return -1;
+    for (; js->header_count < count; js->header_count++) {
+        js->header[js->header_count] = strdup(header[js->header_count]);
+        if (!js->header[js->header_count])
+            return -1;
+    }
+    return 0;
+}
+
+static bool is_key_column(const struct join_side *js, int key_count, int column)
+{
+    for (int k = 0; k < key_count; k++) {
+        if (js->key_columns[k] == column)
+            return true;
+    }
+    return false;
+}
+
+// Fields are length-prefixed in the key, so no value can collide with another split
+static int build_key(struct join_state *st, int side, const struct csv_row_view *row, size_t *len)
+{
+    const int *columns = st->sides[side].key_columns;
+    size_t     need    = 0;
+    for (int k = 0; k < st->key_count; k++) {
+        need += sizeof(uint32_t) + (columns[k] < row->field_count ? row->lengths[columns[k]] : 0);
+    }
+
+    if (need > st->key_cap) {
+        size_t cap = st->key_cap ? st->key_cap : 256;
+        while (cap < need)
+            cap *= 2;
+        char *key = realloc(st->key, cap);
+        if (!key)
+            return -1;
+        st->key     = key;
+        st->key_cap = cap;
+    }
+
+    char *p = st->key;
+    for (int k = 0; k < st->key_count; k++) {
+        int      column = columns[k];
+        uint32_t n      = column < row->field_count ? (uint32_t)row->lengths[column] : 0;
+        memcpy(p, &n, sizeof(n));
+        p += sizeof(n);
+        if (n > 0)
+            memcpy(p, row->fields[column], n);
+        p += n;
+    }
+    *len = need;
+    return 0;
+}
+
+static int table_add(struct join_state *st, const struct csv_row_view *row, size_t key_len)
+{
+    size_t need = 0;
+    for (int i = 0; i < row->field_count; i++) {
+        need += row->lengths[i] + 1;
+    }
+    if (st->data_len + need > st->data_cap) {
+        size_t cap = st->data_cap ? st->data_cap : 1 << 16;
+        while (cap < st->data_len + need)
+            cap *= 2;
+        char *data = realloc(st->data, cap);
+        if (!data)
+            return -1;
+        st->data     = data;
+        st->data_cap = cap;
+    }
+    if (st->row_count == st->row_cap) {
+        long             cap  = st->row_cap ? st->row_cap * 2 : 1024;
+        struct join_row *rows = realloc(st->rows, (size_t)cap * sizeof(*rows));
+        if (!rows)
+            return -1;
+        st->rows    = rows;
+        st->row_cap = cap;
+    }
+
+    bool                created;
+    struct join_bucket *bucket = strtab_get(&st->keys, st->key, key_len, &created);
+    if (!bucket)
+        return -1;
+    if (created)
+        bucket->head = st->row_count;
+    else
+        st->rows[bucket->tail].next = st->row_count;
+    bucket->tail = st->row_count;
+
+    st->rows[st->row_count++] = (struct join_row){
+        .offset = st->data_len, .next = -1, .field_count = row->field_count, .matched = false};
+    for (int i = 0; i < row->field_count; i++) {
+        memcpy(st->data + st->data_len, row->fields[i], row->lengths[i] + 1);
+        st->data_len += row->lengths[i] + 1;
+    }
+    st->bytes += need + key_len + JOIN_ROW_COST;
+    return 0;
+}
+
+static int table_reset(struct join_state *st)
+{
+    strtab_free(&st->keys);
+    st->row_count = 0;
+    st->data_len  = 0;
+    st->bytes     = 0;
+    return strtab_init(&st->keys, sizeof(struct join_bucket));
+}
+
+// Point st->fields at the fields of a build record
+static const char **row_fields(struct join_state *st, const struct join_row *row)
+{
+    const char *p = st->data + row->offset;
+    for (int i = 0; i < row->field_count; i++) {
+        st->fields[i] = p;
+        p += strlen(p) + 1;
+    }
+    return st->fields;
+}
+
+// Add one output record, left fields padded to the left width, then the
+// right fields without its key columns. right is NULL for an unmatched left record.
+static int emit(struct join_state  *st,
+                const char *const  *left,
+                int                 left_count,
+                const char *const  *right,
+                int                 right_count)
+{
+    const struct join_side *ls    = &st->sides[SIDE_LEFT];
+    const struct join_side *rs    = &st->sides[SIDE_RIGHT];
+    int                     width = left_count > ls->columns ? left_count : ls->columns;
+    if (!right)
+        right_count = rs->columns;
+    if (reserve_cells(st, width + right_count) != 0)
+        return -1;
+
+    int n = 0;
+    for (int i = 0; i < width; i++) {
+        st->cells[n++] = i < left_count ? left[i] : "";
+    }
+    for (int i = 0; i < right_count; i++) {
+        if (!is_key_column(rs, st->key_count, i))
+            st->cells[n++] = right ? right[i] : "";
+    }
+    return csv_data_add(st->out, st->cells, n, false);
+}
+
+static int probe(struct join_state *st, const struct csv_row_view *row, size_t key_len)
+{
+    const struct join_bucket *bucket  = strtab_find(&st->keys, st->key, key_len);
+    bool                      matched = false;
+
+    for (long r = bucket ? bucket->head : -1; r >= 0; r = st->rows[r].next) {
+        struct join_row *build  = &st->rows[r];
+        const char     **fields = row_fields(st, build);
+        int              ret;
+        if (st->build == SIDE_LEFT)
+            ret = emit(st, fields, build->field_count, row->fields, row->field_count);
+        else
+            ret = emit(st, row->fields, row->field_count, fields, build->field_count);
+        if (ret != 0)
+            return -1;
+        build->matched = true;
+        matched        = true;
+    }
+
+    if (!matched && st->args->join_left && st->build == SIDE_RIGHT)
+        return emit(st, row->fields, row->field_count, NULL, 0);
+    return 0;
+}
+
+// With the left side in the table, a left join ends with its unmatched records
+static int emit_unmatched(struct join_state *st)
+{
+    if (!st->args->join_left || st->build != SIDE_LEFT)
+        return 0;
+
+    for (long r = 0; r < st->row_count; r++) {
+        const struct join_row *build = &st->rows[r];
+        if (!build->matched && emit(st, row_fields(st, build), build->field_count, NULL, 0) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Route a record to its side's partition by the high bits of its key hash
+static int partition_write(struct join_state *st, int side, const struct csv_row_view *row)
+{
+    size_t len;
+    if (reserve_scratch(st, row->field_count) != 0 || build_key(st, side, row, &len) != 0)
+        return -1;
+
+    size_t part = (size_t)(strtab_hash(st->key, len) >> 32) % JOIN_PARTITIONS;
+    if (side != st->build)
+        part += JOIN_PARTITIONS;
+    return spill_write(&st->parts[part], row->fields, st->zeros, row->field_count);
+}
+
+// Over the memory budget: open the partitions and move the table into them
+static int start_partitions(struct join_state *st)
+{
+    st->parts = calloc(2 * JOIN_PARTITIONS, sizeof(struct spill_file));
+    if (!st->parts)
+        return -1;
+    for (int p = 0; p < 2 * JOIN_PARTITIONS; p++) {
+        if (spill_open(&st->parts[p]) != 0)
+            return -1;
+    }
+    st->partitioned = true;
+
+    for (long r = 0; r < st->row_count; r++) {
+        const struct join_row *build  = &st->rows[r];
+        const char           **fields = row_fields(st, build);
+        for (int i = 0; i < build->field_count; i++) {
+            st->lengths[i] = strlen(fields[i]);
+        }
+        struct csv_row_view view = {
+            .fields = fields, .lengths = st->lengths, .field_count = build->field_count};
+        if (partition_write(st, st->build, &view) != 0)
+            return -1;
+    }
+    return table_reset(st);
+}
+
+// Record the header or first record shape of a side
+static int note_row(struct join_state *st, int side, const struct csv_row_view *row)
+{
+    struct join_side *js = &st->sides[side];
+    if (!js->seen) {
+        js->seen    = true;
+        js->columns = row->field_count;
+        if (row->index < 0)
+            return resolve_side(st, side, row->fields, row->field_count);
+    }
+    return 0;
+}
+
+static int build_row(const struct csv_row_view *row, void *ctx)
+{
+    struct join_state *st = ctx;
+    if (note_row(st, st->build, row) != 0)
+        return -1;
+    if (row->index < 0)
+        return 0;
+    if (st->partitioned)
+        return partition_write(st, st->build, row);
+
+    size_t len;
+    if (reserve_scratch(st, row->field_count) != 0 || build_key(st, st->build, row, &len) != 0 ||
+        table_add(st, row, len) != 0)
+        return -1;
+    if (st->args->max_memory > 0 && st->bytes > st->args->max_memory)
+        return start_partitions(st);
+    return 0;
+}
+
+static int probe_row(const struct csv_row_view *row, void *ctx)
+{
+    struct join_state *st = ctx;
+    if (note_row(st, 1 - st->build, row) != 0)
+        return -1;
+    if (row->index < 0)
+        return 0;
+    if (st->partitioned)
+        return partition_write(st, 1 - st->build, row);
+
+    size_t len;
+    if (build_key(st, 1 - st->build, row, &len) != 0)
+        return -1;
+    return probe(st, row, len);
+}
+
+// Read a partition back, handing every record to fn as a row view
+static int replay(struct join_state *st, struct spill_file *sp, replay_fn fn)
+{
+    if (spill_rewind(sp) != 0)
+        return -1;
+
+    for (long r = 0; r < sp->count; r++) {
+        char     **fields;
+        const int *widths;
+        int        count;
+        if (spill_read(sp, &fields, &widths, &count) != 0 || reserve_scratch(st, count) != 0)
+            return -1;
+        for (int i = 0; i < count; i++) {
+            st->lengths[i] = strlen(fields[i]);
+        }
+        struct csv_row_view view = {.fields      = (const char *const *)fields,
+                                    .lengths     = st->lengths,
+                                    .field_count = count};
+        if (fn(st, &view) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int replay_build(struct join_state *st, const struct csv_row_view *row)
+{
+    size_t len;
+    if (build_key(st, st->build, row, &len) != 0)
+        return -1;
+    return table_add(st, row, len);
+}
+
+static int replay_probe(struct join_state *st, const struct csv_row_view *row)
+{
+    size_t len;
+    if (build_key(st, 1 - st->build, row, &len) != 0)
+        return -1;
+    return probe(st, row, len);
+}
+
+// Grace join: each build partition fits the budget on its own and meets
+// only the probe records that hash to it
+static int join_partitions(struct join_state *st)
+{
+    for (int p = 0; p < JOIN_PARTITIONS; p++) {
+        if (replay(st, &st->parts[p], replay_build) != 0 ||
+            replay(st, &st->parts[JOIN_PARTITIONS + p], replay_probe) != 0 ||
+            emit_unmatched(st) != 0)
+            return -1;
+        spill_close(&st->parts[p]);
+        spill_close(&st->parts[JOIN_PARTITIONS + p]);
+        if (table_reset(st) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int add_header(struct join_state *st)
+{
+    const struct join_side *ls = &st->sides[SIDE_LEFT];
+    const struct join_side *rs = &st->sides[SIDE_RIGHT];
+    if (!ls->header && !rs->header)
+        return 0;
+
+    const char *const *left  = (const char *const *)ls->header;
+    const char *const *right = (const char *const *)rs->header;
+    int                n     = 0;
+    if (reserve_cells(st, ls->columns + rs->columns) != 0)
+        return -1;
+    for (int i = 0; i < ls->columns; i++) {
+        st->cells[n++] = i < ls->header_count ? left[i] : "";
+    }
+    for (int i = 0; i < rs->columns; i++) {
+        if (!is_key_column(rs, st->key_count, i))
+            st->cells[n++] = i < rs->header_count ? right[i] : "";
+    }
+    return csv_data_add(st->out, st->cells, n, true);
+}
+
+static void free_state(struct join_state *st)
+{
+    if (st->parts) {
+        for (int p = 0; p < 2 * JOIN_PARTITIONS; p++) {
+            spill_close(&st->parts[p]);
+        }
+        free(st->parts);
+    }
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < st->sides[s].header_count; i++) {
+            free(st->sides[s].header[i]);
+        }
+        free(st->sides[s].header);
+        free(st->sides[s].key_names);
+        free(st->sides[s].key_columns);
+    }
+    strtab_free(&st->keys);
+    free(st->on_buf);
+    free(st->rows);
+    free(st->data);
+    free(st->key);
+    free(st->cells);
+    free(st->fields);
+    free(st->lengths);
+    free(st->zeros);
+}
+
+static bool regular_size(FILE *fp, off_t *size)
+{
+    struct stat sb;
+    if (fstat(fileno(fp), &sb) != 0 || !S_ISREG(sb.st_mode))
+        return false;
+    *size = sb.st_size;
+    return true;
+}
+
+int print_join(FILE *input, struct cli_args *args)
+{
+    FILE *other = fopen(args->join, "r");
+    if (!other) {
+        fprintf(args->errors, "%s: %s\n", args->join, strerror(errno));
+        return -1;
+    }
+    progress_expect(other);
+
+    // The smaller regular file becomes the table, a pipe always streams
+    off_t left_size     = 0;
+    off_t right_size    = 0;
+    bool  left_regular  = regular_size(input, &left_size);
+    bool  right_regular = regular_size(other, &right_size);
+    bool  left_smaller  = left_regular && right_regular && left_size < right_size;
+    int   build         = left_smaller ? SIDE_LEFT : SIDE_RIGHT;
+    FILE *streams[2]    = {input, other};
+
+    struct csv_data   out;
+    struct join_state st = {.args = args, .build = build, .out = &out};
+
+    // The joined table spills past --max-memory like a parsed one
+    int ret          = csv_data_init(&out);
+    out.memory_limit = args->max_memory;
+    if (ret == 0 && (parse_on(&st, args->join_on) != 0 ||
+                     strtab_init(&st.keys, sizeof(struct join_bucket)) != 0))
+        ret = -1;
+    for (int s = 0; s < 2 && ret == 0 && args->no_headers; s++) {
+        ret = resolve_side(&st, s, NULL, 0);
+    }
+
+    if (ret == 0)
+        ret = parse_csv_stream(streams[build], args, build_row, &st);
+    if (ret == 0)
+        ret = parse_csv_stream(streams[1 - build], args, probe_row, &st);
+    if (ret == 0)
+        ret = st.partitioned ? join_partitions(&st) : emit_unmatched(&st);
+    if (ret == 0)
+        ret = add_header(&st);
+
+    if (ret == 0) {
+        csv_data_finish(&out, args->number);
+        ret = print_table(&out, args);
+    }
+
+    fclose(other);
+    free_state(&st);
+    free_csv_data(&out);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef JOIN_H
+#define JOIN_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Join the input with the --join file on the --on columns and print the
+// merged records. The smaller file is held in a hash table and the other one
+// streams past it; over --max-memory both are partitioned to disk first.
+int print_join(FILE *input, struct cli_args *args);
+
+#endif  // JOIN_H
\ No newline at end of file
@@ -0,0 +1,632 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "csv_parser.h"
+#include "csv_scan.h"
+#include "key_index.h"
+#include "strtab.h"
+#include "table_printer.h"
+#include "utils.h"
+
+#define INDEX_MAGIC       "CSVIDX01"
+#define INDEX_VERSION     1
+#define INDEX_SUFFIX      ".csvi"
+#define INDEX_PATH_MAX    4096
+#define INDEX_FLAG_HEADER 1
+#define READ_WINDOW       4096  // First read of a record, doubled until the record fits
+
+// On-disk layout: this header, then slot_count slots at `slots`
+struct index_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    uint32_t delimiter;
+    uint32_t column;         // Indexed column, 0-based
+    uint64_t header_length;  // Bytes of the header record, 0 without one
+    uint64_t records;
+    uint64_t slot_count;     // Power of two, open addressing with linear probing
+    uint64_t slots;
+    uint64_t postings;  // u64[records], record offsets grouped by key hash
+    uint64_t image_size;
+};
+
+// One distinct key hash, never 0 which marks an empty slot, and the run of
+// postings holding the offsets of its records in file order
+struct index_slot {
+    uint64_t hash;
+    uint64_t start;
+    uint64_t count;
+};
+
+struct index_entry {
+    uint64_t hash;
+    uint64_t offset;
+};
+
+#define INDEX_SLOTS ((sizeof(struct index_header) + 7) & ~(size_t)7)
+
+struct key_index {
+    struct index_header *hdr;  // Mapped sidecar or built image
+    void                *map;
+    size_t               map_len;
+    bool                 owned;  // hdr was malloc'd
+};
+
+struct index_build {
+    const char        *name;  // Column as given on the command line
+    const char        *base;
+    const char        *end;
+    const char        *cursor;  // Start of the next record, in step with the parser
+    char               delim;
+    int                column;
+    FILE              *errors;
+    uint64_t            header_length;
+    struct index_entry *entries;
+    size_t              count;
+    size_t              cap;
+};
+
+struct lookup_state {
+    const char *const *values;
+    const size_t      *lengths;
+    int                value_count;
+    int                column;
+    bool               match;
+};
+
+static uint64_t key_hash(const char *key, size_t len)
+{
+    uint64_t h = strtab_hash(key, len);
+    return h ? h : 1;
+}
+
+static void describe_file(struct index_header   *hdr,
+                          const struct stat     *st,
+                          const struct cli_args *args)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, INDEX_MAGIC, sizeof(hdr->magic));
+    hdr->version    = INDEX_VERSION;
+    hdr->flags      = args->no_headers ? 0 : INDEX_FLAG_HEADER;
+    hdr->dev        = (uint64_t)st->st_dev;
+    hdr->ino        = (uint64_t)st->st_ino;
+    hdr->size       = (uint64_t)st->st_size;
+    hdr->mtime_sec  = (int64_t)st->st_mtim.tv_sec;
+    hdr->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+    hdr->delimiter  = (uint32_t)(unsigned char)(args->tsv ? '\t' : args->delimiter);
+}
+
+// One sidecar per column spelling, delimiter and header mode
+static int index_path(char *path, size_t size, const struct cli_args *args, const char *name)
+{
+    uint64_t h = strtab_hash(name, strlen(name));
+    h          = (h ^ (uint64_t)(unsigned char)(args->tsv ? '\t' : args->delimiter)) * 31;
+    h += args->no_headers ? 1 : 0;
+    int n = snprintf(path, size, "%s.%08x%s", args->file, (unsigned)(h ^ h >> 32), INDEX_SUFFIX);
+    return n < 0 || (size_t)n >= size ? -1 : 0;
+}
+
+static bool index_valid(const struct index_header *hdr,
+                        const struct index_header *file,
+                        size_t                     size)
+{
+    if (memcmp(hdr->magic, INDEX_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != INDEX_VERSION || hdr->image_size != size)
+        return false;
+
+    // The index must describe exactly the file we are about to read
+    if (hdr->dev != file->dev || hdr->ino != file->ino || hdr->size != file->size ||
+        hdr->mtime_sec != file->mtime_sec || hdr->mtime_nsec != file->mtime_nsec ||
+        hdr->delimiter != file->delimiter || hdr->flags != file->flags)
+        return false;
+
+    uint64_t slots_len    = hdr->slot_count * sizeof(struct index_slot);
+    uint64_t postings_len = hdr->records * sizeof(uint64_t);
+    return hdr->slot_count > 0 && (hdr->slot_count & (hdr->slot_count - 1)) == 0 &&
+           hdr->slot_count <= SIZE_MAX / sizeof(struct index_slot) &&
+           hdr->records <= SIZE_MAX / sizeof(uint64_t) && hdr->slots == INDEX_SLOTS &&
+           hdr->postings >= hdr->slots && slots_len <= hdr->postings - hdr->slots &&
+           hdr->postings <= size && postings_len == size - hdr->postings &&
+           hdr->postings % 8 == 0 && hdr->header_length <= hdr->size;
+}
+
+static int open_index(struct key_index *index, const char *path, const struct index_header *file)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct index_header)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void  *map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+    if (!index_valid(map, file, size)) {
+        munmap(map, size);
+        return -1;
+    }
+
+    // Probes land on random slots
+    madvise(map, size, MADV_RANDOM);
+    index->hdr     = map;
+    index->map     = map;
+    index->map_len = size;
+    index->owned   = false;
+    return 0;
+}
+
+static void close_index(struct key_index *index)
+{
+    if (index->map)
+        munmap(index->map, index->map_len);
+    else if (index->owned)
+        free(index->hdr);
+    memset(index, 0, sizeof(*index));
+}
+
+static int resolve_index_column(struct index_build *b, const char *const *header, int count)
+{
+    b->column = resolve_column(b->name, header, count);
+    if (b->column < 0) {
+        fprintf(b->errors, "Unknown key column: %s\n", b->name);
+        return -1;
+    }
+    return 0;
+}
+
+static int index_row(const struct csv_row_view *row, void *ctx)
+{
+    struct index_build *b     = ctx;
+    const char         *start = b->cursor;
+    int                 fields;
+    bool                clean;
+
+    b->cursor = csv_scan_record(start, b->end, b->delim, &fields, &clean);
+    if (row->index < 0) {
+        b->header_length = (uint64_t)(b->cursor - b->base);
+        return resolve_index_column(b, row->fields, row->field_count);
+    }
+
+    if (b->count == b->cap) {
+        size_t              cap     = b->cap ? b->cap * 2 : 4096;
+        struct index_entry *entries = realloc(b->entries, cap * sizeof(*entries));
+        if (!entries)
+            return -1;
+        b->entries = entries;
+        b->cap     = cap;
+    }
+
+    bool   present = b->column < row->field_count;
+    size_t len     = present ? row->lengths[b->column] : 0;
+    b->entries[b->count++] =
+        (struct index_entry){.hash   = key_hash(present ? row->fields[b->column] : "", len),
+                             .offset = (uint64_t)(start - b->base)};
+    return 0;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const struct index_entry *x = a;
+    const struct index_entry *y = b;
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+// Parse the whole input once and lay the records out in an open-addressing table
+static int build_image(struct key_index          *index,
+                       FILE                      *input,
+                       const struct index_header *file,
+                       const struct cli_args     *args,
+                       const char                *name)
+{
+    struct index_build b = {.name   = name,
+                            .delim  = args->tsv ? '\t' : args->delimiter,
+                            .column = -1,
+                            .errors = args->errors};
+
+    void *map = MAP_FAILED;
+    if (file->size > 0)
+        map = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    if (file->size > 0 && map == MAP_FAILED) {
+        fprintf(args->errors, "%s: %s\n", args->file, strerror(errno));
+        return -1;
+    }
+
+    int ret = 0;
+    if (args->no_headers)
+        ret = resolve_index_column(&b, NULL, 0);
+    if (ret == 0 && map != MAP_FAILED) {
+        b.base   = map;
+        b.end    = b.base + file->size;
+        b.cursor = b.base;
+        madvise(map, file->size, MADV_SEQUENTIAL);
+        ret = parse_csv_buffer(b.base, file->size, args, index_row, &b, NULL);
+        munmap(map, file->size);
+    }
+    if (ret == 0 && b.column < 0)
+        ret = resolve_index_column(&b, NULL, 0);  // An empty file has no header to name it
+
+    // Records of one key become a run of postings, and each distinct key a
+    // slot in a table at most two thirds full
+    size_t distinct = 0;
+    if (ret == 0 && b.count > 0) {
+        qsort(b.entries, b.count, sizeof(*b.entries), compare_entries);
+        for (size_t i = 0; i < b.count; i++) {
+            if (i == 0 || b.entries[i].hash != b.entries[i - 1].hash)
+                distinct++;
+        }
+    }
+    uint64_t slot_count = 16;
+    while (slot_count * 2 < (uint64_t)distinct * 3)
+        slot_count *= 2;
+
+    size_t               postings = INDEX_SLOTS + slot_count * sizeof(struct index_slot);
+    size_t               size     = postings + b.count * sizeof(uint64_t);
+    struct index_header *hdr      = ret == 0 ? calloc(1, size) : NULL;
+    if (!hdr) {
+        free(b.entries);
+        return -1;
+    }
+
+    *hdr               = *file;
+    hdr->column        = (uint32_t)b.column;
+    hdr->header_length = b.header_length;
+    hdr->records       = b.count;
+    hdr->slot_count    = slot_count;
+    hdr->slots         = INDEX_SLOTS;
+    hdr->postings      = postings;
+    hdr->image_size    = size;
+
+    struct index_slot *table   = (struct index_slot *)((char *)hdr + INDEX_SLOTS);
+    uint64_t          *offsets = (uint64_t *)((char *)hdr + postings);
+    for (size_t i = 0; i < b.count;) {
+        size_t   run = i;
+        uint64_t s   = b.entries[i].hash & (slot_count - 1);
+        while (table[s].hash != 0)
+            s = (s + 1) & (slot_count - 1);
+        for (; run < b.count && b.entries[run].hash == b.entries[i].hash; run++) {
+            offsets[run] = b.entries[run].offset;
+        }
+        table[s] = (struct index_slot){.hash = b.entries[i].hash, .start = i, .count = run - i};
+        i        = run;
+    }
+    free(b.entries);
+
+    index->hdr   = hdr;
+    index->owned = true;
+    return 0;
+}
+
+// Publish atomically next to the input so readers never see a partial index
+static int store_index(const struct key_index *index, const char *path)
+{
+    char tmp[INDEX_PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp))
+        return -1;
+    int fd = mkstemp(tmp);
+    if (fd < 0)
+        return -1;
+
+    const char *p    = (const char *)index->hdr;
+    size_t      left = index->hdr->image_size;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n <= 0)
+            break;
+        p += n;
+        left -= (size_t)n;
+    }
+    if (close(fd) != 0 || left > 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Use the sidecar when it matches the input, otherwise rebuild and store it.
+// *built tells which happened; a store failure is only fatal when `required`.
+static int get_index(struct key_index      *index,
+                     FILE                  *input,
+                     const struct cli_args *args,
+                     const char            *name,
+                     bool                   required,
+                     bool                  *built)
+{
+    struct stat st;
+    if (!args->file || fstat(fileno(input), &st) != 0 || !S_ISREG(st.st_mode)) {
+        fprintf(args->errors, "--index-key and --lookup need a regular input file\n");
+        return -1;
+    }
+
+    struct index_header file;
+    char                path[INDEX_PATH_MAX];
+    describe_file(&file, &st, args);
+    if (index_path(path, sizeof(path), args, name) != 0) {
+        fprintf(args->errors, "%s: path too long for an index\n", args->file);
+        return -1;
+    }
+
+    *built = false;
+    if (open_index(index, path, &file) == 0)
+        return 0;
+
+    *built = true;
+    if (build_image(index, input, &file, args, name) != 0)
+        return -1;
+
+    // A file that could still change under the same mtime gets its index used
+    // once but not kept
+    if (recently_modified(file.mtime_sec))
+        return 0;
+    if (store_index(index, path) != 0) {
+        fprintf(args->errors, "%s: %s\n", path, strerror(errno));
+        if (required) {
+            close_index(index);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int build_key_index(FILE *input, const struct cli_args *args)
+{
+    struct key_index index = {0};
+    bool             built;
+    if (get_index(&index, input, args, args->index_key, true, &built) != 0)
+        return -1;
+
+    if (built)
+        fprintf(args->errors,
+                "csview: indexed %llu records of %s by %s\n",
+                (unsigned long long)index.hdr->records,
+                args->file,
+                args->index_key);
+    else
+        fprintf(args->errors,
+                "csview: index of %s by %s is up to date\n",
+                args->file,
+                args->index_key);
+    close_index(&index);
+    return 0;
+}
+
+static int compare_offsets(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Offsets of the records whose key hash matches one of the values, in file order
+static int probe_index(const struct key_index   *index,
+                       const struct lookup_state *ls,
+                       uint64_t                 **offsets,
+                       size_t                    *count)
+{
+    const struct index_header *hdr      = index->hdr;
+    const struct index_slot   *table    = (const void *)((const char *)hdr + hdr->slots);
+    const uint64_t            *postings = (const void *)((const char *)hdr + hdr->postings);
+    uint64_t                   mask     = hdr->slot_count - 1;
+    size_t                     cap      = 0;
+
+    *offsets = NULL;
+    *count   = 0;
+    for (int v = 0; v < ls->value_count; v++) {
+        uint64_t h = key_hash(ls->values[v], ls->lengths[v]);
+        uint64_t s = h & mask;
+        while (table[s].hash != 0 && table[s].hash != h)
+            s = (s + 1) & mask;
+        if (table[s].hash == 0)
+            continue;
+
+        const struct index_slot *slot = &table[s];
+        if (slot->start > hdr->records || slot->count > hdr->records - slot->start)
+            return -1;
+        if (*count + slot->count > cap) {
+            cap             = (*count + slot->count) * 2;
+            uint64_t *grown = realloc(*offsets, cap * sizeof(uint64_t));
+            if (!grown)
+                return -1;
+            *offsets = grown;
+        }
+        memcpy(*offsets + *count, postings + slot->start, slot->count * sizeof(uint64_t));
+        *count += slot->count;
+    }
+
+    // A value given twice must not repeat its records
+    if (*count > 1)
+        qsort(*offsets, *count, sizeof(uint64_t), compare_offsets);
+    size_t unique = 0;
+    for (size_t i = 0; i < *count; i++) {
+        if (unique == 0 || (*offsets)[unique - 1] != (*offsets)[i])
+            (*offsets)[unique++] = (*offsets)[i];
+    }
+    *count = unique;
+    return 0;
+}
+
+static int pread_full(int fd, char *buf, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n <= 0)
+            return -1;
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+// Read the record at offset with as few preads as it takes to hold it whole
+static int read_record(int fd, uint64_t offset, uint64_t size, char delim, char **buf, size_t *len)
+{
+    for (size_t window = READ_WINDOW;; window *= 2) {
+        size_t n    = size - offset < window ? (size_t)(size - offset) : window;
+        char  *grow = realloc(*buf, n + 1);
+        if (!grow)
+            return -1;
+        *buf = grow;
+        if (pread_full(fd, *buf, n, offset) != 0)
+            return -1;
+
+        int         fields;
+        bool        clean;
+        const char *end = csv_scan_record(*buf, *buf + n, delim, &fields, &clean);
+        if (end < *buf + n || n == size - offset) {
+            *len = (size_t)(end - *buf);
+            return 0;
+        }
+    }
+}
+
+// Hashes may collide, so a record only matches when its key field really does
+static int check_row(const struct csv_row_view *row, void *ctx)
+{
+    struct lookup_state *ls = ctx;
+    if (ls->column >= row->field_count)
+        return 0;
+    for (int v = 0; v < ls->value_count; v++) {
+        if (row->lengths[ls->column] == ls->lengths[v] &&
+            memcmp(row->fields[ls->column], ls->values[v], ls->lengths[v]) == 0)
+            ls->match = true;
+    }
+    return 0;
+}
+
+static int split_values(char *list, struct lookup_state *ls, const char **values, size_t *lengths)
+{
+    char *save = NULL;
+    for (char *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        values[ls->value_count]  = tok;
+        lengths[ls->value_count] = strlen(tok);
+        ls->value_count++;
+    }
+    ls->values  = values;
+    ls->lengths = lengths;
+    return ls->value_count > 0 ? 0 : -1;
+}
+
+// Gather the header and the matching records into one buffer of CSV text
+static int collect_records(const struct key_index *index,
+                           FILE                   *input,
+                           struct lookup_state    *ls,
+                           const struct cli_args  *args,
+                           struct out_buf         *text)
+{
+    const struct index_header *hdr   = index->hdr;
+    int                        fd    = fileno(input);
+    char                       delim = args->tsv ? '\t' : args->delimiter;
+    struct cli_args            body  = *args;
+    body.no_headers                  = true;
+
+    if (out_buf_init(text, NULL, hdr->header_length + READ_WINDOW) != 0)
+        return -1;
+    if (hdr->header_length > 0 && pread_full(fd, text->data, hdr->header_length, 0) != 0) {
+        fprintf(args->errors, "%s: %s\n", args->file, strerror(errno));
+        return -1;
+    }
+    text->len = hdr->header_length;
+
+    uint64_t *offsets;
+    size_t    count;
+    if (probe_index(index, ls, &offsets, &count) != 0) {
+        free(offsets);
+        return -1;
+    }
+
+    char  *record = NULL;
+    size_t len;
+    int    ret = 0;
+    for (size_t i = 0; i < count && ret == 0; i++) {
+        if (offsets[i] >= hdr->size ||
+            read_record(fd, offsets[i], hdr->size, delim, &record, &len) != 0) {
+            fprintf(args->errors, "%s: %s\n", args->file, strerror(errno));
+            ret = -1;
+            break;
+        }
+        ls->match = false;
+        ret       = parse_csv_buffer(record, len, &body, check_row, ls, NULL);
+        if (ret != 0 || !ls->match)
+            continue;
+
+        // The last record of a file may lack its line break
+        ret = out_buf_write(text, record, len);
+        if (ret == 0 && len > 0 && record[len - 1] != '\n' && record[len - 1] != '\r')
+            ret = out_buf_putc(text, '\n');
+    }
+
+    free(record);
+    free(offsets);
+    return ret;
+}
+
+int print_lookup(FILE *input, struct cli_args *args)
+{
+    char *spec   = strdup(args->lookup);
+    char *equals = spec ? strchr(spec, '=') : NULL;
+    if (!equals || equals == spec) {
+        fprintf(args->errors, "--lookup expects COL=VALUE[,VALUE...]\n");
+        free(spec);
+        return -1;
+    }
+    *equals = '\0';
+
+    size_t               max     = strlen(equals + 1) / 2 + 1;
+    const char         **values  = calloc(max, sizeof(char *));
+    size_t              *lengths = calloc(max, sizeof(size_t));
+    struct lookup_state  ls      = {0};
+    struct key_index     index   = {0};
+    struct out_buf       text    = {0};
+    bool                 built;
+    int                  ret     = values && lengths ? 0 : -1;
+
+    if (ret == 0 && split_values(equals + 1, &ls, values, lengths) != 0) {
+        fprintf(args->errors, "--lookup needs at least one value\n");
+        ret = -1;
+    }
+    if (ret == 0)
+        ret = get_index(&index, input, args, spec, false, &built);
+    if (ret == 0) {
+        ls.column = (int)index.hdr->column;
+        ret       = collect_records(&index, input, &ls, args, &text);
+    }
+
+    // Only the gathered records go through the regular table parser
+    if (ret == 0 && text.len > 0) {
+        FILE           *fp = fmemopen(text.data, text.len, "r");
+        struct csv_data csv;
+        ret = fp ? parse_csv(fp, &csv, *args) : -1;
+        if (fp)
+            fclose(fp);
+        if (ret == 0) {
+            ret = print_table(&csv, args);
+            free_csv_data(&csv);
+        }
+    }
+
+    close_index(&index);
+    free(text.data);
+    free(values);
+    free(lengths);
+    free(spec);
+    return ret;
+}
\ No newline at end of file
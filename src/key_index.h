@@ -0,0 +1,19 @@
+#ifndef KEY_INDEX_H
+#define KEY_INDEX_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Sidecar hash indexes from the values of one column to record offsets,
+// stored next to the input as FILE.<hash>.csvi and trusted only while the
+// file's device, inode, size and mtime are unchanged.
+
+// Build or refresh the --index-key index of the input
+int build_key_index(FILE *input, const struct cli_args *args);
+
+// Print the records whose --lookup column holds one of the given values,
+// reading only those records through the index (built first when missing)
+int print_lookup(FILE *input, struct cli_args *args);
+
+#endif  // KEY_INDEX_H
\ No newline at end of file
@@ -5,8 +5,120 @@
 #include <unistd.h>
 
 #include "cli.h"
+#include "count.h"
 #include "csv_parser.h"
+#include "diff.h"
+#include "exporter.h"
+#include "grep.h"
+#include "group_by.h"
+#include "input_profile.h"
+#include "join.h"
+#include "key_index.h"
+#include "progress.h"
+#include "sample.h"
+#include "server.h"
+#include "sketch.h"
+#include "summary.h"
+#include "table_cache.h"
 #include "table_printer.h"
+#include "top.h"
+
+// Answer the request in args from input and close input if it was opened
+// from args->file; --serve runs the requests of its clients through here
+static int run(FILE *input, struct cli_args *args)
+{
+    int ret;
+    if (args->count) {
+        // Record boundaries are scanned, no field is parsed
+        ret = print_count(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->index_key || args->lookup) {
+        // The sidecar index is built first when asked for or missing
+        ret = args->index_key ? build_key_index(input, args) : 0;
+        if (ret == 0 && args->lookup)
+            ret = print_lookup(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->summary) {
+        // Column profile in a single streaming pass
+        ret = print_summary(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->sketch) {
+        // Constant-size sketches per column, merged across file slices
+        ret = print_sketch(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->group_by) {
+        // Aggregation keeps one row per distinct key, never the records
+        ret = print_group_by(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->diff) {
+        // Only the old file's keys are held, the input is streamed against them
+        ret = print_diff(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->join) {
+        // The smaller file is hashed, the other one streams past it
+        ret = print_join(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->vertical) {
+        // Records are printed as they are parsed, no widths are sniffed
+        ret = print_vertical(input, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else if (args->format != FORMAT_TABLE) {
+        // Export backends write straight from the parser
+        ret = export_csv(input, args->output, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+    } else {
+        // Parse CSV
+        struct csv_data csv;
+        if (args->sample > 0)
+            ret = sample_table(input, &csv, args);
+        else if (args->top > 0)
+            ret = top_table(input, &csv, args);
+        else if (args->grep)
+            ret = grep_table(input, &csv, args);
+        else
+            ret = load_table(input, &csv, args);
+
+        if (args->file) {
+            fclose(input);
+        }
+
+        if (ret != 0)
+            return ret;
+
+        // Print table
+        ret = print_table(&csv, args);
+        free_csv_data(&csv);
+    }
+
+    return ret;
+}
 
 int main(int argc, char *argv[])
 {
@@ -30,39 +142,49 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    // The daemon answers clients until it is stopped, it reads and pages nothing itself
+    if (args.serve) {
+        int ret = serve_tables(&args, run);
+        free_cli_args(&args);
+        return ret;
+    }
+
     // Check for input
     if (!args.file && isatty(STDIN_FILENO)) {
         fprintf(stderr, "no input file specified (use -h for help)\n");
         return 1;
     }
 
-    // Setup pager if needed
-    setup_pager(args.disable_pager);
+    // Setup pager if needed, machine-readable formats are never paged
+    bool machine_output = args.format == FORMAT_NDJSON || args.format == FORMAT_ARROW;
+    bool no_table       = args.count || (args.index_key && !args.lookup);
+    setup_pager(args.disable_pager || machine_output || no_table, args.highlight);
 
-    // Open input file or use stdin
-    FILE *input = args.file ? fopen(args.file, "r") : stdin;
-    if (!input && args.file) {
-        perror(args.file);
-        return 1;
-    }
-
-    // Parse CSV
-    struct csv_data csv;
-    int             ret = parse_csv(input, &csv, args);
+    int ret;
+    if (args.client) {
+        // The daemon reads the file and draws the reply, only the pager runs here
+        ret = client_request(&args, argc, argv);
+    } else {
+        // Open input file or use stdin
+        FILE *input = args.file ? fopen(args.file, "r") : stdin;
+        if (!input && args.file) {
+            perror(args.file);
+            return 1;
+        }
+        if (args.progress)
+            progress_start(input);
 
-    if (args.file) {
-        fclose(input);
-    }
+        // Without -d or -t, a file whose first lines split evenly on tab, ; or |
+        // but not on the comma is read with that delimiter
+        struct input_profile profile;
+        if (!args.delimiter_set && profile_input(input, &profile) == 0 && profile.delimiter)
+            args.delimiter = profile.delimiter;
 
-    if (ret != 0) {
-        return ret;
+        ret = run(input, &args);
     }
 
-    // Print table
-    ret = print_table(&csv, &args);
-
     // Cleanup
-    free_csv_data(&csv);
+    progress_stop();
     free_cli_args(&args);
 
     // Wait for pager to finish if it was started
@@ -0,0 +1,143 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numparse.h"
+
+#define MAX_EXACT_MANTISSA (1ULL << 53)
+
+static const double exact_powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                      1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                      1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// True when all 8 bytes of the word are ASCII digits
+static inline bool is_eight_digits(uint64_t w)
+{
+    uint64_t high = w & 0xF0F0F0F0F0F0F0F0ULL;
+    uint64_t over = ((w + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4;
+    return (high | over) == 0x3333333333333333ULL;
+}
+
+// Convert 8 ASCII digits (first digit in the lowest byte) with three multiplies
+static inline uint32_t parse_eight_digits(uint64_t w)
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+
+    w -= 0x3030303030303030ULL;
+    w = (w * 10) + (w >> 8);
+    w = (((w & mask) * mul1) + (((w >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)w;
+}
+
+// Accumulate a run of digits into *mantissa, returning the number consumed.
+// Leading zeros are skipped, digits that no longer fit are counted in *dropped.
+static size_t parse_digits(const char *p,
+                           const char *end,
+                           uint64_t   *mantissa,
+                           int        *digits,
+                           int        *dropped)
+{
+    const char *start = p;
+
+    if (*mantissa == 0) {
+        while (p < end && *p == '0') {
+            p++;
+        }
+    }
+
+    while (end - p >= 8 && *digits <= 11) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        if (!is_eight_digits(w))
+            break;
+        *mantissa = *mantissa * 100000000ULL + parse_eight_digits(w);
+        *digits += 8;
+        p += 8;
+    }
+
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (*digits < 19) {
+            *mantissa = *mantissa * 10 + (uint64_t)(*p - '0');
+            (*digits)++;
+        } else {
+            (*dropped)++;
+        }
+        p++;
+    }
+    return (size_t)(p - start);
+}
+
+num_kind_t parse_number(const char *str, size_t len, double *value)
+{
+    const char *p   = str;
+    const char *end = str + len;
+    bool        neg = false;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa     = 0;
+    int      digits       = 0;  // Significant digits held in the mantissa
+    int      dropped      = 0;  // Integer digits beyond mantissa precision
+    int      frac_dropped = 0;  // Fraction digits beyond it
+    int      exponent     = 0;
+
+    size_t int_digits = parse_digits(p, end, &mantissa, &digits, &dropped);
+    p += int_digits;
+    exponent += dropped;
+
+    num_kind_t kind       = NUM_INT;
+    size_t     frac_count = 0;
+    if (p < end && *p == '.') {
+        kind = NUM_FLOAT;
+        p++;
+        frac_count = parse_digits(p, end, &mantissa, &digits, &frac_dropped);
+        p += frac_count;
+        exponent -= (int)frac_count - frac_dropped;
+    }
+
+    if (int_digits + frac_count == 0)
+        return NUM_NONE;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        kind = NUM_FLOAT;
+        p++;
+        bool exp_neg = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            exp_neg = *p == '-';
+            p++;
+        }
+        if (p == end || *p < '0' || *p > '9')
+            return NUM_NONE;
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (e < 100000)
+                e = e * 10 + (*p - '0');
+            p++;
+        }
+        exponent += exp_neg ? -e : e;
+    }
+
+    if (p != end)
+        return NUM_NONE;
+
+    // Clinger's fast path: exact when both mantissa and power are exact doubles
+    if (dropped == 0 && frac_dropped == 0 && mantissa <= MAX_EXACT_MANTISSA && exponent >= -22 &&
+        exponent <= 22) {
+        double v = (double)mantissa;
+        if (exponent < 0)
+            v /= exact_powers[-exponent];
+        else
+            v *= exact_powers[exponent];
+        *value = neg ? -v : v;
+        return kind;
+    }
+
+    *value = strtod(str, NULL);
+    return kind;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef NUMPARSE_H
+#define NUMPARSE_H
+
+#include <stddef.h>
+
+typedef enum {
+    NUM_NONE,  // Not a number
+    NUM_INT,
+    NUM_FLOAT
+} num_kind_t;
+
+// Parse a whole field as a decimal integer or float. `str` must be
+// NUL-terminated at `len` so rare long inputs can fall back to strtod.
+num_kind_t parse_number(const char *str, size_t len, double *value);
+
+#endif  // NUMPARSE_H
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+#define MAX_THREADS 256
+
+struct parallel_task {
+    parallel_fn fn;
+    void       *ctx;
+    long        begin;
+    long        end;
+    int         worker;
+};
+
+static void *run_task(void *arg)
+{
+    struct parallel_task *task = arg;
+    task->fn(task->ctx, task->begin, task->end, task->worker);
+    return NULL;
+}
+
+int parallel_threads(int requested, long items, long min_items)
+{
+    long threads = requested;
+    if (threads <= 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (min_items > 0 && threads > items / min_items)
+        threads = items / min_items;
+    return threads < 1 ? 1 : (int)threads;
+}
+
+void parallel_for(int threads, long items, parallel_fn fn, void *ctx)
+{
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+    if (threads <= 1 || items < threads) {
+        fn(ctx, 0, items, 0);
+        return;
+    }
+
+    struct parallel_task tasks[MAX_THREADS];
+    pthread_t            tids[MAX_THREADS];
+    bool                 started[MAX_THREADS];
+
+    for (int i = 0; i < threads; i++) {
+        tasks[i].fn     = fn;
+        tasks[i].ctx    = ctx;
+        tasks[i].begin  = items * i / threads;
+        tasks[i].end    = items * (i + 1) / threads;
+        tasks[i].worker = i;
+    }
+
+    // A worker that cannot be started runs inline instead
+    for (int i = 1; i < threads; i++) {
+        started[i] = pthread_create(&tids[i], NULL, run_task, &tasks[i]) == 0;
+        if (!started[i])
+            run_task(&tasks[i]);
+    }
+    run_task(&tasks[0]);
+
+    for (int i = 1; i < threads; i++) {
+        if (started[i])
+            pthread_join(tids[i], NULL);
+    }
+}
\ No newline at end of file
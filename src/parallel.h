@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Work over items [begin, end), run by worker number `worker`
+typedef void (*parallel_fn)(void *ctx, long begin, long end, int worker);
+
+// Number of workers to use for `items` units of work: `requested` threads,
+// or one per online CPU when it is 0, capped so each gets at least `min_items`
+int parallel_threads(int requested, long items, long min_items);
+
+// Split [0, items) into `threads` contiguous chunks in order and run them
+// concurrently, the calling thread takes the first chunk
+void parallel_for(int threads, long items, parallel_fn fn, void *ctx);
+
+#endif  // PARALLEL_H
\ No newline at end of file
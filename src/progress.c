@@ -0,0 +1,170 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "progress.h"
+
+#define TICK_NS 250000000L  // At most four redraws per second
+
+static _Atomic uint64_t      bytes_done;
+static _Atomic uint64_t      rows_done;
+static _Atomic uint64_t      bytes_total;
+static volatile sig_atomic_t dump_requested;
+
+static bool            enabled;
+static bool            stopping;
+static pthread_t       reporter;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  wake = PTHREAD_COND_INITIALIZER;
+static FILE           *tty;  // Where the live line goes, NULL for SIGUSR1 only
+static bool            own_tty;
+static struct timespec started;
+
+struct sample {
+    double   seconds;
+    uint64_t bytes;
+    uint64_t rows;
+};
+
+static void on_sigusr1(int sig __attribute__((unused)))
+{
+    dump_requested = 1;
+}
+
+static struct sample take_sample(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (struct sample){
+        .seconds = (double)(now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9,
+        .bytes   = atomic_load_explicit(&bytes_done, memory_order_relaxed),
+        .rows    = atomic_load_explicit(&rows_done, memory_order_relaxed)};
+}
+
+// Write the status: percent when the size is known, then rows and rates
+// between the two samples
+static void report(FILE *fp, const struct sample *from, const struct sample *to, const char *end)
+{
+    uint64_t total   = atomic_load_explicit(&bytes_total, memory_order_relaxed);
+    double   elapsed = to->seconds - from->seconds;
+    double   mb      = (double)to->bytes / (1 << 20);
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+
+    if (total > 0) {
+        double percent = 100.0 * (double)to->bytes / (double)total;
+        fprintf(fp, "%5.1f%%  ", percent > 100.0 ? 100.0 : percent);
+    }
+    fprintf(fp,
+            "%.1f MB  %llu rows  %.0f rows/s  %.1f MB/s  %.1fs%s",
+            mb,
+            (unsigned long long)to->rows,
+            (double)(to->rows - from->rows) / elapsed,
+            (double)(to->bytes - from->bytes) / (1 << 20) / elapsed,
+            to->seconds,
+            end);
+    fflush(fp);
+}
+
+static void *report_loop(void *arg __attribute__((unused)))
+{
+    struct sample start = {0};
+    struct sample last  = {0};
+
+    pthread_mutex_lock(&lock);
+    while (!stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TICK_NS;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&wake, &lock, &deadline);
+        if (stopping)
+            break;
+        pthread_mutex_unlock(&lock);
+
+        // Live rates cover the last tick, a SIGUSR1 dump averages the whole run
+        struct sample now = take_sample();
+        if (dump_requested) {
+            dump_requested = 0;
+            fputs("csview: ", stderr);
+            report(stderr, &start, &now, "\n");
+        }
+        if (tty) {
+            fputs("\r\x1b[K", tty);
+            report(tty, &last, &now, "");
+        }
+        last = now;
+
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+void progress_expect(FILE *input)
+{
+    struct stat sb;
+    if (input && fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode))
+        atomic_fetch_add_explicit(&bytes_total, (uint64_t)sb.st_size, memory_order_relaxed);
+}
+
+void progress_start(FILE *input)
+{
+    progress_expect(input);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    // Drawing over output that shares the terminal would garble it
+    if (!isatty(STDOUT_FILENO)) {
+        if (isatty(STDERR_FILENO)) {
+            tty = stderr;
+        } else {
+            int fd = open("/dev/tty", O_WRONLY | O_CLOEXEC);
+            if (fd >= 0 && !(tty = fdopen(fd, "w")))
+                close(fd);
+            own_tty = tty != NULL;
+        }
+    }
+
+    struct sigaction sa = {.sa_handler = on_sigusr1, .sa_flags = SA_RESTART};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+
+    enabled = pthread_create(&reporter, NULL, report_loop, NULL) == 0;
+}
+
+void progress_advance(uint64_t bytes, uint64_t rows)
+{
+    if (!enabled)
+        return;
+    atomic_fetch_add_explicit(&bytes_done, bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&rows_done, rows, memory_order_relaxed);
+}
+
+void progress_stop(void)
+{
+    if (!enabled)
+        return;
+    enabled = false;
+
+    pthread_mutex_lock(&lock);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+    pthread_join(reporter, NULL);
+
+    if (tty) {
+        fputs("\r\x1b[K", tty);
+        fflush(tty);
+        if (own_tty)
+            fclose(tty);
+        tty = NULL;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Progress reporting for --progress. Parsers publish consumed bytes and rows
+// once per input chunk; a reporter thread redraws a status line a few times
+// per second on the terminal and SIGUSR1 prints one to stderr.
+
+// Start reporting, expecting the size of input when it is a regular file
+void progress_start(FILE *input);
+// Account for another input that will be read, e.g. a --diff or --join file
+void progress_expect(FILE *input);
+// Publish a parsed chunk, a no-op unless reporting was started
+void progress_advance(uint64_t bytes, uint64_t rows);
+// Stop the reporter and clear its line; safe to call more than once
+void progress_stop(void);
+
+#endif  // PROGRESS_H
\ No newline at end of file
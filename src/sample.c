@@ -0,0 +1,340 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "csv_scan.h"
+#include "sample.h"
+
+#define ESTIMATE_RECORDS 64  // Leading records used to estimate the record count
+#define EXACT_FACTOR     4   // Sample exactly when the file has few records per sample
+#define CONFIRM_RECORDS  4   // Clean records needed to accept a resync point
+#define RESYNC_LINES     64  // Line breaks tried per random offset
+
+struct sample_row {
+    long   index;
+    char **fields;
+    int    field_count;
+};
+
+struct sample_state {
+    struct csv_data   *csv;
+    struct sample_row *rows;  // Reservoir for inputs that cannot be seeked
+    long               want;
+    long               count;
+    long               seen;
+    long               number;       // File record number of the next sampled record
+    int                numbers_cap;  // Entries of csv->numbers, 0 without -n
+    uint64_t           rng;
+};
+
+// splitmix64, fast and good enough to pick rows
+static uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z          = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z          = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Add a sampled record, keeping its file record number for -n
+static int add_record(struct sample_state *st, const char *const *fields, int field_count)
+{
+    struct csv_data *csv = st->csv;
+    if (csv_data_add(csv, fields, field_count, false) != 0)
+        return -1;
+    if (st->numbers_cap == 0)
+        return 0;
+
+    if (csv->record_count > st->numbers_cap) {
+        int   cap     = st->numbers_cap * 2;
+        long *numbers = realloc(csv->numbers, (size_t)cap * sizeof(long));
+        if (!numbers)
+            return -1;
+        csv->numbers    = numbers;
+        st->numbers_cap = cap;
+    }
+    csv->numbers[csv->record_count - 1] = st->number;
+    return 0;
+}
+
+static int add_row(const struct csv_row_view *row, void *ctx)
+{
+    struct sample_state *st = ctx;
+    if (row->index < 0)
+        return csv_data_add(st->csv, row->fields, row->field_count, true) == 0 ? 0 : -1;
+    return add_record(st, row->fields, row->field_count);
+}
+
+static void free_sample_row(struct sample_row *row)
+{
+    for (int i = 0; i < row->field_count; i++) {
+        free(row->fields[i]);
+    }
+    free(row->fields);
+    row->fields      = NULL;
+    row->field_count = 0;
+}
+
+// Algorithm R: every record ends up in the reservoir with equal probability
+static int reservoir_row(const struct csv_row_view *row, void *ctx)
+{
+    struct sample_state *st = ctx;
+    if (row->index < 0)
+        return add_row(row, ctx);
+
+    long slot = st->count;
+    st->seen++;
+    if (st->count < st->want) {
+        st->count++;
+    } else {
+        slot = (long)(next_random(&st->rng) % (uint64_t)st->seen);
+        if (slot >= st->want)
+            return 0;
+        free_sample_row(&st->rows[slot]);
+    }
+
+    struct sample_row *dst = &st->rows[slot];
+    dst->index             = row->index;
+    dst->field_count       = 0;
+    dst->fields = malloc((size_t)(row->field_count ? row->field_count : 1) * sizeof(char *));
+    if (!dst->fields)
+        return -1;
+    for (int i = 0; i < row->field_count; i++) {
+        dst->fields[i] = strdup(row->fields[i]);
+        if (!dst->fields[i])
+            return -1;
+        dst->field_count++;
+    }
+    return 0;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+    const struct sample_row *x = a;
+    const struct sample_row *y = b;
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static int compare_offsets(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a;
+    size_t y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Move the reservoir into the table in file order
+static int finish_reservoir(struct sample_state *st)
+{
+    int ret = 0;
+    qsort(st->rows, (size_t)st->count, sizeof(*st->rows), compare_rows);
+    for (long i = 0; i < st->count; i++) {
+        struct sample_row *row = &st->rows[i];
+        st->number             = row->index + 1;
+        if (ret == 0 && add_record(st, (const char *const *)row->fields, row->field_count) != 0)
+            ret = -1;
+        free_sample_row(row);
+    }
+    return ret;
+}
+
+static int sample_reservoir(struct sample_state   *st,
+                            FILE                  *input,
+                            const char            *data,
+                            size_t                 len,
+                            const struct cli_args *args)
+{
+    st->rows = calloc((size_t)st->want, sizeof(*st->rows));
+    if (!st->rows)
+        return -1;
+
+    int ret;
+    if (input)
+        ret = parse_csv_stream(input, args, reservoir_row, st);
+    else
+        ret = parse_csv_buffer(data, len, args, reservoir_row, st, NULL);
+
+    // Rows still holding partial copies are released along with the rest
+    if (ret != 0)
+        st->count = st->want < st->seen ? st->want : st->seen;
+    if (finish_reservoir(st) != 0)
+        ret = -1;
+    free(st->rows);
+    st->rows = NULL;
+    return ret;
+}
+
+static size_t unique_offsets(size_t *offsets, size_t count)
+{
+    qsort(offsets, count, sizeof(*offsets), compare_offsets);
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (n == 0 || offsets[i] != offsets[n - 1])
+            offsets[n++] = offsets[i];
+    }
+    return n;
+}
+
+// Move each sampled offset back to the start of the record holding it and
+// number that record. Only -n needs this, as it scans every record up to the
+// last offset. Returns the number of distinct records.
+static size_t number_offsets(const char *base,
+                             const char *data,
+                             const char *end,
+                             char        delim,
+                             size_t     *offsets,
+                             long       *numbers,
+                             size_t      count)
+{
+    const char *p     = data;
+    long        index = 0;
+    size_t      n     = 0;
+    int         fields;
+    bool        clean;
+    for (size_t i = 0; i < count && p < end; i++) {
+        const char *target = base + offsets[i];
+        while (p < end) {
+            const char *next = csv_scan_record(p, end, delim, &fields, &clean);
+            if (next > target)
+                break;
+            p = next;
+            index++;
+        }
+        if (p == end || (n > 0 && offsets[n - 1] == (size_t)(p - base)))
+            continue;
+        offsets[n]   = (size_t)(p - base);
+        numbers[n++] = index + 1;
+    }
+    return n;
+}
+
+static int sample_mapped(struct sample_state   *st,
+                         const char            *base,
+                         size_t                 size,
+                         const struct cli_args *args)
+{
+    const char     *end     = base + size;
+    const char     *data    = base;
+    char            delim   = args->tsv ? '\t' : args->delimiter;
+    int             columns = 0, fields;
+    bool            clean;
+    struct cli_args body = *args;
+    body.no_headers      = true;
+
+    if (!args->no_headers) {
+        data = csv_scan_record(base, end, delim, &columns, &clean);
+        if (parse_csv_buffer(base, (size_t)(data - base), args, add_row, st, NULL) != 0)
+            return -1;
+    }
+
+    // Small files are cheaper to sample exactly than to probe
+    const char *p     = data;
+    long        count = 0;
+    while (count < ESTIMATE_RECORDS && p < end) {
+        p = csv_scan_record(p, end, delim, &fields, &clean);
+        if (fields == 0)
+            break;
+        if (columns == 0)
+            columns = fields;
+        count++;
+    }
+    if (count == 0)
+        return 0;
+    size_t span     = (size_t)(end - data);
+    double estimate = (double)span / (double)(p - data) * (double)count;
+    if (p == end || estimate <= (double)st->want * EXACT_FACTOR)
+        return sample_reservoir(st, NULL, data, span, &body);
+
+    size_t *offsets = malloc((size_t)st->want * sizeof(size_t));
+    if (!offsets)
+        return -1;
+
+    // Probe random byte offsets and move each to the next confirmed record start
+    size_t n        = 0;
+    long   attempts = st->want * 16 + 64;
+    while ((long)n < st->want && attempts-- > 0) {
+        size_t      pos = (size_t)(next_random(&st->rng) % span);
+        const char *rec = data;
+        if (pos > 0) {
+            rec = csv_resync(data + pos - 1, end, delim, columns, CONFIRM_RECORDS, RESYNC_LINES);
+            // Ragged files never confirm a column count, fall back to syntax alone
+            if (!rec)
+                rec = csv_resync(data + pos - 1, end, delim, 0, CONFIRM_RECORDS, RESYNC_LINES);
+        }
+        if (!rec)
+            continue;
+
+        offsets[n++] = (size_t)(rec - base);
+        if ((long)n == st->want)
+            n = unique_offsets(offsets, n);
+    }
+    n = unique_offsets(offsets, n);
+
+    long *numbers = NULL;
+    if (st->numbers_cap > 0) {
+        numbers = malloc((n ? n : 1) * sizeof(long));
+        if (!numbers) {
+            free(offsets);
+            return -1;
+        }
+        n = number_offsets(base, data, end, delim, offsets, numbers, n);
+    }
+
+    // Only the sampled records go through the parser
+    int ret = 0;
+    for (size_t i = 0; i < n && ret == 0; i++) {
+        const char *rec     = base + offsets[i];
+        const char *rec_end = csv_scan_record(rec, end, delim, &fields, &clean);
+        size_t      len     = (size_t)(rec_end - rec);
+        if (numbers)
+            st->number = numbers[i];
+        ret = parse_csv_buffer(rec, len, &body, add_row, st, NULL);
+    }
+    free(numbers);
+    free(offsets);
+    return ret;
+}
+
+int sample_table(FILE *input, struct csv_data *csv, const struct cli_args *args)
+{
+    if (csv_data_init(csv) != 0)
+        return -1;
+
+    struct sample_state st = {.csv = csv, .want = args->sample};
+    st.rng = args->seeded ? args->seed : (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+    if (args->number) {
+        st.numbers_cap = args->sample < 1024 ? (int)args->sample : 1024;
+        csv->numbers   = malloc((size_t)st.numbers_cap * sizeof(long));
+        if (!csv->numbers) {
+            free_csv_data(csv);
+            return -1;
+        }
+    }
+
+    struct stat sb;
+    void       *map = MAP_FAILED;
+    size_t      size = 0;
+    if (fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    int ret;
+    if (map != MAP_FAILED) {
+        madvise(map, size, MADV_RANDOM);
+        ret = sample_mapped(&st, map, size, args);
+        munmap(map, size);
+    } else {
+        ret = sample_reservoir(&st, input, NULL, 0, args);
+    }
+
+    if (ret != 0) {
+        free_csv_data(csv);
+        return -1;
+    }
+    csv_data_finish(csv, args->number);
+    return 0;
+}
\ No newline at end of file
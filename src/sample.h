@@ -0,0 +1,14 @@
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <stdio.h>
+
+#include "cli.h"
+#include "csv_parser.h"
+
+// Fill csv with the header and a random sample of args->sample records in
+// file order. Regular files are sampled by seeking to random byte offsets, so
+// only the sampled records are parsed; other inputs use reservoir sampling.
+int sample_table(FILE *input, struct csv_data *csv, const struct cli_args *args);
+
+#endif  // SAMPLE_H
\ No newline at end of file
@@ -0,0 +1,675 @@
+#define _GNU_SOURCE  // fopencookie, accept4, GNU strerror_r
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "column_view.h"
+#include "csv_parser.h"
+#include "input_profile.h"
+#include "parallel.h"
+#include "server.h"
+#include "table_cache.h"
+#include "table_printer.h"
+
+#define REQUEST_MAGIC       0x51565343u  // "CSVQ"
+#define REQUEST_MAX_BYTES   (1 << 20)
+#define REQUEST_TIMEOUT     10  // Seconds a client may take to send its request
+#define FRAME_MAX_BYTES     (1 << 24)
+#define COPY_BUFFER_SIZE    (1 << 16)
+#define DEFAULT_CACHE_BYTES ((size_t)1 << 30)
+#define REQUEST_PATHS       3  // Input, --diff and --join
+
+enum frame_type {
+    FRAME_OUTPUT = 1,  // Bytes for the client's stdout
+    FRAME_ERROR,       // Bytes for the client's stderr
+    FRAME_STATUS       // Last frame, len is the exit status
+};
+
+// Followed by size bytes: the absolute input, --diff and --join paths, the
+// last two empty when not given, and argc arguments, each NUL-terminated
+struct request_header {
+    uint32_t magic;
+    int32_t  width;  // Client terminal width for --fit, 0 when not asked for
+    uint32_t argc;
+    uint32_t size;
+};
+
+struct frame {
+    uint32_t type;
+    uint32_t len;
+};
+
+// File identity plus the options that change what parse_csv builds
+struct table_key {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    int32_t  sniff;
+    char     delimiter;
+    bool     no_headers;
+    bool     number;
+};
+
+struct table_entry {
+    struct table_key    key;
+    struct csv_data     csv;
+    size_t              bytes;
+    int                 users;    // Requests drawing from csv right now
+    bool                evicted;  // Out of the cache, freed by its last user
+    struct table_entry *prev;     // LRU list, most recently used first
+    struct table_entry *next;
+};
+
+struct server {
+    int                 fd;
+    request_fn          run;
+    size_t              budget;
+    size_t              bytes;
+    struct table_entry *head;
+    struct table_entry *tail;
+    pthread_mutex_t     lock;
+    pthread_mutex_t     getopt_lock;  // getopt keeps its scan state in globals
+};
+
+static int write_full(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_full(int fd, void *data, size_t len)
+{
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_frame(int fd, enum frame_type type, const void *data, uint32_t len)
+{
+    struct frame frame = {.type = (uint32_t)type, .len = len};
+    if (write_full(fd, &frame, sizeof(frame)) != 0)
+        return -1;
+    return type == FRAME_STATUS ? 0 : write_full(fd, data, len);
+}
+
+static void send_error(int fd, const char *prefix, const char *message)
+{
+    char text[PATH_MAX + 256];
+    int  len = snprintf(text, sizeof(text), "%s: %s\n", prefix, message);
+    if (len > (int)sizeof(text) - 1)
+        len = (int)sizeof(text) - 1;
+    send_frame(fd, FRAME_ERROR, text, (uint32_t)len);
+}
+
+static ssize_t write_frames(int fd, enum frame_type type, const char *data, size_t len)
+{
+    uint32_t chunk = len > FRAME_MAX_BYTES ? FRAME_MAX_BYTES : (uint32_t)len;
+    if (send_frame(fd, type, data, chunk) != 0)
+        return -1;
+    return (ssize_t)chunk;
+}
+
+// Stream of the request's report: every stdio flush becomes an output frame
+static ssize_t frame_write(void *cookie, const char *data, size_t len)
+{
+    return write_frames(*(int *)cookie, FRAME_OUTPUT, data, len);
+}
+
+// Stream of the request's diagnostics, sent as error frames
+static ssize_t error_write(void *cookie, const char *data, size_t len)
+{
+    return write_frames(*(int *)cookie, FRAME_ERROR, data, len);
+}
+
+static int connect_socket(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+// Removes path only if it is a socket, never a file a mistyped --serve names
+static int unlink_socket(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0)
+        return errno == ENOENT ? 0 : -1;
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = ENOTSOCK;
+        return -1;
+    }
+    return unlink(path);
+}
+
+static int listen_socket(const char *path)
+{
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    // A socket file nobody answers on was left behind by a daemon that died
+    int probe = connect_socket(path);
+    if (probe >= 0) {
+        fprintf(stderr, "%s: another csview is serving here\n", path);
+        close(probe);
+        return -1;
+    }
+    if (errno == ECONNREFUSED && unlink_socket(path) != 0) {
+        if (errno == ENOTSOCK)
+            fprintf(stderr, "%s: exists and is not a socket, refusing to replace it\n", path);
+        else
+            perror(path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // Requests read files with the daemon's rights, so only its owner may send them
+    mode_t mask = umask(0077);
+    int    ret  = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (ret != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Requests print_table can answer from a cached table as is
+static bool plain_table(const struct cli_args *args)
+{
+    return args->format == FORMAT_TABLE && !args->summary && !args->sketch && args->sample == 0 &&
+           args->top == 0 && !args->group_by && !args->grep && !args->diff && !args->join &&
+           !args->vertical && !args->count && !args->index_key && !args->lookup;
+}
+
+static void lru_unlink(struct server *srv, struct table_entry *entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        srv->head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        srv->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push(struct server *srv, struct table_entry *entry)
+{
+    entry->prev = NULL;
+    entry->next = srv->head;
+    if (srv->head)
+        srv->head->prev = entry;
+    else
+        srv->tail = entry;
+    srv->head = entry;
+}
+
+static void free_entry(struct table_entry *entry)
+{
+    free_csv_data(&entry->csv);
+    free(entry);
+}
+
+// Look up key and pin the entry for the caller; the lock is held
+static struct table_entry *cache_use(struct server *srv, const struct table_key *key)
+{
+    for (struct table_entry *entry = srv->head; entry; entry = entry->next) {
+        if (memcmp(&entry->key, key, sizeof(*key)) == 0) {
+            entry->users++;
+            lru_unlink(srv, entry);
+            lru_push(srv, entry);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Drop least recently used tables until the budget holds. Tables still being
+// drawn are only unlinked, their last user frees them. The lock is held; the
+// idle ones are returned as a list to free after unlocking.
+static struct table_entry *cache_trim(struct server *srv)
+{
+    struct table_entry *idle = NULL;
+    while (srv->bytes > srv->budget && srv->tail) {
+        struct table_entry *victim = srv->tail;
+        lru_unlink(srv, victim);
+        srv->bytes -= victim->bytes;
+        victim->evicted = true;
+        if (victim->users == 0) {
+            victim->next = idle;
+            idle         = victim;
+        }
+    }
+    return idle;
+}
+
+static void free_entries(struct table_entry *list)
+{
+    while (list) {
+        struct table_entry *next = list->next;
+        free_entry(list);
+        list = next;
+    }
+}
+
+static void release_table(struct server *srv, struct table_entry *entry)
+{
+    pthread_mutex_lock(&srv->lock);
+    bool last = --entry->users == 0 && entry->evicted;
+    pthread_mutex_unlock(&srv->lock);
+    if (last)
+        free_entry(entry);
+}
+
+// Pin the parsed table of input for args. Returns 1 when the input has no
+// stable identity to cache it under, nothing is read then.
+static int acquire_table(struct server         *srv,
+                         FILE                  *input,
+                         const struct cli_args *args,
+                         struct table_entry   **out)
+{
+    struct stat st;
+    if (fstat(fileno(input), &st) != 0 || !S_ISREG(st.st_mode))
+        return 1;
+
+    struct table_key key;
+    memset(&key, 0, sizeof(key));
+    key.dev        = (uint64_t)st.st_dev;
+    key.ino        = (uint64_t)st.st_ino;
+    key.size       = (uint64_t)st.st_size;
+    key.mtime_sec  = (int64_t)st.st_mtim.tv_sec;
+    key.mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    key.sniff      = args->sniff;
+    key.delimiter  = args->tsv ? '\t' : args->delimiter;
+    key.no_headers = args->no_headers;
+    key.number     = args->number;
+
+    pthread_mutex_lock(&srv->lock);
+    struct table_entry *entry = cache_use(srv, &key);
+    pthread_mutex_unlock(&srv->lock);
+    if (entry) {
+        *out = entry;
+        return 0;
+    }
+
+    // Parsed outside the lock so other files are served meanwhile. Every
+    // column is measured for whatever --columns or --fit later requests
+    // ask for, and the byte budget keeps nothing from spilling.
+    struct cli_args load = *args;
+    load.fit             = false;
+    load.columns         = NULL;
+    load.max_memory      = SIZE_MAX;
+
+    entry = calloc(1, sizeof(*entry));
+    if (!entry)
+        return -1;
+    if (load_table(input, &entry->csv, &load) != 0) {
+        free(entry);
+        return -1;
+    }
+    entry->key   = key;
+    entry->bytes = entry->csv.memory_used + entry->csv.mapping_len;
+    entry->users = 1;
+
+    // Two requests that missed on the same table both parsed it, one copy is kept
+    struct table_entry *idle = NULL;
+    pthread_mutex_lock(&srv->lock);
+    struct table_entry *other = cache_use(srv, &key);
+    if (!other && entry->bytes <= srv->budget) {
+        lru_push(srv, entry);
+        srv->bytes += entry->bytes;
+        idle = cache_trim(srv);
+    } else if (!other) {
+        entry->evicted = true;
+    }
+    pthread_mutex_unlock(&srv->lock);
+
+    free_entries(idle);
+    if (other) {
+        free_entry(entry);
+        entry = other;
+    }
+    *out = entry;
+    return 0;
+}
+
+static void replace_path(char **arg, const char *path)
+{
+    if (*path) {
+        free(*arg);
+        *arg = strdup(path);
+    }
+}
+
+static int answer(struct server *srv, int *fd, char **paths, int argc, char **argv, int width)
+{
+    const char *path = paths[0];
+    struct cli_args args;
+    pthread_mutex_lock(&srv->getopt_lock);
+    optind  = 0;
+    int ret = parse_cli_args(argc, argv, &args);
+    pthread_mutex_unlock(&srv->getopt_lock);
+    if (ret != 0 || args.help || args.version || args.serve) {
+        send_error(*fd, "csview", "the server rejected the request");
+        free_cli_args(&args);
+        return 1;
+    }
+
+    // The client resolved the files against its own working directory
+    free(args.file);
+    args.file = strdup(path);
+    replace_path(&args.diff, paths[1]);
+    replace_path(&args.join, paths[2]);
+    args.width         = width;
+    args.progress      = false;
+    args.disable_pager = true;
+
+    FILE *input = args.file ? fopen(args.file, "r") : NULL;
+    if (!input) {
+        char buf[256];
+        send_error(*fd, path, strerror_r(errno, buf, sizeof(buf)));
+        free_cli_args(&args);
+        return 1;
+    }
+
+    cookie_io_functions_t io     = {.write = frame_write};
+    cookie_io_functions_t err_io = {.write = error_write};
+    args.output                  = fopencookie(fd, "w", io);
+    args.errors                  = fopencookie(fd, "w", err_io);
+    if (!args.output || !args.errors) {
+        if (args.output)
+            fclose(args.output);
+        if (args.errors)
+            fclose(args.errors);
+        fclose(input);
+        free_cli_args(&args);
+        return 1;
+    }
+    // Diagnostics go out as they are written, ahead of the report still buffered
+    setvbuf(args.errors, NULL, _IOLBF, 0);
+
+    struct input_profile profile;
+    if (!args.delimiter_set && profile_input(input, &profile) == 0 && profile.delimiter)
+        args.delimiter = profile.delimiter;
+
+    struct table_entry *entry = NULL;
+    ret                       = plain_table(&args) ? acquire_table(srv, input, &args, &entry) : 1;
+    if (ret == 1) {
+        ret = srv->run(input, &args);
+    } else {
+        fclose(input);
+        if (ret == 0) {
+            ret = print_table(&entry->csv, &args);
+            release_table(srv, entry);
+        }
+    }
+
+    if (fclose(args.output) != 0 && ret == 0)
+        ret = -1;
+    fclose(args.errors);
+    free_cli_args(&args);
+    return ret;
+}
+
+static void handle_client(struct server *srv, int fd)
+{
+    struct request_header hdr;
+    if (read_full(fd, &hdr, sizeof(hdr)) != 0 || hdr.magic != REQUEST_MAGIC || hdr.argc == 0 ||
+        hdr.size == 0 || hdr.size > REQUEST_MAX_BYTES || hdr.argc >= hdr.size)
+        return;
+
+    char  *payload = malloc(hdr.size);
+    char **argv    = calloc(hdr.argc + 1, sizeof(char *));
+    if (!payload || !argv || read_full(fd, payload, hdr.size) != 0 || payload[hdr.size - 1]) {
+        free(payload);
+        free(argv);
+        return;
+    }
+
+    // The paths come first, then exactly argc arguments
+    char    *paths[REQUEST_PATHS];
+    char    *p   = payload;
+    char    *end = payload + hdr.size;
+    uint32_t n   = 0;
+    for (int i = 0; i < REQUEST_PATHS && p < end; i++) {
+        paths[i] = p;
+        p += strlen(p) + 1;
+    }
+    while (p < end && n < hdr.argc) {
+        argv[n++] = p;
+        p += strlen(p) + 1;
+    }
+
+    int status = 1;
+    if (n == hdr.argc && p == end)
+        status = answer(srv, &fd, paths, (int)hdr.argc, argv, hdr.width > 0 ? hdr.width : 0);
+    send_frame(fd, FRAME_STATUS, NULL, (uint32_t)status);
+
+    free(payload);
+    free(argv);
+}
+
+static void *serve_loop(void *arg)
+{
+    struct server *srv = arg;
+
+    for (;;) {
+        int fd = accept4(srv->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0 && (errno == EINTR || errno == ECONNABORTED))
+            continue;
+        if (fd < 0 && (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)) {
+            perror("accept");
+            sleep(1);
+            continue;
+        }
+        if (fd < 0)
+            break;
+
+        struct timeval timeout = {.tv_sec = REQUEST_TIMEOUT};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        handle_client(srv, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+int serve_tables(const struct cli_args *args, request_fn run)
+{
+    // Static, as detached workers may still hold it while the process exits
+    static struct server srv;
+    srv.run    = run;
+    srv.budget = args->max_memory ? args->max_memory : DEFAULT_CACHE_BYTES;
+    pthread_mutex_init(&srv.lock, NULL);
+    pthread_mutex_init(&srv.getopt_lock, NULL);
+
+    srv.fd = listen_socket(args->serve);
+    if (srv.fd < 0)
+        return 1;
+
+    // Workers inherit the blocked mask, so only sigwait below sees the signals
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    sigaddset(&stop, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int started = 0;
+    int workers = parallel_threads(args->threads, INT_MAX, 1);
+    for (int i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_loop, &srv) == 0) {
+            pthread_detach(thread);
+            started++;
+        }
+    }
+
+    int sig = 0;
+    if (started > 0)
+        sigwait(&stop, &sig);
+    else
+        fprintf(stderr, "Failed to start server threads\n");
+
+    // No new connections, idle tables are released and requests still being
+    // answered are cut off when the process exits
+    shutdown(srv.fd, SHUT_RDWR);
+    unlink_socket(args->serve);
+    pthread_mutex_lock(&srv.lock);
+    srv.budget               = 0;
+    struct table_entry *idle = cache_trim(&srv);
+    pthread_mutex_unlock(&srv.lock);
+    free_entries(idle);
+    return started > 0 ? 0 : 1;
+}
+
+static int relay_reply(int fd, const char *socket_path)
+{
+    char *buf = malloc(COPY_BUFFER_SIZE);
+    if (!buf)
+        return 1;
+
+    int          status = 1;
+    bool         done   = false;
+    struct frame frame;
+    while (read_full(fd, &frame, sizeof(frame)) == 0) {
+        if (frame.type == FRAME_STATUS) {
+            status = (int)(int32_t)frame.len;
+            done   = true;
+            break;
+        }
+
+        FILE *to = frame.type == FRAME_ERROR ? stderr : stdout;
+        while (frame.len > 0) {
+            size_t n = frame.len < COPY_BUFFER_SIZE ? frame.len : COPY_BUFFER_SIZE;
+            if (read_full(fd, buf, n) != 0)
+                break;
+            fwrite(buf, 1, n, to);
+            frame.len -= (uint32_t)n;
+        }
+        if (frame.len > 0)
+            break;
+    }
+    free(buf);
+
+    if (!done)
+        fprintf(stderr, "%s: connection closed before the reply was complete\n", socket_path);
+    return status;
+}
+
+int client_request(const struct cli_args *args, int argc, char *argv[])
+{
+    // The daemon runs in another directory, so relative paths mean nothing to it
+    const char *files[REQUEST_PATHS] = {args->file, args->diff, args->join};
+    char       *paths[REQUEST_PATHS] = {NULL};
+    size_t      size                 = 0;
+    int         failed               = 0;
+    for (int i = 0; i < REQUEST_PATHS; i++) {
+        if (files[i] && !failed && !(paths[i] = realpath(files[i], NULL))) {
+            perror(files[i]);
+            failed = 1;
+        }
+        size += (paths[i] ? strlen(paths[i]) : 0) + 1;
+    }
+    for (int i = 0; i < argc; i++) {
+        size += strlen(argv[i]) + 1;
+    }
+    if (!failed && size > REQUEST_MAX_BYTES) {
+        fprintf(stderr, "Command line too long for --client\n");
+        failed = 1;
+    }
+
+    char *payload = failed ? NULL : malloc(size);
+    if (!payload) {
+        for (int i = 0; i < REQUEST_PATHS; i++) {
+            free(paths[i]);
+        }
+        return 1;
+    }
+    size_t len = 0;
+    for (int i = 0; i < REQUEST_PATHS; i++) {
+        size_t path_len = (paths[i] ? strlen(paths[i]) : 0) + 1;
+        memcpy(payload + len, paths[i] ? paths[i] : "", path_len);
+        len += path_len;
+        free(paths[i]);
+    }
+    for (int i = 0; i < argc; i++) {
+        size_t arg_len = strlen(argv[i]) + 1;
+        memcpy(payload + len, argv[i], arg_len);
+        len += arg_len;
+    }
+
+    // --fit is decided by the terminal the reply ends up on, not the daemon's
+    struct request_header hdr = {.magic = REQUEST_MAGIC,
+                                 .width = args->fit ? terminal_width() : 0,
+                                 .argc  = (uint32_t)argc,
+                                 .size  = (uint32_t)size};
+
+    int ret = 1;
+    int fd  = connect_socket(args->client);
+    if (fd < 0)
+        perror(args->client);
+    else if (write_full(fd, &hdr, sizeof(hdr)) != 0 || write_full(fd, payload, size) != 0)
+        fprintf(stderr, "%s: failed to send the request\n", args->client);
+    else
+        ret = relay_reply(fd, args->client);
+
+    if (fd >= 0)
+        close(fd);
+    free(payload);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Runs one request against its opened input and closes the input
+typedef int (*request_fn)(FILE *input, struct cli_args *args);
+
+// Answer --client requests on the args->serve socket until SIGINT or
+// SIGTERM. Plain table renders are drawn from parsed tables kept in an LRU
+// bounded by --max-memory and keyed by file identity and parse options;
+// every other request goes through run with its output sent to the client.
+int serve_tables(const struct cli_args *args, request_fn run);
+
+// Send the command line to the daemon on args->client and copy its reply to
+// stdout and stderr; returns the exit status of the request
+int client_request(const struct cli_args *args, int argc, char *argv[]);
+
+#endif  // SERVER_H
\ No newline at end of file
@@ -0,0 +1,660 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_parser.h"
+#include "csv_scan.h"
+#include "numparse.h"
+#include "parallel.h"
+#include "sketch.h"
+#include "strtab.h"
+#include "table_printer.h"
+
+#define MIN_CHUNK_BYTES (1 << 22)  // Smallest slice of the file worth a thread
+#define CONFIRM_RECORDS 4
+#define RESYNC_LINES    64
+#define HLL_BITS        12   // 4096 registers, about 1.6% standard error
+#define HLL_REGISTERS   (1 << HLL_BITS)
+#define CMS_DEPTH       4
+#define CMS_WIDTH       512  // Overcounts by under 0.6% of the values, almost surely
+#define KLL_K           200  // Capacity of the top compactor, about 1% rank error
+#define KLL_MAX_DEPTH   64   // Enough levels for 2^63 values
+#define HEAVY_SLOTS     8    // Heavy hitter candidates kept per column
+#define HEAVY_SHOWN     3
+#define SKETCH_COLUMNS  8
+
+// One compactor of a KLL sketch, each item at level h stands for 2^h values
+struct kll_level {
+    double *items;
+    int     count;
+    int     cap;
+};
+
+struct kll {
+    struct kll_level *levels;
+    int               depth;
+    int               caps[KLL_MAX_DEPTH];  // Capacity of each level at the current depth
+    uint64_t          rng;                  // Picks the half of a compacted level that survives
+};
+
+struct heavy {
+    char    *value;
+    size_t   len;
+    uint64_t hash;
+    uint64_t count;  // Count-min estimate when last seen
+};
+
+struct column_sketch {
+    char        *name;
+    long         values;  // Non-empty cells
+    long         empty;   // Empty or missing cells
+    long         numbers;
+    uint8_t      hll[HLL_REGISTERS];
+    uint64_t     cms[CMS_DEPTH][CMS_WIDTH];
+    struct kll   kll;
+    struct heavy heavy[HEAVY_SLOTS];
+    int          heavy_count;
+};
+
+struct sketch_state {
+    struct column_sketch **columns;
+    int                    column_count;
+    long                   rows;
+};
+
+struct sketch_chunk {
+    const char         *begin;
+    const char         *end;
+    struct sketch_state state;
+    bool                unterminated;
+    int                 status;
+};
+
+struct chunk_job {
+    struct sketch_chunk   *chunks;
+    const struct cli_args *args;
+};
+
+static int kll_grow(struct kll *s)
+{
+    if (s->depth == KLL_MAX_DEPTH)
+        return -1;
+
+    struct kll_level *levels = realloc(s->levels, (size_t)(s->depth + 1) * sizeof(*levels));
+    if (!levels)
+        return -1;
+    levels[s->depth] = (struct kll_level){0};
+    s->levels        = levels;
+    s->depth++;
+
+    // Capacities shrink by 2/3 per level below the top, down to two items
+    for (int h = 0; h < s->depth; h++) {
+        double cap = KLL_K * pow(2.0 / 3.0, s->depth - 1 - h);
+        s->caps[h] = cap < 2 ? 2 : (int)cap;
+    }
+    return 0;
+}
+
+static int kll_push(struct kll_level *level, double value)
+{
+    if (level->count == level->cap) {
+        int     cap   = level->cap ? level->cap * 2 : 16;
+        double *items = realloc(level->items, (size_t)cap * sizeof(double));
+        if (!items)
+            return -1;
+        level->items = items;
+        level->cap   = cap;
+    }
+    level->items[level->count++] = value;
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Compact every level at or over capacity: sort it and promote every other
+// item, from a random first one, to the level above
+static int kll_compress(struct kll *s)
+{
+    for (int h = 0; h < s->depth; h++) {
+        if (s->levels[h].count < s->caps[h])
+            continue;
+        if (h + 1 == s->depth && kll_grow(s) != 0)
+            return -1;
+
+        struct kll_level *level = &s->levels[h];
+        qsort(level->items, (size_t)level->count, sizeof(double), compare_doubles);
+
+        // An odd item out stays behind, so the total weight is preserved
+        int pairs = level->count & ~1;
+        s->rng    = s->rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        for (int i = (int)(s->rng >> 63); i < pairs; i += 2) {
+            if (kll_push(&s->levels[h + 1], level->items[i]) != 0)
+                return -1;
+        }
+        if (pairs < level->count)
+            level->items[0] = level->items[pairs];
+        level->count -= pairs;
+    }
+    return 0;
+}
+
+static int kll_add(struct kll *s, double value)
+{
+    if (s->depth == 0 && kll_grow(s) != 0)
+        return -1;
+    if (kll_push(&s->levels[0], value) != 0)
+        return -1;
+    return s->levels[0].count >= s->caps[0] ? kll_compress(s) : 0;
+}
+
+static int kll_merge(struct kll *dst, const struct kll *src)
+{
+    while (dst->depth < src->depth) {
+        if (kll_grow(dst) != 0)
+            return -1;
+    }
+    for (int h = 0; h < src->depth; h++) {
+        for (int i = 0; i < src->levels[h].count; i++) {
+            if (kll_push(&dst->levels[h], src->levels[h].items[i]) != 0)
+                return -1;
+        }
+    }
+    return kll_compress(dst);
+}
+
+static void kll_free(struct kll *s)
+{
+    for (int h = 0; h < s->depth; h++) {
+        free(s->levels[h].items);
+    }
+    free(s->levels);
+}
+
+struct weighted {
+    double   value;
+    uint64_t weight;
+};
+
+static int compare_weighted(const void *a, const void *b)
+{
+    return compare_doubles(&((const struct weighted *)a)->value,
+                           &((const struct weighted *)b)->value);
+}
+
+// Values at the given ranks (0..1) from the weighted items of every level
+static int kll_quantiles(const struct kll *s, const double *ranks, int count, double *out)
+{
+    size_t items = 0;
+    for (int h = 0; h < s->depth; h++) {
+        items += (size_t)s->levels[h].count;
+    }
+    struct weighted *all = malloc((items ? items : 1) * sizeof(*all));
+    if (!all)
+        return -1;
+
+    size_t   n     = 0;
+    uint64_t total = 0;
+    for (int h = 0; h < s->depth; h++) {
+        for (int i = 0; i < s->levels[h].count; i++) {
+            all[n++] = (struct weighted){s->levels[h].items[i], UINT64_C(1) << h};
+            total += UINT64_C(1) << h;
+        }
+    }
+    qsort(all, n, sizeof(*all), compare_weighted);
+
+    for (int q = 0; q < count; q++) {
+        double   target = ranks[q] * (double)total;
+        uint64_t seen   = 0;
+        size_t   i      = 0;
+        while (i + 1 < n && (double)(seen + all[i].weight) < target) {
+            seen += all[i].weight;
+            i++;
+        }
+        out[q] = n ? all[i].value : 0;
+    }
+    free(all);
+    return 0;
+}
+
+// Finalizer of MurmurHash3, spreads strtab_hash over all 64 bits for HyperLogLog
+static uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 33);
+}
+
+static void hll_add(uint8_t *registers, uint64_t hash)
+{
+    // The top bits pick the register, the rank is the position of the first
+    // set bit in the rest; the guard bit caps it for all-zero tails
+    uint64_t rest = hash << HLL_BITS | (UINT64_C(1) << (HLL_BITS - 1));
+    uint8_t  rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    size_t   slot = (size_t)(hash >> (64 - HLL_BITS));
+    if (rank > registers[slot])
+        registers[slot] = rank;
+}
+
+static double hll_estimate(const uint8_t *registers)
+{
+    double m     = HLL_REGISTERS;
+    double sum   = 0;
+    int    zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        sum += ldexp(1.0, -registers[i]);
+        zeros += registers[i] == 0;
+    }
+
+    // Small cardinalities are counted from the empty registers instead
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * log(m / zeros);
+    return estimate;
+}
+
+// Add n to the value's count-min counters and return its estimated count
+static uint64_t cms_update(struct column_sketch *col, uint64_t hash, uint64_t n)
+{
+    uint32_t a        = (uint32_t)hash;
+    uint32_t b        = (uint32_t)(hash >> 32) | 1;
+    uint64_t estimate = UINT64_MAX;
+    for (uint32_t d = 0; d < CMS_DEPTH; d++) {
+        uint64_t *cell = &col->cms[d][(a + d * b) % CMS_WIDTH];
+        *cell += n;
+        if (*cell < estimate)
+            estimate = *cell;
+    }
+    return estimate;
+}
+
+// Keep the values with the largest estimated counts as heavy hitter candidates
+static int heavy_offer(struct column_sketch *col,
+                       const char           *value,
+                       size_t                len,
+                       uint64_t              hash,
+                       uint64_t              count)
+{
+    int lowest = 0;
+    for (int i = 0; i < col->heavy_count; i++) {
+        struct heavy *h = &col->heavy[i];
+        if (h->hash == hash && h->len == len && memcmp(h->value, value, len) == 0) {
+            h->count = count;
+            return 0;
+        }
+        if (h->count < col->heavy[lowest].count)
+            lowest = i;
+    }
+    if (col->heavy_count == HEAVY_SLOTS && count <= col->heavy[lowest].count)
+        return 0;
+
+    char *copy = malloc(len + 1);
+    if (!copy)
+        return -1;
+    memcpy(copy, value, len);
+    copy[len] = '\0';
+
+    if (col->heavy_count < HEAVY_SLOTS)
+        lowest = col->heavy_count++;
+    else
+        free(col->heavy[lowest].value);
+    col->heavy[lowest] = (struct heavy){copy, len, hash, count};
+    return 0;
+}
+
+static int sketch_cell(struct column_sketch *col, const char *field, size_t len)
+{
+    if (len == 0) {
+        col->empty++;
+        return 0;
+    }
+    col->values++;
+
+    uint64_t hash = mix64(strtab_hash(field, len));
+    hll_add(col->hll, hash);
+    if (heavy_offer(col, field, len, hash, cms_update(col, hash, 1)) != 0)
+        return -1;
+
+    double number;
+    if (parse_number(field, len, &number) == NUM_NONE)
+        return 0;
+    col->numbers++;
+    return kll_add(&col->kll, number);
+}
+
+static int grow_columns(struct sketch_state *st, int count)
+{
+    if (count <= st->column_count)
+        return 0;
+
+    struct column_sketch **columns = realloc(st->columns, (size_t)count * sizeof(*columns));
+    if (!columns)
+        return -1;
+    st->columns = columns;
+
+    // Columns first seen late were missing, i.e. empty, in every earlier row
+    for (; st->column_count < count; st->column_count++) {
+        struct column_sketch *col = calloc(1, sizeof(*col));
+        if (!col)
+            return -1;
+        col->empty                    = st->rows;
+        col->kll.rng                  = 0x9E3779B97F4A7C15ULL;
+        st->columns[st->column_count] = col;
+    }
+    return 0;
+}
+
+static int sketch_row(const struct csv_row_view *row, void *ctx)
+{
+    struct sketch_state *st = ctx;
+
+    if (grow_columns(st, row->field_count) != 0)
+        return -1;
+
+    if (row->index < 0) {
+        for (int i = 0; i < row->field_count; i++) {
+            st->columns[i]->name = strdup(row->fields[i]);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < row->field_count; i++) {
+        if (sketch_cell(st->columns[i], row->fields[i], row->lengths[i]) != 0)
+            return -1;
+    }
+    for (int i = row->field_count; i < st->column_count; i++) {
+        st->columns[i]->empty++;
+    }
+    st->rows++;
+    return 0;
+}
+
+static int merge_column(struct column_sketch *dst, const struct column_sketch *src)
+{
+    dst->values += src->values;
+    dst->empty += src->empty;
+    dst->numbers += src->numbers;
+    for (int i = 0; i < HLL_REGISTERS; i++) {
+        if (src->hll[i] > dst->hll[i])
+            dst->hll[i] = src->hll[i];
+    }
+    for (int d = 0; d < CMS_DEPTH; d++) {
+        for (int w = 0; w < CMS_WIDTH; w++) {
+            dst->cms[d][w] += src->cms[d][w];
+        }
+    }
+    if (kll_merge(&dst->kll, &src->kll) != 0)
+        return -1;
+
+    // Candidates of both sides compete on their merged estimates
+    for (int i = 0; i < dst->heavy_count; i++) {
+        dst->heavy[i].count = cms_update(dst, dst->heavy[i].hash, 0);
+    }
+    for (int i = 0; i < src->heavy_count; i++) {
+        const struct heavy *h = &src->heavy[i];
+        if (heavy_offer(dst, h->value, h->len, h->hash, cms_update(dst, h->hash, 0)) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Fold the sketches of a later slice into dst
+static int merge_state(struct sketch_state *dst, const struct sketch_state *src)
+{
+    if (grow_columns(dst, src->column_count) != 0)
+        return -1;
+    for (int i = 0; i < dst->column_count; i++) {
+        if (i >= src->column_count)
+            dst->columns[i]->empty += src->rows;
+        else if (merge_column(dst->columns[i], src->columns[i]) != 0)
+            return -1;
+    }
+    dst->rows += src->rows;
+    return 0;
+}
+
+static void sketch_state_free(struct sketch_state *st)
+{
+    for (int i = 0; i < st->column_count; i++) {
+        struct column_sketch *col = st->columns[i];
+        for (int h = 0; h < col->heavy_count; h++) {
+            free(col->heavy[h].value);
+        }
+        kll_free(&col->kll);
+        free(col->name);
+        free(col);
+    }
+    free(st->columns);
+    memset(st, 0, sizeof(*st));
+}
+
+static void run_chunks(void *ctx, long begin, long end, int worker __attribute__((unused)))
+{
+    struct chunk_job *job  = ctx;
+    struct cli_args   body = *job->args;
+    body.no_headers        = true;
+
+    for (long c = begin; c < end; c++) {
+        struct sketch_chunk *chunk = &job->chunks[c];
+        chunk->status              = parse_csv_buffer(chunk->begin,
+                                         (size_t)(chunk->end - chunk->begin),
+                                         &body,
+                                         sketch_row,
+                                         &chunk->state,
+                                         &chunk->unterminated);
+    }
+}
+
+// Sketch file slices on worker threads and merge them in file order. Slice
+// starts are guessed at confirmed line breaks; a slice that ends inside a
+// record shows the guess was wrong and the pass reruns serially.
+static int sketch_parallel(struct sketch_state   *st,
+                           const char            *data,
+                           const char            *end,
+                           int                    columns,
+                           int                    threads,
+                           const struct cli_args *args)
+{
+    struct sketch_chunk *chunks = calloc((size_t)threads, sizeof(*chunks));
+    if (!chunks)
+        return -1;
+
+    char   delim = args->tsv ? '\t' : args->delimiter;
+    size_t span  = (size_t)(end - data);
+    int    ret   = 0;
+
+    chunks[0].begin = data;
+    for (int i = 1; i < threads; i++) {
+        const char *guess = data + span / (size_t)threads * (size_t)i - 1;
+        const char *start = csv_resync(guess, end, delim, columns, CONFIRM_RECORDS, RESYNC_LINES);
+        if (!start || start < chunks[i - 1].begin)
+            start = start ? chunks[i - 1].begin : end;
+        chunks[i].begin   = start;
+        chunks[i - 1].end = start;
+    }
+    chunks[threads - 1].end = end;
+
+    struct chunk_job job = {.chunks = chunks, .args = args};
+    parallel_for(threads, threads, run_chunks, &job);
+
+    bool aligned = true;
+    for (int i = 0; i < threads; i++) {
+        if (chunks[i].status != 0)
+            ret = -1;
+        if (i < threads - 1 && chunks[i].unterminated)
+            aligned = false;
+    }
+    for (int i = 0; i < threads && ret == 0 && aligned; i++) {
+        ret = merge_state(st, &chunks[i].state);
+    }
+    for (int i = 0; i < threads; i++) {
+        sketch_state_free(&chunks[i].state);
+    }
+    free(chunks);
+
+    if (ret == 0 && !aligned) {
+        struct cli_args body = *args;
+        body.no_headers      = true;
+        ret = parse_csv_buffer(data, span, &body, sketch_row, st, NULL);
+    }
+    return ret;
+}
+
+static int sketch_mapped(struct sketch_state   *st,
+                         const char            *base,
+                         size_t                 size,
+                         const struct cli_args *args)
+{
+    const char     *end     = base + size;
+    const char     *data    = base;
+    char            delim   = args->tsv ? '\t' : args->delimiter;
+    int             columns = 0;
+    bool            clean;
+    struct cli_args body = *args;
+    body.no_headers      = true;
+
+    if (!args->no_headers) {
+        data = csv_scan_record(base, end, delim, &columns, &clean);
+        if (parse_csv_buffer(base, (size_t)(data - base), args, sketch_row, st, NULL) != 0)
+            return -1;
+    } else {
+        csv_scan_record(base, end, delim, &columns, &clean);
+    }
+
+    int threads = parallel_threads(args->threads, (long)(end - data), MIN_CHUNK_BYTES);
+    if (threads > 1)
+        return sketch_parallel(st, data, end, columns, threads, args);
+    return parse_csv_buffer(data, (size_t)(end - data), &body, sketch_row, st, NULL);
+}
+
+static int compare_heavy(const void *a, const void *b)
+{
+    const struct heavy *x = a;
+    const struct heavy *y = b;
+    return (x->count < y->count) - (x->count > y->count);
+}
+
+// "value (share%)" for the leading candidates holding at least 1% of the values
+static char *format_heavy(const struct column_sketch *col)
+{
+    struct heavy top[HEAVY_SLOTS];
+    size_t       size = 1;
+    memcpy(top, col->heavy, (size_t)col->heavy_count * sizeof(top[0]));
+    qsort(top, (size_t)col->heavy_count, sizeof(top[0]), compare_heavy);
+    for (int i = 0; i < col->heavy_count && i < HEAVY_SHOWN; i++) {
+        size += top[i].len + 16;
+    }
+
+    char *text = malloc(size);
+    if (!text)
+        return NULL;
+
+    size_t len = 0;
+    text[0]    = '\0';
+    for (int i = 0; i < col->heavy_count && i < HEAVY_SHOWN; i++) {
+        if (top[i].count < 2 || (double)top[i].count * 100 < (double)col->values)
+            break;
+        double share = 100.0 * (double)top[i].count / (double)col->values;
+        len += (size_t)snprintf(text + len,
+                                size - len,
+                                "%s%s (%.1f%%)",
+                                len ? ", " : "",
+                                top[i].value,
+                                share < 100 ? share : 100);
+    }
+    if (len == 0)
+        snprintf(text, size, "-");
+    return text;
+}
+
+static int add_sketch_row(struct csv_data *csv, int index, const struct column_sketch *col)
+{
+    static const double ranks[3] = {0.5, 0.9, 0.99};
+
+    char   name[24], values[24], empty[24], distinct[24], quantile[3][32];
+    double at[3];
+    bool   numeric = col->numbers > 0 && col->numbers == col->values;
+    if (numeric && kll_quantiles(&col->kll, ranks, 3, at) != 0)
+        return -1;
+
+    double estimate = col->values ? hll_estimate(col->hll) : 0;
+    snprintf(name, sizeof(name), "%d", index + 1);
+    snprintf(values, sizeof(values), "%ld", col->values);
+    snprintf(empty, sizeof(empty), "%ld", col->empty);
+    snprintf(distinct, sizeof(distinct), "%.0f", fmin(estimate, (double)col->values));
+    for (int q = 0; q < 3; q++) {
+        if (numeric)
+            snprintf(quantile[q], sizeof(quantile[q]), "%.6g", at[q]);
+        else
+            snprintf(quantile[q], sizeof(quantile[q]), "-");
+    }
+
+    char *heavy = format_heavy(col);
+    if (!heavy)
+        return -1;
+
+    const char *fields[SKETCH_COLUMNS] = {col->name ? col->name : name,
+                                          values,
+                                          empty,
+                                          distinct,
+                                          quantile[0],
+                                          quantile[1],
+                                          quantile[2],
+                                          heavy};
+    int ret = csv_data_add(csv, fields, SKETCH_COLUMNS, false);
+    free(heavy);
+    return ret;
+}
+
+int print_sketch(FILE *input, struct cli_args *args)
+{
+    struct sketch_state st = {0};
+
+    struct stat sb;
+    void       *map  = MAP_FAILED;
+    size_t      size = 0;
+    if (fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    int ret;
+    if (map != MAP_FAILED) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        ret = sketch_mapped(&st, map, size, args);
+        munmap(map, size);
+    } else {
+        ret = parse_csv_stream(input, args, sketch_row, &st);
+    }
+
+    struct csv_data csv;
+    if (ret == 0 && csv_data_init(&csv) == 0) {
+        static const char *const header[SKETCH_COLUMNS] = {
+            "column", "values", "empty", "distinct", "p50", "p90", "p99", "top values"};
+
+        ret = csv_data_add(&csv, header, SKETCH_COLUMNS, true);
+        for (int i = 0; i < st.column_count && ret == 0; i++) {
+            ret = add_sketch_row(&csv, i, st.columns[i]);
+        }
+        csv_data_finish(&csv, args->number);
+
+        // The report is a regular table, so every style and alignment applies
+        if (ret == 0)
+            ret = print_table(&csv, args);
+        free_csv_data(&csv);
+    } else if (ret == 0) {
+        ret = -1;
+    }
+
+    sketch_state_free(&st);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Approximate column statistics in constant memory per column: HyperLogLog
+// distinct counts, KLL quantiles of numeric cells and count-min heavy
+// hitters. Regular files are sketched in slices on worker threads and the
+// sketches merged; the report is printed as a table.
+int print_sketch(FILE *input, struct cli_args *args);
+
+#endif  // SKETCH_H
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "spill.h"
+
+#define SPILL_IO_BUFFER (1 << 20)
+
+// Create an anonymous temp file under $TMPDIR, it disappears once closed
+static FILE *open_temp_file(void)
+{
+    const char *dir = getenv("TMPDIR");
+    if (!dir || !*dir)
+        dir = "/tmp";
+
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s/csview-spill-XXXXXX", dir) >= (int)sizeof(path))
+        return NULL;
+
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return NULL;
+    unlink(path);
+
+    FILE *fp = fdopen(fd, "w+b");
+    if (!fp)
+        close(fd);
+    return fp;
+}
+
+int spill_open(struct spill_file *sp)
+{
+    memset(sp, 0, sizeof(*sp));
+
+    sp->fp = open_temp_file();
+    if (!sp->fp) {
+        perror("csview: spill file");
+        return -1;
+    }
+
+    sp->io_buf = malloc(SPILL_IO_BUFFER);
+    if (sp->io_buf)
+        setvbuf(sp->fp, sp->io_buf, _IOFBF, SPILL_IO_BUFFER);
+    return 0;
+}
+
+int spill_write(struct spill_file *sp,
+                const char *const *fields,
+                const int         *widths,
+                int                field_count)
+{
+    uint32_t count = (uint32_t)field_count;
+    if (fwrite(&count, sizeof(count), 1, sp->fp) != 1)
+        return -1;
+
+    for (int i = 0; i < field_count; i++) {
+        uint32_t head[2] = {(uint32_t)strlen(fields[i]), (uint32_t)widths[i]};
+        if (fwrite(head, sizeof(head), 1, sp->fp) != 1)
+            return -1;
+        if (head[0] > 0 && fwrite(fields[i], head[0], 1, sp->fp) != 1)
+            return -1;
+    }
+
+    sp->count++;
+    return 0;
+}
+
+int spill_rewind(struct spill_file *sp)
+{
+    if (fflush(sp->fp) != 0)
+        return -1;
+    return fseek(sp->fp, 0, SEEK_SET);
+}
+
+static int reserve_fields(struct spill_file *sp, int count)
+{
+    if (count <= sp->field_cap)
+        return 0;
+
+    char **fields = realloc(sp->fields, (size_t)count * sizeof(char *));
+    if (fields)
+        sp->fields = fields;
+    int *widths = realloc(sp->widths, (size_t)count * sizeof(int));
+    if (widths)
+        sp->widths = widths;
+    size_t *offsets = realloc(sp->offsets, (size_t)count * sizeof(size_t));
+    if (offsets)
+        sp->offsets = offsets;
+    if (!fields || !widths || !offsets)
+        return -1;
+
+    sp->field_cap = count;
+    return 0;
+}
+
+// Decode the next record; the returned arrays stay valid until the next call
+int spill_read(struct spill_file *sp, char ***fields, const int **widths, int *field_count)
+{
+    uint32_t count;
+    if (fread(&count, sizeof(count), 1, sp->fp) != 1)
+        return -1;
+    if (reserve_fields(sp, (int)count) != 0)
+        return -1;
+
+    size_t used = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t head[2];
+        if (fread(head, sizeof(head), 1, sp->fp) != 1)
+            return -1;
+
+        if (used + head[0] + 1 > sp->data_cap) {
+            size_t cap = sp->data_cap ? sp->data_cap : 4096;
+            while (cap < used + head[0] + 1)
+                cap *= 2;
+            char *data = realloc(sp->data, cap);
+            if (!data)
+                return -1;
+            sp->data     = data;
+            sp->data_cap = cap;
+        }
+        if (head[0] > 0 && fread(sp->data + used, head[0], 1, sp->fp) != 1)
+            return -1;
+        sp->data[used + head[0]] = '\0';
+
+        // The buffer may still move, pointers are resolved at the end
+        sp->offsets[i] = used;
+        sp->widths[i]  = (int)head[1];
+        used += head[0] + 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        sp->fields[i] = sp->data + sp->offsets[i];
+    }
+
+    *fields      = sp->fields;
+    *widths      = sp->widths;
+    *field_count = (int)count;
+    return 0;
+}
+
+void spill_close(struct spill_file *sp)
+{
+    if (sp->fp)
+        fclose(sp->fp);
+    free(sp->io_buf);
+    free(sp->data);
+    free(sp->fields);
+    free(sp->widths);
+    free(sp->offsets);
+    memset(sp, 0, sizeof(*sp));
+}
\ No newline at end of file
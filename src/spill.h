@@ -0,0 +1,32 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Sequential on-disk store for parsed records that exceed the memory budget.
+// Each record is encoded as:
+//   u32 field_count, then per field: u32 length, u32 display width, bytes
+struct spill_file {
+    FILE   *fp;
+    char   *io_buf;
+    long    count;  // Records written
+    char   *data;   // Read buffer holding the current record's fields
+    size_t  data_cap;
+    size_t *offsets;
+    char  **fields;
+    int    *widths;
+    int     field_cap;
+};
+
+int  spill_open(struct spill_file *sp);
+int  spill_write(struct spill_file *sp,
+                 const char *const *fields,
+                 const int         *widths,
+                 int                field_count);
+int  spill_rewind(struct spill_file *sp);
+int  spill_read(struct spill_file *sp, char ***fields, const int **widths, int *field_count);
+void spill_close(struct spill_file *sp);
+
+#endif  // SPILL_H
\ No newline at end of file
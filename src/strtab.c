@@ -0,0 +1,166 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "strtab.h"
+
+#define INITIAL_SLOTS 1024
+#define ARENA_BLOCK   (1 << 16)
+
+struct strtab_block {
+    struct strtab_block *next;
+    char                 data[];
+};
+
+uint64_t strtab_hash(const char *s, size_t len)
+{
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ len;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, s, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+        s += 8;
+        len -= 8;
+    }
+
+    uint64_t w = 0;
+    memcpy(&w, s, len);
+    h = (h ^ w) * 0xC4CEB9FE1A85EC53ULL;
+    return h ^ (h >> 29);
+}
+
+int strtab_init(struct strtab *t, size_t value_size)
+{
+    memset(t, 0, sizeof(*t));
+    t->value_size = value_size;
+    t->slot_mask  = INITIAL_SLOTS - 1;
+    t->slots      = calloc(INITIAL_SLOTS, sizeof(uint32_t));
+    return t->slots ? 0 : -1;
+}
+
+void strtab_free(struct strtab *t)
+{
+    while (t->blocks) {
+        struct strtab_block *next = t->blocks->next;
+        free(t->blocks);
+        t->blocks = next;
+    }
+    free(t->slots);
+    free(t->entries);
+    free(t->values);
+    memset(t, 0, sizeof(*t));
+}
+
+static const char *intern(struct strtab *t, const char *key, size_t len)
+{
+    if (!t->arena || len > t->arena_left) {
+        size_t               size  = len > ARENA_BLOCK ? len : ARENA_BLOCK;
+        struct strtab_block *block = malloc(sizeof(*block) + size);
+        if (!block)
+            return NULL;
+        block->next   = t->blocks;
+        t->blocks     = block;
+        t->arena      = block->data;
+        t->arena_left = size;
+    }
+
+    char *copy = t->arena;
+    if (len > 0)
+        memcpy(copy, key, len);
+    t->arena += len;
+    t->arena_left -= len;
+    return copy;
+}
+
+// Double the slot array, rehashing from the stored hashes
+static int grow_slots(struct strtab *t)
+{
+    size_t    mask  = t->slot_mask * 2 + 1;
+    uint32_t *slots = calloc(mask + 1, sizeof(uint32_t));
+    if (!slots)
+        return -1;
+
+    for (size_t i = 0; i < t->count; i++) {
+        size_t slot = t->entries[i].hash & mask;
+        while (slots[slot])
+            slot = (slot + 1) & mask;
+        slots[slot] = (uint32_t)(i + 1);
+    }
+    free(t->slots);
+    t->slots     = slots;
+    t->slot_mask = mask;
+    return 0;
+}
+
+static int grow_entries(struct strtab *t)
+{
+    size_t capacity = t->capacity ? t->capacity * 2 : 256;
+
+    struct strtab_entry *entries = realloc(t->entries, capacity * sizeof(*entries));
+    if (!entries)
+        return -1;
+    t->entries = entries;
+
+    char *values = realloc(t->values, capacity * t->value_size);
+    if (!values)
+        return -1;
+    t->values   = values;
+    t->capacity = capacity;
+    return 0;
+}
+
+// Slot holding key, or the empty slot where it belongs
+static size_t probe(const struct strtab *t, const char *key, size_t len, uint64_t hash)
+{
+    size_t slot = hash & t->slot_mask;
+    while (t->slots[slot]) {
+        const struct strtab_entry *entry = &t->entries[t->slots[slot] - 1];
+        if (entry->hash == hash && entry->len == len && memcmp(entry->key, key, len) == 0)
+            break;
+        slot = (slot + 1) & t->slot_mask;
+    }
+    return slot;
+}
+
+void *strtab_find(const struct strtab *t, const char *key, size_t len)
+{
+    size_t slot = probe(t, key, len, strtab_hash(key, len));
+    return t->slots[slot] ? strtab_value(t, t->slots[slot] - 1) : NULL;
+}
+
+static void *get(struct strtab *t, const char *key, size_t len, bool *created, bool borrow)
+{
+    *created = false;
+    if (t->count * 2 >= t->slot_mask + 1 && grow_slots(t) != 0)
+        return NULL;
+
+    uint64_t hash = strtab_hash(key, len);
+    size_t   slot = probe(t, key, len, hash);
+    if (t->slots[slot])
+        return strtab_value(t, t->slots[slot] - 1);
+
+    if (t->count == UINT32_MAX - 1)
+        return NULL;
+    if (t->count == t->capacity && grow_entries(t) != 0)
+        return NULL;
+    const char *copy = borrow ? key : intern(t, key, len);
+    if (!copy)
+        return NULL;
+
+    size_t index      = t->count++;
+    t->entries[index] = (struct strtab_entry){.key = copy, .len = len, .hash = hash};
+    t->slots[slot]    = (uint32_t)(index + 1);
+    memset(strtab_value(t, index), 0, t->value_size);
+    *created = true;
+    return strtab_value(t, index);
+}
+
+void *strtab_get(struct strtab *t, const char *key, size_t len, bool *created)
+{
+    return get(t, key, len, created, false);
+}
+
+void *strtab_get_borrowed(struct strtab *t, const char *key, size_t len, bool *created)
+{
+    return get(t, key, len, created, true);
+}
\ No newline at end of file
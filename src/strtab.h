@@ -0,0 +1,58 @@
+#ifndef STRTAB_H
+#define STRTAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct strtab_block;
+
+struct strtab_entry {
+    const char *key;  // Copy in the table's arena, or the caller's bytes if borrowed
+    size_t      len;
+    uint64_t    hash;
+};
+
+// Open-addressing hash table from byte strings to fixed-size values. Keys are
+// interned in an arena and entries keep their insertion order.
+struct strtab {
+    uint32_t            *slots;  // Entry index + 1, 0 marks an empty slot
+    size_t               slot_mask;
+    struct strtab_entry *entries;
+    char                *values;
+    size_t               value_size;
+    size_t               count;
+    size_t               capacity;
+    struct strtab_block *blocks;  // Arena holding the key bytes
+    char                *arena;
+    size_t               arena_left;
+};
+
+int  strtab_init(struct strtab *t, size_t value_size);
+void strtab_free(struct strtab *t);
+
+// Find or insert key. New values start zeroed and *created is set. The
+// returned pointer is valid until the next insertion; NULL when out of memory.
+void *strtab_get(struct strtab *t, const char *key, size_t len, bool *created);
+
+// strtab_get keeping key itself instead of a copy, for callers that already
+// hold the bytes; they must stay unchanged for as long as the table lives
+void *strtab_get_borrowed(struct strtab *t, const char *key, size_t len, bool *created);
+
+// Look key up without inserting it, NULL when absent
+void *strtab_find(const struct strtab *t, const char *key, size_t len);
+
+// The table's 64-bit string hash
+uint64_t strtab_hash(const char *s, size_t len);
+
+static inline const struct strtab_entry *strtab_entry(const struct strtab *t, size_t index)
+{
+    return &t->entries[index];
+}
+
+static inline void *strtab_value(const struct strtab *t, size_t index)
+{
+    return t->values + index * t->value_size;
+}
+
+#endif  // STRTAB_H
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "csv_parser.h"
+#include "numparse.h"
+#include "summary.h"
+#include "table_printer.h"
+#include "utils.h"
+
+#define SUMMARY_COLUMNS 9
+
+struct column_stats {
+    char  *name;
+    long   values;  // Non-empty cells
+    long   empty;   // Empty or missing cells
+    long   numbers;
+    bool   has_float;
+    double min;
+    double max;
+    double mean;  // Welford running mean and sum of squared deviations
+    double m2;
+    int    min_width;
+    int    max_width;
+};
+
+struct summary_state {
+    struct column_stats *columns;
+    int                  column_count;
+    long                 rows;
+};
+
+static int grow_columns(struct summary_state *st, int count)
+{
+    if (count <= st->column_count)
+        return 0;
+
+    struct column_stats *columns = realloc(st->columns, (size_t)count * sizeof(*columns));
+    if (!columns)
+        return -1;
+
+    // Columns first seen late were missing, i.e. empty, in every earlier row
+    for (int i = st->column_count; i < count; i++) {
+        memset(&columns[i], 0, sizeof(columns[i]));
+        columns[i].empty = st->rows;
+    }
+    st->columns      = columns;
+    st->column_count = count;
+    return 0;
+}
+
+static void update_stats(struct column_stats *col, const char *field, size_t len)
+{
+    int width = unicode_display_width(field);
+    if (col->values + col->empty == 0 || width < col->min_width)
+        col->min_width = width;
+    if (width > col->max_width)
+        col->max_width = width;
+
+    if (len == 0) {
+        col->empty++;
+        return;
+    }
+    col->values++;
+
+    double     value;
+    num_kind_t kind = parse_number(field, len, &value);
+    // Literals that overflow a double, like 1e400, would poison the moments
+    if (kind == NUM_NONE || !isfinite(value))
+        return;
+
+    if (kind == NUM_FLOAT)
+        col->has_float = true;
+    if (col->numbers == 0 || value < col->min)
+        col->min = value;
+    if (col->numbers == 0 || value > col->max)
+        col->max = value;
+
+    col->numbers++;
+    double delta = value - col->mean;
+    col->mean += delta / (double)col->numbers;
+    col->m2 += delta * (value - col->mean);
+}
+
+static int summary_row(const struct csv_row_view *row, void *ctx)
+{
+    struct summary_state *st = ctx;
+
+    if (grow_columns(st, row->field_count) != 0)
+        return -1;
+
+    if (row->index < 0) {
+        for (int i = 0; i < row->field_count; i++) {
+            st->columns[i].name = strdup(row->fields[i]);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < row->field_count; i++) {
+        update_stats(&st->columns[i], row->fields[i], row->lengths[i]);
+    }
+    for (int i = row->field_count; i < st->column_count; i++) {
+        st->columns[i].empty++;
+        st->columns[i].min_width = 0;
+    }
+    st->rows++;
+    return 0;
+}
+
+static const char *column_type(const struct column_stats *col)
+{
+    if (col->values == 0)
+        return "empty";
+    if (col->numbers < col->values)
+        return "string";
+    return col->has_float ? "float" : "int";
+}
+
+static int add_summary_row(struct csv_data *csv, int index, const struct column_stats *col)
+{
+    char        name[24], empty[24], min[32], max[32], mean[32], stddev[32], min_w[16], max_w[16];
+    const char *type    = column_type(col);
+    bool        numeric = col->numbers > 0 && col->numbers == col->values;
+
+    snprintf(name, sizeof(name), "%d", index + 1);
+    snprintf(empty, sizeof(empty), "%ld", col->empty);
+    snprintf(min_w, sizeof(min_w), "%d", col->min_width);
+    snprintf(max_w, sizeof(max_w), "%d", col->max_width);
+
+    if (numeric) {
+        snprintf(min, sizeof(min), "%.15g", col->min);
+        snprintf(max, sizeof(max), "%.15g", col->max);
+        snprintf(mean, sizeof(mean), "%.6g", col->mean);
+        if (col->numbers > 1)
+            snprintf(stddev, sizeof(stddev), "%.6g", sqrt(col->m2 / (double)(col->numbers - 1)));
+        else
+            snprintf(stddev, sizeof(stddev), "-");
+    } else {
+        snprintf(min, sizeof(min), "-");
+        snprintf(max, sizeof(max), "-");
+        snprintf(mean, sizeof(mean), "-");
+        snprintf(stddev, sizeof(stddev), "-");
+    }
+
+    const char *fields[SUMMARY_COLUMNS] = {
+        col->name ? col->name : name, type, empty, min, max, mean, stddev, min_w, max_w};
+    return csv_data_add(csv, fields, SUMMARY_COLUMNS, false);
+}
+
+int print_summary(FILE *input, struct cli_args *args)
+{
+    struct summary_state st = {0};
+
+    int ret = parse_csv_stream(input, args, summary_row, &st);
+
+    struct csv_data csv;
+    if (ret == 0 && csv_data_init(&csv) == 0) {
+        static const char *const header[SUMMARY_COLUMNS] = {
+            "column", "type", "empty", "min", "max", "mean", "stddev", "min width", "max width"};
+
+        ret = csv_data_add(&csv, header, SUMMARY_COLUMNS, true);
+        for (int i = 0; i < st.column_count && ret == 0; i++) {
+            ret = add_summary_row(&csv, i, &st.columns[i]);
+        }
+        csv_data_finish(&csv, args->number);
+
+        // The report is a regular table, so every style and alignment applies
+        if (ret == 0)
+            ret = print_table(&csv, args);
+        free_csv_data(&csv);
+    } else if (ret == 0) {
+        ret = -1;
+    }
+
+    for (int i = 0; i < st.column_count; i++) {
+        free(st.columns[i].name);
+    }
+    free(st.columns);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdio.h>
+
+#include "cli.h"
+
+// Profile every column in one streaming pass and print one row per column
+int print_summary(FILE *input, struct cli_args *args);
+
+#endif  // SUMMARY_H
\ No newline at end of file
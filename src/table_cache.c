@@ -0,0 +1,501 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "intern.h"
+#include "table_cache.h"
+#include "utils.h"
+
+#define CACHE_MAGIC       "CSVCACH1"
+#define CACHE_VERSION     1
+#define CACHE_SUFFIX      ".csvc"
+#define CACHE_PATH_MAX    4096
+#define CACHE_DEFAULT_MAX ((size_t)1 << 30)
+#define CACHE_IO_BUFFER   (1 << 20)
+#define CACHE_FLAG_HEADER 1
+#define WIDTH_BUCKETS     64  // Exact widths 0..62, the last bucket holds wider cells
+
+// On-disk image layout; every section offset is 8-byte aligned
+struct cache_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    uint32_t delimiter;
+    uint32_t columns;
+    uint64_t rows;        // Including the header row when present
+    uint64_t cells;
+    uint64_t row_starts;  // u64[rows + 1], index of each row's first cell
+    uint64_t offsets;     // u64[cells], offset of each cell in the string blob
+    uint64_t widths;      // u32[cells], display width of each cell
+    uint64_t histograms;  // u32[columns][WIDTH_BUCKETS], data row widths per column
+    uint64_t max_widths;  // u32[columns], widest data cell per column
+    uint64_t strings;     // NUL-terminated cell contents
+    uint64_t strings_len;
+    uint64_t image_size;
+};
+
+struct cache_key {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t  mtime_sec;
+    int64_t  mtime_nsec;
+    uint32_t delimiter;
+    uint32_t flags;
+};
+
+struct cache_entry {
+    char   name[256];
+    off_t  size;
+    time_t mtime;
+};
+
+static uint64_t hash_key(const struct cache_key *key)
+{
+    const unsigned char *p = (const unsigned char *)key;
+    uint64_t             h = 1469598103934665603ULL;  // FNV-1a
+    for (size_t i = 0; i < sizeof(*key); i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+static size_t align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+static bool section_fits(const struct cache_header *hdr, uint64_t off, uint64_t len)
+{
+    return off % 8 == 0 && off <= hdr->image_size && len <= hdr->image_size - off;
+}
+
+static int validate_header(const struct cache_header *hdr, const struct cache_key *key, size_t size)
+{
+    if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->version != CACHE_VERSION || hdr->image_size != size)
+        return -1;
+
+    // The image must describe exactly the file we are about to read
+    if (hdr->dev != key->dev || hdr->ino != key->ino || hdr->size != key->size ||
+        hdr->mtime_sec != key->mtime_sec || hdr->mtime_nsec != key->mtime_nsec ||
+        hdr->delimiter != key->delimiter || hdr->flags != key->flags)
+        return -1;
+
+    if (hdr->rows > INT32_MAX || hdr->cells > SIZE_MAX / sizeof(char *) || hdr->columns > INT32_MAX)
+        return -1;
+
+    if (!section_fits(hdr, hdr->row_starts, (hdr->rows + 1) * 8) ||
+        !section_fits(hdr, hdr->offsets, hdr->cells * 8) ||
+        !section_fits(hdr, hdr->widths, hdr->cells * 4) ||
+        !section_fits(hdr, hdr->histograms, (uint64_t)hdr->columns * WIDTH_BUCKETS * 4) ||
+        !section_fits(hdr, hdr->max_widths, (uint64_t)hdr->columns * 4) ||
+        !section_fits(hdr, hdr->strings, hdr->strings_len) || hdr->strings_len == 0)
+        return -1;
+
+    return 0;
+}
+
+// Compute column widths from the image without touching any cell contents
+static void image_column_widths(struct csv_data            *csv,
+                                const struct cache_header  *hdr,
+                                const char                 *base,
+                                int                         sniff)
+{
+    const uint32_t *histograms = (const uint32_t *)(base + hdr->histograms);
+    const uint32_t *max_widths = (const uint32_t *)(base + hdr->max_widths);
+
+    if (csv->header) {
+        for (int i = 0; i < csv->header->field_count; i++) {
+            if (csv->header->widths[i] > csv->column_widths[i])
+                csv->column_widths[i] = csv->header->widths[i];
+        }
+    }
+
+    if (sniff > 0 && sniff < csv->record_count) {
+        for (int r = 0; r < sniff; r++) {
+            const struct csv_record *record = &csv->records[r];
+            for (int i = 0; i < record->field_count; i++) {
+                if (record->widths[i] > csv->column_widths[i])
+                    csv->column_widths[i] = record->widths[i];
+            }
+        }
+        return;
+    }
+
+    // Whole-table widths come straight from the per-column histograms
+    for (int c = 0; c < csv->max_columns; c++) {
+        const uint32_t *hist  = histograms + (size_t)c * WIDTH_BUCKETS;
+        int             width = 0;
+        for (int b = WIDTH_BUCKETS - 1; b >= 0; b--) {
+            if (hist[b]) {
+                width = b == WIDTH_BUCKETS - 1 ? (int)max_widths[c] : b;
+                break;
+            }
+        }
+        if (width > csv->column_widths[c])
+            csv->column_widths[c] = width;
+    }
+}
+
+static int cache_lookup(const char            *path,
+                        const struct cache_key *key,
+                        struct csv_data        *csv,
+                        const struct cli_args  *args)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct cache_header)) {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void  *map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    char                      *base = map;
+    const struct cache_header *hdr  = map;
+    if (validate_header(hdr, key, size) != 0 || base[hdr->strings + hdr->strings_len - 1] != '\0') {
+        munmap(map, size);
+        close(fd);
+        return -1;
+    }
+
+    // Touch the entry so eviction sees it as recently used
+    futimens(fd, NULL);
+    close(fd);
+
+    if (csv_data_init(csv) != 0) {
+        munmap(map, size);
+        return -1;
+    }
+    free(csv->records);
+    csv->records     = NULL;
+    csv->mapping     = map;
+    csv->mapping_len = size;
+
+    const uint64_t *row_starts = (const uint64_t *)(base + hdr->row_starts);
+    const uint64_t *offsets    = (const uint64_t *)(base + hdr->offsets);
+    const int      *widths     = (const int *)(base + hdr->widths);
+    char           *strings    = base + hdr->strings;
+    bool            has_header = hdr->flags & CACHE_FLAG_HEADER;
+    int             rows       = (int)hdr->rows;
+    int             records    = has_header ? rows - 1 : rows;
+
+    csv->field_pool    = malloc((size_t)(hdr->cells ? hdr->cells : 1) * sizeof(char *));
+    csv->records       = malloc((size_t)(records > 0 ? records : 1) * sizeof(struct csv_record));
+    csv->column_widths = calloc((size_t)(hdr->columns ? hdr->columns : 1), sizeof(int));
+    if (has_header)
+        csv->header = malloc(sizeof(struct csv_record));
+    if (!csv->field_pool || !csv->records || !csv->column_widths || (has_header && !csv->header))
+        goto invalid;
+
+    for (uint64_t i = 0; i < hdr->cells; i++) {
+        if (offsets[i] >= hdr->strings_len)
+            goto invalid;
+        csv->field_pool[i] = strings + offsets[i];
+    }
+
+    if (row_starts[0] != 0 || row_starts[rows] != hdr->cells)
+        goto invalid;
+    for (int r = 0; r < rows; r++) {
+        uint64_t start = row_starts[r];
+        uint64_t count = row_starts[r + 1] - start;
+        if (row_starts[r + 1] < start || count > hdr->columns)
+            goto invalid;
+
+        struct csv_record *record;
+        if (has_header && r == 0)
+            record = csv->header;
+        else
+            record = &csv->records[csv->record_count++];
+        record->fields      = csv->field_pool + start;
+        record->widths      = widths + start;
+        record->field_count = (int)count;
+    }
+
+    csv->record_capacity = csv->record_count;
+    csv->max_columns     = (int)hdr->columns;
+    image_column_widths(csv, hdr, base, args->sniff);
+    csv_data_finish(csv, args->number);
+    return 0;
+
+invalid:
+    free_csv_data(csv);
+    return -1;
+}
+
+static int write_all(FILE *fp, const void *data, size_t len)
+{
+    return fwrite(data, 1, len, fp) == len ? 0 : -1;
+}
+
+static int write_padding(FILE *fp, size_t len)
+{
+    static const char zeros[8] = {0};
+    return write_all(fp, zeros, align8(len) - len);
+}
+
+static const struct csv_record *image_row(const struct csv_data *csv, int r)
+{
+    if (csv->header)
+        return r == 0 ? csv->header : &csv->records[r - 1];
+    return &csv->records[r];
+}
+
+static int write_image(FILE *fp, const struct cache_key *key, const struct csv_data *csv)
+{
+    struct cache_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version    = CACHE_VERSION;
+    hdr.flags      = key->flags;
+    hdr.dev        = key->dev;
+    hdr.ino        = key->ino;
+    hdr.size       = key->size;
+    hdr.mtime_sec  = key->mtime_sec;
+    hdr.mtime_nsec = key->mtime_nsec;
+    hdr.delimiter  = key->delimiter;
+
+    int rows = csv->record_count + (csv->header ? 1 : 0);
+    for (int r = 0; r < rows; r++) {
+        const struct csv_record *record = image_row(csv, r);
+        hdr.cells += (uint64_t)record->field_count;
+        if ((uint32_t)record->field_count > hdr.columns)
+            hdr.columns = (uint32_t)record->field_count;
+        for (int i = 0; i < record->field_count; i++) {
+            hdr.strings_len += strlen(record->fields[i]) + 1;
+        }
+    }
+    if (hdr.strings_len == 0)
+        hdr.strings_len = 1;
+
+    hdr.rows        = (uint64_t)rows;
+    hdr.row_starts  = align8(sizeof(hdr));
+    hdr.offsets     = hdr.row_starts + (hdr.rows + 1) * 8;
+    hdr.widths      = hdr.offsets + hdr.cells * 8;
+    hdr.histograms  = hdr.widths + align8(hdr.cells * 4);
+    hdr.max_widths  = hdr.histograms + (uint64_t)hdr.columns * WIDTH_BUCKETS * 4;
+    hdr.strings     = hdr.max_widths + align8((uint64_t)hdr.columns * 4);
+    hdr.image_size  = hdr.strings + align8(hdr.strings_len);
+
+    uint32_t *histograms = calloc((size_t)hdr.columns * WIDTH_BUCKETS + 1, sizeof(uint32_t));
+    uint32_t *max_widths = calloc((size_t)hdr.columns + 1, sizeof(uint32_t));
+    int       ret        = (histograms && max_widths) ? 0 : -1;
+
+    if (ret == 0)
+        ret = write_all(fp, &hdr, sizeof(hdr)) | write_padding(fp, sizeof(hdr));
+
+    uint64_t cell = 0;
+    for (int r = 0; r < rows && ret == 0; r++) {
+        ret = write_all(fp, &cell, sizeof(cell));
+        cell += (uint64_t)image_row(csv, r)->field_count;
+    }
+    if (ret == 0)
+        ret = write_all(fp, &cell, sizeof(cell));
+
+    uint64_t offset = 0;
+    for (int r = 0; r < rows && ret == 0; r++) {
+        const struct csv_record *record = image_row(csv, r);
+        for (int i = 0; i < record->field_count && ret == 0; i++) {
+            ret = write_all(fp, &offset, sizeof(offset));
+            offset += strlen(record->fields[i]) + 1;
+        }
+    }
+
+    // Every cell is measured once here so later renders never call into libunistring
+    for (int r = 0; r < rows && ret == 0; r++) {
+        const struct csv_record *record = image_row(csv, r);
+        bool                     data   = !(csv->header && r == 0);
+        for (int i = 0; i < record->field_count && ret == 0; i++) {
+            const struct csv_dict *dict  = data ? csv->dict : NULL;
+            uint32_t               width = (uint32_t)intern_cell_width(dict, i, record->fields[i]);
+            ret                          = write_all(fp, &width, sizeof(width));
+            if (data) {
+                uint32_t bucket = width < WIDTH_BUCKETS - 1 ? width : WIDTH_BUCKETS - 1;
+                histograms[(size_t)i * WIDTH_BUCKETS + bucket]++;
+                if (width > max_widths[i])
+                    max_widths[i] = width;
+            }
+        }
+    }
+    if (ret == 0)
+        ret = write_padding(fp, hdr.cells * 4);
+
+    if (ret == 0)
+        ret = write_all(fp, histograms, (size_t)hdr.columns * WIDTH_BUCKETS * sizeof(uint32_t));
+    if (ret == 0)
+        ret = write_all(fp, max_widths, (size_t)hdr.columns * sizeof(uint32_t)) |
+              write_padding(fp, (size_t)hdr.columns * 4);
+
+    size_t written = 0;
+    for (int r = 0; r < rows && ret == 0; r++) {
+        const struct csv_record *record = image_row(csv, r);
+        for (int i = 0; i < record->field_count && ret == 0; i++) {
+            size_t len = strlen(record->fields[i]) + 1;
+            ret        = write_all(fp, record->fields[i], len);
+            written += len;
+        }
+    }
+    if (ret == 0 && written == 0)
+        ret = write_all(fp, "", 1);
+    if (ret == 0)
+        ret = write_padding(fp, hdr.strings_len);
+
+    free(histograms);
+    free(max_widths);
+    return ret;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+    const struct cache_entry *x = a;
+    const struct cache_entry *y = b;
+    return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+
+// Drop least recently used images until the directory fits the size cap
+static void cache_evict(const char *dir)
+{
+    size_t      cap = CACHE_DEFAULT_MAX;
+    const char *max = getenv("CSVIEW_CACHE_MAX");
+    if (max && parse_size(max, &cap) != 0)
+        cap = CACHE_DEFAULT_MAX;
+
+    DIR *d = opendir(dir);
+    if (!d)
+        return;
+
+    struct cache_entry *entries = NULL;
+    size_t              count = 0, capacity = 0, total = 0;
+    struct dirent      *ent;
+    char                path[CACHE_PATH_MAX];
+
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len <= strlen(CACHE_SUFFIX) || len >= sizeof(entries->name) ||
+            strcmp(ent->d_name + len - strlen(CACHE_SUFFIX), CACHE_SUFFIX) != 0)
+            continue;
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) != 0)
+            continue;
+
+        if (count == capacity) {
+            capacity                 = capacity ? capacity * 2 : 32;
+            struct cache_entry *grown = realloc(entries, capacity * sizeof(*entries));
+            if (!grown)
+                break;
+            entries = grown;
+        }
+        memcpy(entries[count].name, ent->d_name, len + 1);
+        entries[count].size  = st.st_size;
+        entries[count].mtime = st.st_mtime;
+        total += (size_t)st.st_size;
+        count++;
+    }
+    closedir(d);
+
+    qsort(entries, count, sizeof(*entries), compare_entries);
+    for (size_t i = 0; i < count && total > cap; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, entries[i].name);
+        if (unlink(path) == 0)
+            total -= (size_t)entries[i].size;
+    }
+    free(entries);
+}
+
+static void cache_store(const char             *dir,
+                        const char             *path,
+                        const struct cache_key *key,
+                        const struct csv_data  *csv)
+{
+    // A file that could still change under the same mtime is not worth caching yet
+    if (recently_modified(key->mtime_sec))
+        return;
+
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST)
+        return;
+
+    char tmp[CACHE_PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s/.csview-XXXXXX", dir) >= (int)sizeof(tmp))
+        return;
+    int fd = mkstemp(tmp);
+    if (fd < 0)
+        return;
+
+    FILE *fp     = fdopen(fd, "wb");
+    char *io_buf = malloc(CACHE_IO_BUFFER);
+    if (!fp) {
+        close(fd);
+        unlink(tmp);
+        free(io_buf);
+        return;
+    }
+    if (io_buf)
+        setvbuf(fp, io_buf, _IOFBF, CACHE_IO_BUFFER);
+
+    int ret = write_image(fp, key, csv);
+    if (fclose(fp) != 0)
+        ret = -1;
+    free(io_buf);
+
+    // Publish atomically so readers never see a partial image
+    if (ret != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return;
+    }
+
+    cache_evict(dir);
+}
+
+int load_table(FILE *input, struct csv_data *csv, const struct cli_args *args)
+{
+    const char *dir = getenv("CSVIEW_CACHE_DIR");
+    struct stat st;
+
+    if (!dir || !*dir || !args->file || fstat(fileno(input), &st) != 0 || !S_ISREG(st.st_mode))
+        return parse_csv(input, csv, *args);
+
+    struct cache_key key;
+    memset(&key, 0, sizeof(key));
+    key.dev        = (uint64_t)st.st_dev;
+    key.ino        = (uint64_t)st.st_ino;
+    key.size       = (uint64_t)st.st_size;
+    key.mtime_sec  = (int64_t)st.st_mtim.tv_sec;
+    key.mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    key.delimiter  = (uint32_t)(unsigned char)(args->tsv ? '\t' : args->delimiter);
+    key.flags      = args->no_headers ? 0 : CACHE_FLAG_HEADER;
+
+    char               path[CACHE_PATH_MAX];
+    unsigned long long hash = (unsigned long long)hash_key(&key);
+    if (snprintf(path, sizeof(path), "%s/%016llx%s", dir, hash, CACHE_SUFFIX) >= (int)sizeof(path))
+        return parse_csv(input, csv, *args);
+
+    if (cache_lookup(path, &key, csv, args) == 0)
+        return 0;
+
+    int ret = parse_csv(input, csv, *args);
+    if (ret == 0 && !csv->spill)
+        cache_store(dir, path, &key, csv);
+    return ret;
+}
\ No newline at end of file
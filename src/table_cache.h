@@ -0,0 +1,15 @@
+#ifndef TABLE_CACHE_H
+#define TABLE_CACHE_H
+
+#include <stdio.h>
+
+#include "cli.h"
+#include "csv_parser.h"
+
+// Parse the input into a table, going through the persistent cache in
+// $CSVIEW_CACHE_DIR when it is set and the input is a regular file. Cache
+// entries are keyed by device, inode, size and mtime plus the parse options,
+// so a modified file is never served from a stale image.
+int load_table(FILE *input, struct csv_data *csv, const struct cli_args *args);
+
+#endif  // TABLE_CACHE_H
\ No newline at end of file
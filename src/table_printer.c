@@ -2,9 +2,23 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "column_view.h"
+#include "grep.h"
+#include "intern.h"
+#include "parallel.h"
+#include "progress.h"
+#include "spill.h"
 #include "table_printer.h"
 #include "utils.h"
 
+#define ROWS_PER_BLOCK     2048     // Rows a worker renders per round
+#define RENDER_BUFFER_SIZE (1 << 18)
+#define MID_LINE_SIZE      256  // Grows for wide tables
+#define HIGHLIGHT_ON       "\x1b[1;31m"
+#define HIGHLIGHT_OFF      "\x1b[0m"
+#define VERTICAL_RULE      24  // Rule length over the unmeasured value column
+#define ELLIPSIS           "\xe2\x80\xa6"
+
 static row_sep_t *create_row_sep(const char *inner,
                                  const char *ljunc,
                                  const char *cjunc,
@@ -39,10 +53,13 @@ table_format_t *create_table_style(table_style_t style_type,
     if (!style)
         return NULL;
 
-    style->padding      = padding;
-    style->indent       = indent;
-    style->header_align = header_align;
-    style->body_align   = body_align;
+    style->padding       = padding;
+    style->indent        = indent;
+    style->header_align  = header_align;
+    style->body_align    = body_align;
+    style->highlight     = NULL;
+    style->highlight_col = -1;
+    style->ascii         = false;
 
     // Initialize row separators to NULL
     style->row_seps.top = NULL;
@@ -167,43 +184,63 @@ void free_table_style(table_format_t *style)
     }
 }
 
-static char *calc_pad(const char *str, int width, int align, bool truncate)
+// Escape codes wrap each match, they take no columns so padding is unaffected
+static void put_highlighted(struct out_buf            *out,
+                            const char                *str,
+                            size_t                     len,
+                            const struct grep_matcher *highlight)
 {
-    if (!str)
-        return NULL;
+    size_t pos = 0, start, end;
+    while (highlight && grep_find(highlight, str, len, pos, &start, &end) && end > start) {
+        out_buf_write(out, str + pos, start - pos);
+        out_buf_puts(out, HIGHLIGHT_ON);
+        out_buf_write(out, str + start, end - start);
+        out_buf_puts(out, HIGHLIGHT_OFF);
+        pos = end;
+    }
+    out_buf_write(out, str + pos, len - pos);
+}
 
-    int str_width = unicode_display_width(str);
+// Write str padded to the column width; a negative str_width means it has not been measured yet
+static void put_padded(struct out_buf            *out,
+                       const char                *str,
+                       int                        str_width,
+                       int                        width,
+                       alignment_t                align,
+                       bool                       truncate,
+                       const struct grep_matcher *highlight)
+{
+    if (str_width < 0)
+        str_width = unicode_display_width(str);
+
+    size_t str_bytes = strlen(str);
 
     // If string is already wider than target width and truncate is enabled
     if (truncate && str_width > width) {
         // Simple byte-based truncation for now
         // TODO: Could use libunistring's uc_truncate for proper Unicode truncation
-        size_t max_bytes = width < (int)strlen(str) ? (size_t)width : strlen(str);
-        char  *result    = malloc(max_bytes + 1);
-        if (!result)
-            return NULL;
-        strncpy(result, str, max_bytes);
-        result[max_bytes] = '\0';
-        return result;
+        out_buf_write(out, str, width < (int)str_bytes ? (size_t)width : str_bytes);
+        return;
     }
 
     if (str_width >= width) {
-        return strdup(str);
+        put_highlighted(out, str, str_bytes, highlight);
+        return;
     }
 
     int padding = width - str_width;
     int left_pad, right_pad;
 
     switch (align) {
-        case 0:  // Left
+        case ALIGN_LEFT:
             left_pad  = 0;
             right_pad = padding;
             break;
-        case 1:  // Center
+        case ALIGN_CENTER:
             left_pad  = padding / 2;
             right_pad = padding - left_pad;
             break;
-        case 2:  // Right
+        case ALIGN_RIGHT:
             left_pad  = padding;
             right_pad = 0;
             break;
@@ -213,36 +250,33 @@ static char *calc_pad(const char *str, int width, int align, bool truncate)
             break;
     }
 
-    // Calculate required buffer size: string bytes + padding spaces + null terminator
-    size_t str_bytes  = strlen(str);
-    size_t total_size = str_bytes + (size_t)left_pad + (size_t)right_pad + 1;
-
-    char *result = malloc(total_size);
-    if (!result)
-        return NULL;
-
-    char *p = result;
-
-    // Add left padding
-    for (int i = 0; i < left_pad; i++) {
-        *p++ = ' ';
-    }
-
-    // Add string
-    strcpy(p, str);
-    p += str_bytes;
+    out_buf_fill(out, ' ', (size_t)left_pad);
+    put_highlighted(out, str, str_bytes, highlight);
+    out_buf_fill(out, ' ', (size_t)right_pad);
+}
 
-    // Add right padding
-    for (int i = 0; i < right_pad; i++) {
-        *p++ = ' ';
+// Write str cut to the width of a column narrowed by --fit, marking the cut with an ellipsis
+static void put_clipped(struct out_buf *out,
+                        const char     *str,
+                        int             str_width,
+                        int             width,
+                        alignment_t     align)
+{
+    if (str_width < 0)
+        str_width = unicode_display_width(str);
+    if (str_width <= width) {
+        put_padded(out, str, str_width, width, align, true, NULL);
+        return;
     }
 
-    *p = '\0';
-
-    return result;
+    int    used;
+    size_t bytes = unicode_truncate(str, width - 1, &used);
+    out_buf_write(out, str, bytes);
+    out_buf_puts(out, ELLIPSIS);
+    out_buf_fill(out, ' ', (size_t)(width - 1 - used));
 }
 
-static void print_row_separator(FILE           *output,
+static void print_row_separator(struct out_buf *out,
                                 table_format_t *style,
                                 int            *widths,
                                 int             col_count,
@@ -252,105 +286,385 @@ static void print_row_separator(FILE           *output,
         return;
 
     // Print indent
-    for (int i = 0; i < style->indent; i++) {
-        fputc(' ', output);
-    }
+    out_buf_fill(out, ' ', (size_t)style->indent);
 
     // Print left junction
     if (style->col_seps.lhs) {
-        fputs(sep->ljunc, output);
+        out_buf_puts(out, sep->ljunc);
     }
 
     // Print column separators
     for (int i = 0; i < col_count; i++) {
         for (int j = 0; j < widths[i] + style->padding * 2; j++) {
-            fputs(sep->inner, output);
+            out_buf_puts(out, sep->inner);
         }
         if (style->col_seps.mid && i < col_count - 1) {
-            fputs(sep->cjunc, output);
+            out_buf_puts(out, sep->cjunc);
         }
     }
 
     // Print right junction
     if (style->col_seps.rhs) {
-        fputs(sep->rjunc, output);
+        out_buf_puts(out, sep->rjunc);
     }
 
-    fputc('\n', output);
+    out_buf_putc(out, '\n');
 }
 
-static void print_row(FILE           *output,
-                      table_format_t *style,
-                      char          **fields,
-                      int             field_count,
-                      int            *widths,
-                      int             col_count,
-                      alignment_t     align,
-                      int             row_number)
+static void print_row(struct out_buf            *out,
+                      table_format_t            *style,
+                      char                     **fields,
+                      int                        field_count,
+                      const int                 *cell_widths,
+                      const struct column_view  *view,
+                      alignment_t                align,
+                      int                        row_number,
+                      const struct grep_matcher *highlight,
+                      const struct csv_dict     *dict)
 {
     // Print indent
-    for (int i = 0; i < style->indent; i++) {
-        fputc(' ', output);
-    }
+    out_buf_fill(out, ' ', (size_t)style->indent);
 
     // Print left border
     if (style->col_seps.lhs) {
-        fputs(style->col_seps.lhs, output);
+        out_buf_puts(out, style->col_seps.lhs);
     }
 
     // Print cells
-    for (int i = 0; i < col_count; i++) {
+    for (int i = 0; i < view->count; i++) {
         // Print padding
-        for (int j = 0; j < style->padding; j++) {
-            fputc(' ', output);
-        }
+        out_buf_fill(out, ' ', (size_t)style->padding);
 
         // Get field content
-        char *content;
-        if (i == 0 && row_number != 0) {
-            // Sequence number column
+        const char                *content;
+        int                        content_width = -1;
+        char                       seq[20];
+        const struct grep_matcher *matches       = NULL;
+        int                        field_index   = view->fields[i];
+        if (field_index < 0) {
+            // Sequence number column, "#" on the header row
             if (row_number == -1) {
-                // Header row with sequence numbers
-                content = strdup("#");
+                content = "#";
             } else {
-                // Data row with sequence numbers
-                content = malloc(20);
-                snprintf(content, 20, "%d", row_number);
+                snprintf(seq, sizeof(seq), "%d", row_number);
+                content = seq;
             }
         } else {
-            int field_index = (row_number != 0) ? i - 1 : i;
-            if (field_index >= 0 && field_index < field_count && fields[field_index]) {
-                content = strdup(fields[field_index]);
+            if (field_index < field_count && fields[field_index]) {
+                content = fields[field_index];
+                if (cell_widths)
+                    content_width = cell_widths[field_index];
+                else if (intern_active(dict, field_index))
+                    content_width = intern_width(content);
+                else if (style->ascii)
+                    content_width = ascii_display_width(content);
+                if (style->highlight_col < 0 || style->highlight_col == field_index)
+                    matches = highlight;
             } else {
-                content = strdup("");
+                content = "";
             }
         }
 
         // Pad content to column width
-        char *padded = calc_pad(content, widths[i], align, true);
-        if (padded) {
-            fputs(padded, output);
-            free(padded);
-        }
-        free(content);
+        if (i == view->clipped)
+            put_clipped(out, content, content_width, view->widths[i], align);
+        else
+            put_padded(out, content, content_width, view->widths[i], align, true, matches);
 
         // Print padding
-        for (int j = 0; j < style->padding; j++) {
-            fputc(' ', output);
-        }
+        out_buf_fill(out, ' ', (size_t)style->padding);
 
         // Print column separator
-        if (style->col_seps.mid && i < col_count - 1) {
-            fputs(style->col_seps.mid, output);
+        if (style->col_seps.mid && i < view->count - 1) {
+            out_buf_puts(out, style->col_seps.mid);
         }
     }
 
     // Print right border
     if (style->col_seps.rhs) {
-        fputs(style->col_seps.rhs, output);
+        out_buf_puts(out, style->col_seps.rhs);
+    }
+
+    out_buf_putc(out, '\n');
+}
+
+// Body rows of one table, formatted by the row_formatter_fn picked for it
+struct body_format {
+    table_format_t           *style;
+    const struct column_view *view;
+    const struct csv_dict    *dict;
+    const long               *numbers;  // As in csv_data, NULL for 1, 2, ...
+    bool                      number;
+};
+
+static inline long record_number(const struct body_format *body, long index)
+{
+    return body->numbers ? body->numbers[index] : index + 1;
+}
+
+typedef void (*row_formatter_fn)(struct out_buf           *out,
+                                 const struct body_format *body,
+                                 char                    **fields,
+                                 int                       field_count,
+                                 const int                *cell_widths,
+                                 long                      index);
+
+// Any style, alignment, highlighting and clipped column
+static void format_any_row(struct out_buf           *out,
+                           const struct body_format *body,
+                           char                    **fields,
+                           int                       field_count,
+                           const int                *cell_widths,
+                           long                      index)
+{
+    print_row(out,
+              body->style,
+              fields,
+              field_count,
+              cell_widths,
+              body->view,
+              body->style->body_align,
+              body->number ? (int)record_number(body, index) : 0,
+              body->style->highlight,
+              body->dict);
+}
+
+// One cell with its padding; the alignment is a constant wherever this is
+// inlined, and the cell and column padding go out in one fill on each side.
+// Cells wider than the column are cut to its width in bytes as in put_padded.
+static inline void put_cell(struct out_buf *out,
+                            const char     *str,
+                            int             str_width,
+                            int             width,
+                            size_t          padding,
+                            alignment_t     align)
+{
+    size_t str_bytes = strlen(str);
+    if (str_width < 0)
+        str_width = unicode_display_width(str);
+    if (str_width > width) {
+        out_buf_fill(out, ' ', padding);
+        out_buf_write(out, str, width < (int)str_bytes ? (size_t)width : str_bytes);
+        out_buf_fill(out, ' ', padding);
+        return;
+    }
+
+    int slack = width - str_width;
+    int left  = align == ALIGN_RIGHT ? slack : align == ALIGN_CENTER ? slack / 2 : 0;
+    out_buf_fill(out, ' ', padding + (size_t)left);
+    out_buf_write(out, str, str_bytes);
+    out_buf_fill(out, ' ', padding + (size_t)(slack - left));
+}
+
+static inline void put_field_cell(struct out_buf           *out,
+                                  const struct body_format *body,
+                                  char                    **fields,
+                                  int                       field_count,
+                                  const int                *cell_widths,
+                                  int                       column,
+                                  alignment_t               align)
+{
+    const char *content = "";
+    int         width   = -1;
+    int         field   = body->view->fields[column];
+    if (field < field_count && fields[field]) {
+        content = fields[field];
+        if (cell_widths)
+            width = cell_widths[field];
+        else if (intern_active(body->dict, field))
+            width = intern_width(content);
+        else if (body->style->ascii)
+            width = ascii_display_width(content);
+    }
+    put_cell(out, content, width, body->view->widths[column], (size_t)body->style->padding, align);
+}
+
+// The record number of a numbered row, "%ld" without the printf machinery
+static inline void put_seq_cell(struct out_buf           *out,
+                                const struct body_format *body,
+                                long                      number,
+                                alignment_t               align)
+{
+    char  digits[24];
+    char *p = digits + sizeof(digits);
+    *--p    = '\0';
+    do {
+        *--p = (char)('0' + number % 10);
+        number /= 10;
+    } while (number > 0);
+    put_cell(out,
+             p,
+             (int)(digits + sizeof(digits) - 1 - p),
+             body->view->widths[0],
+             (size_t)body->style->padding,
+             align);
+}
+
+// Column separators of the styles: name, left border, column separator and
+// right border, empty where the style has none
+#define COLUMN_SEPARATORS(X)  \
+    X(bare, "", "", "")       \
+    X(pipe, "|", "|", "|")    \
+    X(spaced, " ", "|", " ")  \
+    X(box, "│", "│", "│")
+
+// A body row formatter for one separator set, alignment and numbering. The
+// separators are literals and align and NUMBERED are constants, so the
+// compiler drops every per-cell style test of print_row. Only rows of
+// unclipped, unhighlighted views with at least one column come here.
+#define DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, name, ALIGN, NUMBERED)                   \
+    static void format_##seps##_##name##_##NUMBERED(struct out_buf           *out,         \
+                                                    const struct body_format *body,        \
+                                                    char                    **fields,      \
+                                                    int                       field_count, \
+                                                    const int                *cell_widths, \
+                                                    long                      index)       \
+    {                                                                                      \
+        out_buf_fill(out, ' ', (size_t)body->style->indent);                               \
+        if (sizeof(LHS) > 1)                                                               \
+            out_buf_write(out, LHS, sizeof(LHS) - 1);                                      \
+        if (NUMBERED)                                                                      \
+            put_seq_cell(out, body, record_number(body, index), ALIGN);                    \
+        else                                                                               \
+            put_field_cell(out, body, fields, field_count, cell_widths, 0, ALIGN);         \
+        for (int i = 1; i < body->view->count; i++) {                                      \
+            if (sizeof(MID) > 1)                                                           \
+                out_buf_write(out, MID, sizeof(MID) - 1);                                  \
+            put_field_cell(out, body, fields, field_count, cell_widths, i, ALIGN);         \
+        }                                                                                  \
+        if (sizeof(RHS) > 1)                                                               \
+            out_buf_write(out, RHS, sizeof(RHS) - 1);                                      \
+        out_buf_putc(out, '\n');                                                           \
+    }
+
+#define DEFINE_ROW_FORMATTERS(seps, LHS, MID, RHS)                        \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, left, ALIGN_LEFT, 0)        \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, left, ALIGN_LEFT, 1)        \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, center, ALIGN_CENTER, 0)    \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, center, ALIGN_CENTER, 1)    \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, right, ALIGN_RIGHT, 0)      \
+    DEFINE_ROW_FORMATTER(seps, LHS, MID, RHS, right, ALIGN_RIGHT, 1)
+
+COLUMN_SEPARATORS(DEFINE_ROW_FORMATTERS)
+
+struct row_formatters {
+    const char      *lhs;
+    const char      *mid;
+    const char      *rhs;
+    row_formatter_fn format[3][2];  // By body alignment, then numbering
+};
+
+#define ROW_FORMATTER_ENTRY(seps, LHS, MID, RHS)                      \
+    {LHS,                                                             \
+     MID,                                                             \
+     RHS,                                                             \
+     {{format_##seps##_left_0, format_##seps##_left_1},               \
+      {format_##seps##_center_0, format_##seps##_center_1},           \
+      {format_##seps##_right_0, format_##seps##_right_1}}},
+
+static const struct row_formatters row_formatters[] = {COLUMN_SEPARATORS(ROW_FORMATTER_ENTRY)};
+
+static bool same_separator(const char *literal, const char *sep)
+{
+    return sep ? strcmp(literal, sep) == 0 : *literal == '\0';
+}
+
+// Pick the body row formatter once per table
+static row_formatter_fn select_row_formatter(const table_format_t     *style,
+                                             const struct column_view *view)
+{
+    if (style->highlight || view->clipped >= 0 || view->count == 0 ||
+        style->body_align > ALIGN_RIGHT)
+        return format_any_row;
+
+    for (size_t i = 0; i < sizeof(row_formatters) / sizeof(row_formatters[0]); i++) {
+        const struct row_formatters *set = &row_formatters[i];
+        if (same_separator(set->lhs, style->col_seps.lhs) &&
+            same_separator(set->mid, style->col_seps.mid) &&
+            same_separator(set->rhs, style->col_seps.rhs))
+            return set->format[style->body_align][view->fields[0] < 0];
+    }
+    return format_any_row;
+}
+
+struct render_task {
+    struct body_format body;
+    row_formatter_fn   format;
+    const char        *mid_line;  // Middle separator rendered once, NULL if the style has none
+    size_t             mid_len;
+    struct csv_data   *csv;
+    struct out_buf    *bufs;   // One output buffer per worker
+    long               first;  // Index of the first row to draw
+    long               base;   // Index of the first row of the current round
+    long               total;  // Rows from here on are not drawn
+};
+
+static void print_body_row(struct out_buf           *out,
+                           const struct render_task *task,
+                           char                    **fields,
+                           int                       field_count,
+                           const int                *cell_widths,
+                           long                      index)
+{
+    task->format(out, &task->body, fields, field_count, cell_widths, index);
+
+    // Print middle separator if needed
+    if (task->mid_line && index < task->total - 1)
+        out_buf_write(out, task->mid_line, task->mid_len);
+}
+
+static void render_rows(void *ctx, long begin, long end, int worker)
+{
+    struct render_task *task = ctx;
+
+    for (long i = task->base + begin; i < task->base + end; i++) {
+        struct csv_record *record = &task->csv->records[i];
+        print_body_row(
+            &task->bufs[worker], task, record->fields, record->field_count, record->widths, i);
     }
+}
 
-    fputc('\n', output);
+// Format in-memory rows in rounds: each worker renders a contiguous block into
+// its own buffer, then the buffers are written out in order, so the output is
+// identical to a serial render
+static int render_records(struct out_buf *out, struct render_task *task, int threads)
+{
+    struct out_buf *bufs = NULL;
+    if (threads > 1)
+        bufs = calloc((size_t)threads, sizeof(struct out_buf));
+    for (int w = 0; bufs && w < threads; w++) {
+        if (out_buf_init(&bufs[w], NULL, RENDER_BUFFER_SIZE) != 0) {
+            for (int j = 0; j < w; j++) {
+                out_buf_free(&bufs[j]);
+            }
+            free(bufs);
+            bufs = NULL;
+        }
+    }
+    if (!bufs)
+        threads = 1;
+
+    long count = task->csv->record_count < task->total ? task->csv->record_count : task->total;
+    long round = threads > 1 ? (long)threads * ROWS_PER_BLOCK : count;
+    int  ret   = 0;
+
+    task->bufs = bufs ? bufs : out;
+    for (task->base = task->first; task->base < count && ret == 0; task->base += round) {
+        long rows = count - task->base < round ? count - task->base : round;
+        parallel_for(threads, rows, render_rows, task);
+
+        for (int w = 0; bufs && w < threads; w++) {
+            if (bufs[w].error || out_buf_write(out, bufs[w].data, bufs[w].len) != 0)
+                ret = -1;
+            bufs[w].len = 0;
+        }
+    }
+
+    for (int w = 0; bufs && w < threads; w++) {
+        out_buf_free(&bufs[w]);
+    }
+    free(bufs);
+    return ret;
 }
 
 int print_table(struct csv_data *csv, struct cli_args *args)
@@ -358,83 +672,245 @@ int print_table(struct csv_data *csv, struct cli_args *args)
     if (!csv)
         return -1;
 
+    // Parsing is over, the status line must not end up inside the table
+    progress_stop();
+
     table_format_t *style = create_table_style(
         args->style, args->padding, args->indent, args->header_align, args->body_align);
     if (!style)
         return -1;
 
-    FILE *output = stdout;
+    style->ascii = csv->ascii;
+
+    // Only the columns in view are measured and formatted from here on
+    struct column_view view;
+    if (column_view_init(&view, csv, args, style) != 0) {
+        free_table_style(style);
+        return -1;
+    }
+
+    struct out_buf out;
+    if (out_buf_init(&out, args->output, OUT_BUF_SIZE) != 0) {
+        column_view_free(&view);
+        free_table_style(style);
+        return -1;
+    }
+
+    // Highlighting only adds escape codes, column widths stay those of the plain text
+    struct grep_matcher matcher;
+    bool                highlight = args->grep && args->highlight;
+    if (highlight && grep_matcher_init(&matcher, args) == 0) {
+        style->highlight = &matcher;
+        if (args->grep_col && csv->header) {
+            const char *const *names = (const char *const *)csv->header->fields;
+            style->highlight_col = resolve_column(args->grep_col, names, csv->header->field_count);
+        } else if (args->grep_col) {
+            style->highlight_col = resolve_column(args->grep_col, NULL, 0);
+        }
+    } else {
+        highlight = false;
+    }
+
+    // --rows narrows the drawn records, widths and numbering stay those of the whole table
+    long total = csv_data_total_records(csv);
+    long first = args->rows_from < total ? args->rows_from : total;
+    long end   = args->rows_to < total ? args->rows_to : total;
+    int  ret   = 0;
 
     // Print top border
-    print_row_separator(output, style, csv->column_widths, csv->max_columns, style->row_seps.top);
+    print_row_separator(&out, style, view.widths, view.count, style->row_seps.top);
 
     // Print header
     if (csv->header) {
-        char **header_fields      = csv->header->fields;
-        int    header_field_count = csv->header->field_count;
-
-        // Add sequence header if needed
-        if (args->number) {
-            print_row(output,
-                      style,
-                      header_fields,
-                      header_field_count,
-                      csv->column_widths,
-                      csv->max_columns,
-                      style->header_align,
-                      -1);
-        } else {
-            print_row(output,
-                      style,
-                      header_fields,
-                      header_field_count,
-                      csv->column_widths,
-                      csv->max_columns,
-                      style->header_align,
-                      0);
-        }
+        print_row(&out,
+                  style,
+                  csv->header->fields,
+                  csv->header->field_count,
+                  csv->header->widths,
+                  &view,
+                  style->header_align,
+                  args->number ? -1 : 0,
+                  NULL,
+                  NULL);
 
         // Print header separator
-        if (csv->record_count > 0) {
-            print_row_separator(
-                output, style, csv->column_widths, csv->max_columns, style->row_seps.snd);
+        if (end > first) {
+            print_row_separator(&out, style, view.widths, view.count, style->row_seps.snd);
         }
     }
 
-    // Print data rows
-    for (int i = 0; i < csv->record_count; i++) {
-        struct csv_record *record = &csv->records[i];
-
-        if (args->number) {
-            print_row(output,
-                      style,
-                      record->fields,
-                      record->field_count,
-                      csv->column_widths,
-                      csv->max_columns,
-                      style->body_align,
-                      i + 1);
-        } else {
-            print_row(output,
-                      style,
-                      record->fields,
-                      record->field_count,
-                      csv->column_widths,
-                      csv->max_columns,
-                      style->body_align,
-                      0);
+    // Print data rows held in memory. The row formatter is picked and the
+    // middle separator rendered once, not per row.
+    struct out_buf mid_line;
+    if (out_buf_init(&mid_line, NULL, MID_LINE_SIZE) == 0)
+        print_row_separator(&mid_line, style, view.widths, view.count, style->row_seps.mid);
+    else
+        ret = -1;
+
+    struct render_task task = {
+        .body     = {.style   = style,
+                     .view    = &view,
+                     .dict    = csv->dict,
+                     .numbers = csv->numbers,
+                     .number  = args->number},
+        .format   = select_row_formatter(style, &view),
+        .mid_line = mid_line.len > 0 ? mid_line.data : NULL,
+        .mid_len  = mid_line.len,
+        .csv      = csv,
+        .first    = first,
+        .total    = end};
+    int threads = parallel_threads(args->threads, end - first, ROWS_PER_BLOCK);
+    if (ret == 0)
+        ret = render_records(&out, &task, threads);
+
+    // Stream back records spilled past the memory budget, widths were measured at parse time
+    if (csv->spill && end > csv->record_count && ret == 0) {
+        if (spill_rewind(csv->spill) != 0)
+            ret = -1;
+        for (long i = csv->record_count; i < end && ret == 0; i++) {
+            char     **fields;
+            const int *cell_widths;
+            int        field_count;
+            if (spill_read(csv->spill, &fields, &cell_widths, &field_count) != 0) {
+                fprintf(args->errors, "Error reading spilled records\n");
+                ret = -1;
+                break;
+            }
+            if (i < first)
+                continue;
+            print_body_row(&out, &task, fields, field_count, cell_widths, i);
         }
+    }
+
+    // Print bottom border
+    print_row_separator(&out, style, view.widths, view.count, style->row_seps.bot);
+
+    if (out_buf_flush(&out) != 0 && ret == 0)
+        ret = -1;
+    if (highlight)
+        grep_matcher_free(&matcher);
+    out_buf_free(&mid_line);
+    out_buf_free(&out);
+    column_view_free(&view);
+    free_table_style(style);
+    return ret;
+}
 
-        // Print middle separator if needed
-        if (style->row_seps.mid && i < csv->record_count - 1) {
-            print_row_separator(
-                output, style, csv->column_widths, csv->max_columns, style->row_seps.mid);
+struct vertical_state {
+    struct out_buf  out;
+    table_format_t *style;
+    char          **header;
+    int             header_count;
+    int             key_width;
+    bool            number;
+    long            records;
+};
+
+// One "key │ value" line; the value is written as is since it is never measured
+static void print_field_line(struct vertical_state *st, const char *key, const char *value)
+{
+    table_format_t *style = st->style;
+
+    out_buf_fill(&st->out, ' ', (size_t)style->indent);
+    if (style->col_seps.lhs)
+        out_buf_puts(&st->out, style->col_seps.lhs);
+    out_buf_fill(&st->out, ' ', (size_t)style->padding);
+    put_padded(&st->out, key, -1, st->key_width, style->header_align, false, NULL);
+    out_buf_fill(&st->out, ' ', (size_t)style->padding);
+    if (style->col_seps.mid)
+        out_buf_puts(&st->out, style->col_seps.mid);
+    out_buf_fill(&st->out, ' ', (size_t)style->padding);
+    out_buf_puts(&st->out, value);
+    out_buf_putc(&st->out, '\n');
+}
+
+static int vertical_row(const struct csv_row_view *row, void *ctx)
+{
+    struct vertical_state *st = ctx;
+
+    if (row->index < 0) {
+        st->header = calloc((size_t)(row->field_count ? row->field_count : 1), sizeof(char *));
+        if (!st->header)
+            return -1;
+        for (; st->header_count < row->field_count; st->header_count++) {
+            st->header[st->header_count] = strdup(row->fields[st->header_count]);
+            if (!st->header[st->header_count])
+                return -1;
+            int width = unicode_display_width(row->fields[st->header_count]);
+            if (width > st->key_width)
+                st->key_width = width;
         }
+        return 0;
     }
 
-    // Print bottom border
-    print_row_separator(output, style, csv->column_widths, csv->max_columns, style->row_seps.bot);
+    // Fields past the header are keyed by their column number. Blocks already
+    // written keep their width, so a wider key closes their frame and opens a
+    // new one.
+    int widths[2] = {st->key_width, VERTICAL_RULE};
+    int width     = 0;
+    if (row->field_count > st->header_count)
+        width = snprintf(NULL, 0, "%d", row->field_count);
+
+    bool reframe = width > st->key_width;
+    if (reframe) {
+        if (st->records > 0)
+            print_row_separator(&st->out, st->style, widths, 2, st->style->row_seps.bot);
+        st->key_width = widths[0] = width;
+    }
 
-    free_table_style(style);
+    row_sep_t *sep = st->style->row_seps.snd;
+    if (st->records == 0 || reframe)
+        sep = st->style->row_seps.top;
+    if (st->records > 0 && !sep)
+        out_buf_putc(&st->out, '\n');
+    print_row_separator(&st->out, st->style, widths, 2, sep);
+
+    char key[24];
+    if (st->number) {
+        snprintf(key, sizeof(key), "%ld", row->index + 1);
+        print_field_line(st, "#", key);
+    }
+    for (int i = 0; i < row->field_count; i++) {
+        const char *name = key;
+        if (i < st->header_count)
+            name = st->header[i];
+        else
+            snprintf(key, sizeof(key), "%d", i + 1);
+        print_field_line(st, name, row->fields[i]);
+    }
+
+    st->records++;
     return 0;
+}
+
+int print_vertical(FILE *input, struct cli_args *args)
+{
+    table_format_t *style = create_table_style(
+        args->style, args->padding, args->indent, args->header_align, args->body_align);
+    if (!style)
+        return -1;
+
+    // Values are not measured, so blocks stay open on the right
+    table_format_t        open = *style;
+    struct vertical_state st   = {
+          .style = &open, .key_width = args->number ? 1 : 0, .number = args->number};
+    open.col_seps.rhs = NULL;
+
+    int ret = out_buf_init(&st.out, args->output, OUT_BUF_SIZE);
+    if (ret == 0)
+        ret = parse_csv_stream(input, args, vertical_row, &st);
+    if (ret == 0 && st.records > 0) {
+        int widths[2] = {st.key_width, VERTICAL_RULE};
+        print_row_separator(&st.out, &open, widths, 2, open.row_seps.bot);
+    }
+
+    if (out_buf_flush(&st.out) != 0 && ret == 0)
+        ret = -1;
+    out_buf_free(&st.out);
+    for (int i = 0; i < st.header_count; i++) {
+        free(st.header[i]);
+    }
+    free(st.header);
+    free_table_style(style);
+    return ret;
 }
\ No newline at end of file
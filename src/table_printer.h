@@ -1,6 +1,8 @@
 #ifndef TABLE_PRINTER_H
 #define TABLE_PRINTER_H
 
+#include <stdio.h>
+
 #include "cli.h"
 #include "csv_parser.h"
 
@@ -24,16 +26,23 @@ typedef struct {
     char *rhs;  // Right border
 } col_seps_t;
 
+struct grep_matcher;
+
 typedef struct {
-    col_seps_t  col_seps;
-    row_seps_t  row_seps;
-    int         padding;
-    int         indent;
-    alignment_t header_align;
-    alignment_t body_align;
+    col_seps_t                 col_seps;
+    row_seps_t                 row_seps;
+    int                        padding;
+    int                        indent;
+    alignment_t                header_align;
+    alignment_t                body_align;
+    const struct grep_matcher *highlight;      // Matches to emphasize in body cells, or NULL
+    int                        highlight_col;  // Only highlight this field, -1 for all
+    bool                       ascii;          // Cells are likely ASCII, measured a byte per column
 } table_format_t;
 
 int             print_table(struct csv_data *csv, struct cli_args *args);
+// Stream every record as a block of "header: value" lines, nothing is buffered
+int             print_vertical(FILE *input, struct cli_args *args);
 table_format_t *create_table_style(table_style_t style_type,
                                    int           padding,
                                    int           indent,
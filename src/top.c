@@ -0,0 +1,485 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv_scan.h"
+#include "numparse.h"
+#include "parallel.h"
+#include "top.h"
+#include "utils.h"
+
+#define MIN_CHUNK_BYTES (1 << 22)  // Smallest slice of the file worth a thread
+#define CONFIRM_RECORDS 4
+#define RESYNC_LINES    64
+
+struct top_spec {
+    char *column_name;  // Copy of --by without its :num/:desc suffixes
+    int   column;
+    bool  numeric;
+    bool  descending;
+    FILE *errors;
+};
+
+// Sort key of a record; ties keep file order through chunk and index
+struct top_key {
+    double      number;
+    const char *text;
+    size_t      len;
+    bool        is_number;
+    int         chunk;
+    long        index;
+};
+
+// A heap slot owns its copy of the record and reuses the buffers when the
+// slot is handed to a better record
+struct top_entry {
+    struct top_key key;
+    char          *data;  // Fields packed back to back, NUL-terminated
+    size_t         data_cap;
+    const char   **fields;
+    size_t        *lengths;
+    int            field_count;
+    int            field_cap;
+};
+
+// The worst of the kept records sits at the root, ready to be evicted
+struct top_heap {
+    const struct top_spec *spec;
+    struct top_entry      *entries;
+    long                   count;
+    long                   capacity;  // Grows with the records seen, up to want
+    long                   want;
+};
+
+struct top_chunk {
+    const char     *begin;
+    const char     *end;
+    struct top_heap heap;
+    bool            unterminated;
+    int             status;
+};
+
+struct top_state {
+    struct top_spec *spec;
+    struct top_heap *heap;
+    struct csv_data *csv;  // Receives the header, NULL for slices
+    int              chunk;
+};
+
+struct top_job {
+    struct top_spec       *spec;
+    struct top_chunk      *chunks;
+    const struct cli_args *args;
+};
+
+static int parse_spec(struct top_spec *spec, const char *by)
+{
+    spec->column_name = strdup(by);
+    if (!spec->column_name)
+        return -1;
+
+    // Flags are peeled off the end, so column names may contain colons
+    for (;;) {
+        char *colon = strrchr(spec->column_name, ':');
+        if (!colon)
+            break;
+        if (strcmp(colon, ":num") == 0)
+            spec->numeric = true;
+        else if (strcmp(colon, ":desc") == 0)
+            spec->descending = true;
+        else if (strcmp(colon, ":asc") != 0)
+            break;
+        *colon = '\0';
+    }
+    if (*spec->column_name == '\0') {
+        fprintf(spec->errors, "--by needs a column\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int resolve_spec(struct top_spec *spec, const char *const *header, int count)
+{
+    spec->column = resolve_column(spec->column_name, header, count);
+    if (spec->column < 0) {
+        fprintf(spec->errors, "Unknown --by column: %s\n", spec->column_name);
+        return -1;
+    }
+    return 0;
+}
+
+// Numbers come before anything else in numeric order, whichever the direction
+static bool ranks_before(const struct top_spec *spec,
+                         const struct top_key  *a,
+                         const struct top_key  *b)
+{
+    int c;
+    if (spec->numeric && a->is_number != b->is_number)
+        return a->is_number;
+    if (spec->numeric && a->is_number) {
+        c = (a->number > b->number) - (a->number < b->number);
+    } else {
+        c = memcmp(a->text, b->text, a->len < b->len ? a->len : b->len);
+        if (c == 0)
+            c = (a->len > b->len) - (a->len < b->len);
+    }
+    if (spec->descending)
+        c = -c;
+    if (c != 0)
+        return c < 0;
+    if (a->chunk != b->chunk)
+        return a->chunk < b->chunk;
+    return a->index < b->index;
+}
+
+static void make_key(const struct top_spec     *spec,
+                     const struct csv_row_view *row,
+                     int                        chunk,
+                     struct top_key            *key)
+{
+    bool present   = spec->column < row->field_count;
+    key->text      = present ? row->fields[spec->column] : "";
+    key->len       = present ? row->lengths[spec->column] : 0;
+    key->is_number = spec->numeric && parse_number(key->text, key->len, &key->number) != NUM_NONE;
+    key->chunk     = chunk;
+    key->index     = row->index;
+}
+
+static int store_entry(struct top_entry          *entry,
+                       const struct top_spec     *spec,
+                       const struct top_key      *key,
+                       const struct csv_row_view *row)
+{
+    size_t need = 0;
+    for (int i = 0; i < row->field_count; i++) {
+        need += row->lengths[i] + 1;
+    }
+
+    if (need > entry->data_cap) {
+        size_t cap  = entry->data_cap ? entry->data_cap : 256;
+        while (cap < need)
+            cap *= 2;
+        char *data = realloc(entry->data, cap);
+        if (!data)
+            return -1;
+        entry->data     = data;
+        entry->data_cap = cap;
+    }
+    if (row->field_count > entry->field_cap) {
+        const char **fields  = realloc(entry->fields, (size_t)row->field_count * sizeof(char *));
+        if (fields)
+            entry->fields = fields;
+        size_t *lengths = realloc(entry->lengths, (size_t)row->field_count * sizeof(size_t));
+        if (lengths)
+            entry->lengths = lengths;
+        if (!fields || !lengths)
+            return -1;
+        entry->field_cap = row->field_count;
+    }
+
+    char *p = entry->data;
+    for (int i = 0; i < row->field_count; i++) {
+        memcpy(p, row->fields[i], row->lengths[i]);
+        p[row->lengths[i]] = '\0';
+        entry->fields[i]   = p;
+        entry->lengths[i]  = row->lengths[i];
+        p += row->lengths[i] + 1;
+    }
+    entry->field_count = row->field_count;
+
+    // The key text now points into the copy
+    entry->key = *key;
+    if (spec->column < row->field_count)
+        entry->key.text = entry->fields[spec->column];
+    return 0;
+}
+
+static void swap_entries(struct top_entry *a, struct top_entry *b)
+{
+    struct top_entry t = *a;
+    *a                 = *b;
+    *b                 = t;
+}
+
+static void sift_up(struct top_heap *heap, long i)
+{
+    while (i > 0) {
+        long parent = (i - 1) / 2;
+        if (!ranks_before(heap->spec, &heap->entries[parent].key, &heap->entries[i].key))
+            break;
+        swap_entries(&heap->entries[parent], &heap->entries[i]);
+        i = parent;
+    }
+}
+
+static void sift_down(struct top_heap *heap, long i, long count)
+{
+    for (;;) {
+        long worst = i;
+        for (long child = 2 * i + 1; child <= 2 * i + 2 && child < count; child++) {
+            if (ranks_before(heap->spec, &heap->entries[worst].key, &heap->entries[child].key))
+                worst = child;
+        }
+        if (worst == i)
+            break;
+        swap_entries(&heap->entries[worst], &heap->entries[i]);
+        i = worst;
+    }
+}
+
+static int grow_heap(struct top_heap *heap)
+{
+    long capacity = heap->capacity ? heap->capacity * 2 : 64;
+    if (capacity > heap->want)
+        capacity = heap->want;
+
+    struct top_entry *entries = realloc(heap->entries, (size_t)capacity * sizeof(*entries));
+    if (!entries)
+        return -1;
+    memset(&entries[heap->capacity], 0, (size_t)(capacity - heap->capacity) * sizeof(*entries));
+    heap->entries  = entries;
+    heap->capacity = capacity;
+    return 0;
+}
+
+// Copy the record in only when it beats the current worst, rejected rows
+// are never stored
+static int admit(struct top_heap *heap, const struct top_key *key, const struct csv_row_view *row)
+{
+    if (heap->count < heap->want) {
+        if (heap->count == heap->capacity && grow_heap(heap) != 0)
+            return -1;
+        if (store_entry(&heap->entries[heap->count], heap->spec, key, row) != 0)
+            return -1;
+        sift_up(heap, heap->count++);
+        return 0;
+    }
+    if (!ranks_before(heap->spec, key, &heap->entries[0].key))
+        return 0;
+    if (store_entry(&heap->entries[0], heap->spec, key, row) != 0)
+        return -1;
+    sift_down(heap, 0, heap->count);
+    return 0;
+}
+
+// Slots are allocated as records arrive, so a huge NUM costs nothing on a
+// short file
+static int heap_init(struct top_heap *heap, const struct top_spec *spec, long want)
+{
+    heap->spec     = spec;
+    heap->want     = want;
+    heap->count    = 0;
+    heap->capacity = 0;
+    heap->entries  = NULL;
+    return 0;
+}
+
+static void heap_free(struct top_heap *heap)
+{
+    // Slots past count may still hold buffers from a failed store
+    for (long i = 0; i < heap->capacity; i++) {
+        free(heap->entries[i].data);
+        free(heap->entries[i].fields);
+        free(heap->entries[i].lengths);
+    }
+    free(heap->entries);
+    heap->entries  = NULL;
+    heap->capacity = 0;
+}
+
+// Fold a partial heap from a slice into the final one
+static int merge_heap(struct top_heap *into, const struct top_heap *from)
+{
+    for (long i = 0; i < from->count; i++) {
+        const struct top_entry *entry = &from->entries[i];
+        struct csv_row_view     row   = {.fields      = entry->fields,
+                                         .lengths     = entry->lengths,
+                                         .field_count = entry->field_count,
+                                         .index       = entry->key.index};
+        if (admit(into, &entry->key, &row) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int top_row(const struct csv_row_view *row, void *ctx)
+{
+    struct top_state *st = ctx;
+
+    if (row->index < 0) {
+        if (resolve_spec(st->spec, row->fields, row->field_count) != 0)
+            return -1;
+        return csv_data_add(st->csv, row->fields, row->field_count, true) == 0 ? 0 : -1;
+    }
+
+    struct top_key key;
+    make_key(st->spec, row, st->chunk, &key);
+    return admit(st->heap, &key, row);
+}
+
+static void run_chunks(void *ctx, long begin, long end, int worker __attribute__((unused)))
+{
+    struct top_job *job  = ctx;
+    struct cli_args body = *job->args;
+    body.no_headers      = true;
+
+    for (long c = begin; c < end; c++) {
+        struct top_chunk *chunk = &job->chunks[c];
+        struct top_state  st    = {.spec = job->spec, .heap = &chunk->heap, .chunk = (int)c + 1};
+        chunk->status           = parse_csv_buffer(chunk->begin,
+                                         (size_t)(chunk->end - chunk->begin),
+                                         &body,
+                                         top_row,
+                                         &st,
+                                         &chunk->unterminated);
+    }
+}
+
+// Select on worker threads over file slices, each keeping its own heap.
+// Slice starts are guessed at confirmed line breaks; a slice that ends
+// inside a record shows the guess was wrong and the pass reruns serially.
+static int select_parallel(struct top_state      *st,
+                           const char            *data,
+                           const char            *end,
+                           int                    columns,
+                           int                    threads,
+                           const struct cli_args *args)
+{
+    struct top_chunk *chunks = calloc((size_t)threads, sizeof(*chunks));
+    if (!chunks)
+        return -1;
+
+    char   delim = args->tsv ? '\t' : args->delimiter;
+    size_t span  = (size_t)(end - data);
+    int    ret   = 0;
+
+    chunks[0].begin = data;
+    for (int i = 1; i < threads; i++) {
+        const char *guess = data + span / (size_t)threads * (size_t)i - 1;
+        const char *start = csv_resync(guess, end, delim, columns, CONFIRM_RECORDS, RESYNC_LINES);
+        if (!start || start < chunks[i - 1].begin)
+            start = start ? chunks[i - 1].begin : end;
+        chunks[i].begin   = start;
+        chunks[i - 1].end = start;
+    }
+    chunks[threads - 1].end = end;
+
+    for (int i = 0; i < threads; i++) {
+        if (heap_init(&chunks[i].heap, st->heap->spec, st->heap->want) != 0)
+            ret = -1;
+    }
+
+    bool aligned = true;
+    if (ret == 0) {
+        struct top_job job = {.spec = st->spec, .chunks = chunks, .args = args};
+        parallel_for(threads, threads, run_chunks, &job);
+
+        for (int i = 0; i < threads; i++) {
+            if (chunks[i].status != 0)
+                ret = -1;
+            if (i < threads - 1 && chunks[i].unterminated)
+                aligned = false;
+        }
+    }
+
+    for (int i = 0; i < threads && ret == 0 && aligned; i++) {
+        ret = merge_heap(st->heap, &chunks[i].heap);
+    }
+    for (int i = 0; i < threads; i++) {
+        heap_free(&chunks[i].heap);
+    }
+    free(chunks);
+
+    if (ret == 0 && !aligned) {
+        struct cli_args body = *args;
+        body.no_headers      = true;
+        ret = parse_csv_buffer(data, span, &body, top_row, st, NULL);
+    }
+    return ret;
+}
+
+static int select_mapped(struct top_state      *st,
+                         const char            *base,
+                         size_t                 size,
+                         const struct cli_args *args)
+{
+    const char     *end     = base + size;
+    const char     *data    = base;
+    char            delim   = args->tsv ? '\t' : args->delimiter;
+    int             columns = 0;
+    bool            clean;
+    struct cli_args body = *args;
+    body.no_headers      = true;
+
+    data = csv_scan_record(base, end, delim, &columns, &clean);
+    if (!args->no_headers) {
+        if (parse_csv_buffer(base, (size_t)(data - base), args, top_row, st, NULL) != 0)
+            return -1;
+    } else {
+        data = base;
+    }
+
+    int threads = parallel_threads(args->threads, (long)(end - data), MIN_CHUNK_BYTES);
+    if (threads > 1)
+        return select_parallel(st, data, end, columns, threads, args);
+    return parse_csv_buffer(data, (size_t)(end - data), &body, top_row, st, NULL);
+}
+
+// Heapsort the winners best first and hand them to the table
+static int finish_heap(struct top_heap *heap, struct csv_data *csv)
+{
+    for (long n = heap->count - 1; n > 0; n--) {
+        swap_entries(&heap->entries[0], &heap->entries[n]);
+        sift_down(heap, 0, n);
+    }
+    for (long i = 0; i < heap->count; i++) {
+        const struct top_entry *entry = &heap->entries[i];
+        if (csv_data_add(csv, entry->fields, entry->field_count, false) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int top_table(FILE *input, struct csv_data *csv, const struct cli_args *args)
+{
+    if (csv_data_init(csv) != 0)
+        return -1;
+
+    struct top_spec  spec = {.errors = args->errors};
+    struct top_heap  heap = {0};
+    struct top_state st   = {.spec = &spec, .heap = &heap, .csv = csv};
+    int              ret  = parse_spec(&spec, args->by);
+    if (ret == 0)
+        ret = heap_init(&heap, &spec, args->top);
+    if (ret == 0 && args->no_headers)
+        ret = resolve_spec(&spec, NULL, 0);
+
+    struct stat sb;
+    void       *map  = MAP_FAILED;
+    size_t      size = 0;
+    if (ret == 0 && fstat(fileno(input), &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+        size = (size_t)sb.st_size;
+        map  = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+    }
+
+    if (ret == 0 && map != MAP_FAILED) {
+        madvise(map, size, MADV_SEQUENTIAL);
+        ret = select_mapped(&st, map, size, args);
+        munmap(map, size);
+    } else if (ret == 0) {
+        ret = parse_csv_stream(input, args, top_row, &st);
+    }
+    if (ret == 0)
+        ret = finish_heap(&heap, csv);
+
+    heap_free(&heap);
+    free(spec.column_name);
+    if (ret != 0) {
+        free_csv_data(csv);
+        return -1;
+    }
+    csv_data_finish(csv, args->number);
+    return 0;
+}
\ No newline at end of file
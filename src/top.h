@@ -0,0 +1,15 @@
+#ifndef TOP_H
+#define TOP_H
+
+#include <stdio.h>
+
+#include "cli.h"
+#include "csv_parser.h"
+
+// Fill csv with the header and the first args->top records in --by order.
+// Candidates live in a bounded heap, so memory stays O(K) for any input;
+// regular files are scanned in slices on worker threads and the partial
+// heaps merged.
+int top_table(FILE *input, struct csv_data *csv, const struct cli_args *args);
+
+#endif  // TOP_H
\ No newline at end of file
@@ -1,6 +1,9 @@
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
+#include <unistr.h>
 #include <uniwidth.h>
 
 #include "utils.h"
@@ -42,4 +45,202 @@ int unicode_display_width(const char *str)
     }
 
     return max_width;
+}
+
+// Width of text expected to be printable ASCII, one column per byte. Any
+// other byte falls back to the full Unicode measurement.
+int ascii_display_width(const char *str)
+{
+    if (!str)
+        return 0;
+
+    const unsigned char *s = (const unsigned char *)str;
+    size_t               n = 0;
+    while ((unsigned char)(s[n] - 0x20) < 0x5f)
+        n++;
+    return s[n] == '\0' ? (int)n : unicode_display_width(str);
+}
+
+// Length in bytes of the longest prefix of str that fits in width columns,
+// never splitting a character. The prefix's own width is stored in used.
+size_t unicode_truncate(const char *str, int width, int *used)
+{
+    const uint8_t *s     = (const uint8_t *)str;
+    size_t         len   = strlen(str);
+    size_t         pos   = 0;
+    int            total = 0;
+
+    while (pos < len) {
+        ucs4_t uc;
+        int    n = u8_mbtouc(&uc, s + pos, len - pos);
+        int    w = uc_width(uc, "UTF-8");
+        if (w < 0)
+            w = 1;  // Control characters take one column each
+        if (total + w > width)
+            break;
+        total += w;
+        pos += (size_t)n;
+    }
+
+    *used = total;
+    return pos;
+}
+
+// Parse a byte count with an optional binary K/M/G/T suffix (e.g. "512M", "2GiB")
+int parse_size(const char *str, size_t *size)
+{
+    char              *end;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (end == str || *str == '-')
+        return -1;
+
+    int shift = 0;
+    switch (*end) {
+        case 'k':
+        case 'K':
+            shift = 10;
+            break;
+        case 'm':
+        case 'M':
+            shift = 20;
+            break;
+        case 'g':
+        case 'G':
+            shift = 30;
+            break;
+        case 't':
+        case 'T':
+            shift = 40;
+            break;
+        case '\0':
+            break;
+        default:
+            return -1;
+    }
+    if (shift) {
+        end++;
+        if (*end == 'i')
+            end++;
+    }
+    if (*end == 'b' || *end == 'B')
+        end++;
+    if (*end != '\0' || value > (SIZE_MAX >> shift))
+        return -1;
+
+    *size = (size_t)value << shift;
+    return 0;
+}
+
+// Find a column by header name, or by 1-based number when no name matches.
+// Returns the 0-based index, or -1 when the column does not exist.
+int resolve_column(const char *name, const char *const *header, int count)
+{
+    for (int i = 0; header && i < count; i++) {
+        if (strcmp(header[i], name) == 0)
+            return i;
+    }
+
+    char *end;
+    long  number = strtol(name, &end, 10);
+    if (*name == '\0' || *end != '\0' || number < 1 || number > INT32_MAX)
+        return -1;
+    if (header && number > count)
+        return -1;
+    return (int)number - 1;
+}
+
+// True when the mtime lies in the current or the previous clock second. A
+// write in the same second may leave the mtime where it was, so anything
+// derived from the file could go stale without its key changing.
+bool recently_modified(int64_t mtime_sec)
+{
+    return time(NULL) - mtime_sec < 2;
+}
+
+int out_buf_init(struct out_buf *ob, FILE *fp, size_t cap)
+{
+    ob->data  = malloc(cap);
+    ob->len   = 0;
+    ob->cap   = cap;
+    ob->fp    = fp;
+    ob->error = 0;
+    return ob->data ? 0 : -1;
+}
+
+// A buffer without a stream grows to hold `need` more bytes instead of flushing
+static int out_buf_grow(struct out_buf *ob, size_t need)
+{
+    size_t cap = ob->cap ? ob->cap : 4096;
+    while (cap - ob->len < need)
+        cap *= 2;
+
+    char *data = realloc(ob->data, cap);
+    if (!data) {
+        ob->error = 1;
+        return -1;
+    }
+    ob->data = data;
+    ob->cap  = cap;
+    return 0;
+}
+
+int out_buf_flush(struct out_buf *ob)
+{
+    if (ob->error)
+        return -1;
+    if (!ob->fp)
+        return ob->len == ob->cap ? out_buf_grow(ob, 1) : 0;
+    if (ob->len > 0 && fwrite(ob->data, 1, ob->len, ob->fp) != ob->len) {
+        ob->error = 1;
+        return -1;
+    }
+    ob->len = 0;
+    return 0;
+}
+
+int out_buf_write(struct out_buf *ob, const void *data, size_t len)
+{
+    if (len > ob->cap - ob->len && !ob->fp) {
+        if (out_buf_grow(ob, len) != 0)
+            return -1;
+    } else if (len > ob->cap - ob->len) {
+        if (out_buf_flush(ob) != 0)
+            return -1;
+
+        // Oversized writes bypass the buffer entirely
+        if (len >= ob->cap) {
+            if (fwrite(data, 1, len, ob->fp) != len) {
+                ob->error = 1;
+                return -1;
+            }
+            return 0;
+        }
+    }
+
+    memcpy(ob->data + ob->len, data, len);
+    ob->len += len;
+    return 0;
+}
+
+int out_buf_fill(struct out_buf *ob, char c, size_t count)
+{
+    while (count > 0) {
+        if (ob->len == ob->cap && out_buf_flush(ob) != 0)
+            return -1;
+        size_t n = ob->cap - ob->len;
+        if (n > count)
+            n = count;
+        memset(ob->data + ob->len, c, n);
+        ob->len += n;
+        count -= n;
+    }
+    return 0;
+}
+
+void out_buf_free(struct out_buf *ob)
+{
+    free(ob->data);
+    ob->data = NULL;
+    ob->len  = 0;
+    ob->cap  = 0;
 }
\ No newline at end of file
@@ -1,6 +1,48 @@
 #ifndef UNICODE_UTILS_H
 #define UNICODE_UTILS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Large write-combining buffer in front of a FILE stream, or a growable
+// memory buffer when created without one
+struct out_buf {
+    char  *data;
+    size_t len;
+    size_t cap;
+    FILE  *fp;
+    int    error;
+};
+
+#define OUT_BUF_SIZE (1 << 20)
+
 int unicode_display_width(const char *str);
+int ascii_display_width(const char *str);
+size_t unicode_truncate(const char *str, int width, int *used);
+int parse_size(const char *str, size_t *size);
+int resolve_column(const char *name, const char *const *header, int count);
+bool recently_modified(int64_t mtime_sec);
+
+int  out_buf_init(struct out_buf *ob, FILE *fp, size_t cap);
+int  out_buf_write(struct out_buf *ob, const void *data, size_t len);
+int  out_buf_fill(struct out_buf *ob, char c, size_t count);
+int  out_buf_flush(struct out_buf *ob);
+void out_buf_free(struct out_buf *ob);
+
+static inline int out_buf_puts(struct out_buf *ob, const char *str)
+{
+    return out_buf_write(ob, str, strlen(str));
+}
+
+static inline int out_buf_putc(struct out_buf *ob, char c)
+{
+    if (ob->len == ob->cap && out_buf_flush(ob) != 0)
+        return -1;
+    ob->data[ob->len++] = c;
+    return 0;
+}
 
 #endif  // UNICODE_UTILS_H
\ No newline at end of file
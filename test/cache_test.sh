@@ -0,0 +1,179 @@
+#!/bin/bash
+
+# Parsed-table cache test for csview
+# With CSVIEW_CACHE_DIR set, a table is parsed once and later renders map the
+# cached image instead. Every render from the image must match a run without
+# the cache, and a changed file or different parse options must never be
+# answered from an image of something else.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/cache"
+parse_options "$@"
+
+CACHE_DIR=""
+WORK_DIR=""
+
+# Give the file an mtime old enough for its image to be stored
+age_file()
+{
+    touch -d '-1 min' "$1"
+}
+
+# Count the images in the cache directory
+image_count()
+{
+    find "$CACHE_DIR" -name '*.csvc' 2> /dev/null | wc -l
+}
+
+# Render the file with and without the cache, expecting the same output
+run_cached()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    env -u CSVIEW_CACHE_DIR "$C_VERSION" -P "$@" "$data_file" > "$prefix.out" 2>> "$log"
+    CSVIEW_CACHE_DIR="$CACHE_DIR" "$C_VERSION" -P "$@" "$data_file" > "${prefix}_cached.out" \
+        2>> "$log"
+    local exit_code=$?
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "csview $* uncached vs cached" "$prefix.out" "${prefix}_cached.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Expect the number of images in the cache directory
+expect_images()
+{
+    local test_name="$1"
+    local expected="$2"
+
+    begin_test "$test_name"
+
+    local log="$OUTPUT_DIR/$test_name.log"
+    local count
+    count=$(image_count)
+    : > "$log"
+    local test_passed=true
+    if [[ $count -ne $expected ]]; then
+        echo "expected $expected images, found $count" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Start from an empty cache and fresh copies of the data files
+reset_cache()
+{
+    rm -rf "$CACHE_DIR" "$WORK_DIR"
+    mkdir -p "$WORK_DIR"
+    cp "$DATA_DIR/basic.csv" "$DATA_DIR/wide_unicode.csv" "$DATA_DIR/query.csv" \
+        "$DATA_DIR/special_chars.csv" "$WORK_DIR/"
+    for f in "$WORK_DIR"/*.csv; do
+        age_file "$f"
+    done
+}
+
+# Test that renders from a stored image match fresh parses
+test_renders()
+{
+    echo -e "${CYAN}=== Render Tests ===${NC}"
+
+    reset_cache
+    run_cached "first_run" "$WORK_DIR/query.csv"
+    expect_images "first_run_stored" 1
+    run_cached "second_run" "$WORK_DIR/query.csv"
+    expect_images "second_run_reused" 1
+
+    run_cached "number" "$WORK_DIR/query.csv" -n -s rounded
+    run_cached "rows" "$WORK_DIR/query.csv" --rows 100-200 --sniff 0
+    run_cached "columns" "$WORK_DIR/query.csv" --columns 2,1
+    run_cached "sniff" "$WORK_DIR/query.csv" --sniff 0 --body-align right
+    run_cached "text" "$WORK_DIR/query.csv" --format text
+    expect_images "render_options_share_image" 1
+
+    run_cached "unicode" "$WORK_DIR/wide_unicode.csv" -s grid
+    run_cached "unicode_again" "$WORK_DIR/wide_unicode.csv" -s grid --sniff 2
+    run_cached "multiline" "$WORK_DIR/special_chars.csv"
+    run_cached "multiline_again" "$WORK_DIR/special_chars.csv" -s markdown
+    expect_images "one_image_per_file" 3
+}
+
+# Test that parse options and file changes get images of their own
+test_keys()
+{
+    echo -e "${CYAN}=== Key Tests ===${NC}"
+
+    reset_cache
+    run_cached "headers" "$WORK_DIR/basic.csv"
+    run_cached "no_headers" "$WORK_DIR/basic.csv" -H
+    run_cached "delimiter" "$WORK_DIR/basic.csv" -d ';'
+    run_cached "delimiter_again" "$WORK_DIR/basic.csv" -d ';'
+    expect_images "parse_options_keyed" 3
+
+    echo "Dave,40,Berlin" >> "$WORK_DIR/basic.csv"
+    age_file "$WORK_DIR/basic.csv"
+    run_cached "appended" "$WORK_DIR/basic.csv"
+
+    # Same inode and size, new content and mtime
+    sed 's/Berlin/Madrid/' "$WORK_DIR/basic.csv" > "$OUTPUT_DIR/rewritten.csv"
+    cat "$OUTPUT_DIR/rewritten.csv" > "$WORK_DIR/basic.csv"
+    touch -d '-2 min' "$WORK_DIR/basic.csv"
+    run_cached "rewritten" "$WORK_DIR/basic.csv"
+
+    # Just written files are not stored, their mtime may not change on the next write
+    local images
+    images=$(image_count)
+    echo "Erin,50,Rome" >> "$WORK_DIR/basic.csv"
+    run_cached "fresh" "$WORK_DIR/basic.csv"
+    expect_images "fresh_not_stored" "$images"
+}
+
+# Test that a broken or evicted image falls back to parsing
+test_recovery()
+{
+    echo -e "${CYAN}=== Recovery Tests ===${NC}"
+
+    reset_cache
+    run_cached "store" "$WORK_DIR/query.csv"
+    local image
+    image=$(find "$CACHE_DIR" -name '*.csvc' | head -1)
+    if [[ -n "$image" ]]; then
+        truncate -s 100 "$image"
+    fi
+    run_cached "truncated_image" "$WORK_DIR/query.csv"
+    run_cached "restored" "$WORK_DIR/query.csv"
+
+    rm -rf "$CACHE_DIR"
+    CSVIEW_CACHE_MAX=1 run_cached "evicted" "$WORK_DIR/query.csv"
+    expect_images "cap_evicts" 0
+}
+
+# Main test execution
+main()
+{
+    print_header "Table Cache"
+    check_executables
+    CACHE_DIR="$(cd "$OUTPUT_DIR" && pwd)/images"
+    WORK_DIR="$OUTPUT_DIR/work"
+
+    test_renders
+    test_keys
+    test_recovery
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,143 @@
+#!/bin/bash
+
+# --count consistency test for csview
+# --count scans record boundaries without parsing fields, on a pipe as a
+# stream and on a regular file mapped and split across threads. Both must
+# agree with the records the parser produces for random inputs.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/count"
+SMALL_INPUTS=300
+LARGE_INPUTS=4
+LARGE_BYTES=$((17 << 20)) # Four slices of MIN_CHUNK_BYTES with -j 4
+SEED=1
+EXTRA_OPTIONS="n:l:r:"
+
+extra_usage()
+{
+    echo "  -n <num>     Small random inputs per mode (default: 300)"
+    echo "  -l <num>     Large random inputs per mode, threaded on files (default: 4)"
+    echo "  -r <seed>    First random seed (default: 1)"
+}
+
+handle_option()
+{
+    case $1 in
+    n) SMALL_INPUTS="$2" ;;
+    l) LARGE_INPUTS="$2" ;;
+    r) SEED="$2" ;;
+    *) return 1 ;;
+    esac
+}
+
+parse_options "$@"
+
+# Print "records columns" as the parser sees the input: one NDJSON line per
+# record, the first one listing the fields of the first record
+parser_count()
+{
+    local options="$1"
+    local data_file="$2"
+
+    "$C_VERSION" $options -H --format ndjson < "$data_file" | python3 -c '
+import json, sys
+records, columns = 0, 0
+for line in sys.stdin:
+    if records == 0:
+        columns = len(json.loads(line))
+    records += 1
+print(records, columns)'
+}
+
+# Log a mismatch between the expected and the reported counts
+expect_count()
+{
+    local log="$1"
+    local label="$2"
+    local want="$3"
+    local got="$4"
+
+    if [[ "$got" != "$want" ]]; then
+        echo "$label: expected '$want', got '$got'" >> "$log"
+        return 1
+    fi
+    return 0
+}
+
+# Compare --count on the file and on a pipe, with and without -H, to the parser
+run_count()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local options="$3"
+    local threads="$4"
+
+    begin_test "$test_name ($options, $(wc -c < "$data_file") bytes)"
+
+    local expected
+    expected=$(parser_count "$options" "$data_file")
+    local records=${expected% *}
+    local columns=${expected#* }
+    local headed=$((records > 0 ? records - 1 : 0))
+
+    local test_passed=true
+    local log="$OUTPUT_DIR/${test_name}.log"
+    : > "$log"
+
+    local got
+    got=$("$C_VERSION" $options -j "$threads" -H --count "$data_file" 2>&1)
+    expect_count "$log" "file -H" "$records $columns" "$got" || test_passed=false
+    got=$("$C_VERSION" $options -H --count < "$data_file" 2>&1)
+    expect_count "$log" "pipe -H" "$records $columns" "$got" || test_passed=false
+    got=$("$C_VERSION" $options -j "$threads" --count "$data_file" 2>&1)
+    expect_count "$log" "file" "$headed $columns" "$got" || test_passed=false
+    got=$("$C_VERSION" $options --count < "$data_file" 2>&1)
+    expect_count "$log" "pipe" "$headed $columns" "$got" || test_passed=false
+
+    if [[ "$test_passed" == true ]]; then
+        rm -f "$log"
+    else
+        cp "$data_file" "$OUTPUT_DIR/${test_name}.csv"
+    fi
+    end_test "$test_passed" "$log" "input kept as $OUTPUT_DIR/${test_name}.csv"
+}
+
+# Run count tests on generated inputs of one mode
+test_random_inputs()
+{
+    local mode="$1"
+    local inputs="$2"
+    local min_bytes="$3"
+    local threads="$4"
+    local data_file="$OUTPUT_DIR/input.csv"
+
+    for ((i = 0; i < inputs; i++)); do
+        local seed=$((SEED + i))
+        local options
+        options=$(python3 "$TEST_DIR/random_csv.py" "$seed" "$data_file" "$mode" "$min_bytes")
+        run_count "${mode}_${min_bytes}_${seed}" "$data_file" "$options" "$threads"
+    done
+    rm -f "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "--count Consistency"
+    check_executables
+    require_python "generate the random inputs"
+
+    echo -e "${CYAN}=== Quote-free Inputs ===${NC}"
+    test_random_inputs plain "$SMALL_INPUTS" 0 1
+
+    echo -e "${CYAN}=== Inputs with Quoted Fields ===${NC}"
+    test_random_inputs mixed "$SMALL_INPUTS" 0 1
+
+    echo -e "${CYAN}=== Large Inputs on Threads ===${NC}"
+    test_random_inputs plain "$LARGE_INPUTS" "$LARGE_BYTES" 4
+    test_random_inputs mixed "$LARGE_INPUTS" "$LARGE_BYTES" 4
+
+    finish "Check the inputs and logs in $OUTPUT_DIR"
+}
+
+main
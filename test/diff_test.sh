@@ -0,0 +1,202 @@
+#!/bin/bash
+
+# --diff test for csview
+# Small inputs with known differences, keyed by one or more columns, with
+# reordered and missing columns and duplicate keys, must print the expected
+# cells whether the new side is a file or a pipe.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/diff"
+parse_options "$@"
+
+# Write a fixture file from stdin
+fixture()
+{
+    cat > "$OUTPUT_DIR/$1"
+}
+
+# Diff new against old and compare the cells with the expected ones on stdin,
+# written with | between cells
+run_diff()
+{
+    local test_name="$1"
+    local old="$OUTPUT_DIR/$2"
+    local new="$OUTPUT_DIR/$3"
+    shift 3
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    tr '|' '\t' > "$prefix.expected"
+    "$C_VERSION" -P -s markdown --diff "$old" "$@" "$new" > "${prefix}_file.out" 2> "$prefix.err"
+    local file_exit_code=$?
+    "$C_VERSION" -P -s markdown --diff "$old" "$@" < "$new" > "${prefix}_pipe.out" 2>> "$prefix.err"
+    local pipe_exit_code=$?
+    markdown_cells "${prefix}_file.out" > "${prefix}_file.cells"
+
+    local test_passed=true
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "expected vs csview" "$prefix.expected" "${prefix}_file.cells" ||
+        test_passed=false
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write the fixtures
+make_data()
+{
+    fixture old.csv << 'EOF'
+id,name,city
+1,Alice,Paris
+2,Bob,London
+3,"Car, ol",Rome
+4,Dan,Oslo
+EOF
+    fixture new.csv << 'EOF'
+id,name,city
+2,Bob,Berlin
+1,Alice,Paris
+5,Eve,"New ""York"""
+3,"Car, ol",Rome
+EOF
+    fixture old_pairs.csv << 'EOF'
+region,id,value
+eu,1,10
+us,1,20
+eu,2,30
+EOF
+    fixture new_pairs.csv << 'EOF'
+region,id,value
+us,1,25
+eu,1,10
+us,2,30
+EOF
+    fixture old_columns.csv << 'EOF'
+id,name,city,zip
+1,Alice,Paris,75
+2,Bob,London,10
+EOF
+    fixture new_columns.csv << 'EOF'
+city,id,name,phone
+Paris,1,Alice,555
+London,2,Bobby,556
+EOF
+    fixture old_dupes.csv << 'EOF'
+id,v
+1,a
+1,b
+2,c
+EOF
+    fixture new_dupes.csv << 'EOF'
+id,v
+1,a
+2,d
+EOF
+}
+
+# Test records added, removed and changed
+test_records()
+{
+    echo -e "${CYAN}=== Record Tests ===${NC}"
+
+    run_diff "changes" old.csv new.csv --key id << 'EOF'
+|id|name|city
+~|2|Bob|London → Berlin
++|5|Eve|New "York"
+-|4|Dan|Oslo
+EOF
+    run_diff "reversed" new.csv old.csv --key id << 'EOF'
+|id|name|city
+~|2|Bob|Berlin → London
++|4|Dan|Oslo
+-|5|Eve|New "York"
+EOF
+    run_diff "same" old.csv old.csv --key id << 'EOF'
+|id|name|city
+EOF
+    run_diff "quoted_key" old.csv new.csv --key name << 'EOF'
+|id|name|city
+~|2|Bob|London → Berlin
++|5|Eve|New "York"
+-|4|Dan|Oslo
+EOF
+    run_diff "two_keys" old_pairs.csv new_pairs.csv --key region,id << 'EOF'
+|region|id|value
+~|us|1|20 → 25
++|us|2|30
+-|eu|2|30
+EOF
+    # Key 1 repeats on both sides: the first records are compared, the second
+    # new one counts as added
+    run_diff "numbered_key" old_pairs.csv new_pairs.csv --key 2 << 'EOF'
+|region|id|value
+~|eu → us|1|10 → 25
++|eu|1|10
+~|eu → us|2|30
+EOF
+}
+
+# Test columns matched by name or position
+test_columns()
+{
+    echo -e "${CYAN}=== Column Tests ===${NC}"
+
+    run_diff "reordered" old_columns.csv new_columns.csv --key id << 'EOF'
+|city|id|name|phone|zip
+~|Paris|1|Alice|→ 555|75 →
+~|London|2|Bob → Bobby|→ 556|10 →
+EOF
+    run_diff "no_headers" old.csv new.csv -H --key 1 << 'EOF'
+~|2|Bob|London → Berlin
++|5|Eve|New "York"
+-|4|Dan|Oslo
+EOF
+    run_diff "duplicates" old_dupes.csv new_dupes.csv --key id << 'EOF'
+|id|v
+~|2|c → d
+EOF
+}
+
+# Test the errors
+test_errors()
+{
+    echo -e "${CYAN}=== Error Tests ===${NC}"
+
+    check_error "unknown_key" "Unknown key column: nope" \
+        --diff "$OUTPUT_DIR/old.csv" --key nope "$OUTPUT_DIR/new.csv"
+    check_error "missing_old" "missing.csv" \
+        --diff "$OUTPUT_DIR/missing.csv" --key id "$OUTPUT_DIR/new.csv"
+
+    begin_test "duplicate_warning"
+    local log="$OUTPUT_DIR/duplicate_warning.log"
+    : > "$log"
+    local test_passed=true
+    if ! grep -qF "1 duplicate keys in $OUTPUT_DIR/old_dupes.csv" "$OUTPUT_DIR/duplicates.err"; then
+        echo "no duplicate key warning on stderr" >> "$log"
+        test_passed=false
+    fi
+    end_test "$test_passed" "$log"
+}
+
+# Main test execution
+main()
+{
+    print_header "Diff"
+    check_executables
+    make_data
+
+    test_records
+    test_columns
+    test_errors
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Check a csview --format output against the records of its input.
+
+Usage: export_check.py <format> <input> <output> [options]
+The options are the csview ones the output was made with, among -H, -n, -t,
+-d <delim>, --sniff <rows>, --header-align <align> and --body-align <align>. Prints the first
+difference and exits 1 when the output does not hold the input's records.
+"""
+
+import csv
+import json
+import sys
+import unicodedata
+
+
+def parse_args(argv):
+    opts = {"headers": True, "number": False, "delimiter": ",",
+            "header_align": "center", "body_align": "left", "sniff": 1000}
+    i = 0
+    while i < len(argv):
+        arg = argv[i]
+        if arg == "-H":
+            opts["headers"] = False
+        elif arg == "-n":
+            opts["number"] = True
+        elif arg == "-t":
+            opts["delimiter"] = "\t"
+        elif arg == "-d":
+            i += 1
+            opts["delimiter"] = argv[i]
+        elif arg == "--sniff":
+            i += 1
+            opts["sniff"] = int(argv[i])
+        elif arg == "--header-align":
+            i += 1
+            opts["header_align"] = argv[i]
+        elif arg == "--body-align":
+            i += 1
+            opts["body_align"] = argv[i]
+        else:
+            sys.exit(f"unknown option: {arg}")
+        i += 1
+    return opts
+
+
+def read_records(path, delimiter):
+    with open(path, newline="", encoding="utf-8") as f:
+        return [r for r in csv.reader(f, delimiter=delimiter) if r]
+
+
+# Display width, of the widest line for fields spanning lines
+def width(text):
+    return max(sum(2 if unicodedata.east_asian_width(c) in "WF" else 1 for c in line)
+               for line in text.split("\n"))
+
+
+def expected_text(records, opts):
+    rows = [list(r) for r in records]
+    first_body = 1 if opts["headers"] else 0
+    if opts["number"]:
+        for i, row in enumerate(rows):
+            row.insert(0, "#" if i < first_body else str(i - first_body + 1))
+    columns = max(len(r) for r in rows)
+    # Widths cover the header and the first --sniff records
+    measured = rows if opts["sniff"] == 0 else rows[:first_body + opts["sniff"]]
+    widths = [max(width(r[i]) if i < len(r) else 0 for r in measured) for i in range(columns)]
+
+    lines = []
+    for i, row in enumerate(rows):
+        align = opts["header_align"] if i < first_body else opts["body_align"]
+        cells = []
+        for c in range(columns):
+            content = row[c] if c < len(row) else ""
+            pad = widths[c] - width(content)
+            left = {"left": 0, "center": pad // 2, "right": pad}[align]
+            right = pad - left if c < columns - 1 else 0
+            cells.append(" " * left + content + " " * right)
+        lines.append("  ".join(cells) + "\n")
+    return "".join(lines)
+
+
+def expected_objects(records, opts):
+    if not opts["headers"]:
+        return [list(r) for r in records]
+    header, body = records[0], records[1:]
+    return [dict(zip(header, r)) for r in body]
+
+
+def read_arrow(path):
+    try:
+        import pyarrow.ipc as ipc
+    except ImportError:
+        sys.exit(77)
+    with open(path, "rb") as f:
+        table = ipc.open_stream(f).read_all()
+    return table.schema.names, table.to_pylist()
+
+
+def report(expected, actual):
+    for i, (e, a) in enumerate(zip(expected, actual)):
+        if e != a:
+            print(f"record {i + 1}: expected {e!r}, got {a!r}")
+            return 1
+    print(f"expected {len(expected)} records, got {len(actual)}")
+    return 1
+
+
+def main():
+    fmt, input_path, output_path = sys.argv[1:4]
+    opts = parse_args(sys.argv[4:])
+    records = read_records(input_path, opts["delimiter"])
+
+    if fmt == "text":
+        with open(output_path, encoding="utf-8", newline="") as f:
+            actual = f.read().splitlines(keepends=True)
+        expected = expected_text(records, opts).splitlines(keepends=True)
+    elif fmt == "ndjson":
+        with open(output_path, encoding="utf-8") as f:
+            actual = [json.loads(line) for line in f]
+        expected = expected_objects(records, opts)
+    elif fmt == "arrow":
+        names, actual = read_arrow(output_path)
+        if opts["headers"]:
+            expected = expected_objects(records, opts)
+        else:
+            expected = [dict(zip(names, r)) for r in records]
+    else:
+        sys.exit(f"unknown format: {fmt}")
+
+    return 0 if expected == actual else report(expected, actual)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,116 @@
+#!/bin/bash
+
+# --format backend test for csview
+# The text, NDJSON and Arrow backends must hold the records of the input as
+# Python's csv module reads them, laid out by the text rules of exporter.c,
+# whether the input is a file or a pipe. Arrow needs pyarrow and is skipped
+# without it.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/export"
+parse_options "$@"
+
+HAVE_PYARROW=false
+
+# Export the input from the file and from a pipe, and check both outputs
+run_export()
+{
+    local test_name="$1"
+    local format="$2"
+    local data_file="$3"
+    shift 3
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P --format "$format" "$@" "$data_file" > "${prefix}_file.out" 2>> "$log"
+    local file_exit_code=$?
+    "$C_VERSION" -P --format "$format" "$@" < "$data_file" > "${prefix}_pipe.out" 2>> "$log"
+    local pipe_exit_code=$?
+
+    local test_passed=true
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out" || test_passed=false
+    if ! python3 "$TEST_DIR/export_check.py" "$format" "$data_file" "${prefix}_file.out" "$@" \
+        >> "$log" 2>&1; then
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Run every backend over the input with the options
+run_formats()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    run_export "${test_name}_text" text "$data_file" "$@"
+    run_export "${test_name}_ndjson" ndjson "$data_file" "$@"
+    if [[ "$HAVE_PYARROW" == true ]]; then
+        run_export "${test_name}_arrow" arrow "$data_file" "$@"
+    fi
+}
+
+# Write inputs with quoting and widths the data directory lacks
+make_data()
+{
+    printf 'a,b,c\n"x, y","say ""hi""",\n"",plain,"multi\nline"\n1,22,333\n' \
+        > "$OUTPUT_DIR/quoted.csv"
+    { echo "id,name,value"
+      for ((i = 1; i <= 3000; i++)); do echo "$i,name$((i % 97)),$((i * 7 % 1000))"; done; } \
+        > "$OUTPUT_DIR/long.csv"
+}
+
+# Test records and layout across the data files
+test_data_files()
+{
+    echo -e "${CYAN}=== Data File Tests ===${NC}"
+
+    run_formats "basic" "$DATA_DIR/basic.csv"
+    run_formats "empty_fields" "$DATA_DIR/empty_fields.csv"
+    run_formats "numbers" "$DATA_DIR/numbers_mixed.csv"
+    run_formats "cjk" "$DATA_DIR/cjk_mixed.csv"
+    run_formats "tsv" "$DATA_DIR/tsv_data.tsv" -t
+    run_formats "quoted" "$OUTPUT_DIR/quoted.csv"
+    run_formats "long" "$OUTPUT_DIR/long.csv"
+}
+
+# Test the options the backends honour
+test_options()
+{
+    echo -e "${CYAN}=== Option Tests ===${NC}"
+
+    run_formats "no_headers" "$DATA_DIR/basic.csv" -H
+    run_formats "number" "$DATA_DIR/basic.csv" -n
+    run_formats "number_no_headers" "$DATA_DIR/cjk_mixed.csv" -n -H
+    run_formats "align" "$DATA_DIR/empty_fields.csv" --header-align left --body-align right
+    run_formats "align_center" "$DATA_DIR/cjk_mixed.csv" --body-align center
+}
+
+# Main test execution
+main()
+{
+    print_header "Export Backend"
+    check_executables
+    require_python "read the inputs as CSV"
+    if python3 -c "import pyarrow" 2> /dev/null; then
+        HAVE_PYARROW=true
+    else
+        echo -e "${YELLOW}pyarrow not found, skipping the Arrow tests${NC}"
+    fi
+    make_data
+
+    test_data_files
+    test_options
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,191 @@
+#!/bin/bash
+
+# --fit/--columns test for csview
+# With --fit no line may be wider than $COLUMNS, every line of a table must
+# keep the same width, and each cell shown must be the whole cell or a prefix
+# of it cut with an ellipsis. --columns picks and orders the columns first,
+# and --fit keeps the first ones listed.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/fit"
+WIDTHS="16 23 31 40 57 80 121"
+parse_options "$@"
+
+# Print the distinct display widths of the lines, wide East Asian characters
+# counting two columns as they do in the terminal
+line_widths()
+{
+    python3 -c '
+import sys, unicodedata
+widths = {sum(2 if unicodedata.east_asian_width(c) in "WF" else 1 for c in line.rstrip("\n"))
+          for line in open(sys.argv[1], encoding="utf-8")}
+print("\n".join(str(w) for w in sorted(widths)))' "$1"
+}
+
+# Check that every kept cell is the cell without --fit or a prefix of it cut
+# with an ellipsis
+check_cells()
+{
+    local full="$1"
+    local fitted="$2"
+
+    awk -F'\t' '
+        FNR == NR { full[FNR] = $0; next }
+        {
+            n = split(full[FNR], cells, "\t")
+            if (NF > n) {
+                print "line " FNR ": more cells than without --fit"
+                exit 1
+            }
+            for (i = 1; i <= NF; i++) {
+                if ($i == cells[i])
+                    continue
+                cut = substr($i, 1, length($i) - length("…"))
+                if (substr($i, length(cut) + 1) != "…" || index(cells[i], cut) != 1) {
+                    print "line " FNR ", cell " i ": \"" $i "\" is not cut from \"" cells[i] "\""
+                    exit 1
+                }
+            }
+        }
+        END { if (NR != 2 * FNR) print "line counts differ" }' "$full" "$fitted"
+}
+
+# Draw the file at each width and check the widths of the lines
+run_widths()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local test_passed=true
+    local width
+    for width in $WIDTHS; do
+        COLUMNS=$width "$C_VERSION" -P --fit "$@" "$data_file" > "${prefix}_$width.out" 2>> "$log"
+        local exit_code=$?
+        line_widths "${prefix}_$width.out" > "${prefix}_$width.widths"
+        if [[ $exit_code -ne 0 ]]; then
+            echo "COLUMNS=$width: exit code $exit_code" >> "$log"
+            test_passed=false
+        elif [[ $(wc -l < "${prefix}_$width.widths") -ne 1 ]]; then
+            echo "COLUMNS=$width: lines of different widths: $(tr '\n' ' ' < \
+                "${prefix}_$width.widths")" >> "$log"
+            test_passed=false
+        elif [[ $(cat "${prefix}_$width.widths") -gt $width ]]; then
+            echo "COLUMNS=$width: lines $(cat "${prefix}_$width.widths") wide" >> "$log"
+            test_passed=false
+        fi
+    done
+
+    end_test "$test_passed" "$log"
+}
+
+# Draw the file as markdown at each width and check the cells against the
+# ones drawn without --fit
+run_cells()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P -s markdown "$@" "$data_file" > "$prefix.out" 2>> "$log"
+    markdown_cells "$prefix.out" > "$prefix.cells"
+    local test_passed=true
+    local width
+    for width in $WIDTHS; do
+        COLUMNS=$width "$C_VERSION" -P -s markdown --fit "$@" "$data_file" \
+            > "${prefix}_$width.out" 2>> "$log"
+        markdown_cells "${prefix}_$width.out" > "${prefix}_$width.cells"
+        if ! check_cells "$prefix.cells" "${prefix}_$width.cells" >> "$log"; then
+            echo "COLUMNS=$width: cells differ" >> "$log"
+            test_passed=false
+        fi
+    done
+    [[ -s "$log" ]] && test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Test line widths across data files and styles
+test_widths()
+{
+    echo -e "${CYAN}=== Width Tests ===${NC}"
+
+    run_widths "query" "$DATA_DIR/query.csv"
+    run_widths "query_ascii" "$DATA_DIR/query.csv" -s ascii
+    run_widths "query_number" "$DATA_DIR/query.csv" -n -s grid
+    run_widths "query_padding" "$DATA_DIR/query.csv" -p 3
+    run_widths "wide_unicode" "$DATA_DIR/wide_unicode.csv" -s rounded
+    run_widths "chinese_sectors" "$DATA_DIR/chinese_sectors.csv" -n
+    run_widths "emoji" "$DATA_DIR/emoji_data.csv" -s markdown
+    run_widths "cjk_mixed" "$DATA_DIR/cjk_mixed.csv" -H
+    run_widths "wide_columns" "$DATA_DIR/wide_columns.csv" --header-align left
+    run_widths "numbers_mixed" "$DATA_DIR/numbers_mixed.csv" --body-align right
+    run_widths "tsv" "$DATA_DIR/tsv_data.tsv" -t -s sharp
+}
+
+# Test that cells are kept whole or cut short
+test_cells()
+{
+    echo -e "${CYAN}=== Cell Tests ===${NC}"
+
+    run_cells "query_cells" "$DATA_DIR/query.csv"
+    run_cells "wide_unicode_cells" "$DATA_DIR/wide_unicode.csv"
+    run_cells "chinese_sectors_cells" "$DATA_DIR/chinese_sectors.csv" -n
+    run_cells "emoji_cells" "$DATA_DIR/emoji_data.csv"
+    run_cells "columns_cells" "$DATA_DIR/query.csv" --columns 5,1,3
+}
+
+# Test --columns on its own and ahead of --fit
+test_columns()
+{
+    echo -e "${CYAN}=== Column Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/people.csv"
+    printf 'id,name,description,city\n' > "$data_file"
+    printf '1,Alice,A very long description indeed,Paris\n2,北京人,短,東京\n' >> "$data_file"
+    printf '| city  |    description     |\n|-------|--------------------|\n' \
+        > "$OUTPUT_DIR/listed_first.expected"
+    printf '| Paris | A very long descr… |\n| 東京  | 短                 |\n' \
+        >> "$OUTPUT_DIR/listed_first.expected"
+    COLUMNS=30 check_output "listed_first" "$OUTPUT_DIR/listed_first.expected" \
+        -s markdown --fit --columns city,description,id "$data_file"
+
+    "$C_VERSION" -P --columns 4,1 "$data_file" > "$OUTPUT_DIR/columns_alone.expected" 2> /dev/null
+    COLUMNS=10 check_output "columns_ignore_width" "$OUTPUT_DIR/columns_alone.expected" \
+        --columns 4,1 "$data_file"
+
+    "$C_VERSION" -P "$DATA_DIR/query.csv" > "$OUTPUT_DIR/wide_enough.expected" 2> /dev/null
+    COLUMNS=1000 check_output "wide_enough" "$OUTPUT_DIR/wide_enough.expected" \
+        --fit "$DATA_DIR/query.csv"
+
+    printf '┌───┐\n│ … │\n├───┤\n│ 1 │\n│ 2 │\n└───┘\n' > "$OUTPUT_DIR/narrowest.expected"
+    COLUMNS=1 check_output "narrowest" "$OUTPUT_DIR/narrowest.expected" --fit "$data_file"
+
+    check_error "unknown_column" "Unknown column: nope" --columns id,nope "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "Fit"
+    check_executables
+    require_python "count display widths"
+
+    test_widths
+    test_cells
+    test_columns
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,145 @@
+#!/bin/bash
+
+# Table body formatter byte-identity test for csview
+# Body rows are drawn by formatters specialized per separator set, alignment
+# and numbering (DEFINE_ROW_FORMATTER over COLUMN_SEPARATORS in
+# table_printer.c). Every style, alignment and numbering, crossed with the
+# options that change the layout, must draw the same bytes as a reference
+# build, such as the last commit before an edit to them.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/formatter"
+REF_VERSION=""
+REF_REVISION=""
+EXTRA_OPTIONS="r:g:"
+USAGE_ARGS=" (-r <path> | -g <revision>)"
+
+extra_usage()
+{
+    echo "  -r <path>    Path to the reference executable"
+    echo "  -g <rev>     Build the reference from this git revision, e.g. HEAD"
+}
+
+handle_option()
+{
+    case $1 in
+    r) REF_VERSION="$2" ;;
+    g) REF_REVISION="$2" ;;
+    *) return 1 ;;
+    esac
+}
+
+parse_options "$@"
+OUTPUT_DIR="$(cd "$OUTPUT_DIR" && pwd)"
+
+# Build the reference from a git revision in a temporary worktree
+build_reference()
+{
+    local worktree="$OUTPUT_DIR/reference-src"
+
+    echo -e "${BLUE}Building reference from $REF_REVISION${NC}"
+    git worktree remove --force "$worktree" > /dev/null 2>&1
+    if ! git worktree add --detach "$worktree" "$REF_REVISION" > /dev/null 2>&1; then
+        echo -e "${RED}Error: cannot check out $REF_REVISION${NC}"
+        exit 1
+    fi
+    if ! cmake -S "$worktree" -B "$worktree/build" > /dev/null ||
+        ! cmake --build "$worktree/build" -j "$(nproc)" > /dev/null; then
+        echo -e "${RED}Error: reference build failed${NC}"
+        git worktree remove --force "$worktree"
+        exit 1
+    fi
+    cp "$worktree/build/csview" "$OUTPUT_DIR/csview.ref"
+    git worktree remove --force "$worktree"
+    REF_VERSION="$OUTPUT_DIR/csview.ref"
+}
+
+# Check the executables, building the reference when asked to
+check_reference()
+{
+    check_executables
+
+    if [[ -z "$REF_VERSION" && -n "$REF_REVISION" ]]; then
+        build_reference
+    fi
+    if [[ ! -x "$REF_VERSION" ]]; then
+        echo -e "${RED}Error: reference executable not found, give one with -r or -g${NC}"
+        usage
+        exit 1
+    fi
+}
+
+# Write a file whose records are shorter and longer than the header
+make_data()
+{
+    printf 'id,name,note\n1,Alice\n2,Bob,tall,extra\n3\n,,\n4,"Dan ""D""",😀 wide\n' \
+        > "$OUTPUT_DIR/ragged.csv"
+}
+
+# Draw the table with both executables and compare the bytes
+run_render()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local args="$3"
+
+    begin_test "$test_name: $args"
+
+    local c_output="$OUTPUT_DIR/c.txt"
+    local ref_output="$OUTPUT_DIR/ref.txt"
+    local log="$OUTPUT_DIR/${TOTAL_TESTS}_diff.txt"
+    COLUMNS=40 "$C_VERSION" -P $args "$data_file" > "$c_output" 2>&1
+    COLUMNS=40 "$REF_VERSION" -P $args "$data_file" > "$ref_output" 2>&1
+
+    local test_passed=true
+    : > "$log"
+    expect_same "$log" "reference vs C" "$ref_output" "$c_output" || test_passed=false
+    [[ "$test_passed" == true ]] && rm -f "$log"
+    end_test "$test_passed" "$log"
+}
+
+# Cross every style, alignment and numbering with the layout options
+test_matrix()
+{
+    local data_file="$1"
+    local styles=("none" "ascii" "ascii2" "sharp" "rounded" "reinforced" "markdown" "grid")
+    local alignments=("left" "center" "right")
+    local numbering=("" "-n")
+    local extras=("" "-p 0 -i 2" "--sniff 2" "-H" "--columns 2,1" "--rows 2-4" "--max-memory 1K" \
+        "-p 3" "--fit" "--grep a --highlight")
+
+    echo -e "${CYAN}=== $(basename "$data_file") ===${NC}"
+    for style in "${styles[@]}"; do
+        for align in "${alignments[@]}"; do
+            for number in "${numbering[@]}"; do
+                for extra in "${extras[@]}"; do
+                    run_render "$(basename "$data_file" .csv)" "$data_file" \
+                        "-s $style --header-align $align --body-align $align $number $extra"
+                done
+            done
+        done
+    done
+}
+
+# Main test execution
+main()
+{
+    print_header "Body Formatter"
+    check_reference
+    echo "Reference: $REF_VERSION"
+    echo
+
+    make_data
+
+    test_matrix "$DATA_DIR/wide_unicode.csv"
+    test_matrix "$DATA_DIR/empty_fields.csv"
+    test_matrix "$DATA_DIR/special_chars.csv"
+    test_matrix "$DATA_DIR/query.csv"
+    test_matrix "$OUTPUT_DIR/ragged.csv"
+
+    rm -f "$OUTPUT_DIR/c.txt" "$OUTPUT_DIR/ref.txt"
+
+    finish "Check the diff files in $OUTPUT_DIR for detailed differences"
+}
+
+main
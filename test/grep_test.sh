@@ -0,0 +1,108 @@
+#!/bin/bash
+
+# --grep consistency test for csview
+# A regular file is searched in its mapped bytes, a pipe record by record
+# through the parser; both must select the same records
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/grep"
+parse_options "$@"
+
+# Run one search on the file and on a pipe of it, expecting the same records
+# and, when given, a line of the file-path output containing expect
+run_grep()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local pattern="$3"
+    local args="$4"
+    local expect="$5"
+
+    begin_test "$test_name"
+
+    local file_output="$OUTPUT_DIR/${test_name}_file.txt"
+    local pipe_output="$OUTPUT_DIR/${test_name}_pipe.txt"
+    local log="$OUTPUT_DIR/${test_name}.log"
+    : > "$log"
+    "$C_VERSION" $args --grep "$pattern" "$data_file" > "$file_output" 2>&1
+    local file_exit_code=$?
+    "$C_VERSION" $args --grep "$pattern" < "$data_file" > "$pipe_output" 2>&1
+    local pipe_exit_code=$?
+
+    local test_passed=true
+    expect_same "$log" "file vs pipe" "$pipe_output" "$file_output" || test_passed=false
+    if [[ $file_exit_code -ne $pipe_exit_code ]]; then
+        echo "exit codes differ: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    if [[ -n "$expect" ]] && ! grep -qF -- "$expect" "$file_output"; then
+        echo "expected record not found: $expect" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Write the inputs whose stored bytes differ from the field text
+make_data()
+{
+    printf 'a,b\n"say ""hi"" now",x\nq"r,y\n"multi\nline ""x""",z\nplain,w\n' \
+        > "$OUTPUT_DIR/quotes.csv"
+    printf 'a,b\r\n"say ""hi"" now",x\r\n"one ""two""\r\nthree",y\r\n' \
+        > "$OUTPUT_DIR/quotes_crlf.csv"
+}
+
+# Test plain literals
+test_literals()
+{
+    echo -e "${CYAN}=== Literal Pattern Tests ===${NC}"
+
+    run_grep "literal_basic" "$DATA_DIR/basic.csv" "e" ""
+    run_grep "literal_missing" "$DATA_DIR/basic.csv" "no such text" ""
+    run_grep "literal_no_headers" "$DATA_DIR/basic.csv" "e" "-H"
+    run_grep "literal_unicode" "$DATA_DIR/unicode.csv" "é" ""
+    run_grep "literal_query" "$DATA_DIR/query.csv" "1" ""
+    run_grep "literal_delimiter" "$DATA_DIR/special_chars.csv" "Comma,Inside" "" "Comma,Inside"
+    run_grep "literal_newline_field" "$OUTPUT_DIR/quotes.csv" "line" "" "multi"
+}
+
+# Test literals containing quotes, stored doubled inside quoted fields
+test_quotes()
+{
+    echo -e "${CYAN}=== Quoted Pattern Tests ===${NC}"
+
+    run_grep "quote_inside_field" "$OUTPUT_DIR/quotes.csv" 'y "h' "" 'say "hi" now'
+    run_grep "quote_doubled_pair" "$OUTPUT_DIR/quotes.csv" '"hi"' "" 'say "hi" now'
+    run_grep "quote_bare" "$OUTPUT_DIR/quotes.csv" 'q"r' "" 'q"r'
+    run_grep "quote_only" "$OUTPUT_DIR/quotes.csv" '"' "" 'q"r'
+    run_grep "quote_multiline" "$OUTPUT_DIR/quotes.csv" 'e "x' "" 'line "x"'
+    run_grep "quote_column" "$OUTPUT_DIR/quotes.csv" 'y "h' "--grep-col a" 'say "hi" now'
+    run_grep "quote_other_column" "$OUTPUT_DIR/quotes.csv" 'y "h' "--grep-col b" ""
+    run_grep "quote_crlf" "$OUTPUT_DIR/quotes_crlf.csv" 'e "two"' "" 'one "two"'
+    run_grep "quote_special_chars" "$DATA_DIR/special_chars.csv" 'Quotes"Here' "" 'Quotes"Here'
+}
+
+# Test regular expressions, always matched on parsed fields
+test_regex()
+{
+    echo -e "${CYAN}=== Regex Pattern Tests ===${NC}"
+
+    run_grep "regex_anchor" "$DATA_DIR/basic.csv" "^[A-Z]" "--regex"
+    run_grep "regex_quote" "$OUTPUT_DIR/quotes.csv" '"hi"' "--regex" 'say "hi" now'
+}
+
+# Main test execution
+main()
+{
+    print_header "--grep Consistency"
+    check_executables
+    make_data
+
+    test_literals
+    test_quotes
+    test_regex
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,200 @@
+#!/bin/bash
+
+# --group-by test for csview
+# Groups are aggregated from a mapped file in slices or from a pipe record by
+# record. Both must print the groups awk computes from the same unquoted
+# input: in order of first appearance or by --sort-count, with the numeric
+# fields, as csview's number parser reads them, summed in file order.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/group_by"
+parse_options "$@"
+
+# Print the groups of an unquoted input as tab-separated rows under their
+# header, for 1-based key columns and aggregates in --agg syntax
+reference_groups()
+{
+    local data_file="$1"
+    local keys="$2"
+    local aggs="$3"
+    local sort_count="$4"
+
+    awk -F, -v keys="$keys" -v aggs="$aggs" -v sort_count="$sort_count" '
+        function numeric(s) {
+            return s ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/
+        }
+        function cell(kind, g, a) {
+            if (kind == "count")
+                return count[g]
+            if (!((g, a) in n))
+                return "-"
+            if (kind == "sum")
+                return sprintf("%.15g", sum[g, a])
+            if (kind == "avg")
+                return sprintf("%.6g", sum[g, a] / n[g, a])
+            return sprintf("%.15g", kind == "min" ? lo[g, a] : hi[g, a])
+        }
+        NF == 0 { next }
+        {
+            # The parser trims blanks around fields
+            for (i = 1; i <= NF; i++)
+                gsub(/^[ \t]+|[ \t]+$/, "", $i)
+        }
+        !header++ {
+            nk = split(keys, key, ",")
+            na = split(aggs, agg, ",")
+            line = ""
+            for (k = 1; k <= nk; k++)
+                line = line (k > 1 ? "\t" : "") $key[k]
+            for (a = 1; a <= na; a++) {
+                split(agg[a], part, ":")
+                kind[a] = part[1]
+                col[a] = part[2]
+                line = line "\t" (kind[a] == "count" ? "count" : kind[a] "(" $col[a] ")")
+            }
+            print "-999999999999\t0\t" line
+            next
+        }
+        {
+            g = ""
+            for (k = 1; k <= nk; k++)
+                g = g (k > 1 ? "\t" : "") $key[k]
+            if (!(g in count))
+                order[++groups] = g
+            count[g]++
+            for (a = 1; a <= na; a++) {
+                c = col[a]
+                if (c == "" || !numeric($c))
+                    continue
+                v = $c + 0
+                if (!((g, a) in n) || v < lo[g, a])
+                    lo[g, a] = v
+                if (!((g, a) in n) || v > hi[g, a])
+                    hi[g, a] = v
+                if ((g, a) in n)
+                    sum[g, a] += v
+                else
+                    sum[g, a] = v
+                n[g, a]++
+            }
+        }
+        END {
+            for (i = 1; i <= groups; i++) {
+                g = order[i]
+                line = g
+                for (a = 1; a <= na; a++)
+                    line = line "\t" cell(kind[a], g, a)
+                print (sort_count ? -count[g] : 0) "\t" i "\t" line
+            }
+        }' "$data_file" | sort -t $'\t' -k1,1n -k2,2n | cut -f 3-
+}
+
+# Group the file and a pipe of it, comparing both with awk's groups
+run_groups()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local keys="$3"
+    local aggs="$4"
+    local sort_count="$5"
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local args=(-P -s markdown --group-by "$keys" --agg "$aggs")
+    [[ -n "$sort_count" ]] && args+=(--sort-count)
+    "$C_VERSION" "${args[@]}" "$data_file" > "${prefix}_file.out" 2>> "$log"
+    local file_exit_code=$?
+    "$C_VERSION" "${args[@]}" < "$data_file" > "${prefix}_pipe.out" 2>> "$log"
+    local pipe_exit_code=$?
+    reference_groups "$data_file" "$keys" "$aggs" "$sort_count" > "$prefix.expected"
+    markdown_cells "${prefix}_file.out" > "${prefix}_file.cells"
+
+    local test_passed=true
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "awk vs csview" "$prefix.expected" "${prefix}_file.cells" ||
+        test_passed=false
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write rows unquoted records with keys of several lengths and values in every
+# number form, with fields that only look like numbers
+make_data()
+{
+    local rows="$1"
+    local data_file="$2"
+
+    awk -v rows="$rows" 'BEGIN {
+        split("1,-2.5,+3,.25,7.,1e3,-4E-2,007,0.1,x,,1e,--,5 ,2.5.1", forms, ",")
+        print "key,sub,value,weight"
+        for (i = 1; i <= rows; i++) {
+            key = i % 97 == 0 ? "lonely" i % 3 : "k" (i * 7 % 13)
+            printf "%s,s%d,%s,%d\n", key, i % 4, forms[i % 15 + 1], i % 1000 - 500
+        }
+    }' > "$data_file"
+}
+
+# Write groups without numbers and with tied counts
+make_edges()
+{
+    {
+        echo "key,value"
+        echo "only_text,abc"
+        echo "only_text,"
+        echo "tie_b,1"
+        echo "tie_a,2"
+        echo "tie_b,3"
+        echo "tie_a,4"
+    } > "$OUTPUT_DIR/edges.csv"
+}
+
+# Test the data files
+test_data_files()
+{
+    echo -e "${CYAN}=== Data File Tests ===${NC}"
+
+    run_groups "sectors_count" "$DATA_DIR/chinese_sectors.csv" 2 count
+    run_groups "sectors_aggs" "$DATA_DIR/chinese_sectors.csv" 1 "count,sum:3,avg:4,min:5,max:6"
+    run_groups "query_in" "$DATA_DIR/query.csv" 3 "count,sum:4,avg:6,min:14,max:21"
+    run_groups "query_dt" "$DATA_DIR/query.csv" 2,3 "count,avg:15,max:17" sort
+    run_groups "query_sorted" "$DATA_DIR/query.csv" 1 "count" sort
+}
+
+# Test generated inputs and number forms
+test_generated()
+{
+    echo -e "${CYAN}=== Generated Input Tests ===${NC}"
+
+    run_groups "generated" "$OUTPUT_DIR/generated.csv" 1 "count,sum:3,avg:3,min:3,max:3"
+    run_groups "generated_two_keys" "$OUTPUT_DIR/generated.csv" 1,2 "count,sum:4,avg:3"
+    run_groups "generated_sorted" "$OUTPUT_DIR/generated.csv" 2,1 "count,min:4,max:3" sort
+    run_groups "generated_large" "$OUTPUT_DIR/large.csv" 1,2 "count,sum:4,avg:3,max:4"
+    run_groups "edges" "$OUTPUT_DIR/edges.csv" 1 "count,sum:2,avg:2,min:2,max:2"
+    run_groups "edges_sorted" "$OUTPUT_DIR/edges.csv" 1 "count,sum:2" sort
+}
+
+# Main test execution
+main()
+{
+    print_header "Group By"
+    check_executables
+    # The large input is split into slices on worker threads
+    make_data 5000 "$OUTPUT_DIR/generated.csv"
+    make_data 600000 "$OUTPUT_DIR/large.csv"
+    make_edges
+
+    test_data_files
+    test_generated
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,195 @@
+#!/bin/bash
+
+# --index-key/--lookup test for csview
+# A lookup reads only the records the sidecar index points at. It must show
+# the records awk selects from the same file, in file order, whether the
+# index was built beforehand, on demand or rebuilt after the file changed.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/index"
+parse_options "$@"
+
+# Write a fixture file from stdin
+fixture()
+{
+    cat > "$OUTPUT_DIR/$1"
+}
+
+# Give the file an mtime old enough for its index to be stored
+age_file()
+{
+    touch -d '-1 min' "$1"
+}
+
+# Print the records of an unquoted file whose column is one of the values,
+# with the header, as tab-separated rows
+reference_lookup()
+{
+    local data_file="$1"
+    local column="$2"
+    local values="$3"
+
+    awk -F, -v OFS='\t' -v column="$column" -v values="$values" '
+        BEGIN {
+            n = split(values, list, ",")
+            for (i = 1; i <= n; i++)
+                wanted[list[i]] = 1
+        }
+        NR == 1 || $column in wanted { $1 = $1; print }' "$data_file"
+}
+
+# Look the values up, with every row sniffed so wide ids are not cut, and
+# compare the cells with awk's records
+run_lookup()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local column="$3"
+    local name="$4"
+    local values="$5"
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    reference_lookup "$data_file" "$column" "$values" > "$prefix.expected"
+    "$C_VERSION" -P -s markdown --sniff 0 --lookup "$name=$values" "$data_file" \
+        > "$prefix.out" 2> "$prefix.err"
+    local exit_code=$?
+    markdown_cells "$prefix.out" > "$prefix.cells"
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code: $(head -c 200 "$prefix.err")" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "awk vs csview" "$prefix.expected" "$prefix.cells" || test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Expect the number of sidecar indexes next to the file
+expect_indexes()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local expected="$3"
+
+    begin_test "$test_name"
+
+    local log="$OUTPUT_DIR/$test_name.log"
+    local count
+    count=$(find "$(dirname "$data_file")" -name "$(basename "$data_file").*.csvi" | wc -l)
+    : > "$log"
+    local test_passed=true
+    if [[ $count -ne $expected ]]; then
+        echo "expected $expected indexes, found $count" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Write unquoted records with repeated keys of several lengths
+make_data()
+{
+    awk 'BEGIN {
+        print "id,key,city,score"
+        split("北京|Paris|東京都|Rome|x", city, "|")
+        for (i = 1; i <= 20000; i++)
+            printf "%d,k%d,%s,%d\n", i, i * 7 % 997, city[i % 5 + 1], i % 101
+    }' > "$OUTPUT_DIR/large.csv"
+    age_file "$OUTPUT_DIR/large.csv"
+}
+
+# Test lookups through a prebuilt index and one built on demand
+test_lookups()
+{
+    echo -e "${CYAN}=== Lookup Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/large.csv"
+    rm -f "$data_file".*.csvi
+    "$C_VERSION" -P --index-key key "$data_file" > /dev/null 2>&1
+    expect_indexes "index_built" "$data_file" 1
+
+    run_lookup "one_key" "$data_file" 2 key "k5"
+    run_lookup "many_keys" "$data_file" 2 key "k996,k0,k5,k500"
+    run_lookup "missing_key" "$data_file" 2 key "nope"
+    run_lookup "on_demand" "$data_file" 3 city "東京都,x"
+    run_lookup "by_number" "$data_file" 4 score "0,100"
+    expect_indexes "index_per_column" "$data_file" 3
+}
+
+# Test that changes to the file rebuild its index
+test_changes()
+{
+    echo -e "${CYAN}=== Change Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/large.csv"
+    echo "20001,k5,Rome,7" >> "$data_file"
+    age_file "$data_file"
+    run_lookup "appended" "$data_file" 2 key "k5,k6"
+
+    # Same inode and size, new content and mtime
+    sed 's/^20001,k5,/20001,k6,/' "$data_file" > "$OUTPUT_DIR/rewritten.csv"
+    cat "$OUTPUT_DIR/rewritten.csv" > "$data_file"
+    touch -d '-2 min' "$data_file"
+    run_lookup "rewritten" "$data_file" 2 key "k5,k6"
+
+    # Just written files are read through a fresh index every time
+    echo "20002,k5,Oslo,8" >> "$data_file"
+    run_lookup "fresh" "$data_file" 2 key "k5"
+    echo "20003,k5,Oslo,9" >> "$data_file"
+    run_lookup "fresh_again" "$data_file" 2 key "k5"
+}
+
+# Test quoted fields, lookups by column number and the errors
+test_fixtures()
+{
+    echo -e "${CYAN}=== Fixture Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/quoted.csv"
+    printf 'id,key,note\n1,"a,b","x\ny"\n2,c,plain\n3,"a,b",z\n4,"""q""",w\n' > "$data_file"
+    age_file "$data_file"
+    fixture multiline.expected << 'EOF'
+| id | key | note |
+|----|-----|------|
+| 1  | a,b | x
+y    |
+| 3  | a,b | z    |
+EOF
+    fixture quote.expected << 'EOF'
+| id | key | note |
+|----|-----|------|
+| 4  | "q" | w    |
+EOF
+    fixture no_headers.expected << 'EOF'
+| 2 | c | plain |
+EOF
+    check_output "multiline" "$OUTPUT_DIR/multiline.expected" -s markdown --lookup id=3,1 \
+        "$data_file"
+    check_output "quote" "$OUTPUT_DIR/quote.expected" -s markdown --lookup 'key="q"' "$data_file"
+    check_output "no_headers" "$OUTPUT_DIR/no_headers.expected" -s markdown -H --lookup 2=c \
+        "$data_file"
+
+    check_error "pipe_input" "need an input file" --lookup key=a < "$data_file"
+    check_error "bad_lookup" "--lookup expects" --lookup key "$data_file"
+    check_error "unknown_column" "Unknown key column: nope" --lookup nope=a "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "Key Index"
+    check_executables
+    make_data
+
+    test_lookups
+    test_changes
+    test_fixtures
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,114 @@
+#!/bin/bash
+
+# Value interning test for csview
+# Low-cardinality columns of a buffered table share one copy per value that
+# carries its display width. Interning must not show: tables of inputs that
+# intern, fall back or change cardinality past the probe window must lay out
+# exactly as the text rules of export_check.py do on the plain values.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/intern"
+parse_options "$@"
+
+# Export the input as text and check it against the reference
+run_intern()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P --format text "$@" "$data_file" > "$prefix.out" 2>> "$log"
+    local exit_code=$?
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code" >> "$log"
+        test_passed=false
+    fi
+    if ! python3 "$TEST_DIR/export_check.py" text "$data_file" "$prefix.out" "$@" >> "$log" 2>&1; then
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Write rows records: a few values of several display widths, a column whose
+# values stay distinct, one that turns distinct after switch records and one
+# whose widest value first shows up there
+make_data()
+{
+    local rows="$1"
+    local switch="$2"
+    local data_file="$3"
+
+    awk -v rows="$rows" -v switch="$switch" 'BEGIN {
+        split("北京|Paris|東京都|Rome|😀 smile|São Paulo|x", city, "|")
+        split("ok|warn|fail", level, "|")
+        print "city,id,level,late,note"
+        for (i = 1; i <= rows; i++) {
+            late = i <= switch ? level[i % 3 + 1] : "v" i
+            note = i <= switch ? "n" i % 5 : (i % 7 == 0 ? "很长很长的备注" i % 5 : "n" i % 5)
+            printf "%s,%d,%s,%s,%s\n", city[i % 7 + 1], i * 7919, level[i % 3 + 1], late, note
+        }
+    }' > "$data_file"
+}
+
+# Test tables whose columns intern or fall back
+test_cardinality()
+{
+    echo -e "${CYAN}=== Cardinality Tests ===${NC}"
+
+    run_intern "default_sniff" "$OUTPUT_DIR/switch.csv"
+    run_intern "all_rows" "$OUTPUT_DIR/switch.csv" --sniff 0
+    run_intern "short_sniff" "$OUTPUT_DIR/switch.csv" --sniff 50
+    run_intern "long_sniff" "$OUTPUT_DIR/switch.csv" --sniff 8000
+    # The wide note first shows up in record 3003
+    run_intern "sniff_before_wide" "$OUTPUT_DIR/switch.csv" --sniff 3002
+    run_intern "sniff_to_wide" "$OUTPUT_DIR/switch.csv" --sniff 3003
+    run_intern "no_headers" "$OUTPUT_DIR/switch.csv" -H --sniff 0
+    run_intern "aligned" "$OUTPUT_DIR/switch.csv" --body-align right --sniff 0
+    run_intern "small" "$OUTPUT_DIR/small.csv" --sniff 0
+}
+
+# Test interned tables alongside records kept apart from the dictionary
+test_layouts()
+{
+    echo -e "${CYAN}=== Layout Tests ===${NC}"
+
+    run_intern "numbered" "$OUTPUT_DIR/switch.csv" -n --sniff 0
+    run_intern "ragged" "$OUTPUT_DIR/ragged.csv" --sniff 0
+    run_intern "cjk_file" "$DATA_DIR/cjk_mixed.csv" --sniff 0
+    run_intern "query" "$DATA_DIR/query.csv" --sniff 0
+    check_unchanged "spilled_text" "--max-memory 64K" file "$OUTPUT_DIR/switch.csv" \
+        --format text --sniff 0
+    check_unchanged "spilled_table" "--max-memory 64K" file "$OUTPUT_DIR/switch.csv" -s grid
+}
+
+# Main test execution
+main()
+{
+    print_header "Value Interning"
+    check_executables
+    require_python "lay out the reference text"
+    make_data 20000 3000 "$OUTPUT_DIR/switch.csv"
+    make_data 40 40 "$OUTPUT_DIR/small.csv"
+    { echo "a,b,c"; for ((i = 0; i < 500; i++)); do
+          case $((i % 3)) in
+          0) echo "x,y" ;;
+          1) echo "x,y,z,extra" ;;
+          2) echo "宽,y,z" ;;
+          esac
+      done; } > "$OUTPUT_DIR/ragged.csv"
+
+    test_cardinality
+    test_layouts
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
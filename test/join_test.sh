@@ -0,0 +1,263 @@
+#!/bin/bash
+
+# --join test for csview
+# Small fixtures must join into the expected cells, and generated inputs into
+# the rows awk joins from them, in memory and partitioned to temp files under
+# --max-memory, whether the input is a file or a pipe.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/join"
+parse_options "$@"
+
+# Write a fixture file from stdin
+fixture()
+{
+    cat > "$OUTPUT_DIR/$1"
+}
+
+# Run the join on the input file and a pipe of it, leaving the file's cells in
+# prefix.cells
+join_cells()
+{
+    local prefix="$1"
+    local log="$2"
+    local input="$3"
+    shift 3
+
+    "$C_VERSION" -P -s markdown "$@" "$input" > "${prefix}_file.out" 2> "$prefix.err"
+    local file_exit_code=$?
+    "$C_VERSION" -P -s markdown "$@" < "$input" > "${prefix}_pipe.out" 2>> "$prefix.err"
+    local pipe_exit_code=$?
+    markdown_cells "${prefix}_file.out" > "$prefix.cells"
+
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        return 1
+    fi
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out"
+}
+
+# Join the fixture input with the right one and compare the cells with the
+# expected ones on stdin, written with | between cells
+run_fixture()
+{
+    local test_name="$1"
+    local input="$OUTPUT_DIR/$2"
+    local right="$OUTPUT_DIR/$3"
+    shift 3
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    tr '|' '\t' > "$prefix.expected"
+
+    local test_passed=true
+    join_cells "$prefix" "$log" "$input" --join "$right" "$@" || test_passed=false
+    expect_same "$log" "expected vs csview" "$prefix.expected" "$prefix.cells" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Print the rows awk joins from the generated files on their key columns, the
+# input's second and the right side's first, in sorted order
+reference_join()
+{
+    local input="$1"
+    local right="$2"
+    local left="$3"
+
+    awk -F, -v OFS='\t' -v left="$left" '
+        FNR == NR {
+            if (FNR == 1)
+                right_header = $2 OFS $3
+            else
+                rows[$1] = rows[$1] "\n" $2 OFS $3
+            next
+        }
+        {
+            key = $2
+            gsub(/,/, OFS)
+        }
+        FNR == 1 { print $0, right_header; next }
+        key in rows {
+            n = split(substr(rows[key], 2), matched, "\n")
+            for (i = 1; i <= n; i++)
+                print $0, matched[i]
+            next
+        }
+        left { print $0, "", "" }' "$right" "$input" | sort
+}
+
+# Join the generated files and compare the sorted cells with awk's rows
+run_generated()
+{
+    local test_name="$1"
+    local left="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local input="$OUTPUT_DIR/users.csv"
+    local right="$OUTPUT_DIR/groups.csv"
+    reference_join "$input" "$right" "$left" > "$prefix.expected"
+    local args=(--join "$right" --on group=code "$@")
+    [[ -n "$left" ]] && args+=(--left)
+
+    local test_passed=true
+    join_cells "$prefix" "$log" "$input" "${args[@]}" || test_passed=false
+    sort "$prefix.cells" > "$prefix.sorted"
+    expect_same "$log" "awk vs csview, sorted" "$prefix.expected" "$prefix.sorted" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write the fixtures and the generated inputs, whose groups repeat on the
+# right and are missing for some users
+make_data()
+{
+    fixture people.csv << 'EOF'
+id,name,cid
+1,Alice,FR
+2,"Bob, Jr",UK
+3,Cara,IT
+4,Dan,XX
+5,Eve,FR
+EOF
+    fixture countries.csv << 'EOF'
+code,country,cap
+FR,France,Paris
+UK,United Kingdom,London
+IT,Italy,Rome
+DE,Germany,Berlin
+FR,France2,Lyon
+EOF
+    fixture regions_left.csv << 'EOF'
+r,k,v
+eu,1,a
+us,1,b
+eu,2,c
+EOF
+    fixture regions_right.csv << 'EOF'
+k,r,w
+1,eu,X
+2,us,Y
+1,eu,Z
+EOF
+
+    awk 'BEGIN {
+        print "id,group,score"
+        for (i = 1; i <= 6000; i++)
+            printf "%d,g%d,%d\n", i, i * 7 % 450, i * 13 % 101
+    }' > "$OUTPUT_DIR/users.csv"
+    awk 'BEGIN {
+        print "code,label,rank"
+        for (i = 0; i < 800; i++)
+            if (i % 5 != 0)
+                printf "g%d,label%d,%d\n", i % 400, i, i % 9
+    }' > "$OUTPUT_DIR/groups.csv"
+}
+
+# Test the fixtures
+test_fixtures()
+{
+    echo -e "${CYAN}=== Fixture Tests ===${NC}"
+
+    run_fixture "inner" people.csv countries.csv --on cid=code << 'EOF'
+id|name|cid|country|cap
+1|Alice|FR|France|Paris
+5|Eve|FR|France|Paris
+2|Bob, Jr|UK|United Kingdom|London
+3|Cara|IT|Italy|Rome
+1|Alice|FR|France2|Lyon
+5|Eve|FR|France2|Lyon
+EOF
+    run_fixture "left" people.csv countries.csv --on cid=code --left << 'EOF'
+id|name|cid|country|cap
+1|Alice|FR|France|Paris
+5|Eve|FR|France|Paris
+2|Bob, Jr|UK|United Kingdom|London
+3|Cara|IT|Italy|Rome
+1|Alice|FR|France2|Lyon
+5|Eve|FR|France2|Lyon
+4|Dan|XX||
+EOF
+    run_fixture "left_partitioned" people.csv countries.csv --on cid=code --left \
+        --max-memory 1K << 'EOF'
+id|name|cid|country|cap
+1|Alice|FR|France|Paris
+5|Eve|FR|France|Paris
+2|Bob, Jr|UK|United Kingdom|London
+3|Cara|IT|Italy|Rome
+1|Alice|FR|France2|Lyon
+5|Eve|FR|France2|Lyon
+4|Dan|XX||
+EOF
+    run_fixture "two_columns" regions_left.csv regions_right.csv --on r,k << 'EOF'
+r|k|v|w
+eu|1|a|X
+eu|1|a|Z
+EOF
+    run_fixture "same_name" regions_left.csv regions_right.csv --on k << 'EOF'
+r|k|v|r|w
+eu|1|a|eu|X
+eu|1|a|eu|Z
+us|1|b|eu|X
+us|1|b|eu|Z
+eu|2|c|us|Y
+EOF
+    run_fixture "no_headers" regions_left.csv regions_right.csv -H --on 2=1 << 'EOF'
+r|k|v|r|w
+eu|1|a|eu|X
+eu|1|a|eu|Z
+us|1|b|eu|X
+us|1|b|eu|Z
+eu|2|c|us|Y
+EOF
+}
+
+# Test generated inputs against awk, in memory and partitioned
+test_generated()
+{
+    echo -e "${CYAN}=== Generated Input Tests ===${NC}"
+
+    run_generated "generated_inner" ""
+    run_generated "generated_left" left
+    run_generated "generated_partitioned" "" --max-memory 4K
+    run_generated "generated_left_partitioned" left --max-memory 4K
+}
+
+# Test the errors
+test_errors()
+{
+    echo -e "${CYAN}=== Error Tests ===${NC}"
+
+    check_error "unknown_column" "Unknown join column: nope" \
+        --join "$OUTPUT_DIR/countries.csv" --on nope "$OUTPUT_DIR/people.csv"
+    check_error "missing_on" "--join and --on must be used together" \
+        --join "$OUTPUT_DIR/countries.csv" "$OUTPUT_DIR/people.csv"
+    check_error "missing_right" "missing.csv" \
+        --join "$OUTPUT_DIR/missing.csv" --on cid=code "$OUTPUT_DIR/people.csv"
+}
+
+# Main test execution
+main()
+{
+    print_header "Join"
+    check_executables
+    make_data
+
+    test_fixtures
+    test_generated
+    test_errors
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,172 @@
+#!/bin/bash
+
+# Parser fast path differential test for csview
+# Quote-free input is split without libcsv until the first quote shows up,
+# where libcsv takes over at a record boundary. A quoted empty record put in
+# front of the same input makes libcsv parse all of it, so both runs must
+# produce the same records after that first one.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/parser"
+RANDOM_INPUTS=450
+SEED=1
+EXTRA_OPTIONS="n:r:"
+
+extra_usage()
+{
+    echo "  -n <num>     Random inputs per mode, quote-free and mixed (default: 450)"
+    echo "  -r <seed>    First random seed (default: 1)"
+}
+
+handle_option()
+{
+    case $1 in
+    n) RANDOM_INPUTS="$2" ;;
+    r) SEED="$2" ;;
+    *) return 1 ;;
+    esac
+}
+
+parse_options "$@"
+
+# Compare one output of the input with the same output of the libcsv run,
+# minus the leading empty record
+compare_run()
+{
+    local log="$1"
+    local label="$2"
+    local data_file="$3"
+    local forced_file="$4"
+    local pipe="$5"
+    shift 5
+
+    local fast="$OUTPUT_DIR/fast.txt"
+    local reference="$OUTPUT_DIR/reference.txt"
+    if [[ "$pipe" == true ]]; then
+        "$C_VERSION" "$@" < "$data_file" > "$fast" 2>&1
+        "$C_VERSION" "$@" < "$forced_file" 2>&1 | tail -n +2 > "$reference"
+    else
+        "$C_VERSION" "$@" "$data_file" > "$fast" 2>&1
+        "$C_VERSION" "$@" "$forced_file" 2>&1 | tail -n +2 > "$reference"
+    fi
+
+    if ! cmp -s "$fast" "$reference"; then
+        echo "$label ($*):" >> "$log"
+        diff -u "$reference" "$fast" | head -20 >> "$log"
+        return 1
+    fi
+    return 0
+}
+
+# Parse the input on the fast path and through libcsv, as records and as a table
+run_parser()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local options="$3"
+
+    begin_test "$test_name ($options, $(wc -c < "$data_file") bytes)"
+
+    local forced_file="$OUTPUT_DIR/forced.csv"
+    { printf '""\n'; cat "$data_file"; } > "$forced_file"
+
+    local test_passed=true
+    local log="$OUTPUT_DIR/${test_name}.log"
+    : > "$log"
+
+    # NDJSON streams records as parsed, the table also measures every width
+    compare_run "$log" "file records" "$data_file" "$forced_file" false $options -H --format ndjson ||
+        test_passed=false
+    compare_run "$log" "pipe records" "$data_file" "$forced_file" true $options -H --format ndjson ||
+        test_passed=false
+    compare_run "$log" "file table" "$data_file" "$forced_file" false $options -H -s none --sniff 0 ||
+        test_passed=false
+    compare_run "$log" "pipe table" "$data_file" "$forced_file" true $options -H -s none --sniff 0 ||
+        test_passed=false
+
+    if [[ "$test_passed" == true ]]; then
+        rm -f "$log"
+    else
+        cp "$data_file" "$OUTPUT_DIR/${test_name}.csv"
+    fi
+    end_test "$test_passed" "$log" "input kept as $OUTPUT_DIR/${test_name}.csv"
+}
+
+# Test line endings, blank lines and fields across read chunks
+test_edge_cases()
+{
+    echo -e "${CYAN}=== Edge Case Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/input.csv"
+    local long_field
+    long_field=$(head -c 70000 /dev/zero | tr '\0' 'x')
+
+    printf 'a,b\r1,2\r3,4\r' > "$data_file"
+    run_parser "cr_only" "$data_file" "-d ,"
+    printf 'a,b\r\n1,2\r\n3,4' > "$data_file"
+    run_parser "crlf_unterminated" "$data_file" "-d ,"
+    printf 'a,b\n1,2\r\n3,4\r5,6\n' > "$data_file"
+    run_parser "mixed_line_ends" "$data_file" "-d ,"
+    printf '\n\na,b\n\n \n1,2\n\t\n\n3,4\n\n' > "$data_file"
+    run_parser "blank_lines" "$data_file" "-d ,"
+    printf '\r\n\r\na;b\r\n\r\n1;2\r\n' > "$data_file"
+    run_parser "blank_crlf_lines" "$data_file" "-d ;"
+    printf ' a , b \n 1 ,\t2\t\n,\n' > "$data_file"
+    run_parser "padded_fields" "$data_file" "-d ,"
+
+    # Fields that end past BUFFER_SIZE and MEMORY_SLICE of the reader
+    printf 'a,b\n1,%s\n2,%s\r\n3,y\n' "${long_field:0:9000}" "$long_field" > "$data_file"
+    run_parser "chunk_spanning_field" "$data_file" "-d ,"
+    { for ((i = 0; i < 3000; i++)); do printf '%d,%s\r\n' "$i" "${long_field:0:$((i % 97))}"; done; } \
+        > "$data_file"
+    run_parser "chunk_spanning_crlf" "$data_file" "-d ,"
+
+    # The first quote far into the file hands the rest over to libcsv
+    { for ((i = 0; i < 5000; i++)); do printf '%d,plain\n' "$i"; done
+      printf '"q,1","multi\nline ""x"""\n9,after\n'; } > "$data_file"
+    run_parser "quote_handoff" "$data_file" "-d ,"
+    { for ((i = 0; i < 5000; i++)); do printf '%d,plain\r\n' "$i"; done
+      printf '%s,"a\r\nb"\r\n9,after' "$long_field"; } > "$data_file"
+    run_parser "quote_handoff_crlf" "$data_file" "-d ,"
+    { for ((i = 0; i < 5000; i++)); do printf '%d\tpla"in\n' "$i"; done; } > "$data_file"
+    run_parser "quote_inside_field" "$data_file" "-t"
+
+    rm -f "$data_file"
+}
+
+# Test generated inputs of one mode
+test_random_inputs()
+{
+    local mode="$1"
+    local data_file="$OUTPUT_DIR/input.csv"
+
+    for ((i = 0; i < RANDOM_INPUTS; i++)); do
+        local seed=$((SEED + i))
+        local options
+        options=$(python3 "$TEST_DIR/random_csv.py" "$seed" "$data_file" "$mode")
+        run_parser "${mode}_${seed}" "$data_file" "$options"
+    done
+    rm -f "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "Parser Fast Path"
+    check_executables
+    require_python "generate the random inputs"
+
+    test_edge_cases
+
+    echo -e "${CYAN}=== Quote-free Inputs ===${NC}"
+    test_random_inputs plain
+
+    echo -e "${CYAN}=== Inputs with Quoted Fields ===${NC}"
+    test_random_inputs mixed
+
+    rm -f "$OUTPUT_DIR/forced.csv" "$OUTPUT_DIR/fast.txt" "$OUTPUT_DIR/reference.txt"
+
+    finish "Check the inputs and logs in $OUTPUT_DIR"
+}
+
+main
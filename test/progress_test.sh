@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# --progress test for csview
+# The progress line goes to the terminal and a SIGUSR1 dump to stderr, so
+# every mode must print the same stdout with --progress as without, keep a
+# redirected stderr clear, and answer SIGUSR1 with a status line instead of
+# dying.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/progress"
+parse_options "$@"
+
+# Run the mode with and without --progress on the file and a pipe of it
+run_progress()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    check_unchanged "${test_name}_file" "--progress" file "$data_file" "$@"
+    check_unchanged "${test_name}_pipe" "--progress" pipe "$data_file" "$@"
+}
+
+# Test stdout across the modes that report progress
+test_modes()
+{
+    echo -e "${CYAN}=== Mode Tests ===${NC}"
+
+    run_progress "table" "$OUTPUT_DIR/large.csv"
+    run_progress "table_spilled" "$OUTPUT_DIR/large.csv" --max-memory 64K -n
+    run_progress "vertical" "$DATA_DIR/query.csv" -x
+    run_progress "ndjson" "$OUTPUT_DIR/large.csv" --format ndjson
+    run_progress "text" "$DATA_DIR/wide_unicode.csv" --format text
+    run_progress "count" "$OUTPUT_DIR/large.csv" --count
+    run_progress "group_by" "$OUTPUT_DIR/large.csv" --group-by 2
+    run_progress "grep" "$OUTPUT_DIR/large.csv" --grep 99
+    run_progress "summary" "$DATA_DIR/numbers_mixed.csv" --summary
+    run_progress "sketch" "$OUTPUT_DIR/large.csv" --sketch
+    run_progress "top" "$OUTPUT_DIR/large.csv" --top 5 --by 3:num
+}
+
+# Test that stderr stays clear without a terminal
+test_quiet()
+{
+    echo -e "${CYAN}=== Quiet Stderr Tests ===${NC}"
+
+    begin_test "quiet_stderr"
+    local log="$OUTPUT_DIR/quiet_stderr.log"
+    : > "$log"
+    local err
+    for err in "$OUTPUT_DIR"/*_extra.err; do
+        if [[ -s "$err" ]]; then
+            echo "$err: $(head -c 200 "$err")" >> "$log"
+        fi
+    done
+    local test_passed=true
+    [[ -s "$log" ]] && test_passed=false
+    end_test "$test_passed" "$log"
+}
+
+# Test a SIGUSR1 dump while a slow pipe is read
+test_signal()
+{
+    echo -e "${CYAN}=== Signal Tests ===${NC}"
+
+    begin_test "sigusr1_dump"
+    local prefix="$OUTPUT_DIR/sigusr1"
+    local log="$prefix.log"
+    : > "$log"
+    { head -n 1000 "$OUTPUT_DIR/large.csv"; sleep 1; tail -n 5 "$OUTPUT_DIR/large.csv"; } |
+        "$C_VERSION" -P -x --progress > "$prefix.out" 2> "$prefix.err" &
+    local pid=$!
+    sleep 0.5
+    kill -USR1 "$pid" 2> /dev/null
+    wait "$pid"
+    local exit_code=$?
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code" >> "$log"
+        test_passed=false
+    fi
+    if ! grep -q '^csview: .* rows ' "$prefix.err"; then
+        echo "no status line on stderr: $(head -c 200 "$prefix.err")" >> "$log"
+        test_passed=false
+    fi
+    if ! tail -n 2 "$prefix.out" | grep -q "$(tail -n 1 "$OUTPUT_DIR/large.csv" | cut -d, -f3)"; then
+        echo "the records after the signal are missing" >> "$log"
+        test_passed=false
+    fi
+    end_test "$test_passed" "$log"
+}
+
+# Main test execution
+main()
+{
+    print_header "Progress"
+    check_executables
+    awk 'BEGIN {
+        print "id,group,value"
+        for (i = 1; i <= 200000; i++)
+            printf "%d,g%d,%d\n", i, i % 17, i * 7919 % 100003
+    }' > "$OUTPUT_DIR/large.csv"
+
+    test_modes
+    test_quiet
+    test_signal
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
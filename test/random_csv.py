@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+
+# Random CSV generator for the consistency tests
+#
+# Usage: random_csv.py SEED OUTPUT [plain|mixed] [MIN_BYTES]
+#
+# plain inputs never contain a quote, mixed ones start quoting somewhere in
+# the file, possibly past the first parser chunk. Both mix delimiters, LF,
+# CRLF and bare CR line ends, blank and whitespace-only lines, ragged rows and
+# fields long enough to span read chunks. The delimiter is printed as the
+# csview option selecting it.
+
+import random
+import sys
+
+DELIMITERS = [(",", "-d ,"), (",", "-d ,"), ("\t", "-t"), (";", "-d ;"), ("|", "-d |")]
+TERMINATORS = ["\n", "\n", "\n", "\r\n", "\r", "\n\n", "\n  \n", "\r\n\r\n", "\n\t\n"]
+PIECES = ["a", "bb", "x y", "1.5", "-7", "", " ", "é", "日本", "🙂", "ab\tc"]
+
+
+def plain_field(r, delim):
+    if r.random() < 0.01:
+        text = "z" * r.choice([3000, 9000, 70000])  # Past BUFFER_SIZE or MEMORY_SLICE
+    else:
+        text = r.choice(PIECES)
+    text = text.replace(delim, "")
+    return r.choice(["", "", " ", "\t"]) + text + r.choice(["", "", " ", "  "])
+
+
+def quoted_field(r, delim):
+    inner = r.choice(['say ""hi""', "a" + delim + "b", "line\nbreak", "cr\r\nlf", "", '""', "q"])
+    if r.random() < 0.01:
+        inner += "w" * 70000
+    return '"' + inner + '"'
+
+
+def main():
+    seed = int(sys.argv[1])
+    path = sys.argv[2]
+    mode = sys.argv[3] if len(sys.argv) > 3 else "plain"
+    min_bytes = int(sys.argv[4]) if len(sys.argv) > 4 else 0
+
+    r = random.Random(seed)
+    delim, option = r.choice(DELIMITERS)
+    quote_from = r.choice([0, 1, 5, 50, 400, 2000]) if mode == "mixed" else None
+
+    parts = []
+    size = 0
+    rows = r.randint(0, 400)
+    i = 0
+    while i < rows or size < min_bytes:
+        count = r.randint(1, 6)
+        fields = []
+        for _ in range(count):
+            if quote_from is not None and i >= quote_from and r.random() < 0.3:
+                fields.append(quoted_field(r, delim))
+            else:
+                fields.append(plain_field(r, delim))
+        if r.random() < 0.05:
+            fields = [""]
+        line = delim.join(fields) + r.choice(TERMINATORS)
+        parts.append(line)
+        size += len(line)
+        i += 1
+
+    text = "".join(parts)
+    if r.random() < 0.3:
+        text = text.rstrip("\r\n")  # No line break after the last record
+    if r.random() < 0.1:
+        text = r.choice(["\n", "\r\n", "\r", "  \n"]) + text
+
+    with open(path, "w", encoding="utf-8", newline="") as out:
+        out.write(text)
+    print(option)
+
+
+if __name__ == "__main__":
+    main()
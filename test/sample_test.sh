@@ -0,0 +1,161 @@
+#!/bin/bash
+
+# --sample test for csview
+# A mapped file is sampled at random byte offsets moved to record starts, a
+# pipe through a reservoir. Either way the sample must hold the asked number
+# of distinct records of the input in file order, -n must print their record
+# numbers, and a --seed must repeat the same sample.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/sample"
+parse_options "$@"
+
+# Write records whose id is their record number and whose value follows from
+# it, every tenth one breaking its value over two lines when multiline is set
+make_data()
+{
+    local rows="$1"
+    local multiline="$2"
+    local data_file="$3"
+
+    awk -v rows="$rows" -v multiline="$multiline" 'BEGIN {
+        print "id,value"
+        for (i = 1; i <= rows; i++) {
+            if (multiline && i % 10 == 0)
+                printf "%07d,\"v%04d\nmore\"\n", i, i * 7 % 10000
+            else
+                printf "%07d,v%04d\n", i, i * 7 % 10000
+        }
+    }' > "$data_file"
+}
+
+# Print the problems of a -s none -n sample of a make_data input, expecting
+# want records
+check_records()
+{
+    local output="$1"
+    local want="$2"
+
+    awk -v want="$want" '
+        NR == 1 { next }
+        $1 !~ /^[0-9]+$/ { next }
+        {
+            rows++
+            id = $2 + 0
+            if ($1 + 0 != id)
+                print "line " NR ": numbered " $1 " but record " id
+            if ($3 != sprintf("v%04d", id * 7 % 10000))
+                print "line " NR ": record " id " holds " $3
+            if (id <= last)
+                print "line " NR ": record " id " after " last
+            last = id
+        }
+        END {
+            if (rows != want)
+                print "expected " want " records, got " rows + 0
+        }' "$output"
+}
+
+# Sample the input and check the records, then repeat the seed
+run_sample()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local input="$3"
+    local want="$4"
+    local count="$5"
+    local seed="$6"
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local args=(-P -s none -n --sample "$count" --seed "$seed")
+    for run in first second; do
+        if [[ "$input" == pipe ]]; then
+            cat "$data_file" | "$C_VERSION" "${args[@]}" > "${prefix}_$run.out" 2>> "$log"
+        else
+            "$C_VERSION" "${args[@]}" "$data_file" > "${prefix}_$run.out" 2>> "$log"
+        fi
+    done
+
+    local test_passed=true
+    check_records "${prefix}_first.out" "$want" >> "$log"
+    [[ -s "$log" ]] && test_passed=false
+    expect_same "$log" "same seed" "${prefix}_first.out" "${prefix}_second.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Expect every tenth of the file to be picked about as often over many seeds
+run_spread()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local rows="$3"
+    local seeds=200
+    local count=10
+
+    begin_test "$test_name"
+
+    local log="$OUTPUT_DIR/$test_name.log"
+    : > "$log"
+    for ((seed = 1; seed <= seeds; seed++)); do
+        "$C_VERSION" -P -s none --sample "$count" --seed "$seed" "$data_file"
+    done | awk -v rows="$rows" -v picks=$((seeds * count)) '
+        $1 ~ /^[0-9]+$/ { tenth[int(($1 - 1) * 10 / rows)]++ }
+        END {
+            for (i = 0; i < 10; i++) {
+                if (tenth[i] < picks / 10 * 0.7 || tenth[i] > picks / 10 * 1.3)
+                    print "tenth " i + 1 " of the file picked " tenth[i] + 0 " of " picks " times"
+            }
+        }' >> "$log"
+
+    local test_passed=true
+    [[ -s "$log" ]] && test_passed=false
+    end_test "$test_passed" "$log"
+}
+
+# Test samples of files large enough to be probed at byte offsets
+test_probed()
+{
+    echo -e "${CYAN}=== Probed File Tests ===${NC}"
+
+    run_sample "probed" "$OUTPUT_DIR/large.csv" file 20 20 1
+    run_sample "probed_seed" "$OUTPUT_DIR/large.csv" file 20 20 987654321
+    run_sample "probed_many" "$OUTPUT_DIR/large.csv" file 1000 1000 7
+    run_sample "probed_multiline" "$OUTPUT_DIR/multiline.csv" file 50 50 3
+    run_spread "probed_spread" "$OUTPUT_DIR/large.csv" 100000
+}
+
+# Test samples drawn from every record
+test_exact()
+{
+    echo -e "${CYAN}=== Reservoir Tests ===${NC}"
+
+    run_sample "pipe" "$OUTPUT_DIR/large.csv" pipe 20 20 1
+    run_sample "pipe_multiline" "$OUTPUT_DIR/multiline.csv" pipe 50 50 3
+    run_sample "small_file" "$OUTPUT_DIR/small.csv" file 10 10 5
+    run_sample "small_pipe" "$OUTPUT_DIR/small.csv" pipe 10 10 5
+    run_sample "all_records" "$OUTPUT_DIR/small.csv" file 30 100 2
+    run_sample "all_records_pipe" "$OUTPUT_DIR/small.csv" pipe 30 100 2
+}
+
+# Main test execution
+main()
+{
+    print_header "Sample"
+    check_executables
+    make_data 100000 "" "$OUTPUT_DIR/large.csv"
+    make_data 100000 1 "$OUTPUT_DIR/multiline.csv"
+    make_data 30 "" "$OUTPUT_DIR/small.csv"
+
+    test_probed
+    test_exact
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
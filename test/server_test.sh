@@ -0,0 +1,195 @@
+#!/bin/bash
+
+# --serve/--client test for csview
+# Starts a daemon on a temporary socket and checks that its replies match
+# local runs byte for byte, cached table renders and other modes alike, and
+# that request errors reach the client's stderr and exit status.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/server"
+SERVER_PID=""
+parse_options "$@"
+
+SOCKET_DIR=$(mktemp -d "${TMPDIR:-/tmp}/csview-test.XXXXXX")
+SOCKET="$SOCKET_DIR/csview.sock"
+
+stop_server()
+{
+    if [[ -n "$SERVER_PID" ]]; then
+        kill -TERM "$SERVER_PID" 2> /dev/null
+        wait "$SERVER_PID" 2> /dev/null
+        SERVER_PID=""
+    fi
+    rm -rf "$SOCKET_DIR"
+}
+trap stop_server EXIT
+
+# Start the daemon in another directory and wait for its socket, so that
+# relative paths resolved against the daemon's directory fail
+start_server()
+{
+    local server
+    server=$(realpath "$C_VERSION")
+    (cd "$SOCKET_DIR" && exec "$server" --serve "$SOCKET") 2> "$OUTPUT_DIR/server.err" &
+    SERVER_PID=$!
+
+    for ((i = 0; i < 50; i++)); do
+        [[ -S "$SOCKET" ]] && return 0
+        sleep 0.1
+    done
+    echo -e "${RED}Error: the server did not open $SOCKET${NC}"
+    cat "$OUTPUT_DIR/server.err"
+    exit 1
+}
+
+# Run the arguments locally and through the daemon, expecting the same
+# stdout, stderr and exit status
+run_client()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local args="$3"
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    "$C_VERSION" -P $args "$data_file" > "${prefix}_local.txt" 2> "${prefix}_local.err"
+    local local_exit_code=$?
+    "$C_VERSION" -P --client "$SOCKET" $args "$data_file" > "${prefix}_client.txt" \
+        2> "${prefix}_client.err"
+    local client_exit_code=$?
+
+    local test_passed=true
+    local log="${prefix}_diff.txt"
+    : > "$log"
+    expect_same "$log" "output" "${prefix}_local.txt" "${prefix}_client.txt" || test_passed=false
+    expect_same "$log" "error output" "${prefix}_local.err" "${prefix}_client.err" ||
+        test_passed=false
+    if [[ $local_exit_code -ne $client_exit_code ]]; then
+        echo "exit codes differ: local=$local_exit_code, client=$client_exit_code" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Run a failing request through the daemon, expecting message on stderr
+run_client_error()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local args="$3"
+    local message="$4"
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    "$C_VERSION" -P --client "$SOCKET" $args "$data_file" > "${prefix}_client.txt" \
+        2> "${prefix}_client.err"
+    local client_exit_code=$?
+
+    local test_passed=true
+    local log="${prefix}.log"
+    : > "$log"
+    if ! grep -qF -- "$message" "${prefix}_client.err"; then
+        echo "missing message on stderr: $message" >> "$log"
+        test_passed=false
+    fi
+    if [[ $client_exit_code -eq 0 ]]; then
+        echo "exit code is 0" >> "$log"
+        test_passed=false
+    fi
+    if grep -qF -- "$message" "$OUTPUT_DIR/server.err"; then
+        echo "message went to the server's stderr" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Test table renders answered from the cached table
+test_cached_tables()
+{
+    echo -e "${CYAN}=== Cached Table Tests ===${NC}"
+
+    run_client "plain" "$DATA_DIR/basic.csv" ""
+    run_client "plain_again" "$DATA_DIR/basic.csv" ""
+    run_client "style_number" "$DATA_DIR/unicode.csv" "-s rounded -n"
+    run_client "no_headers" "$DATA_DIR/cjk_mixed.csv" "-H --body-align right"
+    run_client "rows" "$DATA_DIR/query.csv" "--rows 10-20"
+    run_client "rows_open_end" "$DATA_DIR/query.csv" "--rows 5990-"
+    run_client "columns" "$DATA_DIR/basic.csv" "--columns 3,1"
+    run_client "columns_rows" "$DATA_DIR/query.csv" "--columns 2 --rows -5 -s grid"
+    run_client "tsv" "$DATA_DIR/tsv_data.tsv" "-t"
+    run_client "multiline" "$DATA_DIR/special_chars.csv" "-s markdown"
+}
+
+# Test modes the daemon runs outside the cache
+test_other_modes()
+{
+    echo -e "${CYAN}=== Other Mode Tests ===${NC}"
+
+    run_client "summary" "$DATA_DIR/numbers_mixed.csv" "--summary"
+    run_client "count" "$DATA_DIR/query.csv" "--count"
+    run_client "grep" "$DATA_DIR/query.csv" "--grep 11"
+    run_client "group_by" "$DATA_DIR/chinese_sectors.csv" "--group-by 1"
+    run_client "vertical" "$DATA_DIR/emoji_data.csv" "-x"
+    run_client "ndjson" "$DATA_DIR/special_chars.csv" "--format ndjson"
+    run_client "text" "$DATA_DIR/wide_columns.csv" "--format text"
+    run_client "diff" "$DATA_DIR/basic.csv" "--diff $DATA_DIR/empty_fields.csv --key name"
+    run_client "join" "$DATA_DIR/basic.csv" "--join=$DATA_DIR/empty_fields.csv --on name"
+}
+
+# Test that request errors come back to the client
+test_errors()
+{
+    echo -e "${CYAN}=== Error Tests ===${NC}"
+
+    run_client "error_local_match" "$DATA_DIR/basic.csv" "--group-by nope"
+    run_client_error "error_group_by" "$DATA_DIR/basic.csv" "--group-by nope" "Unknown column: nope"
+    run_client_error "error_columns" "$DATA_DIR/basic.csv" "--columns nope" "Unknown column: nope"
+    run_client_error "error_regex" "$DATA_DIR/basic.csv" "--grep ( --regex" "Invalid regex"
+    run_client_error "error_lookup" "$DATA_DIR/basic.csv" "--lookup bad" "--lookup expects"
+    run_client_error "error_missing_file" "$OUTPUT_DIR/missing.csv" "" "missing.csv"
+}
+
+# Test that --serve never replaces a file that is not a socket
+test_serve_path()
+{
+    echo -e "${CYAN}=== Serve Path Tests ===${NC}"
+
+    begin_test "serve_on_regular_file"
+
+    local victim="$SOCKET_DIR/victim.csv"
+    local log="$OUTPUT_DIR/victim.log"
+    cp "$DATA_DIR/basic.csv" "$victim"
+    : > "$log"
+    local test_passed=true
+    if timeout 5 "$C_VERSION" --serve "$victim" > /dev/null 2>> "$log"; then
+        echo "exit code is 0" >> "$log"
+        test_passed=false
+    fi
+    if ! cmp -s "$DATA_DIR/basic.csv" "$victim"; then
+        echo "the file was replaced" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Main test execution
+main()
+{
+    print_header "Server"
+    check_executables
+    start_server
+
+    test_cached_tables
+    test_other_modes
+    test_errors
+    test_serve_path
+
+    finish "Check the diff files in $OUTPUT_DIR for detailed differences"
+}
+
+main
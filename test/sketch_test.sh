@@ -0,0 +1,198 @@
+#!/bin/bash
+
+# --sketch test for csview
+# Value and empty counts must be exact, distinct counts within 5% of sort -u,
+# quantiles within 3% in rank of the exact ones and the heavy hitters shown
+# with their shares, whether the input is a pipe, a file or a file sketched
+# in slices on worker threads.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/sketch"
+parse_options "$@"
+
+# Compare the sketch cells with the exact statistics of an unquoted file,
+# printing one line per estimate out of bounds
+check_sketch()
+{
+    local cells="$1"
+    local data_file="$2"
+    local headers="$3"
+
+    awk -F'\t' -v headers="$headers" '
+        FNR == NR {
+            if (FNR > 1)
+                row[$1] = $0
+            next
+        }
+        FNR == 1 {
+            FS = ","
+            $0 = $0
+            for (c = 1; c <= NF; c++)
+                name[c] = headers ? $c : c
+            columns = NF
+            if (headers)
+                next
+        }
+        {
+            for (c = 1; c <= columns; c++) {
+                if (c > NF || $c == "") {
+                    empty[c]++
+                    continue
+                }
+                values[c]++
+                if (!(($c, c) in seen)) {
+                    seen[$c, c] = 1
+                    distinct[c]++
+                }
+                count[$c, c]++
+                if ($c ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/)
+                    number[c, ++numbers[c]] = $c + 0
+            }
+        }
+        function rank_error(c, q, x,    below, upto, i) {
+            for (i = 1; i <= numbers[c]; i++) {
+                below += number[c, i] < x
+                upto += number[c, i] <= x
+            }
+            if (upto / numbers[c] < q - 0.03)
+                return upto / numbers[c]
+            if (below / numbers[c] > q + 0.03)
+                return below / numbers[c]
+            return -1
+        }
+        END {
+            for (c = 1; c <= columns; c++) {
+                if (!(name[c] in row)) {
+                    print name[c] ": no row"
+                    continue
+                }
+                split(row[name[c]], cell, "\t")
+                if (cell[2] != values[c] + 0 || cell[3] != empty[c] + 0)
+                    print name[c] ": " cell[2] " values, " cell[3] " empty, expected " \
+                        values[c] + 0 ", " empty[c] + 0
+                d = distinct[c] + 0
+                if (cell[4] < d * 0.95 - 1 || cell[4] > d * 1.05 + 1)
+                    print name[c] ": " cell[4] " distinct, exactly " d
+                numeric = values[c] > 0 && numbers[c] == values[c]
+                split("0.5 0.9 0.99", at, " ")
+                for (q = 1; q <= 3; q++) {
+                    if (!numeric) {
+                        if (cell[4 + q] != "-")
+                            print name[c] ": quantile " cell[4 + q] " of a text column"
+                    } else if ((r = rank_error(c, at[q], cell[4 + q] + 0)) >= 0) {
+                        print name[c] ": p" at[q] * 100 " " cell[4 + q] " has rank " r
+                    }
+                }
+                n = split(cell[8], heavy, ", ")
+                for (i = 1; i <= n && cell[8] != "-"; i++) {
+                    value = heavy[i]
+                    sub(/ \([0-9.]+%\)$/, "", value)
+                    shown = substr(heavy[i], length(value) + 3) + 0
+                    share = 100 * count[value, c] / values[c]
+                    if (shown < share - 0.1 || shown > share + 0.7)
+                        print name[c] ": " heavy[i] ", exactly " share "%"
+                }
+            }
+        }' "$cells" "$data_file"
+}
+
+# Sketch the file or a pipe of it and check the estimates
+run_sketch()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local source="$3"
+    shift 3
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    if [[ $source == pipe ]]; then
+        "$C_VERSION" -P -s markdown --sketch "$@" < "$data_file" > "$prefix.out" 2> "$prefix.err"
+    else
+        "$C_VERSION" -P -s markdown --sketch "$@" "$data_file" > "$prefix.out" 2> "$prefix.err"
+    fi
+    local exit_code=$?
+    markdown_cells "$prefix.out" > "$prefix.cells"
+    local headers=yes
+    [[ " $* " == *" -H "* ]] && headers=""
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code: $(head -c 200 "$prefix.err")" >> "$log"
+        test_passed=false
+    fi
+    check_sketch "$prefix.cells" "$data_file" "$headers" >> "$log"
+    [[ -s "$log" ]] && test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write records with unique, repeated, skewed, sparse and CJK columns
+make_data()
+{
+    local rows="$1"
+    local data_file="$2"
+
+    awk -v rows="$rows" 'BEGIN {
+        print "id,group,amount,status,sparse,city"
+        split("北京|東京|서울|Zürich|Paris|Ōsaka|上海", city, "|")
+        for (i = 1; i <= rows; i++) {
+            r = i * 7919 % 100003
+            status = r % 10 < 4 ? "hot" : r % 10 < 5 ? "warm" : "c" r % 20011
+            sparse = r % 10 < 3 ? "" : r % 300 / 4
+            printf "%d,g%d,%d,%s,%s,%s%d\n", i, r % 1000, r % 50021, status, sparse,
+                city[i % 7 + 1], r % 11
+        }
+    }' > "$data_file"
+}
+
+# Test the estimates on files and pipes of several sizes
+test_estimates()
+{
+    echo -e "${CYAN}=== Estimate Tests ===${NC}"
+
+    run_sketch "small_file" "$OUTPUT_DIR/small.csv" file
+    run_sketch "small_pipe" "$OUTPUT_DIR/small.csv" pipe
+    run_sketch "small_no_headers" "$OUTPUT_DIR/small.csv" file -H
+    run_sketch "large_file" "$OUTPUT_DIR/large.csv" file -j 1
+    run_sketch "large_threads" "$OUTPUT_DIR/large.csv" file -j 4
+    run_sketch "large_pipe" "$OUTPUT_DIR/large.csv" pipe
+    run_sketch "numbers_mixed" "$DATA_DIR/numbers_mixed.csv" file
+}
+
+# Test exact counts of a fixture with empty and missing cells
+test_fixtures()
+{
+    echo -e "${CYAN}=== Fixture Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/empty.csv"
+    printf 'a,b,c\n1,x,\n,y,3\n2,,4\n3,x\n5,x,abc\n' > "$data_file"
+    cat > "$OUTPUT_DIR/empty.expected" << 'EOF'
+| column | values | empty | distinct | p50 | p90 | p99 | top values |
+|--------|--------|-------|----------|-----|-----|-----|------------|
+| a      | 4      | 1     | 4        | 2   | 5   | 5   | -          |
+| b      | 4      | 1     | 2        | -   | -   | -   | x (75.0%)  |
+| c      | 3      | 2     | 3        | -   | -   | -   | -          |
+EOF
+    check_output "empty" "$OUTPUT_DIR/empty.expected" -s markdown --sketch "$data_file"
+    check_error "format" "--sketch cannot be combined" --sketch --format ndjson "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "Sketch"
+    check_executables
+    make_data 20000 "$OUTPUT_DIR/small.csv"
+    make_data 400000 "$OUTPUT_DIR/large.csv"
+
+    test_estimates
+    test_fixtures
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
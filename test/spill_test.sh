@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# --max-memory spill test for csview
+# Parsed rows past the budget go to a temporary file and are read back for
+# the render, so every budget must draw the same table as no budget at all,
+# from a file and from a pipe.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/spill"
+parse_options "$@"
+
+# Write a table larger than the budgets, with multi-line and wide fields
+make_data()
+{
+    { echo "id,name,note"
+      for ((i = 1; i <= 20000; i++)); do
+          if ((i % 1000 == 0)); then
+              printf '%d,"line %d""\nnext",宽字符%d\n' "$i" "$i" "$i"
+          else
+              echo "$i,name$((i % 89)),$((i * 31 % 977))"
+          fi
+      done; } > "$OUTPUT_DIR/large.csv"
+}
+
+# Render the input under each budget, from the file and from a pipe
+run_budgets()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    for budget in 1K 64K 1M; do
+        check_unchanged "${test_name}_${budget}_file" "--max-memory $budget" file "$data_file" "$@"
+        check_unchanged "${test_name}_${budget}_pipe" "--max-memory $budget" pipe "$data_file" "$@"
+    done
+}
+
+# Test the table renders over the data files
+test_tables()
+{
+    echo -e "${CYAN}=== Table Tests ===${NC}"
+
+    run_budgets "basic" "$DATA_DIR/basic.csv"
+    run_budgets "unicode" "$DATA_DIR/wide_unicode.csv" -s rounded
+    run_budgets "multiline" "$DATA_DIR/special_chars.csv" -s grid
+    run_budgets "query" "$DATA_DIR/query.csv" --sniff 0
+    run_budgets "large" "$OUTPUT_DIR/large.csv" --sniff 0
+    run_budgets "large_sniffed" "$OUTPUT_DIR/large.csv"
+}
+
+# Test the options that read the spilled rows back in other ways
+test_options()
+{
+    echo -e "${CYAN}=== Option Tests ===${NC}"
+
+    run_budgets "number" "$OUTPUT_DIR/large.csv" -n --sniff 0
+    run_budgets "no_headers" "$OUTPUT_DIR/large.csv" -H -s ascii
+    run_budgets "rows" "$OUTPUT_DIR/large.csv" --rows 9990-12010 --sniff 0
+    run_budgets "columns" "$OUTPUT_DIR/large.csv" --columns 3,1 --sniff 0
+    run_budgets "text" "$OUTPUT_DIR/large.csv" --format text
+}
+
+# Main test execution
+main()
+{
+    print_header "Spill"
+    check_executables
+    make_data
+
+    test_tables
+    test_options
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,289 @@
+#!/bin/bash
+
+# Shared harness of the C-only consistency tests, sourced by each of them.
+# A script sets OUTPUT_DIR, and for options of its own EXTRA_OPTIONS (getopts
+# letters), a handle_option function taking the letter and its argument and
+# an extra_usage function, then calls parse_options "$@".
+
+# Color definitions
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+CYAN='\033[0;36m'
+MAGENTA='\033[0;35m'
+NC='\033[0m' # No Color
+
+# Global counters
+TOTAL_TESTS=0
+PASSED_TESTS=0
+FAILED_TESTS=0
+
+# Configuration
+C_VERSION="../csview"
+DATA_DIR="./data"
+OUTPUT_DIR="./output"
+EXTRA_OPTIONS=""
+USAGE_ARGS=""
+VERBOSE=false
+STOP_ON_FAIL=false
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+CURRENT_TEST=""
+
+usage()
+{
+    echo "Usage: $0 [options]$USAGE_ARGS"
+    echo "Options:"
+    echo "  -c <path>    Path to C version executable (default: ../csview)"
+    echo "  -d <path>    Test data directory (default: ./data)"
+    echo "  -o <path>    Output directory (default: $OUTPUT_DIR)"
+    if declare -F extra_usage > /dev/null; then
+        extra_usage
+    fi
+    echo "  -v           Verbose mode"
+    echo "  -s           Stop on first failure"
+    echo "  -h           Show help"
+}
+
+# Parse command line arguments and create the output directory
+parse_options()
+{
+    local opt
+    while getopts "c:d:o:vsh$EXTRA_OPTIONS" opt; do
+        case $opt in
+        c) C_VERSION="$OPTARG" ;;
+        d) DATA_DIR="$OPTARG" ;;
+        o) OUTPUT_DIR="$OPTARG" ;;
+        v) VERBOSE=true ;;
+        s) STOP_ON_FAIL=true ;;
+        h)
+            usage
+            exit 0
+            ;;
+        *)
+            if ! declare -F handle_option > /dev/null || ! handle_option "$opt" "$OPTARG"; then
+                usage
+                exit 1
+            fi
+            ;;
+        esac
+    done
+
+    mkdir -p "$OUTPUT_DIR"
+}
+
+# Check executables
+check_executables()
+{
+    if [[ ! -x "$C_VERSION" ]]; then
+        echo -e "${RED}Error: C version executable not found or not executable: $C_VERSION${NC}"
+        exit 1
+    fi
+
+    if [[ ! -d "$DATA_DIR" ]]; then
+        echo -e "${RED}Error: Test data directory not found: $DATA_DIR${NC}"
+        exit 1
+    fi
+}
+
+require_python()
+{
+    if ! command -v python3 > /dev/null; then
+        echo -e "${RED}Error: python3 is needed to $1${NC}"
+        exit 1
+    fi
+}
+
+# Print the suite banner and its configuration
+print_header()
+{
+    echo -e "${MAGENTA}=== CSV Viewer $1 Test Suite ===${NC}"
+    echo "C version: $C_VERSION"
+    echo "Data directory: $DATA_DIR"
+    echo "Output directory: $OUTPUT_DIR"
+    echo
+}
+
+# Start a test, named in verbose mode
+begin_test()
+{
+    CURRENT_TEST="$1"
+    TOTAL_TESTS=$((TOTAL_TESTS + 1))
+
+    if [[ "$VERBOSE" == true ]]; then
+        echo -e "${BLUE}Test $TOTAL_TESTS: $CURRENT_TEST${NC}"
+    fi
+}
+
+# Record the outcome of the current test. A failure prints its log indented
+# and the note, if any, after its name.
+end_test()
+{
+    local test_passed="$1"
+    local log="$2"
+    local note="$3"
+
+    if [[ "$test_passed" == true ]]; then
+        PASSED_TESTS=$((PASSED_TESTS + 1))
+        [[ "$VERBOSE" == true ]] && echo -e "  ${GREEN}✓ PASSED${NC}"
+        return 0
+    fi
+
+    FAILED_TESTS=$((FAILED_TESTS + 1))
+    echo -e "  ${RED}✗ FAILED: $CURRENT_TEST${note:+ ($note)}${NC}"
+    if [[ -s "$log" ]]; then
+        head -20 "$log" | sed 's/^/    /'
+    fi
+
+    if [[ "$STOP_ON_FAIL" == true ]]; then
+        echo -e "${RED}Stopping on first failure as requested${NC}"
+        exit 1
+    fi
+}
+
+# Log the difference when file actual is not the same as file expected
+expect_same()
+{
+    local log="$1"
+    local label="$2"
+    local expected="$3"
+    local actual="$4"
+
+    if ! cmp -s "$expected" "$actual"; then
+        echo "$label:" >> "$log"
+        diff -u "$expected" "$actual" | head -20 >> "$log"
+        return 1
+    fi
+    return 0
+}
+
+# Run csview with the arguments, expecting success and the bytes of file
+# expected on stdout
+check_output()
+{
+    local test_name="$1"
+    local expected="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P "$@" > "$prefix.out" 2> "$prefix.err"
+    local exit_code=$?
+
+    local test_passed=true
+    if [[ $exit_code -ne 0 ]]; then
+        echo "exit code $exit_code: $(head -c 200 "$prefix.err")" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "csview $*" "$expected" "$prefix.out" || test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Run csview with the arguments on data_file, read as a file or through a
+# pipe, with and without the extra options (one string, after the arguments
+# so that they override them), expecting the same stdout and exit status
+check_unchanged()
+{
+    local test_name="$1"
+    local extra="$2"
+    local input="$3"
+    local data_file="$4"
+    shift 4
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local plain_exit_code extra_exit_code
+    if [[ "$input" == pipe ]]; then
+        cat "$data_file" | "$C_VERSION" -P "$@" > "$prefix.out" 2> "$prefix.err"
+        plain_exit_code=${PIPESTATUS[1]}
+        cat "$data_file" | "$C_VERSION" -P "$@" $extra > "${prefix}_extra.out" \
+            2> "${prefix}_extra.err"
+        extra_exit_code=${PIPESTATUS[1]}
+    else
+        "$C_VERSION" -P "$@" "$data_file" > "$prefix.out" 2> "$prefix.err"
+        plain_exit_code=$?
+        "$C_VERSION" -P "$@" $extra "$data_file" > "${prefix}_extra.out" 2> "${prefix}_extra.err"
+        extra_exit_code=$?
+    fi
+
+    local test_passed=true
+    if [[ $plain_exit_code -ne 0 || $plain_exit_code -ne $extra_exit_code ]]; then
+        echo "exit codes: $plain_exit_code, with $extra: $extra_exit_code" >> "$log"
+        head -c 200 "${prefix}_extra.err" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "csview $* vs with $extra" "$prefix.out" "${prefix}_extra.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Print the cells of a -s markdown table as tab-separated rows
+markdown_cells()
+{
+    awk -F'|' '!/^\|[-:|]+\|$/ {
+        line = ""
+        for (i = 2; i < NF; i++) {
+            c = $i
+            gsub(/^ +| +$/, "", c)
+            line = line (i > 2 ? "\t" : "") c
+        }
+        print line
+    }' "$1"
+}
+
+# Run csview with the arguments, expecting a failure with message on stderr
+check_error()
+{
+    local test_name="$1"
+    local message="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P "$@" > "$prefix.out" 2> "$prefix.err"
+    local exit_code=$?
+
+    local test_passed=true
+    if [[ $exit_code -eq 0 ]]; then
+        echo "csview $*: exit code is 0" >> "$log"
+        test_passed=false
+    fi
+    if ! grep -qF -- "$message" "$prefix.err"; then
+        echo "csview $*: missing on stderr: $message" >> "$log"
+        test_passed=false
+    fi
+
+    end_test "$test_passed" "$log"
+}
+
+# Print the summary and exit with the result, pointing failures at hint
+finish()
+{
+    local hint="${1:-Check the logs in $OUTPUT_DIR}"
+
+    echo
+    echo -e "${MAGENTA}=== Test Summary ===${NC}"
+    echo "Total tests: $TOTAL_TESTS"
+    echo -e "Passed: ${GREEN}$PASSED_TESTS${NC}"
+    echo -e "Failed: ${RED}$FAILED_TESTS${NC}"
+
+    if [[ $FAILED_TESTS -eq 0 ]]; then
+        echo -e "${GREEN}All tests passed successfully!${NC}"
+        exit 0
+    else
+        echo -e "${RED}$FAILED_TESTS test(s) failed${NC}"
+        echo "$hint"
+        exit 1
+    fi
+}
@@ -0,0 +1,101 @@
+#!/bin/bash
+
+# -j worker thread test for csview
+# Widths are measured and rows formatted in blocks on worker threads, and the
+# file-slicing modes split a mapped file at guessed record starts. Any thread
+# count must print what one thread prints.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/threads"
+ROWS=300000
+EXTRA_OPTIONS="n:"
+
+extra_usage()
+{
+    echo "  -n <num>     Records of the rendered input, six times more are sliced (default: 300000)"
+}
+
+handle_option()
+{
+    case $1 in
+    n) ROWS="$2" ;;
+    *) return 1 ;;
+    esac
+}
+
+parse_options "$@"
+
+# Write rows records, with quoted delimiters and line breaks where a slice
+# start may be guessed
+make_data()
+{
+    local rows="$1"
+    local data_file="$2"
+
+    awk -v rows="$rows" 'BEGIN {
+        print "id,group,amount,note"
+        for (i = 1; i <= rows; i++) {
+            note = "n" (i * 7919 % 10007)
+            if (i % 997 == 0)
+                note = "\"quoted, with\nbreak " i "\""
+            else if (i % 991 == 0)
+                note = "宽" i
+            printf "%d,g%d,%d.%02d,%s\n", i, i % 37, i * 31 % 9973, i % 100, note
+        }
+    }' > "$data_file"
+}
+
+# Run the mode with several thread counts against one thread
+run_threads()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    for threads in 2 3 8; do
+        check_unchanged "${test_name}_j${threads}" "-j $threads" file "$data_file" -j 1 "$@"
+    done
+}
+
+# Test width measuring and row formatting
+test_tables()
+{
+    echo -e "${CYAN}=== Table Tests ===${NC}"
+
+    run_threads "table" "$OUTPUT_DIR/large.csv" --sniff 0
+    run_threads "table_sniffed" "$OUTPUT_DIR/large.csv"
+    run_threads "number" "$OUTPUT_DIR/large.csv" -n -s grid --sniff 0
+    run_threads "align" "$OUTPUT_DIR/large.csv" --body-align center -p 2 --sniff 0
+    run_threads "rows" "$OUTPUT_DIR/large.csv" --rows 12345-234567 --sniff 0
+    run_threads "columns" "$OUTPUT_DIR/large.csv" --columns 4,1 --sniff 0
+    run_threads "spilled" "$OUTPUT_DIR/large.csv" --max-memory 1M --sniff 0
+    run_threads "query" "$DATA_DIR/query.csv" --sniff 0
+    check_unchanged "table_pipe_j4" "-j 4" pipe "$OUTPUT_DIR/large.csv" -j 1 --sniff 0
+}
+
+# Test the modes that split the file into slices
+test_slices()
+{
+    echo -e "${CYAN}=== File Slice Tests ===${NC}"
+
+    run_threads "count" "$OUTPUT_DIR/huge.csv" --count
+    run_threads "group_by" "$OUTPUT_DIR/huge.csv" --group-by 2 --agg count,sum:3,max:1
+    run_threads "top" "$OUTPUT_DIR/huge.csv" --top 50 --by 3:num:desc
+}
+
+# Main test execution
+main()
+{
+    print_header "Worker Thread"
+    check_executables
+    # Render blocks need many rows, file slices many megabytes each
+    make_data "$ROWS" "$OUTPUT_DIR/large.csv"
+    make_data $((ROWS * 6)) "$OUTPUT_DIR/huge.csv"
+
+    test_tables
+    test_slices
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,180 @@
+#!/bin/bash
+
+# --top/--by test for csview
+# The heap must keep the records a stable sort | head keeps: text in byte
+# order, :num numbers first in numeric order with the rest after them in text
+# order, :desc reversing both, and ties in file order either way, whether the
+# input is a pipe, a file or a file sliced across worker threads.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/top"
+parse_options "$@"
+
+# Print the header and the first k records of an unquoted file ordered by
+# column, as tab-separated rows. Numeric orders sort the numbers with sort -g
+# and the other cells as text after them
+reference_top()
+{
+    local data_file="$1"
+    local k="$2"
+    local column="$3"
+    local flags="$4"
+    local headers="$5"
+
+    local reverse=""
+    [[ $flags == *desc* ]] && reverse=r
+    local body="$OUTPUT_DIR/reference.body"
+    if [[ -n "$headers" ]]; then
+        head -n 1 "$data_file"
+        tail -n +2 "$data_file" > "$body"
+    else
+        cp "$data_file" "$body"
+    fi
+
+    {
+        if [[ $flags == *num* ]]; then
+            awk -F, -v column="$column" \
+                '$column ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/' "$body" |
+                LC_ALL=C sort -s -t, -k"$column,${column}g$reverse"
+            awk -F, -v column="$column" \
+                '$column !~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/' "$body" |
+                LC_ALL=C sort -s -t, -k"$column,$column$reverse"
+        else
+            LC_ALL=C sort -s -t, -k"$column,$column$reverse" "$body"
+        fi
+    } | head -n "$k"
+    rm -f "$body"
+}
+
+# Run --top on the file and a pipe of it and compare the cells with the
+# reference's records
+run_top()
+{
+    local test_name="$1"
+    local data_file="$2"
+    local k="$3"
+    local column="$4"
+    local by="$5"
+    shift 5
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    local headers=yes
+    [[ " $* " == *" -H "* ]] && headers=""
+    reference_top "$data_file" "$k" "$column" "$by" "$headers" | tr ',' '\t' > "$prefix.expected"
+    "$C_VERSION" -P -s markdown --sniff 0 --top "$k" --by "$by" "$@" "$data_file" \
+        > "${prefix}_file.out" 2> "$prefix.err"
+    local file_exit_code=$?
+    "$C_VERSION" -P -s markdown --sniff 0 --top "$k" --by "$by" "$@" < "$data_file" \
+        > "${prefix}_pipe.out" 2>> "$prefix.err"
+    local pipe_exit_code=$?
+    markdown_cells "${prefix}_file.out" > "$prefix.cells"
+
+    local test_passed=true
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "sort | head vs csview" "$prefix.expected" "$prefix.cells" ||
+        test_passed=false
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write records whose scores tie often and mix integers, decimals, exponents,
+# negatives and text, and whose names mix ASCII and CJK
+make_data()
+{
+    local rows="$1"
+    local data_file="$2"
+
+    awk -v rows="$rows" 'BEGIN {
+        print "id,name,score,group"
+        split("北京|Paris|東京|paris|Zürich|", city, "|")
+        for (i = 1; i <= rows; i++) {
+            r = i * 7919 % 10007
+            if (r % 53 == 0)
+                score = "n/a"
+            else if (r % 59 == 0)
+                score = ""
+            else if (r % 61 == 0)
+                score = "x" r % 7
+            else if (r % 7 == 0)
+                score = (r % 89) "e" (r % 3)
+            else if (r % 5 == 0)
+                score = "-" (r % 97) "." (r % 10)
+            else if (r % 3 == 0)
+                score = "+" (r % 101)
+            else
+                score = r % 211
+            printf "%d,%s%d,%s,g%d\n", i, city[i % 6 + 1], r % 17, score, i % 5
+        }
+    }' > "$data_file"
+}
+
+# Test text and numeric orders in both directions
+test_orders()
+{
+    echo -e "${CYAN}=== Order Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/small.csv"
+    run_top "text" "$data_file" 50 2 name
+    run_top "text_desc" "$data_file" 50 2 name:desc
+    run_top "text_scores" "$data_file" 300 3 score
+    run_top "num" "$data_file" 300 3 score:num
+    run_top "num_desc" "$data_file" 300 3 score:num:desc
+    run_top "num_asc" "$data_file" 40 3 score:asc:num
+    run_top "ties" "$data_file" 700 4 group
+    run_top "one" "$data_file" 1 3 score:num:desc
+    run_top "all" "$data_file" 5000 3 score:num
+    run_top "by_number" "$data_file" 25 3 3:num:desc
+    run_top "no_headers" "$data_file" 25 3 3:num -H
+}
+
+# Test large inputs, sliced across worker threads when they are files
+test_large()
+{
+    echo -e "${CYAN}=== Large Input Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/large.csv"
+    run_top "large" "$data_file" 1000 3 score:num -j 1
+    run_top "large_threads" "$data_file" 1000 3 score:num -j 4
+    run_top "large_desc_threads" "$data_file" 2000 3 score:num:desc -j 8
+    run_top "large_text_threads" "$data_file" 500 2 name:desc -j 3
+}
+
+# Test the errors
+test_errors()
+{
+    echo -e "${CYAN}=== Error Tests ===${NC}"
+
+    local data_file="$OUTPUT_DIR/small.csv"
+    check_error "zero" "--top must be a positive number" --top 0 --by score "$data_file"
+    check_error "missing_by" "--top and --by must be used together" --top 3 "$data_file"
+    check_error "unknown_column" "Unknown --by column: nope" --top 3 --by nope:num "$data_file"
+    check_error "no_column" "--by needs a column" --top 3 --by :num "$data_file"
+    check_error "format" "--top only applies to plain table output" \
+        --top 3 --by score --format ndjson "$data_file"
+}
+
+# Main test execution
+main()
+{
+    print_header "Top"
+    check_executables
+    make_data 3000 "$OUTPUT_DIR/small.csv"
+    make_data 500000 "$OUTPUT_DIR/large.csv"
+
+    test_orders
+    test_large
+    test_errors
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main
@@ -0,0 +1,178 @@
+#!/bin/bash
+
+# -x vertical view test for csview
+# Records print as blocks of header: value lines as they are parsed, framed
+# by the header names alone. Fixtures pin the blocks, numbering, records
+# longer than the header and the reframe when their key column widens; a pipe
+# must print what the file does and an endless one must stream.
+
+source "$(dirname "$0")/test_lib.sh"
+OUTPUT_DIR="./output/vertical"
+parse_options "$@"
+
+# Write a fixture file from stdin
+fixture()
+{
+    cat > "$OUTPUT_DIR/$1"
+}
+
+# Print the file with -x and the arguments on the file and on a pipe of it
+run_stream()
+{
+    local test_name="$1"
+    local data_file="$2"
+    shift 2
+
+    begin_test "$test_name"
+
+    local prefix="$OUTPUT_DIR/$test_name"
+    local log="$prefix.log"
+    : > "$log"
+    "$C_VERSION" -P -x "$@" "$data_file" > "${prefix}_file.out" 2>> "$log"
+    local file_exit_code=$?
+    "$C_VERSION" -P -x "$@" < "$data_file" > "${prefix}_pipe.out" 2>> "$log"
+    local pipe_exit_code=$?
+
+    local test_passed=true
+    if [[ $file_exit_code -ne 0 || $pipe_exit_code -ne 0 ]]; then
+        echo "exit codes: file=$file_exit_code, pipe=$pipe_exit_code" >> "$log"
+        test_passed=false
+    fi
+    expect_same "$log" "file vs pipe" "${prefix}_file.out" "${prefix}_pipe.out" ||
+        test_passed=false
+
+    end_test "$test_passed" "$log"
+}
+
+# Write the inputs and the blocks expected of them
+make_data()
+{
+    fixture ragged.csv << 'EOF'
+id,name
+1,Alice
+2,Bob,extra,more
+EOF
+    fixture ragged.expected << 'EOF'
+┌──────┬──────────────────────────
+│  id  │ 1
+│ name │ Alice
+├──────┼──────────────────────────
+│  id  │ 2
+│ name │ Bob
+│  3   │ extra
+│  4   │ more
+└──────┴──────────────────────────
+EOF
+    fixture ragged_number.expected << 'EOF'
+┌──────┬──────────────────────────
+│  #   │ 1
+│  id  │ 1
+│ name │ Alice
+├──────┼──────────────────────────
+│  #   │ 2
+│  id  │ 2
+│ name │ Bob
+│  3   │ extra
+│  4   │ more
+└──────┴──────────────────────────
+EOF
+    fixture ragged_no_headers.expected << 'EOF'
++---+--------------------------
+| 1 | id
+| 2 | name
++---+--------------------------
+| 1 | 1
+| 2 | Alice
++---+--------------------------
+| 1 | 2
+| 2 | Bob
+| 3 | extra
+| 4 | more
++---+--------------------------
+EOF
+    fixture widening.csv << 'EOF'
+a,b
+1,2
+1,2,3,4,5,6,7,8,9,10,11,12
+3,4
+EOF
+    fixture widening.expected << 'EOF'
+┌───┬──────────────────────────
+│ a │ 1
+│ b │ 2
+└───┴──────────────────────────
+┌────┬──────────────────────────
+│ a  │ 1
+│ b  │ 2
+│ 3  │ 3
+│ 4  │ 4
+│ 5  │ 5
+│ 6  │ 6
+│ 7  │ 7
+│ 8  │ 8
+│ 9  │ 9
+│ 10 │ 10
+│ 11 │ 11
+│ 12 │ 12
+├────┼──────────────────────────
+│ a  │ 3
+│ b  │ 4
+└────┴──────────────────────────
+EOF
+}
+
+# Test the blocks of the fixtures
+test_fixtures()
+{
+    echo -e "${CYAN}=== Fixture Tests ===${NC}"
+
+    check_output "ragged" "$OUTPUT_DIR/ragged.expected" -x "$OUTPUT_DIR/ragged.csv"
+    check_output "ragged_number" "$OUTPUT_DIR/ragged_number.expected" \
+        -x -n "$OUTPUT_DIR/ragged.csv"
+    check_output "ragged_no_headers" "$OUTPUT_DIR/ragged_no_headers.expected" \
+        -x -H -s ascii "$OUTPUT_DIR/ragged.csv"
+    check_output "widening" "$OUTPUT_DIR/widening.expected" -x "$OUTPUT_DIR/widening.csv"
+}
+
+# Test that pipes print what files do, across styles and data files
+test_streams()
+{
+    echo -e "${CYAN}=== Stream Tests ===${NC}"
+
+    run_stream "widening_styles" "$OUTPUT_DIR/widening.csv" -s grid -n
+    run_stream "unicode" "$DATA_DIR/unicode.csv"
+    run_stream "emoji" "$DATA_DIR/emoji_data.csv" -s rounded -n
+    run_stream "cjk_no_headers" "$DATA_DIR/cjk_mixed.csv" -H
+    run_stream "multiline" "$DATA_DIR/special_chars.csv" -s markdown
+    run_stream "query" "$DATA_DIR/query.csv" -n
+    run_stream "tsv" "$DATA_DIR/tsv_data.tsv" -t -s reinforced
+
+    # Blocks come out before the input ends
+    begin_test "endless_pipe"
+    local log="$OUTPUT_DIR/endless_pipe.log"
+    local lines
+    lines=$({ echo "a,b"; yes "1,2"; } | timeout 5 "$C_VERSION" -P -x 2> /dev/null | head -n 4 |
+        wc -l)
+    : > "$log"
+    local test_passed=true
+    if [[ $lines -ne 4 ]]; then
+        echo "got $lines lines before the timeout" >> "$log"
+        test_passed=false
+    fi
+    end_test "$test_passed" "$log"
+}
+
+# Main test execution
+main()
+{
+    print_header "Vertical View"
+    check_executables
+    make_data
+
+    test_fixtures
+    test_streams
+
+    finish "Check the outputs and logs in $OUTPUT_DIR"
+}
+
+main